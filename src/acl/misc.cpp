@@ -96,7 +96,7 @@ UploadMaximum(const User& user, const fs::Path& path)
     for (const auto& limit : cfg::Get().MaximumSpeed())
     {
       if (limit.Uploads() > 0 && limit.ACL().Evaluate(info) &&
-          util::WildcardMatch(limit.Path(), path.ToString()))
+          limit.PathMask().Match(path.ToString()))
       {
         matches.emplace_back(&limit);
       }
@@ -115,7 +115,7 @@ DownloadMaximum(const User& user, const fs::Path& path)
     for (const auto& limit : cfg::Get().MaximumSpeed())
     {
       if (limit.Downloads() > 0 && limit.ACL().Evaluate(info) &&
-          util::WildcardMatch(limit.Path(), path.ToString()))
+          limit.PathMask().Match(path.ToString()))
       {
         matches.emplace_back(&limit);
       }
@@ -130,7 +130,7 @@ int UploadMinimum(const User& user, const fs::Path& path)
   for (const auto& limit : cfg::Get().MinimumSpeed())
   {
     if (limit.ACL().Evaluate(info) &&
-        util::WildcardMatch(limit.Path(), path.ToString()))
+        limit.PathMask().Match(path.ToString()))
     {
       return limit.Uploads();
     }
@@ -144,7 +144,7 @@ int DownloadMinimum(const User& user, const fs::Path& path)
   for (const auto& limit : cfg::Get().MinimumSpeed())
   {
     if (limit.ACL().Evaluate(info) &&
-        util::WildcardMatch(limit.Path(), path.ToString()))
+        limit.PathMask().Match(path.ToString()))
     {
       return limit.Downloads();
     }
@@ -206,7 +206,7 @@ CreditCheck(const User& user, const fs::VirtualPath& path)
   auto info = user.ACLInfo();
   for (const auto& cc : cfg::Get().Creditcheck())
   {
-    if (util::WildcardMatch(cc.Path(), path.ToString()) &&
+    if (cc.PathMask().Match(path.ToString()) &&
         cc.ACL().Evaluate(info))
     {
       return boost::optional<const cfg::Creditcheck&>(cc);
@@ -221,7 +221,7 @@ CreditLoss(const User& user, const fs::VirtualPath& path)
   auto info = user.ACLInfo();
   for (const auto& cc : cfg::Get().Creditloss())
   {
-    if (util::WildcardMatch(cc.Path(), path.ToString()) &&
+    if (cc.PathMask().Match(path.ToString()) &&
         cc.ACL().Evaluate(info))
     {
       return boost::optional<const cfg::Creditloss&>(cc);
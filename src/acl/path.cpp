@@ -22,13 +22,8 @@ bool HiddenFile(const fs::VirtualPath& path)
 
   for (auto& hf : cfg::Get().HiddenFiles())
   {
-    if (util::WildcardMatch(hf.Path(), dirname))
-    {
-      for (auto& mask : hf.Masks())
-      {
-        if (util::WildcardMatch(mask, basename)) return true;
-      }
-    }
+    if (hf.PathMask().Match(dirname) && hf.MaskList().MatchAny(basename))
+      return true;
   }
   return false;
 }
@@ -62,7 +57,7 @@ bool Evaluate(const std::vector<cfg::Right>& rights,
         return right.ACL().Evaluate(info);
     }
     else
-      if (util::WildcardMatch(right.Path(), path.ToString()))
+      if (right.PathMask().Match(path.ToString()))
         return right.ACL().Evaluate(info);
   }
   return false;
@@ -163,12 +158,8 @@ struct Traits<Download>
 private:
   static util::Error CheckNoretrieve(const fs::VirtualPath& path)
   {
-    const cfg::Config& config = cfg::Get();
-    for (auto& mask : config.Noretrieve())
-    {
-      if (util::WildcardMatch(mask, path.Basename().ToString()))
-        return util::Error::Failure(EACCES);
-    }
+    if (cfg::Get().NoretrieveMasks().MatchAny(path.Basename().ToString()))
+      return util::Error::Failure(EACCES);
     return util::Error::Success();
   }
 
@@ -56,6 +56,7 @@ Config::Config(const std::string& configPath, bool tool) :
   currentSection(nullptr),
   port(-1),
   freeSpace(ParseSize("1G")),
+  freeSpaceInterval(10),
   sitenameLong("EBFTPD"),
   sitenameShort("EB"),
   datapath("data"),
@@ -72,6 +73,8 @@ Config::Config(const std::string& configPath, bool tool) :
   multiplierMax(10),
   emptyNuke(102400),
   maxSitecmdLines(1000),
+  databaseBackend(::cfg::DatabaseBackend::MongoDB),
+  ownershipStore(::cfg::OwnershipStore::Xattr),
   weekStart(::cfg::WeekStart::Sunday),
   epsvFxp(::cfg::EPSVFxp::Allow),
   maximumRatio(10),
@@ -149,6 +152,22 @@ void Config::ParseGlobal(const std::string& opt, std::vector<std::string>& toks)
     ParameterCheck(opt, toks, 3, 5);
     database = ::cfg::Database(toks);
   }
+  else if (opt == "database_backend")
+  {
+    ParameterCheck(opt, toks, 1);
+    util::ToLower(toks[0]);
+    if (toks[0] == "mongodb") databaseBackend = ::cfg::DatabaseBackend::MongoDB;
+    else if (toks[0] == "embedded") databaseBackend = ::cfg::DatabaseBackend::Embedded;
+    else throw ConfigError("database_backend must be either mongodb or embedded.");
+  }
+  else if (opt == "ownership_store")
+  {
+    ParameterCheck(opt, toks, 1);
+    util::ToLower(toks[0]);
+    if (toks[0] == "xattr") ownershipStore = ::cfg::OwnershipStore::Xattr;
+    else if (toks[0] == "table") ownershipStore = ::cfg::OwnershipStore::Table;
+    else throw ConfigError("ownership_store must be either xattr or table.");
+  }
   else
   if (opt == "sitepath")
   {
@@ -200,6 +219,12 @@ void Config::ParseGlobal(const std::string& opt, std::vector<std::string>& toks)
     ParameterCheck(opt, toks, 1);
     freeSpace = ParseSize(toks[0]);
   }
+  else if (opt == "free_space_interval")
+  {
+    ParameterCheck(opt, toks, 1);
+    freeSpaceInterval = boost::lexical_cast<int>(toks[0]);
+    if (freeSpaceInterval < 1) throw boost::bad_lexical_cast();
+  }
   else if (opt == "total_users")
   {
     ParameterCheck(opt, toks, 1);
@@ -323,11 +348,13 @@ void Config::ParseGlobal(const std::string& opt, std::vector<std::string>& toks)
     ParameterCheck(opt, toks, 1, -1);
     idleCommands.insert(idleCommands.end(), toks.begin(), toks.end());
     for (auto& cmd : idleCommands) util::ToUpper(cmd);
+    for (auto& cmd : toks) idleCommandMasks.Add(cmd, util::Wildcard::CaseFold);
   }
   else if (opt == "noretrieve")
   {
     ParameterCheck(opt, toks, 1, -1);
     noretrieve.insert(noretrieve.end(), toks.begin(), toks.end());
+    for (auto& mask : toks) noretrieveMasks.Add(mask);
   }
   else if (opt == "maximum_speed")
   {
@@ -482,16 +509,19 @@ void Config::ParseGlobal(const std::string& opt, std::vector<std::string>& toks)
   {
     ParameterCheck(opt, toks, 1, -1);
     eventpath.insert(eventpath.end(), toks.begin(), toks.end());
+    for (auto& mask : toks) eventpathMasks.Add(mask);
   }
   else if (opt == "dupe_path")
   {
     ParameterCheck(opt, toks, 1, -1);
     dupepath.insert(dupepath.end(), toks.begin(), toks.end());
+    for (auto& mask : toks) dupepathMasks.Add(mask);
   }
   else if (opt == "index_path")
   {
     ParameterCheck(opt, toks, 1, -1);
     indexpath.insert(indexpath.end(), toks.begin(), toks.end());
+    for (auto& mask : toks) indexpathMasks.Add(mask);
   } 
   else if (opt == "hideinwho")
   {
@@ -611,6 +641,16 @@ void Config::ParseGlobal(const std::string& opt, std::vector<std::string>& toks)
     ParameterCheck(opt, toks, 1, 2);
     postCheck.emplace_back(toks);
   }
+  else if (opt == "script_worker")
+  {
+    ParameterCheck(opt, toks, 1, 3);
+    scriptWorker.emplace_back(toks);
+  }
+  else if (opt == "zipscript")
+  {
+    ParameterCheck(opt, toks, 1, -1);
+    for (auto& mask : toks) zipscriptMasks.Add(mask);
+  }
   else if (opt == "section")
   {
     ParameterCheck(opt, toks, 1);
@@ -707,6 +747,7 @@ void Config::ParseSection(const std::string& opt, std::vector<std::string>& toks
   {
     ParameterCheck(opt, toks, 1, -1);
     currentSection->paths.insert(currentSection->paths.end(), toks.begin(), toks.end());
+    for (auto& mask : toks) currentSection->pathMasks.Add(mask);
   }
   else if (opt == "separate_credits")
   {
@@ -832,17 +873,22 @@ ConfigPtr Config::Load(std::string configPath, bool tool)
 bool Config::IsEventLogged(const std::string& path) const
 {
   if (path.empty()) return false;
-  return util::WildcardMatch(eventpath, path + (path.back() != '/' ? "/" : ""));
+  return eventpathMasks.MatchAny(path + (path.back() != '/' ? "/" : ""));
 }
 
 bool Config::IsDupeLogged(const std::string& path) const
 {
-  return util::WildcardMatch(dupepath, path + (path.back() != '/' ? "/" : ""));
+  return dupepathMasks.MatchAny(path + (path.back() != '/' ? "/" : ""));
 }
 
 bool Config::IsIndexed(const std::string& path) const
 {
-  return util::WildcardMatch(indexpath, path + (path.back() != '/' ? "/" : ""));
+  return indexpathMasks.MatchAny(path + (path.back() != '/' ? "/" : ""));
+}
+
+bool Config::IsZipscripted(const std::string& path) const
+{
+  return zipscriptMasks.MatchAny(path + (path.back() != '/' ? "/" : ""));
 }
 
 // end namespace
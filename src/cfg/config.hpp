@@ -18,6 +18,8 @@ namespace cfg
 {
 
 enum class WeekStart { Sunday, Monday };
+enum class DatabaseBackend { MongoDB, Embedded };
+enum class OwnershipStore { Xattr, Table };
 enum class EPSVFxp { Allow, Deny, Force };
 enum class LogAddresses { Never, Errors, Always };
 
@@ -51,6 +53,7 @@ class Config
   ::cfg::AsciiDownloads asciiDownloads;
   ::cfg::AsciiUploads asciiUploads;
   long long freeSpace;
+  int freeSpaceInterval;
   std::string sitenameLong;
   std::string sitenameShort;
   std::string loginPrompt;
@@ -111,6 +114,9 @@ class Config
   std::vector<std::string> eventpath;
   std::vector<std::string> dupepath;
   std::vector<std::string> indexpath;
+  util::WildcardList eventpathMasks;
+  util::WildcardList dupepathMasks;
+  util::WildcardList indexpathMasks;
 
   // end rights
   std::vector< ::cfg::PathFilter> pathFilter;
@@ -122,10 +128,12 @@ class Config
   bool dlIncomplete;
   std::vector< ::cfg::Cscript> cscript;
   std::vector<std::string> idleCommands;
+  util::WildcardList idleCommandMasks;
   int totalUsers;
   ::cfg::Lslong lslong;
   std::vector< ::cfg::HiddenFiles> hiddenFiles;
   std::vector<std::string> noretrieve;
+  util::WildcardList noretrieveMasks;
   int multiplierMax;
   long long emptyNuke;
   std::vector< ::cfg::Creditcheck> creditcheck;
@@ -137,10 +145,14 @@ class Config
   int maxSitecmdLines;
   ::cfg::IdleTimeout idleTimeout;
   ::cfg::Database database;
+  ::cfg::DatabaseBackend databaseBackend;
+  ::cfg::OwnershipStore ownershipStore;
   ::cfg::WeekStart weekStart;
   std::vector<CheckScript> preCheck;
   std::vector<CheckScript> preDirCheck;
   std::vector<CheckScript> postCheck;
+  std::vector< ::cfg::ScriptWorker> scriptWorker;
+  util::WildcardList zipscriptMasks;
   std::unordered_map<std::string, acl::ACL> commandACLs;  
   std::map<std::string, Section> sections;
   ::cfg::EPSVFxp epsvFxp;
@@ -184,6 +196,8 @@ public:
   int Version() const { return version; }
 
   const ::cfg::Database& Database() const { return database; }
+  ::cfg::DatabaseBackend DatabaseBackend() const { return databaseBackend; }
+  ::cfg::OwnershipStore OwnershipStore() const { return ownershipStore; }
   const std::string& Sitepath() const { return sitepath; }
   const std::string& Pidfile() const { return pidfile; }
   const std::string& TlsCertificate() const { return tlsCertificate; }
@@ -192,6 +206,7 @@ public:
   const ::cfg::AsciiDownloads& AsciiDownloads() const { return asciiDownloads; } 
   const ::cfg::AsciiUploads& AsciiUploads() const { return asciiUploads; } 
   long long FreeSpace() const { return freeSpace; }
+  int FreeSpaceInterval() const { return freeSpaceInterval; }
   const std::string& SitenameLong() const { return sitenameLong; }
   const std::string& SitenameShort() const { return sitenameShort; }
   const std::string& LoginPrompt() const { return loginPrompt; }
@@ -258,6 +273,7 @@ public:
   bool IsDupeLogged(const std::string& path) const;
   bool IsIndexed(const std::string& path) const;
   const std::vector<std::string>& Indexed() const { return indexpath; }
+  bool IsZipscripted(const std::string& path) const;
 
   const std::vector< ::cfg::PathFilter>& PathFilter() const { return pathFilter; }
   const ::cfg::MaxUsers& MaxUsers() const { return maxUsers; }
@@ -268,10 +284,12 @@ public:
   bool DlIncomplete() const { return dlIncomplete; }
   const std::vector< ::cfg::Cscript>& Cscript() const { return cscript; }
   const std::vector<std::string>& IdleCommands() const { return idleCommands; }
+  const util::WildcardList& IdleCommandMasks() const { return idleCommandMasks; }
   int TotalUsers() const { return totalUsers; }
   const ::cfg::Lslong& Lslong() const { return lslong; }
   const std::vector< ::cfg::HiddenFiles>& HiddenFiles() const { return hiddenFiles; }
   const std::vector<std::string>& Noretrieve() const { return noretrieve; }
+  const util::WildcardList& NoretrieveMasks() const { return noretrieveMasks; }
   int MultiplierMax() const { return multiplierMax; }
   long long EmptyNuke() const { return emptyNuke; }
   const std::vector< ::cfg::Creditcheck>& Creditcheck() const { return creditcheck; }
@@ -286,6 +304,7 @@ public:
   const std::vector<CheckScript>& PreCheck() const { return preCheck; }
   const std::vector<CheckScript>& PreDirCheck() const { return preDirCheck; }
   const std::vector<CheckScript>& PostCheck() const { return postCheck; }  
+  const std::vector< ::cfg::ScriptWorker>& ScriptWorker() const { return scriptWorker; }
   const std::map<std::string, Section>& Sections() const { return sections; }
   boost::optional<const Section&> SectionMatch(const std::string& path) const;
   ::cfg::EPSVFxp EPSVFxp() const { return epsvFxp; }
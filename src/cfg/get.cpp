@@ -60,6 +60,7 @@ void StopStartCheck()
   if (shared->Port() != old.Port()) settings.push_back("port");
   if (shared->TlsCertificate() != old.TlsCertificate()) settings.push_back("tls_certificate");
   if (shared->TlsCiphers() != old.TlsCiphers()) settings.push_back("tls_ciphers");
+  if (shared->OwnershipStore() != old.OwnershipStore()) settings.push_back("ownership_store");
   
   if (shared->Database().Address() != old.Database().Address() ||   
       shared->Database().Port() != old.Database().Port())
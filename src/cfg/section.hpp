@@ -3,6 +3,7 @@
 
 #include <string>
 #include <vector>
+#include "util/wildcard.hpp"
 
 namespace fs
 {
@@ -16,6 +17,7 @@ class Section
 {
   std::string name;
   std::vector<std::string> paths;
+  util::WildcardList pathMasks;
   bool separateCredits;
   int ratio;
 
@@ -57,18 +57,13 @@ AsciiDownloads::AsciiDownloads(const std::vector<std::string>& toks) :
   }
   catch (const std::bad_cast&) { }
   if (kBytes == 0) kBytes = -1;
-  masks.assign(toks.begin() + 1, toks.end());
+  for (auto it = toks.begin() + 1; it != toks.end(); ++it) masks.Add(*it);
 }
 
 bool AsciiDownloads::Allowed(off_t size, const std::string& path) const
 {
   if (kBytes > 0 && size / 1024 > kBytes) return false;
-  if (masks.empty()) return true;
-  for (auto& mask : masks)
-  {
-    if (util::WildcardMatch(mask, path)) return true;
-  }
-  return false;
+  return masks.Empty() || masks.MatchAny(path);
 }
 
 
@@ -79,12 +74,7 @@ AsciiUploads::AsciiUploads(const std::vector<std::string>& toks) :
 
 bool AsciiUploads::Allowed(const std::string& path) const
 {
-  if (masks.empty()) return true;
-  for (auto& mask : masks)
-  {
-    if (util::WildcardMatch(mask, path)) return true;
-  }
-  return false;
+  return masks.Empty() || masks.MatchAny(path);
 }
 
 SecureIp::SecureIp(std::vector<std::string> toks)
@@ -108,7 +98,8 @@ SecurePass::SecurePass(std::vector<std::string> toks) :
 SpeedLimit::SpeedLimit(std::vector<std::string> toks) :
   path(toks[0]),
   downloads(ParseSize(toks[1])),
-  uploads(ParseSize(toks[2]))
+  uploads(ParseSize(toks[2])),
+  pathMask(path)
 {
   toks.erase(toks.begin(), toks.begin() + 3);
   acl = acl::ACL(util::Join(toks, " "));
@@ -167,6 +158,7 @@ Right::Right(std::vector<std::string> toks)
   acl = acl::ACL(util::Join(toks, " "));
   specialVar = path.find("[:username:]") != std::string::npos ||
                path.find("[:groupname:]") != std::string::npos;
+  if (!specialVar) pathMask = util::Wildcard(path);
 }
 
 PathFilter::PathFilter() :
@@ -251,6 +243,8 @@ HiddenFiles::HiddenFiles(std::vector<std::string> toks)
   path = toks[0];
   toks.erase(toks.begin());
   masks = toks;
+  pathMask = util::Wildcard(path);
+  maskList = util::WildcardList(masks);
 }
 
 Requests::Requests(const std::vector<std::string>& toks)   
@@ -262,6 +256,7 @@ Requests::Requests(const std::vector<std::string>& toks)
 Creditcheck::Creditcheck(std::vector<std::string> toks)   
 {
   path = toks[0];
+  pathMask = util::Wildcard(path);
   ratio = boost::lexical_cast<int>(toks[1]);
   if (ratio < 0) throw boost::bad_lexical_cast();
   toks.erase(toks.begin(), toks.begin()+2);
@@ -271,6 +266,7 @@ Creditcheck::Creditcheck(std::vector<std::string> toks)
 Creditloss::Creditloss(std::vector<std::string> toks)   
 {
   path = toks[0];
+  pathMask = util::Wildcard(path);
   ratio = boost::lexical_cast<int>(toks[1]);
   if (ratio < 0) throw boost::bad_lexical_cast();
   toks.erase(toks.begin(), toks.begin()+2);
@@ -425,8 +421,17 @@ boost::posix_time::seconds IdleTimeout::Timeout() const { return pimpl->timeout;
 CheckScript::CheckScript(const std::vector<std::string>& toks) :
   path(toks[0]), 
   mask(toks.size() == 2 ? toks[1] : "*"), 
-  disabled(toks[0] == "none")
+  disabled(toks[0] == "none"),
+  fileMask(mask)
+{
+}
+
+ScriptWorker::ScriptWorker(const std::vector<std::string>& toks) :
+  path(toks[0]),
+  workers(toks.size() >= 2 ? boost::lexical_cast<int>(toks[1]) : 2),
+  timeout(toks.size() >= 3 ? boost::lexical_cast<int>(toks[2]) : 60)
 {
+  if (workers < 1 || timeout < 1) throw boost::bad_lexical_cast();
 }
 
 Log::Log(const std::string& name, const std::vector<std::string>& toks) :
@@ -9,6 +9,7 @@
 #include "acl/acl.hpp"
 #include "acl/passwdstrength.hpp"
 #include "acl/ipstrength.hpp"
+#include "util/wildcard.hpp"
 #include "main.hpp"
 
 namespace boost { namespace posix_time
@@ -48,11 +49,14 @@ class Right
   // includes wildcards and possibley regex so can't be std::string path;
   acl::ACL acl;
   bool specialVar;
+  util::Wildcard pathMask;
   
 public:
   Right(std::vector<std::string> toks);
   const acl::ACL& ACL() const { return acl; }
   const std::string& Path() const { return path; }
+  // only compiled when there are no special variables to substitute
+  const util::Wildcard& PathMask() const { return pathMask; }
   bool SpecialVar() const { return specialVar; }
 };
 
@@ -70,7 +74,7 @@ public:
 class AsciiDownloads
 {
   long long kBytes;
-  std::vector<std::string> masks;
+  util::WildcardList masks;
   
 public:
   AsciiDownloads() : kBytes(-1) { }
@@ -80,7 +84,7 @@ public:
 
 class AsciiUploads
 {
-  std::vector<std::string> masks;
+  util::WildcardList masks;
   
 public:
   AsciiUploads() = default;
@@ -125,10 +129,12 @@ class SpeedLimit
   long long downloads;
   long long uploads;
   acl::ACL acl;
+  util::Wildcard pathMask;
   
 public:
   SpeedLimit(std::vector<std::string> toks);
   const std::string& Path() const { return path; }
+  const util::Wildcard& PathMask() const { return pathMask; }
   long long Uploads() const { return downloads; }
   long long Downloads() const { return uploads; }
   const acl::ACL& ACL() const { return acl; }
@@ -255,11 +261,15 @@ class HiddenFiles
 {
   std::string path;
   std::vector<std::string> masks;
+  util::Wildcard pathMask;
+  util::WildcardList maskList;
   
 public:
   HiddenFiles(std::vector<std::string> toks);
   const std::string& Path() const { return path; }
   const std::vector<std::string>& Masks() const { return masks; }
+  const util::Wildcard& PathMask() const { return pathMask; }
+  const util::WildcardList& MaskList() const { return maskList; }
 };
 
 class Requests
@@ -279,10 +289,12 @@ class Creditcheck
   std::string path;
   int ratio;
   acl::ACL acl;
+  util::Wildcard pathMask;
   
 public:
   Creditcheck(std::vector<std::string> toks);
   const std::string& Path() const { return path; }
+  const util::Wildcard& PathMask() const { return pathMask; }
   int Ratio() const { return ratio; }
   const acl::ACL& ACL() const { return acl; }
 };
@@ -292,12 +304,14 @@ class Creditloss
   std::string path;
   int ratio;
   acl::ACL acl;
+  util::Wildcard pathMask;
   
 public:
   Creditloss(std::vector<std::string> toks);
   const acl::ACL& ACL() const { return acl; }
   int Ratio() const { return ratio; }
   const std::string& Path() const { return path; }
+  const util::Wildcard& PathMask() const { return pathMask; }
 };
 
 class NukedirStyle
@@ -406,15 +420,31 @@ class CheckScript
   std::string path;
   std::string mask;
   bool disabled;
+  util::Wildcard fileMask;
 
 public:
   CheckScript(const std::vector<std::string>& toks);
 
   const std::string Path() const { return path; }
   const std::string Mask() const { return mask; }
+  const util::Wildcard& FileMask() const { return fileMask; }
   bool Disabled() const { return disabled; }
 };
 
+class ScriptWorker
+{
+  std::string path;
+  int workers;
+  int timeout;
+
+public:
+  ScriptWorker(const std::vector<std::string>& toks);
+
+  const std::string& Path() const { return path; }
+  int Workers() const { return workers; }
+  int Timeout() const { return timeout; }
+};
+
 class Log
 {
   std::string name;
@@ -14,6 +14,9 @@
 #include "acl/user.hpp"
 #include "acl/group.hpp"
 #include "ftp/data.hpp"
+#include "cfg/get.hpp"
+#include "util/scopeguard.hpp"
+#include "util/threadpool.hpp"
 
 namespace cmd
 {
@@ -35,6 +38,47 @@ enum Options
   OptSizeName     = 'z'   // display size and name only
 };
 
+const unsigned prefetchThreads = 4;
+
+util::ThreadPool& PrefetchPool()
+{
+  static util::ThreadPool pool(prefetchThreads);
+  return pool;
+}
+
+}
+
+DirectoryList::OutputBuffer::OutputBuffer(ftp::Writeable& socket) :
+  socket(socket)
+{
+  setp(buffer, buffer + sizeof(buffer));
+}
+
+int DirectoryList::OutputBuffer::overflow(int ch)
+{
+  Flush();
+  if (ch != traits_type::eof())
+  {
+    *pptr() = ch;
+    pbump(1);
+  }
+  return traits_type::not_eof(ch);
+}
+
+int DirectoryList::OutputBuffer::sync()
+{
+  Flush();
+  return 0;
+}
+
+void DirectoryList::OutputBuffer::Flush()
+{
+  if (pptr() > pbase())
+  {
+    size_t len = pptr() - pbase();
+    setp(buffer, buffer + sizeof(buffer));
+    socket.Write(buffer, len);
+  }
 }
 
 ListOptions::ListOptions(const std::string& userDefined,
@@ -130,11 +174,22 @@ DirectoryList::DirectoryList(ftp::Client& client,
                              const ListOptions& options,
                              int maxRecursion) :
   client(client),
-  socket(socket),
   path(path),
   options(options),
-  maxRecursion(maxRecursion)
+  maxRecursion(maxRecursion),
+  outputBuffer(socket),
+  output(&outputBuffer),
+  lookahead(0),
+  running(0)
 {
+  // rethrows network errors raised while flushing the buffer
+  output.exceptions(std::ios_base::badbit);
+}
+
+DirectoryList::~DirectoryList()
+{
+  std::unique_lock<std::mutex> lock(runningMutex);
+  while (running > 0) runningCond.wait(lock);
 }
 
 void DirectoryList::SplitPath(const fs::Path& path, fs::VirtualPath& parent,
@@ -204,23 +259,50 @@ void DirectoryList::Readdir(const fs::VirtualPath& path, fs::DirEnumerator& dirE
   }
 }
 
-void DirectoryList::ListPath(const fs::VirtualPath& path, std::queue<std::string> masks, int depth) const
+std::future<DirectoryList::DirEnumeratorPtr> DirectoryList::Prefetch(const fs::VirtualPath& path) const
 {
-  if (maxRecursion && depth > maxRecursion) return;
-
-  fs::DirEnumerator dirEnum;
-  try
   {
-    Readdir(path, dirEnum);
+    std::lock_guard<std::mutex> lock(runningMutex);
+    ++running;
   }
-  catch (const util::SystemError& e)
+  
+  ++lookahead;
+  return PrefetchPool().Submit([this, path]() -> DirEnumeratorPtr
+    {
+      auto runningGuard = util::MakeScopeExit([this]()
+        {
+          std::lock_guard<std::mutex> lock(runningMutex);
+          --running;
+          runningCond.notify_all();
+        });
+      
+      cfg::UpdateLocal();
+      auto dirEnum = std::make_shared<fs::DirEnumerator>();
+      Readdir(path, *dirEnum);
+      return dirEnum;
+    });
+}
+
+void DirectoryList::ListPath(const fs::VirtualPath& path, std::queue<std::string> masks, 
+                             int depth, DirEnumeratorPtr dirEnum) const
+{
+  if (maxRecursion && depth > maxRecursion) return;
+
+  if (!dirEnum)
   {
-    // silent failure - gives empty directory list
-    return;
+    dirEnum = std::make_shared<fs::DirEnumerator>();
+    try
+    {
+      Readdir(path, *dirEnum);
+    }
+    catch (const util::SystemError& e)
+    {
+      // silent failure - gives empty directory list
+      return;
+    }
   }
   
-
-  std::ostringstream message;
+  std::ostream& message = output;
   if (depth > 1) message << "\r\n";
   
   if (!path.IsEmpty() && depth > 1 && (options.Recursive() || !masks.empty()))
@@ -230,7 +312,7 @@ void DirectoryList::ListPath(const fs::VirtualPath& path, std::queue<std::string
   
   if (options.LongFormat())
   {
-    message << "total " << static_cast<long long>(dirEnum.TotalBytes() / 1024) << "\r\n";
+    message << "total " << static_cast<long long>(dirEnum->TotalBytes() / 1024) << "\r\n";
   }
   
   std::string mask;
@@ -242,7 +324,7 @@ void DirectoryList::ListPath(const fs::VirtualPath& path, std::queue<std::string
   
   if (masks.empty())
   {
-    for (const auto& de : dirEnum)
+    for (const auto& de : *dirEnum)
     {
       const std::string& pathStr = de.Path().ToString();
       if (pathStr[0] == '.' && !options.All()) continue;
@@ -291,11 +373,11 @@ void DirectoryList::ListPath(const fs::VirtualPath& path, std::queue<std::string
     }
   }
   
-  Output(message.str());
-  
-  if (options.Recursive() || !mask.empty())
+  if ((options.Recursive() || !mask.empty()) && 
+      (!maxRecursion || depth < maxRecursion))
   {
-    for (const auto& de : dirEnum)
+    std::vector<std::pair<fs::VirtualPath, std::future<DirEnumeratorPtr>>> subdirs;
+    for (const auto& de : *dirEnum)
     {
       if (!de.Status().IsDirectory() ||
            de.Status().IsSymLink()) continue;
@@ -304,10 +386,36 @@ void DirectoryList::ListPath(const fs::VirtualPath& path, std::queue<std::string
       if (pathStr[0] == '.' && !options.All()) continue;
       if (!mask.empty() && fnmatch(mask.c_str(), pathStr.c_str(), 0)) continue;
 
-      fs::VirtualPath fullPath(path);
-      fullPath /= de.Path();
-   
-      ListPath(fullPath, masks, depth + 1);
+      subdirs.emplace_back(path / de.Path(), std::future<DirEnumeratorPtr>());
+    }
+    
+    // output stays depth first, enumerating upcoming subdirectories
+    // in the background while earlier ones are written
+    dirEnum.reset();
+    size_t next = 0;
+    for (size_t i = 0; i < subdirs.size(); ++i)
+    {
+      for (next = std::max(next, i + 1); 
+           next < subdirs.size() && lookahead < maximumLookahead; ++next)
+      {
+        subdirs[next].second = Prefetch(subdirs[next].first);
+      }
+
+      DirEnumeratorPtr subdirEnum;
+      if (subdirs[i].second.valid())
+      {
+        --lookahead;
+        try
+        {
+          subdirEnum = subdirs[i].second.get();
+        }
+        catch (const util::SystemError&)
+        {
+          continue;
+        }
+      }
+      
+      ListPath(subdirs[i].first, masks, depth + 1, subdirEnum);
     }
   }
 }
@@ -318,6 +426,7 @@ void DirectoryList::Execute()
   std::queue<std::string> masks;
   SplitPath(path, parent, masks);
   ListPath(parent, masks);
+  outputBuffer.Flush();
 }
 
 std::string DirectoryList::Permissions(const util::path::Status& status)
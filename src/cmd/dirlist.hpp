@@ -1,8 +1,14 @@
 #ifndef __CMD_DIRLIST_HPP
 #define __CMD_DIRLIST_HPP
 
+#include <condition_variable>
 #include <ctime>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <ostream>
 #include <string>
+#include <streambuf>
 #include <queue>
 #include <unordered_map>
 #include "fs/path.hpp"
@@ -61,22 +67,47 @@ public:
 
 class DirectoryList
 {
+  // fixed size buffer streaming straight into the socket
+  class OutputBuffer : public std::streambuf
+  {
+    ftp::Writeable& socket;
+    char buffer[16384];
+    
+    int overflow(int ch);
+    int sync();
+    
+  public:
+    OutputBuffer(ftp::Writeable& socket);
+    void Flush();
+  };
+  
+  typedef std::shared_ptr<fs::DirEnumerator> DirEnumeratorPtr;
+
   ftp::Client& client;
-  ftp::Writeable& socket;
   fs::Path path;
   ListOptions options;
   int maxRecursion;
   
+  mutable OutputBuffer outputBuffer;
+  mutable std::ostream output;
+  
+  // subdirectories of a recursive listing are enumerated ahead on a
+  // shared pool, lookahead bounds how many results are held at once
+  mutable int lookahead;
+  mutable int running;
+  mutable std::mutex runningMutex;
+  mutable std::condition_variable runningCond;
+  
+  static const int maximumLookahead = 16;
+  
   mutable std::unordered_map<acl::UserID, std::string> userNameCache;
   mutable std::unordered_map<acl::GroupID, std::string> groupNameCache;
   mutable std::unordered_map<time_t, std::string> timestampCache;
   
-  void ListPath(const fs::VirtualPath& path, std::queue<std::string> masks, int depth = 1) const;
+  void ListPath(const fs::VirtualPath& path, std::queue<std::string> masks, int depth = 1,
+                DirEnumeratorPtr dirEnum = DirEnumeratorPtr()) const;
   void Readdir(const fs::VirtualPath& path, fs::DirEnumerator& dirEnum) const;
-  inline void Output(const std::string& message) const
-  {
-    socket.Write(message.c_str(), message.length());
-  }
+  std::future<DirEnumeratorPtr> Prefetch(const fs::VirtualPath& path) const;
   
   const std::string& UIDToName(acl::UserID uid) const;
   const std::string& GIDToName(acl::GroupID gid) const;
@@ -93,6 +124,7 @@ public:
                 const fs::Path& path,
                 const ListOptions& options,
                 int maxRecursion);
+  ~DirectoryList();
                 
   void Execute();
 };
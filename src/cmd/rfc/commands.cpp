@@ -21,6 +21,7 @@
 #include "db/stats/stats.hpp"
 #include "exec/check.hpp"
 #include "exec/cscript.hpp"
+#include "exec/zipscript.hpp"
 #include "fs/directory.hpp"
 #include "fs/file.hpp"
 #include "fs/owner.hpp"
@@ -118,6 +119,11 @@ void DELECommand::Execute()
     throw cmd::NoPostScriptError();
   }
   
+  db::index::AdjustSize(path.ToString(), -(bytes / 1024));
+  
+  if (cfg::Get().IsZipscripted(path.Dirname().ToString()))
+    exec::Zipscript::Deleted(fs::MakeReal(path));
+  
   auto section = cfg::Get().SectionMatch(path.ToString());
   bool nostats = !section || acl::path::FileAllowed<acl::path::Nostats>(client.User(), path);
   if (!nostats)
@@ -710,6 +716,8 @@ void RMDCommand::Execute()
   
   if (config.IsIndexed(path.ToString()))
     db::index::Delete(path.ToString());
+  db::index::InvalidateSize(path.Dirname().ToString());
+  exec::Zipscript::Forget(fs::MakeReal(path));
   
   if (config.IsEventLogged(path.ToString()))
   {
@@ -778,6 +786,24 @@ void RNTOCommand::Execute()
     throw cmd::NoPostScriptError();
   }
 
+  // checked like an upload, otherwise a file could skip the crc check by
+  // being uploaded under another name and renamed
+  std::string zipscriptMessage;
+  if (!isDirectory && cfg::Get().IsZipscripted(path.Dirname().ToString()) &&
+      !exec::Zipscript::Uploaded(fs::MakeReal(path), boost::none, zipscriptMessage))
+  {
+    e = fs::RenameFile(fs::MakeReal(path), fs::MakeReal(client.RenameFrom()));
+    if (!e)
+    {
+      fs::DeleteFile(fs::MakeReal(path));
+      if (cfg::Get().IsZipscripted(client.RenameFrom().Dirname().ToString()))
+        exec::Zipscript::Deleted(fs::MakeReal(client.RenameFrom()));
+    }
+    
+    control.Reply(ftp::ActionNotOkay, argStr + ": " + zipscriptMessage);
+    throw cmd::NoPostScriptError();
+  }
+
   if (isDirectory)
   {
     // this should be changed to a single move action so as to retain the
@@ -792,6 +818,16 @@ void RNTOCommand::Execute()
     }
   }
   
+  db::index::InvalidateSize(client.RenameFrom().Dirname().ToString());
+  db::index::InvalidateSize(path.Dirname().ToString());
+  
+  if (isDirectory)
+    exec::Zipscript::Forget(fs::MakeReal(client.RenameFrom()));
+  else
+  if (cfg::Get().IsZipscripted(client.RenameFrom().Dirname().ToString()))
+    exec::Zipscript::Deleted(fs::MakeReal(client.RenameFrom()));
+  
+  if (!zipscriptMessage.empty()) control.PartReply(ftp::FileActionOkay, zipscriptMessage);
   control.Reply(ftp::FileActionOkay, "RNTO command successful.");
 }
 
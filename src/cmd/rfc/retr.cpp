@@ -18,10 +18,12 @@
 #include "acl/flags.hpp"
 #include "ftp/data.hpp"
 #include "fs/path.hpp"
+#include "fs/growth.hpp"
 #include "db/stats/stats.hpp"
 #include "stats/types.hpp"
 #include "stats/stat.hpp"
 #include "ftp/online.hpp"
+#include "ftp/metrics.hpp"
 
 namespace cmd { namespace rfc
 {
@@ -150,6 +152,13 @@ void RETRCommand::Execute()
     throw cmd::NoPostScriptError();
   }
 
+  bool finished = false;
+  ftp::Metrics::Add(ftp::Metric::DownloadsStarted);
+  auto metricsGuard = util::MakeScopeExit([&]
+  {
+    ftp::Metrics::Add(finished ? ftp::Metric::DownloadsFinished : ftp::Metric::DownloadsAborted);
+  });
+
   auto dataGuard = util::MakeScopeExit([&]
   {
     if (data.State().Type() != ftp::TransferType::None)
@@ -202,10 +211,11 @@ void RETRCommand::Execute()
   try
   {
     ftp::DownloadSpeedControl speedControl(client, path);
-    ftp::OnlineTransferUpdater onlineUpdater(boost::this_thread::get_id(), stats::Direction::Download,
-                                             data.State().StartTime());
+    ftp::OnlineTransferUpdater onlineUpdater(stats::Direction::Download, data.State().StartTime());
     
     bool dlIncomplete = cfg::Get().DlIncomplete();
+    fs::RealPath realPath(fs::MakeReal(path));
+    std::unique_ptr<fs::GrowthNotifier::Watch> growth;
     std::vector<char> asciiBuf;
     char buffer[16384];
     
@@ -214,8 +224,11 @@ void RETRCommand::Execute()
       std::streamsize len = fin->read(buffer, sizeof(buffer));
       if (len < 0) 
       {
-        if (!dlIncomplete || !fs::IsIncomplete(MakeReal(path))) break;
-        boost::this_thread::sleep(pt::microseconds(10000));
+        if (!dlIncomplete || !fs::IsIncomplete(realPath)) break;
+        
+        // read again once registered, growth before then isn't signalled
+        if (growth) growth->Wait();
+        else growth.reset(new fs::GrowthNotifier::Watch(realPath));
         continue;
       }
       
@@ -230,6 +243,7 @@ void RETRCommand::Execute()
       }
       
       data.Write(bufp, len);
+      ftp::Metrics::Add(ftp::Metric::BytesOut, len);
 
       onlineUpdater.Update(data.State().Bytes());
       speedControl.Apply();
@@ -280,11 +294,13 @@ void RETRCommand::Execute()
     throw cmd::NoPostScriptError();
   }
 
+  finished = true;
   control.Reply(ftp::DataClosedOkay, "Transfer finished @ " + stats::AutoUnitSpeedString(speed / 1024)); 
   
   (void) countGuard;
   (void) dataGuard;
   (void) transferLogGuard;
+  (void) metricsGuard;
 }
 
 } /* rfc namespace */
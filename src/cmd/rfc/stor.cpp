@@ -3,7 +3,11 @@
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include "cmd/rfc/stor.hpp"
 #include "fs/file.hpp"
+#include "fs/directory.hpp"
+#include "fs/freespace.hpp"
+#include "fs/growth.hpp"
 #include "db/stats/stats.hpp"
+#include "db/index/index.hpp"
 #include "stats/util.hpp"
 #include "ftp/counter.hpp"
 #include "util/scopeguard.hpp"
@@ -15,6 +19,7 @@
 #include "fs/mode.hpp"
 #include "util/string.hpp"
 #include "exec/check.hpp"
+#include "exec/zipscript.hpp"
 #include "cmd/error.hpp"
 #include "fs/owner.hpp"
 #include "util/asynccrc32.hpp"
@@ -26,6 +31,7 @@
 #include "acl/flags.hpp"
 #include "ftp/xdupe.hpp"
 #include "ftp/online.hpp"
+#include "ftp/metrics.hpp"
 
 namespace cmd { namespace rfc
 {
@@ -215,6 +221,13 @@ void STORCommand::Execute()
     throw cmd::NoPostScriptError();
   }
 
+  bool finished = false;
+  ftp::Metrics::Add(ftp::Metric::UploadsStarted);
+  auto metricsGuard = util::MakeScopeExit([&]
+  {
+    ftp::Metrics::Add(finished ? ftp::Metric::UploadsFinished : ftp::Metric::UploadsAborted);
+  });
+
   auto dataGuard = util::MakeScopeExit([&]
   {
     if (data.State().Type() != ftp::TransferType::None)
@@ -251,18 +264,41 @@ void STORCommand::Execute()
   });
   
   static const size_t bufferSize = 16384;
-  bool calcCrc = CalcCRC(path);
+  bool zipscript = cfg::Get().IsZipscripted(path.Dirname().ToString());
+  bool calcCrc = zipscript || CalcCRC(path);
   std::unique_ptr<util::CRC32> crc32(cfg::Get().AsyncCRC() ? 
                                      new util::AsyncCRC32(bufferSize, 10) :
                                      new util::CRC32());
   bool aborted = false;
   fileOkay = false;
   
+  // reported in chunks to keep the free space estimate current
+  static const size_t consumedChunk = 1024 * 1024;
+  size_t consumed = 0;
+  fs::RealPath realPath(fs::MakeReal(path));
+  
+  // anything short of a checked upload is deleted, so the zipscript
+  // mustn't go on counting it
+  if (zipscript) exec::Zipscript::Uploading(realPath);
+  auto zipscriptGuard = util::MakeScopeExit([&]
+  {
+    if (zipscript && !fileOkay)
+    {
+      try
+      {
+        exec::Zipscript::Deleted(realPath);
+      }
+      catch (std::exception& e)
+      {
+        logs::Error("Failed to update zipscript for failed upload: %1%", e.what());
+      }
+    }
+  });
+  
   try
   {
     ftp::UploadSpeedControl speedControl(client, path);
-    ftp::OnlineTransferUpdater onlineUpdater(boost::this_thread::get_id(), stats::Direction::Upload,
-                                             data.State().StartTime());
+    ftp::OnlineTransferUpdater onlineUpdater(stats::Direction::Upload, data.State().StartTime());
     std::vector<char> asciiBuf;
     char buffer[bufferSize];
     
@@ -279,8 +315,17 @@ void STORCommand::Execute()
       }
       
       data.State().Update(len);
+      ftp::Metrics::Add(ftp::Metric::BytesIn, len);
       
       fout->write(bufp, len);
+      consumed += len;
+      if (consumed >= consumedChunk)
+      {
+        fs::FreeSpaceMonitor::Consumed(realPath, consumed);
+        consumed = 0;
+      }
+      
+      fs::GrowthNotifier::Grown(realPath);
       
       if (calcCrc) crc32->Update(reinterpret_cast<uint8_t*>(bufp), len);
       onlineUpdater.Update(data.State().Bytes());
@@ -316,9 +361,13 @@ void STORCommand::Execute()
 
   fout->close();
   data.Close();
+  fs::FreeSpaceMonitor::Consumed(realPath, consumed);
+  fs::InvalidateDirectorySize(realPath.Dirname());
   
-  e = fs::Chmod(fs::MakeReal(path), completeMode);
+  e = fs::Chmod(realPath, completeMode);
   if (!e) control.PartReply(ftp::DataClosedOkay, "Failed to chmod upload: " + e.Message());
+  // no longer incomplete, let anyone following it finish
+  fs::GrowthNotifier::Grown(realPath);
 
   auto duration = data.State().Duration();
   double speed = stats::CalculateSpeed(data.State().Bytes(), duration);
@@ -329,11 +378,29 @@ void STORCommand::Execute()
     throw cmd::NoPostScriptError();
   }
   
-  if (exec::PostCheck(client, path, 
+  bool zipscriptOkay = true;
+  if (zipscript)
+  {
+    // a resumed upload's crc only covers what was sent this time
+    boost::optional<uint32_t> crc;
+    if (data.RestartOffset() == 0) crc.reset(crc32->Checksum());
+    
+    std::string messages;
+    zipscriptOkay = exec::Zipscript::Uploaded(realPath, crc, messages);
+    if (!messages.empty()) control.PartReply(ftp::CodeDeferred, messages);
+  }
+  
+  if (zipscriptOkay &&
+      exec::PostCheck(client, path, 
                       calcCrc ? crc32->HexString() : "000000", speed, 
                       section ? section->Name() : ""))
   {
     fileOkay = true;
+    if (data.RestartOffset() > 0 || data.DataType() == ftp::DataType::ASCII)
+      db::index::InvalidateSize(path.Dirname().ToString());
+    else
+      db::index::AdjustSize(path.ToString(), data.State().Bytes() / 1024);
+
     bool nostats = !section || acl::path::FileAllowed<acl::path::Nostats>(client.User(), path);
     db::stats::Upload(client.User(), data.State().Bytes() / 1024,
                       duration.total_milliseconds(),
@@ -343,11 +410,14 @@ void STORCommand::Execute()
             data.State().Bytes() / 1024 * stats::UploadRatio(client, path, section));
   }
 
+  finished = true;
   control.Reply(ftp::DataClosedOkay, "Transfer finished @ " + stats::AutoUnitSpeedString(speed / 1024)); 
   
   (void) countGuard;
   (void) fileGuard;
+  (void) zipscriptGuard;
   (void) dataGuard;
+  (void) metricsGuard;
 }
 
 } /* rfc namespace */
@@ -32,6 +32,7 @@
 #include "cfg/util.hpp"
 #include "cmd/error.hpp"
 #include "cmd/online.hpp"
+#include "db/connectionstats.hpp"
 #include "db/dupe/dupe.hpp"
 #include "db/index/index.hpp"
 #include "db/stats/protocol.hpp"
@@ -40,6 +41,7 @@
 #include "db/stats/transfers.hpp"
 #include "fs/dircontainer.hpp"
 #include "fs/directory.hpp"
+#include "fs/freespace.hpp"
 #include "fs/globiterator.hpp"
 #include "fs/owner.hpp"
 #include "fs/path.hpp"
@@ -383,6 +385,15 @@ void DELUSERCommand::Execute()
   logs::Siteop(client.User().Name(), "deleted user '%1%'", user->Name());
 }
 
+void DBSTATSCommand::Execute()
+{
+  for (const std::string& line : db::ConnectionStats::Get().Format())
+  {
+    control.PartReply(ftp::CommandOkay, line);
+  }
+  control.Reply(ftp::CommandOkay, "DBSTATS command finished.");
+}
+
 void DISKFREECommand::Execute()
 {
   std::string pathStr = argStr.empty() ? "." : argStr;
@@ -394,7 +405,7 @@ void DISKFREECommand::Execute()
   }
   
   unsigned long long bytes;
-  auto e = util::path::FreeDiskSpace(fs::MakeReal(path).ToString(), bytes);
+  auto e = fs::FreeSpaceMonitor::FreeBytes(fs::MakeReal(path), bytes);
   if (!e)
   {
     control.Reply(ftp::ActionNotOkay, pathStr + ":" + e.Message());
@@ -1035,12 +1046,18 @@ void NEWCommand::Execute()
   for (const auto& result : results)
   {
     auto real = fs::MakeReal(fs::VirtualPath(result.path));
-    long long kBytes;
-    auto e = fs::DirectorySize(real, cfg::Get().DirSizeDepth(), kBytes);
-    if (e.Errno() == ENOENT)
+    long long kBytes = result.kBytes;
+    if (kBytes < 0)
     {
-      db::index::Delete(result.path);
-      continue;
+      auto e = fs::DirectorySize(real, cfg::Get().DirSizeDepth(), kBytes);
+      if (e.Errno() == ENOENT)
+      {
+        db::index::Delete(result.path);
+        continue;
+      }
+      
+      if (e) db::index::CacheSize(result.path, kBytes);
+      else kBytes = -1;
     }
     
     auto owner = fs::GetOwner(real);
@@ -1050,7 +1067,7 @@ void NEWCommand::Execute()
     body.RegisterValue("age", Age(now - result.dateTime));
     body.RegisterValue("path", fs::Path(result.path).Basename().ToString());
     body.RegisterValue("section", result.section);
-    body.RegisterSize("size", e ? kBytes : -1);
+    body.RegisterSize("size", kBytes);
     body.RegisterValue("user", acl::UIDToName(owner.UID()));
     body.RegisterValue("group", acl::GIDToName(owner.GID()));
     os << body.Compile();
@@ -1387,20 +1404,26 @@ void SEARCHCommand::Execute()
     unsigned index = 0;
     for (const auto& result : results)
     {
-      long long kBytes;
-      auto e = fs::DirectorySize(fs::MakeReal(fs::VirtualPath(result.path)),
-                                 cfg::Get().DirSizeDepth(), kBytes);
-      if (e.Errno() == ENOENT)
+      long long kBytes = result.kBytes;
+      if (kBytes < 0)
       {
-        db::index::Delete(result.path);
-        continue;
+        auto e = fs::DirectorySize(fs::MakeReal(fs::VirtualPath(result.path)),
+                                   cfg::Get().DirSizeDepth(), kBytes);
+        if (e.Errno() == ENOENT)
+        {
+          db::index::Delete(result.path);
+          continue;
+        }
+        
+        if (e) db::index::CacheSize(result.path, kBytes);
+        else kBytes = -1;
       }
 
       body.RegisterValue("index", ++index);
       body.RegisterValue("datetime", boost::lexical_cast<std::string>(result.dateTime));
       body.RegisterValue("path", result.path);
       body.RegisterValue("section", result.section);
-      body.RegisterSize("size", e ? kBytes : -1);
+      body.RegisterSize("size", kBytes);
       os << body.Compile();
     }
 
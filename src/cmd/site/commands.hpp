@@ -67,6 +67,15 @@ public:
   void Execute();
 };
 
+class DBSTATSCommand : public Command
+{
+public:
+  DBSTATSCommand(ftp::Client& client, const std::string& argStr, const Args& args) :
+    Command(client, client.Control(), client.Data(), argStr, args) { }
+
+  void Execute();
+};
+
 class DISKFREECommand : public Command
 {
 public:
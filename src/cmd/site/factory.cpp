@@ -47,6 +47,10 @@ Factory::Factory()
                       std::make_shared<Creator<DELUSERCommand>>(),
                       "Syntax: SITE DELUSER <user>",
                       "Delete a user" }, },
+    { "DBSTATS",    { 0,  0,  "dbstats",
+                      std::make_shared<Creator<DBSTATSCommand>>(),
+                      "Syntax: SITE DBSTATS",
+                      "Display database connection latency statistics" }, },
     { "DISKFREE",   { 0,  1,  "diskfree",
                       std::make_shared<Creator<DISKFREECommand>>(),
                       "Syntax: SITE DISKFREE [<path>]",
@@ -1,8 +1,8 @@
-#include <stack>
 #include <boost/lexical_cast.hpp>
 #include "cmd/site/logs.hpp"
 #include "logs/logs.hpp"
-#include "util/reverselogreader.hpp"
+#include "util/logsearch.hpp"
+#include "util/threadpool.hpp"
 #include "cmd/error.hpp"
 #include "util/path/path.hpp"
 #include "cfg/get.hpp"
@@ -10,6 +10,19 @@
 namespace cmd { namespace site
 {
 
+namespace
+{
+
+const unsigned searchThreads = 4;
+
+util::ThreadPool& SearchPool()
+{
+  static util::ThreadPool pool(searchThreads);
+  return pool;
+}
+
+}
+
 LOGSCommand::LOGSCommand(ftp::Client& client, const std::string& argStr, const Args& args) :
   Command(client, client.Control(), client.Data(), argStr, args),
   number(cfg::Get().DefaultLogLines())
@@ -40,38 +53,14 @@ bool LOGSCommand::ParseArgs()
   return true;
 }
 
-bool LOGSCommand::CheckStrings(std::string line)
-{
-  util::ToLower(line);
-  for (auto& s : strings)
-  {
-    if (line.find(s) == std::string::npos)
-      return false;
-  }
-  return true;
-}
-
 void LOGSCommand::Show(const std::string& path)
 {
   try
   {
-    util::ReverseLogReader in(path);
-    std::stack<std::string> lines;
-    std::string line;
-    int count = 0;
-    while (in.Getline(line) && count < number)
-    {
-      if (CheckStrings(line) && !line.empty())
-      {
-        lines.push(line);
-        ++count;
-      }
-    }
-    
-    while (!lines.empty())
+    util::LogSearch search(path, strings);
+    for (const std::string& line : search.Last(number, &SearchPool()))
     {
-      control.PartReply(ftp::CommandOkay, lines.top());
-      lines.pop();
+      control.PartReply(ftp::CommandOkay, line);
     }
   
     control.Reply(ftp::CommandOkay, "LOGS command finished");
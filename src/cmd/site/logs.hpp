@@ -15,7 +15,6 @@ class LOGSCommand : public Command
   static const int defaultNumberLines = 100;
   
   bool ParseArgs();
-  bool CheckStrings(std::string line);
   void Show(const std::string& path);
   
 public:
@@ -1,31 +1,344 @@
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
 #include <sstream>
 #include <string>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include "cmd/site/wipe.hpp"
 #include "fs/globiterator.hpp"
 #include "fs/dircontainer.hpp"
 #include "fs/directory.hpp"
 #include "fs/file.hpp"
+#include "fs/owner.hpp"
+#include "fs/ownertable.hpp"
+#include "fs/dircache.hpp"
+#include "fs/pathcache.hpp"
 #include "cmd/error.hpp"
 #include "db/index/index.hpp"
+#include "exec/zipscript.hpp"
 #include "acl/path.hpp"
 #include "util/path/status.hpp"
 #include "cfg/get.hpp"
 #include "util/enumbitwise.hpp"
+#include "util/threadpool.hpp"
 #include "logs/logs.hpp"
 #include "util/string.hpp"
 #include "acl/user.hpp"
 
+namespace PP = acl::path;
+
 namespace cmd { namespace site
 {
 
+namespace
+{
+
+const unsigned wipeThreads = 4;
+const std::chrono::seconds progressInterval(5);
+const int maxHeldDescriptors = 64;
+
+util::ThreadPool& WipePool()
+{
+  static util::ThreadPool pool(wipeThreads);
+  return pool;
+}
+
+// removes directory trees depth first, each directory is enumerated on the
+// pool and a subdirectory is opened relative to its parent so nothing is
+// followed out of the tree. a parent's descriptor is shared by its pending
+// subdirectories until they're opened, past maxHeldDescriptors they're
+// enumerated inline instead. a directory is removed by whichever task
+// finishes its last child
+class WipeEngine
+{
+  typedef std::shared_ptr<int> DescriptorPtr;
+  
+  struct Directory
+  {
+    std::shared_ptr<Directory> parent;
+    fs::VirtualPath path;
+    DescriptorPtr parentFd;
+    std::atomic<int> pending;
+    std::atomic<bool> listed;
+    std::atomic<bool> incomplete;
+    
+    Directory(const std::shared_ptr<Directory>& parent, const fs::VirtualPath& path, 
+              const DescriptorPtr& parentFd = DescriptorPtr()) :
+      parent(parent), path(path), parentFd(parentFd), 
+      pending(1), listed(false), incomplete(false) { }
+  };
+  
+  typedef std::shared_ptr<Directory> DirectoryPtr;
+
+  const acl::User& user;
+  std::mutex mutex;
+  std::condition_variable cond;
+  int outstanding;
+  std::atomic<int> held;
+  std::atomic<int> dirs;
+  std::atomic<int> files;
+  std::atomic<int> failed;
+  std::vector<std::string> errors;
+  std::vector<std::string> indexed;
+  
+  void Submit(const DirectoryPtr& directory)
+  {
+    WipePool().Submit([this, directory]() { Enumerate(directory); });
+  }
+  
+  void Failure(const fs::VirtualPath& path, const std::string& message)
+  {
+    ++failed;
+    std::lock_guard<std::mutex> lock(mutex);
+    errors.emplace_back("WIPE " + path.ToString() + ": " + message);
+  }
+  
+  void Failure(const fs::VirtualPath& path, const util::Error& e)
+  {
+    Failure(path, e.Message());
+  }
+  
+  DescriptorPtr Hold(int fd)
+  {
+    ++held;
+    return DescriptorPtr(new int(fd), [this](int* fd) { close(*fd); delete fd; --held; });
+  }
+  
+  // same as fs::DeleteFile after the unlink
+  static void Deleted(const fs::RealPath& path)
+  {
+    if (path.Basename().ToString() != fs::OwnerTable::filename) fs::RemoveOwner(path);
+    fs::DirectoryCache::Invalidate(path);
+    fs::PathCache::Invalidate(path);
+  }
+  
+  void List(const DirectoryPtr& directory)
+  {
+    cfg::UpdateLocal();
+    
+    const int flags = O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC;
+    int fd = directory->parentFd
+           ? openat(*directory->parentFd, directory->path.Basename().CString(), flags)
+           : open(fs::MakeReal(directory->path).CString(), flags);
+    directory->parentFd.reset();
+    DIR* dp = fd < 0 ? nullptr : fdopendir(fd);
+    if (!dp)
+    {
+      Failure(directory->path, util::Error::Failure(errno));
+      if (fd >= 0) close(fd);
+      return;
+    }
+    
+    std::shared_ptr<DIR> dirGuard(dp, closedir);
+    directory->listed = true;
+    
+    // shared with subdirectories until they're opened, so outlives dp
+    DescriptorPtr self;
+    
+    // hidden files aren't checked for view, anything the user may delete
+    // has to go or the directory can't be removed
+    struct dirent* de;
+    while ((de = readdir(dp)))
+    {
+      const char* name = de->d_name;
+      if (name[0] == '.' && (!name[1] || (name[1] == '.' && !name[2]))) continue;
+      
+      fs::VirtualPath entryPath(directory->path / name);
+      bool isDirectory = de->d_type == DT_DIR;
+      if (de->d_type == DT_UNKNOWN)
+      {
+        struct stat st;
+        isDirectory = fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(st.st_mode);
+      }
+      
+      if (isDirectory)
+      {
+        if (!self)
+        {
+          int dupFd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+          if (dupFd < 0)
+          {
+            Failure(entryPath, util::Error::Failure(errno));
+            directory->incomplete = true;
+            continue;
+          }
+          self = Hold(dupFd);
+        }
+        
+        auto child = std::make_shared<Directory>(directory, entryPath, self);
+        ++directory->pending;
+        if (held > maxHeldDescriptors)
+        {
+          Enumerate(child);
+          continue;
+        }
+        
+        try
+        {
+          Submit(child);
+        }
+        catch (...)
+        {
+          --directory->pending;
+          throw;
+        }
+        continue;
+      }
+      
+      util::Error e = PP::FileAllowed<PP::Delete>(user, entryPath);
+      if (e && unlinkat(fd, name, 0) < 0) e = util::Error::Failure(errno);
+      if (!e)
+      {
+        Failure(entryPath, e);
+        directory->incomplete = true;
+      }
+      else
+      {
+        Deleted(fs::MakeReal(entryPath));
+        ++files;
+      }
+    }
+  }
+  
+  void Enumerate(const DirectoryPtr& directory)
+  {
+    try
+    {
+      List(directory);
+    }
+    catch (const std::exception& e)
+    {
+      Failure(directory->path, std::string(e.what()));
+      directory->incomplete = true;
+    }
+    
+    Finish(directory);
+  }
+  
+  bool Remove(const DirectoryPtr& directory)
+  {
+    util::Error e = directory->incomplete
+                    ? util::Error::Failure(ENOTEMPTY)
+                    : PP::DirAllowed<PP::Delete>(user, directory->path);
+    if (e) e = fs::RemoveDirectory(fs::MakeReal(directory->path));
+    if (!e)
+    {
+      Failure(directory->path, e);
+      return false;
+    }
+    
+    ++dirs;
+    if (cfg::Get().IsIndexed(directory->path.ToString()))
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      indexed.emplace_back(directory->path.ToString());
+    }
+    return true;
+  }
+  
+  void Finish(DirectoryPtr directory)
+  {
+    // not opened if listing threw, let the parent's descriptor go
+    directory->parentFd.reset();
+    if (--directory->pending > 0) return;
+    
+    bool removed = false;
+    if (directory->listed)
+    {
+      try
+      {
+        removed = Remove(directory);
+      }
+      catch (const std::exception& e)
+      {
+        Failure(directory->path, std::string(e.what()));
+      }
+    }
+    
+    DirectoryPtr parent = directory->parent;
+    if (parent)
+    {
+      if (!removed) parent->incomplete = true;
+      Finish(parent);
+    }
+    else
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      --outstanding;
+      cond.notify_all();
+    }
+  }
+  
+public:
+  WipeEngine(const acl::User& user) :
+    user(user), outstanding(0), held(0), dirs(0), files(0), failed(0) { }
+    
+  ~WipeEngine()
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (outstanding > 0) cond.wait(lock);
+  }
+  
+  void Wipe(const fs::VirtualPath& path)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      ++outstanding;
+    }
+    
+    try
+    {
+      Submit(std::make_shared<Directory>(DirectoryPtr(), path));
+    }
+    catch (...)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      --outstanding;
+      throw;
+    }
+  }
+  
+  bool Wait(const std::chrono::seconds& timeout)
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    return cond.wait_for(lock, timeout, [this]() { return outstanding == 0; });
+  }
+  
+  std::vector<std::string> Errors()
+  {
+    std::vector<std::string> drained;
+    std::lock_guard<std::mutex> lock(mutex);
+    drained.swap(errors);
+    return drained;
+  }
+  
+  std::vector<std::string> Indexed()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    return indexed;
+  }
+  
+  int Dirs() const { return dirs; }
+  int Files() const { return files; }
+  int Failed() const { return failed; }
+};
+
+}
+
 void WIPECommand::Process(fs::VirtualPath pathmask)
 {
-  auto flags = fs::GlobIterator::NoFlags;
-  if (recursive) flags |= fs::GlobIterator::Recursive;
+  WipeEngine engine(client.User());
+  std::vector<std::string> indexed;
   
   try
   {
-    for (auto& entry : fs::GlobContainer(client.User(), pathmask, flags))
+    for (auto& entry : fs::GlobContainer(client.User(), pathmask))
     {
       fs::VirtualPath entryPath(pathmask.Dirname() / entry);
       try
@@ -33,6 +346,14 @@ void WIPECommand::Process(fs::VirtualPath pathmask)
         util::path::Status status(fs::MakeReal(entryPath).ToString());
         if (status.IsDirectory())
         {
+          if (recursive && !status.IsSymLink())
+          {
+            engine.Wipe(entryPath);
+            db::index::InvalidateSize(entryPath.Dirname().ToString());
+            exec::Zipscript::Forget(fs::MakeReal(entryPath));
+            continue;
+          }
+          
           util::Error e = fs::RemoveDirectory(client.User(), entryPath);
           if (!e)
           {
@@ -43,7 +364,9 @@ void WIPECommand::Process(fs::VirtualPath pathmask)
           else
           {
             if (cfg::Get().IsIndexed(entryPath.ToString()))
-              db::index::Delete(entryPath.ToString());
+              indexed.emplace_back(entryPath.ToString());
+            db::index::InvalidateSize(entryPath.Dirname().ToString());
+            exec::Zipscript::Forget(fs::MakeReal(entryPath));
             ++dirs;
           }
         }
@@ -57,13 +380,18 @@ void WIPECommand::Process(fs::VirtualPath pathmask)
             ++failed;
           }
           else
+          {
+            db::index::InvalidateSize(entryPath.Dirname().ToString());
+            if (cfg::Get().IsZipscripted(entryPath.Dirname().ToString()))
+              exec::Zipscript::Deleted(fs::MakeReal(entryPath));
             ++files;
+          }
         }
       }
       catch (const util::SystemError& e)
       {
         ++failed;
-        control.PartReply(ftp::CommandOkay, "CHOWN " + 
+        control.PartReply(ftp::CommandOkay, "WIPE " + 
             entryPath.ToString() + ": " + e.Message());        
       }
     }
@@ -74,6 +402,34 @@ void WIPECommand::Process(fs::VirtualPath pathmask)
     control.PartReply(ftp::CommandOkay, 
         "WIPE " + pathmask.ToString() + ": " + e.Message());
   }
+  
+  auto lastProgress = std::chrono::steady_clock::now();
+  while (true)
+  {
+    bool finished = engine.Wait(std::chrono::seconds(1));
+    for (const auto& error : engine.Errors())
+      control.PartReply(ftp::CommandOkay, error);
+    if (finished) break;
+    
+    auto now = std::chrono::steady_clock::now();
+    if (now - lastProgress >= progressInterval)
+    {
+      std::ostringstream os;
+      os << "WIPE in progress (okay on: " 
+         << dirs + engine.Dirs() << " directories, " << files + engine.Files()
+         << " files / failures: " << failed + engine.Failed() << ").";
+      control.PartReply(ftp::CommandOkay, os.str());
+      lastProgress = now;
+    }
+  }
+  
+  dirs += engine.Dirs();
+  files += engine.Files();
+  failed += engine.Failed();
+  
+  auto engineIndexed = engine.Indexed();
+  indexed.insert(indexed.end(), engineIndexed.begin(), engineIndexed.end());
+  db::index::Delete(indexed);
 }
 
 void WIPECommand::ParseArgs()
@@ -26,15 +26,16 @@ std::string SimplifyJavascript(const std::string& javascript)
 
 }
 
-boost::once_flag Connection::once = BOOST_ONCE_INIT;
+boost::thread_specific_ptr<mongo::DBClientConnection> Connection::safeConn;
+boost::thread_specific_ptr<mongo::DBClientConnection> Connection::fastConn;
 
-void Connection::AuthenticateHook::onCreate(mongo::DBClientBase* conn)
+void Connection::Authenticate(mongo::DBClientConnection& conn)
 {
   const auto& dbConfig = cfg::Get().Database();
   if (dbConfig.NeedAuth())
   {
     std::string errmsg;
-    if (!conn->auth(dbConfig.Name(), dbConfig.Login(), dbConfig.Password(), errmsg))
+    if (!conn.auth(dbConfig.Name(), dbConfig.Login(), dbConfig.Password(), errmsg))
     {
       throw db::DBError(errmsg);
     }
@@ -42,6 +43,7 @@ void Connection::AuthenticateHook::onCreate(mongo::DBClientBase* conn)
 }
 
 Connection::Connection(ConnectionMode mode) :
+  conn(nullptr),
   mode(mode),
   database(cfg::Get().Database().Name())
 {
@@ -50,14 +52,34 @@ Connection::Connection(ConnectionMode mode) :
 
 void Connection::Create()
 {
-  boost::call_once(&CreateAuthenticateHook, once);  
+  // each thread keeps its own connections open for its lifetime, fast mode
+  // gets a separate one so the getlasterror after a safe operation never
+  // reports the failure of an unacknowledged write, see FastConnection
+  auto& threadConn = mode == ConnectionMode::Fast ? fastConn : safeConn;
+  if (threadConn.get() && !threadConn->isFailed())
+  {
+    conn = threadConn.get();
+    return;
+  }
+  
+  bool reconnect = threadConn.get() != nullptr;
+  threadConn.reset();
+
   boost::this_thread::disable_interruption noInterrupt;
   
   try
   {
     try
     {
-      scopedConn.reset(mongo::ScopedDbConnection::getScopedDbConnection(cfg::Get().Database().Host()));
+      LatencyTimer timer(Operation::Connect);
+      std::unique_ptr<mongo::DBClientConnection> newConn(new mongo::DBClientConnection());
+      newConn->connect(cfg::Get().Database().Host());
+      Authenticate(*newConn);
+      if (mode == ConnectionMode::Fast)
+        newConn->setWriteConcern(mongo::W_NONE);
+      threadConn.reset(newConn.release());
+      conn = threadConn.get();
+      ConnectionStats::Get().Connected(reconnect);
     }
     catch (const mongo::DBException& e)
     {
@@ -72,27 +94,25 @@ void Connection::Create()
     if (mode == ConnectionMode::Safe)
       throw DBError("Unable to authenticate with database");
   }
-  
-  if (scopedConn && mode == ConnectionMode::Fast)
-    scopedConn->conn().setWriteConcern(mongo::W_NONE);
-}
-
-void Connection::CreateAuthenticateHook()
-{
-  mongo::pool.addHook(new AuthenticateHook());
 }
 
 int Connection::Update(const std::string& collection, const mongo::Query& query, 
       const mongo::BSONObj& obj, bool upsert)
 {
-  if (scopedConn)
+  if (conn)
   {
     boost::this_thread::disable_interruption noInterrupt;
     
     try
     {
-      scopedConn->conn().update(Namespace(collection), query, obj, upsert);
-      if (mode != ConnectionMode::Fast)
+      {
+        LatencyTimer timer(Operation::Update);
+        conn->update(Namespace(collection), query, obj, upsert);
+      }
+      
+      if (mode == ConnectionMode::Fast)
+        ConnectionStats::Get().Unacknowledged(1);
+      else
       {
         auto err = GetLastError();
         if (!err.Okay())
@@ -117,14 +137,20 @@ int Connection::Update(const std::string& collection, const mongo::Query& query,
 
 int Connection::Remove(const std::string& collection, const mongo::Query& query)
 {
-  if (scopedConn)
+  if (conn)
   {
     boost::this_thread::disable_interruption noInterrupt;
     
     try
     {
-      scopedConn->conn().remove(Namespace(collection), query);
-      if (mode != ConnectionMode::Fast)
+      {
+        LatencyTimer timer(Operation::Remove);
+        conn->remove(Namespace(collection), query);
+      }
+      
+      if (mode == ConnectionMode::Fast)
+        ConnectionStats::Get().Unacknowledged(1);
+      else
       {
         auto err = GetLastError();
         if (!err.Okay())
@@ -151,14 +177,18 @@ std::vector<mongo::BSONObj> Connection::Query(
       const mongo::BSONObj* fieldsToReturn)
 {
   std::vector<mongo::BSONObj> results;
-  if (scopedConn)
+  if (conn)
   {
     boost::this_thread::disable_interruption noInterrupt;
     
     try
     {
-      auto cursor = scopedConn->conn().query(Namespace(collection), 
-            query, nToReturn, nToSkip, fieldsToReturn);
+      std::auto_ptr<mongo::DBClientCursor> cursor;
+      {
+        LatencyTimer timer(Operation::Query);
+        cursor = conn->query(Namespace(collection), 
+              query, nToReturn, nToSkip, fieldsToReturn);
+      }
       if (!cursor.get()) throw DBReadError();
       
       if (mode != ConnectionMode::Fast)
@@ -189,13 +219,14 @@ std::vector<mongo::BSONObj> Connection::Query(
 void Connection::EnsureIndex(const std::string& collection, 
       const mongo::BSONObj& keys, bool unique)
 {
-  if (!scopedConn) return;
+  if (!conn) return;
   
   try
   {
     boost::this_thread::disable_interruption noInterrupt;
 
-    scopedConn->conn().ensureIndex(Namespace(collection), keys, unique);
+    LatencyTimer timer(Operation::Command);
+    conn->ensureIndex(Namespace(collection), keys, unique);
     if (mode != ConnectionMode::Fast)
     {
       auto err = GetLastError();
@@ -217,13 +248,14 @@ void Connection::EnsureIndex(const std::string& collection,
 long long Connection::Count(const std::string& collection, const mongo::BSONObj& query)
 {
   long long count = -1;
-  if (scopedConn) 
+  if (conn) 
   {
     boost::this_thread::disable_interruption noInterrupt;
 
     try
     {
-      count = scopedConn->conn().count(Namespace(collection), query);
+      LatencyTimer timer(Operation::Count);
+      count = conn->count(Namespace(collection), query);
       if (mode != ConnectionMode::Fast)
       {
         auto err = GetLastError();
@@ -249,13 +281,14 @@ long long Connection::Count(const std::string& collection, const mongo::BSONObj&
 bool Connection::RunCommand(const mongo::BSONObj& command, mongo::BSONObj& info, int options)
 {
   bool ret = false;
-  if (scopedConn)
+  if (conn)
   {
     boost::this_thread::disable_interruption noInterrupt;
     
     try
     {
-      ret = scopedConn->conn().runCommand(database, command, info, options);
+      LatencyTimer timer(Operation::Command);
+      ret = conn->runCommand(database, command, info, options);
       if (mode != ConnectionMode::Fast)
       {
         auto err = GetLastError();
@@ -280,13 +313,14 @@ bool Connection::Eval(const std::string& javascript, mongo::BSONObj& info, mongo
       mongo::BSONObj* args)
 {
   bool ret = false;
-  if (scopedConn)
+  if (conn)
   {
     boost::this_thread::disable_interruption noInterrupt;
 
     try
     {
-      ret = scopedConn->conn().eval(database, javascript, info, retval, args);
+      LatencyTimer timer(Operation::Eval);
+      ret = conn->eval(database, javascript, info, retval, args);
       if (!ret && mode != ConnectionMode::Fast)
       {
         auto err = GetLastError();
@@ -307,7 +341,7 @@ bool Connection::Eval(const std::string& javascript, mongo::BSONObj& info, mongo
 int Connection::InsertAutoIncrement(const std::string& collection, 
       const mongo::BSONObj& obj, const std::string& autoIncField)
 {
-  if (!scopedConn) return -1;
+  if (!conn) return -1;
 
   std::string ns = Namespace(collection);
   while (true)
@@ -329,14 +363,18 @@ int Connection::InsertAutoIncrement(const std::string& collection,
     {
       boost::this_thread::disable_interruption noInterrupt;
       
-      scopedConn->conn().insert(ns, bab.obj());
+      {
+        LatencyTimer timer(Operation::Insert);
+        conn->insert(ns, bab.obj());
+      }
+      
       auto err = GetLastError();
       if (!err.Okay())
       {
         if (err["code"].Number() == 11000)
         {
           auto fields = BSON(autoIncField << 1);
-          auto cursor = scopedConn->conn().query(ns, QUERY(autoIncField << id), 1, 0, &fields);
+          auto cursor = conn->query(ns, QUERY(autoIncField << id), 1, 0, &fields);
           if (cursor.get() && cursor->more())
             continue;
           else
@@ -360,7 +398,7 @@ int Connection::InsertAutoIncrement(const std::string& collection,
 
 int Connection::NextAutoIncrement(const std::string& collection, const std::string& autoIncField)
 {
-  if (!scopedConn) return -1;
+  if (!conn) return -1;
   
   static const char* javascript =
     "function autoIncInsert(colName, field) {\n"
@@ -2,8 +2,8 @@
 #define __DB_CONNECTION_HPP
 
 #include <mongo/client/dbclient.h>
-#include <boost/thread/once.hpp>
 #include <boost/thread/thread.hpp>
+#include <boost/thread/tss.hpp>
 #include <boost/optional.hpp>
 #include "util/string.hpp"
 #include <memory>
@@ -14,6 +14,7 @@
 #include "logs/logs.hpp"
 #include "db/serialization.hpp"
 #include "db/error.hpp"
+#include "db/connectionstats.hpp"
 
 namespace db
 {
@@ -27,14 +28,7 @@ enum class ConnectionMode
 
 class Connection
 {
-  struct AuthenticateHook : mongo::DBConnectionHook
-  {
-    void onCreate(mongo::DBClientBase* conn);
-    void onHandedOut(mongo::DBClientBase*) { }
-    void onDestroy(mongo::DBClientBase*) { }
-  };
-
-  std::unique_ptr<mongo::ScopedDbConnection> scopedConn;
+  mongo::DBClientConnection* conn;
   ConnectionMode mode;
   std::string database;
   
@@ -48,20 +42,22 @@ class Connection
     return ns;
   }
   
-  static boost::once_flag once;
+  static unsigned long long InsertCount(const mongo::BSONObj&) { return 1; }
+  static unsigned long long InsertCount(const std::vector<mongo::BSONObj>& objs)
+  { return objs.size(); }
+
+  static boost::thread_specific_ptr<mongo::DBClientConnection> safeConn;
+  static boost::thread_specific_ptr<mongo::DBClientConnection> fastConn;
   
-  static void CreateAuthenticateHook();
+  static void Authenticate(mongo::DBClientConnection& conn);
   
 public:
   Connection(ConnectionMode mode);
-  ~Connection()
-  {
-    if (scopedConn) scopedConn->done();
-  }
   
   LastError GetLastError()
   {
-    return LastError(scopedConn->conn().getLastErrorDetailed());
+    LatencyTimer timer(Operation::LastError);
+    return LastError(conn->getLastErrorDetailed());
   }
 
   int Update(const std::string& collection, const mongo::Query& query, 
@@ -99,14 +95,20 @@ public:
   template <typename BSONObject>
   void Insert(const std::string& collection, const BSONObject& obj)
   {
-    if (!scopedConn) return;
+    if (!conn) return;
     
     boost::this_thread::disable_interruption noInterrupt;
     
     try
     {
-      scopedConn->conn().insert(Namespace(collection), obj);
-      if (mode != ConnectionMode::Fast)
+      {
+        LatencyTimer timer(Operation::Insert);
+        conn->insert(Namespace(collection), obj);
+      }
+      
+      if (mode == ConnectionMode::Fast)
+        ConnectionStats::Get().Unacknowledged(InsertCount(obj));
+      else
       {
         auto err = GetLastError();
         if (!err.Okay())
@@ -126,7 +128,7 @@ public:
   template <typename T>
   void InsertMulti(const std::string& collection, const std::vector<T>& objects)
   {
-    if (!scopedConn || objects.empty()) return;
+    if (!conn || objects.empty()) return;
     
     try
     {
@@ -148,7 +150,7 @@ public:
   template <typename T>
   void InsertOne(const std::string& collection, const T& obj)
   {
-    if (!scopedConn) return;
+    if (!conn) return;
     try
     {
       Insert(collection, Serialize(obj));
@@ -172,7 +174,7 @@ public:
                             const mongo::BSONObj* fieldsToReturn = nullptr)
   {
     std::vector<T> results;
-    if (!scopedConn) return results;
+    if (!conn) return results;
     
     auto objects = Query(collection, query, nToReturn, nToSkip, fieldsToReturn);
     try
@@ -196,7 +198,7 @@ public:
   boost::optional<T> QueryOne(const std::string& collection, const mongo::Query& query, 
                               const mongo::BSONObj* fieldsToReturn = nullptr)
   {
-    if (scopedConn)
+    if (conn)
     {
       auto results = QueryMulti<T>(collection, query, 1, 0, fieldsToReturn);
       if (!results.empty()) return boost::optional<T>(results.front());
@@ -218,7 +220,7 @@ public:
   int InsertAutoIncrement(const std::string& collection, const T& obj, 
         const std::string& autoIncField)
   {
-    if (scopedConn)
+    if (conn)
     {
       try
       {
@@ -246,6 +248,9 @@ public:
   NoErrorConnection() : Connection(ConnectionMode::NoError) { }
 };
 
+// unacknowledged writes on a socket of their own, a query on another
+// connection straight after, even from the same thread, may not see them.
+// only use for writes nothing needs to read back straight away
 class FastConnection : public Connection
 {
 public:
@@ -0,0 +1,115 @@
+#include <sstream>
+#include <iomanip>
+#include "db/connectionstats.hpp"
+#include "ftp/metrics.hpp"
+
+namespace db
+{
+
+const long long LatencyHistogram::bucketBounds[LatencyHistogram::numBuckets - 1] =
+{
+  100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000,
+  100000, 250000, 500000, 1000000
+};
+
+ConnectionStats ConnectionStats::instance;
+
+LatencyHistogram::LatencyHistogram() :
+  count(0), total(0), maximum(0)
+{
+  for (auto& bucket : buckets) bucket = 0;
+}
+
+void LatencyHistogram::Record(long long microseconds)
+{
+  if (microseconds < 0) microseconds = 0;
+
+  unsigned i = 0;
+  while (i < numBuckets - 1 && microseconds > bucketBounds[i]) ++i;
+  ++buckets[i];
+  ++count;
+  total += microseconds;
+
+  unsigned long long current = maximum;
+  while (static_cast<unsigned long long>(microseconds) > current &&
+         !maximum.compare_exchange_weak(current, microseconds));
+}
+
+void ConnectionStats::Record(Operation op, long long microseconds)
+{
+  histograms[static_cast<unsigned>(op)].Record(microseconds);
+  ftp::Metrics::Database(op, microseconds);
+}
+
+long long LatencyHistogram::Percentile(double p) const
+{
+  unsigned long long total = count;
+  if (total == 0) return 0;
+
+  unsigned long long wanted = static_cast<unsigned long long>(total * p);
+  if (wanted == 0) wanted = 1;
+
+  unsigned long long seen = 0;
+  for (unsigned i = 0; i < numBuckets - 1; ++i)
+  {
+    seen += buckets[i];
+    if (seen >= wanted) return bucketBounds[i];
+  }
+  return maximum;
+}
+
+std::string OperationName(Operation op)
+{
+  switch (op)
+  {
+    case Operation::Connect   : return "connect";
+    case Operation::Insert    : return "insert";
+    case Operation::Update    : return "update";
+    case Operation::Remove    : return "remove";
+    case Operation::Query     : return "query";
+    case Operation::Count     : return "count";
+    case Operation::Command   : return "command";
+    case Operation::Eval      : return "eval";
+    case Operation::LastError : return "lasterror";
+  }
+  return "unknown";
+}
+
+std::vector<std::string> ConnectionStats::Format() const
+{
+  std::vector<std::string> lines;
+
+  {
+    std::ostringstream os;
+    os << "Connections: " << Connects() << " (reconnects: " << Reconnects()
+       << ") Unacknowledged writes: " << Unacknowledged();
+    lines.emplace_back(os.str());
+  }
+
+  {
+    std::ostringstream os;
+    os << std::left << std::setw(10) << "Operation" << std::right
+       << std::setw(10) << "Count" << std::setw(10) << "Avg(us)"
+       << std::setw(10) << "p50(us)" << std::setw(10) << "p99(us)"
+       << std::setw(10) << "Max(us)";
+    lines.emplace_back(os.str());
+  }
+
+  for (unsigned i = 0; i < numOperations; ++i)
+  {
+    const LatencyHistogram& hist = histograms[i];
+    unsigned long long count = hist.Count();
+    std::ostringstream os;
+    os << std::left << std::setw(10) << OperationName(static_cast<Operation>(i))
+       << std::right << std::setw(10) << count
+       << std::setw(10) << (count ? hist.Total() / count : 0)
+       << std::setw(10) << hist.Percentile(0.5)
+       << std::setw(10) << hist.Percentile(0.99)
+       << std::setw(10) << hist.Maximum();
+    lines.emplace_back(os.str());
+  }
+
+  return lines;
+}
+
+} /* db namespace */
@@ -0,0 +1,106 @@
+#ifndef __DB_CONNECTIONSTATS_HPP
+#define __DB_CONNECTIONSTATS_HPP
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+namespace db
+{
+
+enum class Operation : unsigned
+{
+  Connect,
+  Insert,
+  Update,
+  Remove,
+  Query,
+  Count,
+  Command,
+  Eval,
+  LastError
+};
+
+class LatencyHistogram
+{
+public:
+  // upper bounds in microseconds, final bucket catches everything above
+  static const unsigned numBuckets = 14;
+  static const long long bucketBounds[numBuckets - 1];
+
+private:
+  std::atomic<unsigned long long> buckets[numBuckets];
+  std::atomic<unsigned long long> count;
+  std::atomic<unsigned long long> total;
+  std::atomic<unsigned long long> maximum;
+
+public:
+  LatencyHistogram();
+
+  void Record(long long microseconds);
+
+  unsigned long long Count() const { return count; }
+  unsigned long long Total() const { return total; }
+  unsigned long long Maximum() const { return maximum; }
+  unsigned long long Bucket(unsigned i) const { return buckets[i]; }
+  long long Percentile(double p) const;
+};
+
+class ConnectionStats
+{
+  static const unsigned numOperations = static_cast<unsigned>(Operation::LastError) + 1;
+
+  LatencyHistogram histograms[numOperations];
+  std::atomic<unsigned long long> connects;
+  std::atomic<unsigned long long> reconnects;
+  std::atomic<unsigned long long> unacknowledged;
+
+  static ConnectionStats instance;
+
+  ConnectionStats() : connects(0), reconnects(0), unacknowledged(0) { }
+
+public:
+  void Record(Operation op, long long microseconds);
+
+  void Connected(bool reconnect)
+  {
+    ++connects;
+    if (reconnect) ++reconnects;
+  }
+
+  void Unacknowledged(unsigned long long n) { unacknowledged += n; }
+
+  const LatencyHistogram& Histogram(Operation op) const
+  { return histograms[static_cast<unsigned>(op)]; }
+
+  unsigned long long Connects() const { return connects; }
+  unsigned long long Reconnects() const { return reconnects; }
+  unsigned long long Unacknowledged() const { return unacknowledged; }
+
+  std::vector<std::string> Format() const;
+
+  static ConnectionStats& Get() { return instance; }
+};
+
+std::string OperationName(Operation op);
+
+class LatencyTimer
+{
+  Operation op;
+  boost::posix_time::ptime start;
+
+public:
+  LatencyTimer(Operation op) :
+    op(op), start(boost::posix_time::microsec_clock::universal_time()) { }
+
+  ~LatencyTimer()
+  {
+    auto elapsed = boost::posix_time::microsec_clock::universal_time() - start;
+    ConnectionStats::Get().Record(op, elapsed.total_microseconds());
+  }
+};
+
+} /* db namespace */
+
+#endif
@@ -0,0 +1,244 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include "db/dupe/dupeindex.hpp"
+#include "db/storage.hpp"
+#include "cfg/get.hpp"
+#include "util/string.hpp"
+#include "logs/logs.hpp"
+
+namespace db { namespace dupe
+{
+
+namespace
+{
+
+const char snapshotMagic[8] = { 'E', 'B', 'D', 'U', 'P', 'E', '1', '\0' };
+const boost::posix_time::ptime epoch(boost::gregorian::date(1970, 1, 1));
+
+template <typename T>
+void WriteValue(std::ostream& os, T value)
+{
+  os.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+bool ReadValue(std::istream& is, T& value)
+{
+  return is.read(reinterpret_cast<char*>(&value), sizeof(value)).good();
+}
+
+void WriteString(std::ostream& os, const std::string& s)
+{
+  WriteValue<uint16_t>(os, s.size());
+  os.write(s.data(), s.size());
+}
+
+bool ReadString(std::istream& is, std::string& s)
+{
+  uint16_t length;
+  if (!ReadValue(is, length)) return false;
+  s.resize(length);
+  return is.read(&s[0], length).good() || length == 0;
+}
+
+}
+
+std::unique_ptr<DupeIndex> DupeIndex::instance;
+
+DupeIndex::Entry::Entry(const std::string& directory, const std::string& section,
+      const boost::posix_time::ptime& dateTime) :
+  directory(directory), lower(util::ToLowerCopy(directory)),
+  section(section), dateTime(dateTime)
+{
+}
+
+uint32_t DupeIndex::Trigram(const char* s)
+{
+  return (static_cast<uint32_t>(static_cast<unsigned char>(s[0])) << 16) |
+         (static_cast<uint32_t>(static_cast<unsigned char>(s[1])) << 8) |
+          static_cast<uint32_t>(static_cast<unsigned char>(s[2]));
+}
+
+void DupeIndex::Insert(const std::string& directory, const std::string& section,
+      const boost::posix_time::ptime& dateTime)
+{
+  EntryID id = entries.size();
+  if (!directories.insert(std::make_pair(directory, id)).second) return;
+  entries.emplace_back(directory, section, dateTime);
+
+  const std::string& lower = entries.back().lower;
+  for (std::string::size_type i = 0; i + 3 <= lower.length(); ++i)
+  {
+    Postings& list = postings[Trigram(&lower[i])];
+    if (list.empty() || list.back() != id) list.emplace_back(id);
+  }
+}
+
+void DupeIndex::Add(const std::string& directory, const std::string& section,
+      const boost::posix_time::ptime& dateTime)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  Insert(directory, section, dateTime);
+}
+
+std::vector<DupeResult> DupeIndex::Search(const std::vector<std::string>& terms, int limit) const
+{
+  std::vector<std::string> lowerTerms;
+  for (const auto& term : terms)
+  {
+    if (!term.empty()) lowerTerms.emplace_back(util::ToLowerCopy(term));
+  }
+
+  std::vector<DupeResult> results;
+  std::lock_guard<std::mutex> lock(mutex);
+
+  std::vector<const Postings*> lists;
+  for (const auto& term : lowerTerms)
+  {
+    for (std::string::size_type i = 0; i + 3 <= term.length(); ++i)
+    {
+      auto it = postings.find(Trigram(&term[i]));
+      if (it == postings.end()) return results;
+      lists.emplace_back(&it->second);
+    }
+  }
+
+  std::sort(lists.begin(), lists.end());
+  lists.erase(std::unique(lists.begin(), lists.end()), lists.end());
+  std::sort(lists.begin(), lists.end(),
+            [](const Postings* a, const Postings* b) { return a->size() < b->size(); });
+
+  auto accept = [&](EntryID id) -> bool
+    {
+      for (auto it = lists.begin() + (lists.empty() ? 0 : 1); it != lists.end(); ++it)
+      {
+        if (!std::binary_search((*it)->begin(), (*it)->end(), id)) return false;
+      }
+
+      const Entry& entry = entries[id];
+      for (const auto& term : lowerTerms)
+      {
+        if (entry.lower.find(term) == std::string::npos) return false;
+      }
+
+      results.emplace_back(entry.directory, entry.section, entry.dateTime);
+      return limit <= 0 || static_cast<int>(results.size()) < limit;
+    };
+
+  if (lists.empty())
+  {
+    for (EntryID id = entries.size(); id > 0; --id)
+    {
+      if (!accept(id - 1)) break;
+    }
+  }
+  else
+  {
+    const Postings& smallest = *lists.front();
+    for (auto it = smallest.rbegin(); it != smallest.rend(); ++it)
+    {
+      if (!accept(*it)) break;
+    }
+  }
+
+  return results;
+}
+
+size_t DupeIndex::Size() const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return entries.size();
+}
+
+util::Error DupeIndex::LoadSnapshot()
+{
+  std::ifstream is(snapshotPath.c_str(), std::ios::binary);
+  if (!is) return util::Error::Failure(errno);
+
+  char magic[sizeof(snapshotMagic)];
+  if (!is.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), snapshotMagic))
+    return util::Error::Failure("Invalid snapshot header");
+
+  uint32_t count;
+  if (!ReadValue(is, count)) return util::Error::Failure("Truncated snapshot");
+
+  entries.reserve(count);
+  std::string directory;
+  std::string section;
+  for (uint32_t i = 0; i < count; ++i)
+  {
+    int64_t seconds;
+    if (!ReadValue(is, seconds) || !ReadString(is, directory) || !ReadString(is, section))
+      return util::Error::Failure("Truncated snapshot");
+    Insert(directory, section, epoch + boost::posix_time::seconds(seconds));
+  }
+
+  return util::Error::Success();
+}
+
+util::Error DupeIndex::SaveSnapshot() const
+{
+  std::string tmpPath = snapshotPath + ".tmp";
+
+  {
+    std::ofstream os(tmpPath.c_str(), std::ios::binary | std::ios::trunc);
+    if (!os) return util::Error::Failure(errno);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    os.write(snapshotMagic, sizeof(snapshotMagic));
+    WriteValue<uint32_t>(os, entries.size());
+    for (const auto& entry : entries)
+    {
+      WriteValue<int64_t>(os, (entry.dateTime - epoch).total_seconds());
+      WriteString(os, entry.directory);
+      WriteString(os, entry.section);
+    }
+
+    if (!os.flush()) return util::Error::Failure(errno);
+  }
+
+  if (rename(tmpPath.c_str(), snapshotPath.c_str()) < 0)
+    return util::Error::Failure(errno);
+
+  return util::Error::Success();
+}
+
+bool DupeIndex::Initialise()
+{
+  instance.reset(new DupeIndex(cfg::Get().Datapath() + "/dupe.snapshot"));
+
+  boost::posix_time::ptime since(boost::posix_time::not_a_date_time);
+  util::Error e = instance->LoadSnapshot();
+  if (!e)
+  {
+    if (e.Errno() != ENOENT)
+      logs::Database("Unable to load dupe index snapshot, rebuilding: %1%", e.Message());
+    instance.reset(new DupeIndex(instance->snapshotPath));
+  }
+  else if (!instance->entries.empty())
+  {
+    // overlap slightly in case of clock skew, duplicates are ignored
+    since = instance->entries.back().dateTime - boost::posix_time::minutes(5);
+  }
+
+  for (const auto& result : GetStorage().DupeSince(since))
+  {
+    instance->Insert(result.directory, result.section, result.dateTime);
+  }
+
+  logs::Debug("Dupe index loaded with %1% entries", instance->entries.size());
+  return true;
+}
+
+void DupeIndex::Cleanup()
+{
+  if (!instance) return;
+  util::Error e = instance->SaveSnapshot();
+  if (!e) logs::Database("Unable to save dupe index snapshot: %1%", e.Message());
+  instance.reset();
+}
+
+} /* dupe namespace */
+} /* db namespace */
@@ -0,0 +1,68 @@
+#ifndef __DB_DUPE_DUPEINDEX_HPP
+#define __DB_DUPE_DUPEINDEX_HPP
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include "db/dupe/dupe.hpp"
+#include "util/error.hpp"
+
+namespace db { namespace dupe
+{
+
+// trigram index over dupe directory names, entry ids are assigned in
+// insertion order so every posting list is sorted and a reverse walk
+// yields newest first
+class DupeIndex
+{
+  struct Entry
+  {
+    std::string directory;
+    std::string lower;
+    std::string section;
+    boost::posix_time::ptime dateTime;
+
+    Entry(const std::string& directory, const std::string& section,
+          const boost::posix_time::ptime& dateTime);
+  };
+
+  typedef uint32_t EntryID;
+  typedef std::vector<EntryID> Postings;
+
+  mutable std::mutex mutex;
+  std::vector<Entry> entries;
+  std::unordered_map<std::string, EntryID> directories;
+  std::unordered_map<uint32_t, Postings> postings;
+  std::string snapshotPath;
+
+  static std::unique_ptr<DupeIndex> instance;
+
+  DupeIndex(const std::string& snapshotPath) : snapshotPath(snapshotPath) { }
+
+  void Insert(const std::string& directory, const std::string& section,
+              const boost::posix_time::ptime& dateTime);
+
+  util::Error LoadSnapshot();
+  util::Error SaveSnapshot() const;
+
+  static uint32_t Trigram(const char* s);
+
+public:
+  void Add(const std::string& directory, const std::string& section,
+           const boost::posix_time::ptime& dateTime);
+  std::vector<DupeResult> Search(const std::vector<std::string>& terms, int limit) const;
+  size_t Size() const;
+
+  static bool Initialise();
+  static void Cleanup();
+  static DupeIndex* Get() { return instance.get(); }
+};
+
+} /* dupe namespace */
+} /* db namespace */
+
+#endif
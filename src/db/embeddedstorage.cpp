@@ -0,0 +1,1259 @@
+#include <algorithm>
+#include <cerrno>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <boost/lexical_cast.hpp>
+#include <boost/date_time/c_local_time_adjustor.hpp>
+#include "db/embeddedstorage.hpp"
+#include "db/replicator.hpp"
+#include "stats/date.hpp"
+#include "util/string.hpp"
+#include "logs/logs.hpp"
+
+namespace db
+{
+
+namespace
+{
+
+typedef boost::date_time::c_local_adjustor<boost::posix_time::ptime> local_adj;
+
+const unsigned long long minimumCompactCount = 1000;
+
+boost::posix_time::ptime ToPosixTime(time_t t)
+{
+  return local_adj::utc_to_local(boost::posix_time::from_time_t(t));
+}
+
+bool MatchTerms(const std::string& lower, const std::vector<std::string>& terms)
+{
+  for (const auto& term : terms)
+  {
+    if (lower.find(term) == std::string::npos) return false;
+  }
+  return true;
+}
+
+std::vector<std::string> LowerTerms(const std::vector<std::string>& terms)
+{
+  std::vector<std::string> lower;
+  lower.reserve(terms.size());
+  for (const auto& term : terms) lower.emplace_back(util::ToLowerCopy(term));
+  return lower;
+}
+
+template <typename T>
+std::string ToString(const T& value)
+{
+  return boost::lexical_cast<std::string>(value);
+}
+
+// fields are read front to back, running off the end throws so the
+// record is skipped as malformed
+class RecordReader
+{
+  const RecordLog::Record& record;
+  size_t pos;
+
+public:
+  RecordReader(const RecordLog::Record& record, size_t pos) : record(record), pos(pos) { }
+
+  const std::string& Next()
+  {
+    if (pos >= record.size()) throw std::out_of_range("Record too short");
+    return record[pos++];
+  }
+
+  template <typename T>
+  T Next()
+  {
+    return boost::lexical_cast<T>(Next());
+  }
+};
+
+// containers and maps are stored as a count followed by their elements
+template <typename Container>
+void AppendContainer(RecordLog::Record& record, const Container& container)
+{
+  record.emplace_back(ToString(container.size()));
+  for (const auto& value : container) record.emplace_back(ToString(value));
+}
+
+template <typename Container>
+void ReadContainer(RecordReader& reader, Container& container)
+{
+  container.clear();
+  auto size = reader.Next<size_t>();
+  while (size-- > 0)
+    container.insert(container.end(), reader.Next<typename Container::value_type>());
+}
+
+template <typename Map>
+void AppendMap(RecordLog::Record& record, const Map& map)
+{
+  record.emplace_back(ToString(map.size()));
+  for (const auto& kv : map)
+  {
+    record.emplace_back(kv.first);
+    record.emplace_back(ToString(kv.second));
+  }
+}
+
+template <typename Map>
+void ReadMap(RecordReader& reader, Map& map)
+{
+  map.clear();
+  auto size = reader.Next<size_t>();
+  while (size-- > 0)
+  {
+    std::string key = reader.Next();
+    map[key] = reader.Next<typename Map::mapped_type>();
+  }
+}
+
+RecordLog::Record UserRecord(const acl::UserData& user)
+{
+  RecordLog::Record record { "U", ToString(user.id), user.name, user.password,
+      user.salt, user.flags, ToString(user.primaryGid), ToString(user.creator),
+      boost::gregorian::to_iso_string(user.created), user.homeDir,
+      ToString(user.idleTime),
+      user.expires ? boost::gregorian::to_iso_string(*user.expires) : std::string(),
+      ToString(user.numLogins), user.comment, user.tagline,
+      ToString(user.maxDownSpeed), ToString(user.maxUpSpeed),
+      ToString(user.maxSimDown), ToString(user.maxSimUp), ToString(user.loggedIn),
+      user.lastLogin ? boost::posix_time::to_iso_string(*user.lastLogin) : std::string() };
+
+  AppendContainer(record, user.ipMasks);
+  AppendContainer(record, user.secondaryGids);
+  AppendContainer(record, user.gadminGids);
+  AppendMap(record, user.ratio);
+  AppendMap(record, user.credits);
+  AppendMap(record, user.weeklyAllotment);
+  return record;
+}
+
+acl::UserData UserFromRecord(const RecordLog::Record& record)
+{
+  RecordReader reader(record, 1);
+  acl::UserData user;
+  user.id = reader.Next<acl::UserID>();
+  user.name = reader.Next();
+  user.password = reader.Next();
+  user.salt = reader.Next();
+  user.flags = reader.Next();
+  user.primaryGid = reader.Next<acl::GroupID>();
+  user.creator = reader.Next<acl::UserID>();
+  user.created = boost::gregorian::from_undelimited_string(reader.Next());
+  user.homeDir = reader.Next();
+  user.idleTime = reader.Next<int>();
+
+  const std::string& expires = reader.Next();
+  if (!expires.empty()) user.expires.reset(boost::gregorian::from_undelimited_string(expires));
+
+  user.numLogins = reader.Next<int>();
+  user.comment = reader.Next();
+  user.tagline = reader.Next();
+  user.maxDownSpeed = reader.Next<long long>();
+  user.maxUpSpeed = reader.Next<long long>();
+  user.maxSimDown = reader.Next<int>();
+  user.maxSimUp = reader.Next<int>();
+  user.loggedIn = reader.Next<int>();
+
+  const std::string& lastLogin = reader.Next();
+  if (!lastLogin.empty()) user.lastLogin.reset(boost::posix_time::from_iso_string(lastLogin));
+
+  ReadContainer(reader, user.ipMasks);
+  ReadContainer(reader, user.secondaryGids);
+  ReadContainer(reader, user.gadminGids);
+  ReadMap(reader, user.ratio);
+  ReadMap(reader, user.credits);
+  ReadMap(reader, user.weeklyAllotment);
+  return user;
+}
+
+bool CopyUserField(const acl::UserData& from, acl::UserData& to, const std::string& field)
+{
+  if (field == "name") to.name = from.name;
+  else if (field == "ip masks") to.ipMasks = from.ipMasks;
+  else if (field == "password") to.password = from.password;
+  else if (field == "salt") to.salt = from.salt;
+  else if (field == "flags") to.flags = from.flags;
+  else if (field == "primary gid") to.primaryGid = from.primaryGid;
+  else if (field == "secondary gids") to.secondaryGids = from.secondaryGids;
+  else if (field == "gadmin gids") to.gadminGids = from.gadminGids;
+  else if (field == "creator") to.creator = from.creator;
+  else if (field == "home dir") to.homeDir = from.homeDir;
+  else if (field == "idle time") to.idleTime = from.idleTime;
+  else if (field == "expires") to.expires = from.expires;
+  else if (field == "num logins") to.numLogins = from.numLogins;
+  else if (field == "comment") to.comment = from.comment;
+  else if (field == "tagline") to.tagline = from.tagline;
+  else if (field == "max down speed") to.maxDownSpeed = from.maxDownSpeed;
+  else if (field == "max up speed") to.maxUpSpeed = from.maxUpSpeed;
+  else if (field == "max sim down") to.maxSimDown = from.maxSimDown;
+  else if (field == "max sim up") to.maxSimUp = from.maxSimUp;
+  else if (field == "logged in") to.loggedIn = from.loggedIn;
+  else if (field == "last login") to.lastLogin = from.lastLogin;
+  else if (field == "ratio") to.ratio = from.ratio;
+  else if (field == "credits") to.credits = from.credits;
+  else if (field == "weekly allotment") to.weeklyAllotment = from.weeklyAllotment;
+  else return false;
+  return true;
+}
+
+RecordLog::Record GroupRecord(const acl::GroupData& group)
+{
+  return RecordLog::Record { "U", ToString(group.id), group.name,
+      group.description, group.comment, ToString(group.slots),
+      ToString(group.leechSlots), ToString(group.allotmentSlots),
+      ToString(group.maxAllotmentSize), ToString(group.maxLogins) };
+}
+
+acl::GroupData GroupFromRecord(const RecordLog::Record& record)
+{
+  RecordReader reader(record, 1);
+  acl::GroupData group;
+  group.id = reader.Next<acl::GroupID>();
+  group.name = reader.Next();
+  group.description = reader.Next();
+  group.comment = reader.Next();
+  group.slots = reader.Next<int>();
+  group.leechSlots = reader.Next<int>();
+  group.allotmentSlots = reader.Next<int>();
+  group.maxAllotmentSize = reader.Next<long long>();
+  group.maxLogins = reader.Next<int>();
+  return group;
+}
+
+bool CopyGroupField(const acl::GroupData& from, acl::GroupData& to, const std::string& field)
+{
+  if (field == "name") to.name = from.name;
+  else if (field == "description") to.description = from.description;
+  else if (field == "comment") to.comment = from.comment;
+  else if (field == "slots") to.slots = from.slots;
+  else if (field == "leech slots") to.leechSlots = from.leechSlots;
+  else if (field == "allotment slots") to.allotmentSlots = from.allotmentSlots;
+  else if (field == "max allotment size") to.maxAllotmentSize = from.maxAllotmentSize;
+  else if (field == "max logins") to.maxLogins = from.maxLogins;
+  else return false;
+  return true;
+}
+
+// checked at startup and after every append, the log is rewritten with
+// one record per live entry once it's more than twice that long
+bool NeedsCompact(unsigned long long logCount, unsigned long long liveCount)
+{
+  return logCount > minimumCompactCount && logCount > liveCount * 2;
+}
+
+}
+
+EmbeddedStorage::DupeEntry::DupeEntry(const std::string& directory,
+      const std::string& section, time_t created) :
+  directory(directory), lower(util::ToLowerCopy(directory)),
+  section(section), created(created)
+{
+}
+
+EmbeddedStorage::IndexEntry::IndexEntry(const std::string& path,
+      const std::string& section, time_t created) :
+  path(path), lower(util::ToLowerCopy(path)),
+  section(section), created(created)
+{
+}
+
+EmbeddedStorage::MailEntry::MailEntry(const std::string& sender, acl::UserID recipient,
+      const std::string& body, const boost::posix_time::ptime& timeSent,
+      mail::Status status) :
+  sender(sender), recipient(recipient), body(body),
+  timeSent(timeSent), status(status)
+{
+}
+
+EmbeddedStorage::EmbeddedStorage(const std::string& dataPath) :
+  dataPath(dataPath),
+  dupeLog(dataPath + "/dupe.log"),
+  indexLog(dataPath + "/index.log"),
+  indexSequence(0),
+  transfersLog(dataPath + "/transfers.log"),
+  protocolLog(dataPath + "/protocol.log"),
+  usersLog(dataPath + "/users.log"),
+  groupsLog(dataPath + "/groups.log"),
+  mailLog(dataPath + "/mail.log"),
+  mailSequence(0)
+{
+}
+
+void EmbeddedStorage::ReplayDupe(const RecordLog::Record& record)
+{
+  if (record.size() != 4 || record[0] != "A") return;
+  if (!dupeDirectories.insert(record[1]).second) return;
+  dupes.emplace_back(record[1], record[2], boost::lexical_cast<time_t>(record[3]));
+}
+
+void EmbeddedStorage::ReplayIndex(const RecordLog::Record& record)
+{
+  if (record.size() == 4 && record[0] == "A")
+    InsertIndex(record[1], record[2], boost::lexical_cast<time_t>(record[3]));
+  else if (record.size() == 2 && record[0] == "D")
+    EraseIndex(record[1]);
+}
+
+void EmbeddedStorage::ReplayTransfer(const RecordLog::Record& record)
+{
+  if (record.size() != 11 || record[0] != "U") return;
+
+  TransferMapKey key(boost::lexical_cast<acl::UserID>(record[1]),
+                     boost::lexical_cast<int>(record[2]),
+                     boost::lexical_cast<int>(record[3]),
+                     boost::lexical_cast<int>(record[4]),
+                     boost::lexical_cast<int>(record[5]),
+                     boost::lexical_cast<unsigned>(record[6]),
+                     record[7]);
+
+  TransferTotal& total = transfers[key];
+  total.files += boost::lexical_cast<long long>(record[8]);
+  total.kBytes += boost::lexical_cast<long long>(record[9]);
+  total.xfertime += boost::lexical_cast<long long>(record[10]);
+}
+
+void EmbeddedStorage::ReplayProtocol(const RecordLog::Record& record)
+{
+  if (record.size() != 8 || record[0] != "U") return;
+
+  ProtocolMapKey key(boost::lexical_cast<acl::UserID>(record[1]),
+                     boost::lexical_cast<int>(record[2]),
+                     boost::lexical_cast<int>(record[3]),
+                     boost::lexical_cast<int>(record[4]),
+                     boost::lexical_cast<int>(record[5]));
+
+  auto& total = protocol[key];
+  total.first += boost::lexical_cast<long long>(record[6]);
+  total.second += boost::lexical_cast<long long>(record[7]);
+}
+
+void EmbeddedStorage::ReplayUser(const RecordLog::Record& record)
+{
+  if (record.size() > 1 && record[0] == "U")
+    StoreUser(UserFromRecord(record));
+  else if (record.size() == 4 && record[0] == "C")
+  {
+    auto it = users.find(boost::lexical_cast<acl::UserID>(record[1]));
+    if (it != users.end())
+      it->second.credits[record[2]] = boost::lexical_cast<long long>(record[3]);
+  }
+  else if (record.size() == 2 && record[0] == "D")
+  {
+    auto it = users.find(boost::lexical_cast<acl::UserID>(record[1]));
+    if (it == users.end()) return;
+    userNames.erase(it->second.name);
+    users.erase(it);
+  }
+}
+
+void EmbeddedStorage::ReplayGroup(const RecordLog::Record& record)
+{
+  if (record.size() > 1 && record[0] == "U")
+    StoreGroup(GroupFromRecord(record));
+  else if (record.size() == 2 && record[0] == "D")
+  {
+    auto it = groups.find(boost::lexical_cast<acl::GroupID>(record[1]));
+    if (it == groups.end()) return;
+    groupNames.erase(it->second.name);
+    groups.erase(it);
+  }
+}
+
+void EmbeddedStorage::ReplayMail(const RecordLog::Record& record)
+{
+  if (record.size() == 7 && record[0] == "A")
+  {
+    auto seq = boost::lexical_cast<unsigned long long>(record[1]);
+    mail.insert(std::make_pair(seq, MailEntry(record[2], 
+          boost::lexical_cast<acl::UserID>(record[3]), record[4],
+          boost::posix_time::from_iso_string(record[5]),
+          util::EnumFromString<mail::Status>(record[6]))));
+    mailSequence = std::max(mailSequence, seq + 1);
+  }
+  else if (record.size() == 3 && record[0] == "S")
+  {
+    auto it = mail.find(boost::lexical_cast<unsigned long long>(record[1]));
+    if (it != mail.end()) it->second.status = util::EnumFromString<mail::Status>(record[2]);
+  }
+  else if (record.size() == 2 && record[0] == "D")
+    mail.erase(boost::lexical_cast<unsigned long long>(record[1]));
+}
+
+void EmbeddedStorage::StoreUser(const acl::UserData& user)
+{
+  auto it = users.find(user.id);
+  if (it != users.end()) userNames.erase(it->second.name);
+  users[user.id] = user;
+  userNames[user.name] = user.id;
+}
+
+void EmbeddedStorage::StoreGroup(const acl::GroupData& group)
+{
+  auto it = groups.find(group.id);
+  if (it != groups.end()) groupNames.erase(it->second.name);
+  groups[group.id] = group;
+  groupNames[group.name] = group.id;
+}
+
+bool EmbeddedStorage::AppendUser(const RecordLog::Record& record)
+{
+  util::Error e = usersLog.Append(record);
+  if (!e)
+  {
+    logs::Database("Unable to append to %1%: %2%", usersLog.Path(), e.Message());
+    return false;
+  }
+
+  if (NeedsCompact(usersLog.Count(), users.size())) CompactUsers();
+  return true;
+}
+
+bool EmbeddedStorage::AppendGroup(const RecordLog::Record& record)
+{
+  util::Error e = groupsLog.Append(record);
+  if (!e)
+  {
+    logs::Database("Unable to append to %1%: %2%", groupsLog.Path(), e.Message());
+    return false;
+  }
+
+  if (NeedsCompact(groupsLog.Count(), groups.size())) CompactGroups();
+  return true;
+}
+
+bool EmbeddedStorage::AppendMail(const RecordLog::Record& record)
+{
+  util::Error e = mailLog.Append(record);
+  if (!e)
+  {
+    logs::Database("Unable to append to %1%: %2%", mailLog.Path(), e.Message());
+    return false;
+  }
+
+  if (NeedsCompact(mailLog.Count(), mail.size())) CompactMail();
+  return true;
+}
+
+void EmbeddedStorage::InsertIndex(const std::string& path,
+      const std::string& section, time_t created)
+{
+  if (indexPaths.find(path) != indexPaths.end()) return;
+  unsigned long long seq = indexSequence++;
+  index.insert(std::make_pair(seq, IndexEntry(path, section, created)));
+  indexPaths.insert(std::make_pair(path, seq));
+}
+
+void EmbeddedStorage::EraseIndex(const std::string& path)
+{
+  auto it = indexPaths.find(path);
+  if (it == indexPaths.end()) return;
+  index.erase(it->second);
+  indexPaths.erase(it);
+}
+
+void EmbeddedStorage::CompactIndex()
+{
+  std::vector<RecordLog::Record> records;
+  records.reserve(index.size());
+  for (const auto& kv : index)
+  {
+    const IndexEntry& entry = kv.second;
+    records.emplace_back(RecordLog::Record { "A", entry.path, entry.section,
+                                             ToString(entry.created) });
+  }
+
+  util::Error e = indexLog.Rewrite(records);
+  if (!e) logs::Database("Unable to compact %1%: %2%", indexLog.Path(), e.Message());
+}
+
+void EmbeddedStorage::CompactTransfers()
+{
+  std::vector<RecordLog::Record> records;
+  records.reserve(transfers.size());
+  for (const auto& kv : transfers)
+  {
+    records.emplace_back(RecordLog::Record { "U",
+        ToString(std::get<0>(kv.first)), ToString(std::get<1>(kv.first)),
+        ToString(std::get<2>(kv.first)), ToString(std::get<3>(kv.first)),
+        ToString(std::get<4>(kv.first)), ToString(std::get<5>(kv.first)),
+        std::get<6>(kv.first), ToString(kv.second.files),
+        ToString(kv.second.kBytes), ToString(kv.second.xfertime) });
+  }
+
+  util::Error e = transfersLog.Rewrite(records);
+  if (!e) logs::Database("Unable to compact %1%: %2%", transfersLog.Path(), e.Message());
+}
+
+void EmbeddedStorage::CompactProtocol()
+{
+  std::vector<RecordLog::Record> records;
+  records.reserve(protocol.size());
+  for (const auto& kv : protocol)
+  {
+    records.emplace_back(RecordLog::Record { "U",
+        ToString(std::get<0>(kv.first)), ToString(std::get<1>(kv.first)),
+        ToString(std::get<2>(kv.first)), ToString(std::get<3>(kv.first)),
+        ToString(std::get<4>(kv.first)), ToString(kv.second.first),
+        ToString(kv.second.second) });
+  }
+
+  util::Error e = protocolLog.Rewrite(records);
+  if (!e) logs::Database("Unable to compact %1%: %2%", protocolLog.Path(), e.Message());
+}
+
+void EmbeddedStorage::CompactUsers()
+{
+  std::vector<RecordLog::Record> records;
+  records.reserve(users.size());
+  for (const auto& kv : users) records.emplace_back(UserRecord(kv.second));
+
+  util::Error e = usersLog.Rewrite(records);
+  if (!e) logs::Database("Unable to compact %1%: %2%", usersLog.Path(), e.Message());
+}
+
+void EmbeddedStorage::CompactGroups()
+{
+  std::vector<RecordLog::Record> records;
+  records.reserve(groups.size());
+  for (const auto& kv : groups) records.emplace_back(GroupRecord(kv.second));
+
+  util::Error e = groupsLog.Rewrite(records);
+  if (!e) logs::Database("Unable to compact %1%: %2%", groupsLog.Path(), e.Message());
+}
+
+void EmbeddedStorage::CompactMail()
+{
+  std::vector<RecordLog::Record> records;
+  records.reserve(mail.size());
+  for (const auto& kv : mail)
+  {
+    const MailEntry& entry = kv.second;
+    records.emplace_back(RecordLog::Record { "A", ToString(kv.first), entry.sender,
+        ToString(entry.recipient), entry.body,
+        boost::posix_time::to_iso_string(entry.timeSent),
+        util::EnumToString(entry.status) });
+  }
+
+  util::Error e = mailLog.Rewrite(records);
+  if (!e) logs::Database("Unable to compact %1%: %2%", mailLog.Path(), e.Message());
+}
+
+bool EmbeddedStorage::Initialise()
+{
+  if (mkdir(dataPath.c_str(), 0700) < 0 && errno != EEXIST)
+  {
+    logs::Database("Unable to create embedded database directory: %1%: %2%",
+                   dataPath, util::Error::Failure(errno).Message());
+    return false;
+  }
+
+  std::vector<std::pair<RecordLog*, std::function<void(const RecordLog::Record&)>>> logs =
+  {
+    { &dupeLog, [this](const RecordLog::Record& r) { ReplayDupe(r); } },
+    { &indexLog, [this](const RecordLog::Record& r) { ReplayIndex(r); } },
+    { &transfersLog, [this](const RecordLog::Record& r) { ReplayTransfer(r); } },
+    { &protocolLog, [this](const RecordLog::Record& r) { ReplayProtocol(r); } },
+    { &usersLog, [this](const RecordLog::Record& r) { ReplayUser(r); } },
+    { &groupsLog, [this](const RecordLog::Record& r) { ReplayGroup(r); } },
+    { &mailLog, [this](const RecordLog::Record& r) { ReplayMail(r); } }
+  };
+
+  for (auto& log : logs)
+  {
+    util::Error e = log.first->Open(log.second);
+    if (!e)
+    {
+      logs::Database("Unable to load %1%: %2%", log.first->Path(), e.Message());
+      return false;
+    }
+
+    if (log.first->Malformed() > 0)
+    {
+      logs::Database("Skipped %1% malformed records while loading %2%", 
+                     log.first->Malformed(), log.first->Path());
+    }
+  }
+
+  if (NeedsCompact(indexLog.Count(), index.size())) CompactIndex();
+  if (NeedsCompact(transfersLog.Count(), transfers.size())) CompactTransfers();
+  if (NeedsCompact(protocolLog.Count(), protocol.size())) CompactProtocol();
+  if (NeedsCompact(usersLog.Count(), users.size())) CompactUsers();
+  if (NeedsCompact(groupsLog.Count(), groups.size())) CompactGroups();
+  if (NeedsCompact(mailLog.Count(), mail.size())) CompactMail();
+
+  return true;
+}
+
+void EmbeddedStorage::DupeAdd(const std::string& directory, const std::string& section)
+{
+  std::lock_guard<std::mutex> lock(dupeMutex);
+  if (!dupeDirectories.insert(directory).second) return;
+
+  time_t now = time(nullptr);
+  dupes.emplace_back(directory, section, now);
+
+  util::Error e = dupeLog.Append({ "A", directory, section, ToString(now) });
+  if (!e) logs::Database("Unable to append to %1%: %2%", dupeLog.Path(), e.Message());
+}
+
+std::vector<dupe::DupeResult> EmbeddedStorage::DupeSearch(
+      const std::vector<std::string>& terms, int limit)
+{
+  auto lowerTerms = LowerTerms(terms);
+  std::vector<dupe::DupeResult> results;
+
+  std::lock_guard<std::mutex> lock(dupeMutex);
+  for (const auto& entry : dupes)
+  {
+    if (limit > 0 && static_cast<int>(results.size()) >= limit) break;
+    if (MatchTerms(entry.lower, lowerTerms))
+      results.emplace_back(entry.directory, entry.section, ToPosixTime(entry.created));
+  }
+
+  return results;
+}
+
+std::vector<dupe::DupeResult> EmbeddedStorage::DupeSince(const boost::posix_time::ptime& since)
+{
+  std::vector<dupe::DupeResult> results;
+
+  std::lock_guard<std::mutex> lock(dupeMutex);
+  for (const auto& entry : dupes)
+  {
+    auto dateTime = ToPosixTime(entry.created);
+    if (since.is_special() || dateTime >= since)
+      results.emplace_back(entry.directory, entry.section, dateTime);
+  }
+
+  return results;
+}
+
+void EmbeddedStorage::IndexAdd(const std::string& path, const std::string& section)
+{
+  std::lock_guard<std::mutex> lock(indexMutex);
+  if (indexPaths.find(path) != indexPaths.end()) return;
+
+  time_t now = time(nullptr);
+  InsertIndex(path, section, now);
+
+  util::Error e = indexLog.Append({ "A", path, section, ToString(now) });
+  if (!e) logs::Database("Unable to append to %1%: %2%", indexLog.Path(), e.Message());
+  else if (NeedsCompact(indexLog.Count(), index.size())) CompactIndex();
+}
+
+void EmbeddedStorage::IndexDelete(const std::string& path)
+{
+  std::lock_guard<std::mutex> lock(indexMutex);
+  if (indexPaths.find(path) == indexPaths.end()) return;
+
+  EraseIndex(path);
+
+  util::Error e = indexLog.Append({ "D", path });
+  if (!e) logs::Database("Unable to append to %1%: %2%", indexLog.Path(), e.Message());
+  else if (NeedsCompact(indexLog.Count(), index.size())) CompactIndex();
+}
+
+void EmbeddedStorage::IndexDelete(const std::vector<std::string>& paths)
+{
+  std::vector<RecordLog::Record> records;
+  std::lock_guard<std::mutex> lock(indexMutex);
+  for (const auto& path : paths)
+  {
+    if (indexPaths.find(path) == indexPaths.end()) continue;
+    EraseIndex(path);
+    records.push_back({ "D", path });
+  }
+
+  if (records.empty()) return;
+  util::Error e = indexLog.Append(records);
+  if (!e) logs::Database("Unable to append to %1%: %2%", indexLog.Path(), e.Message());
+  else if (NeedsCompact(indexLog.Count(), index.size())) CompactIndex();
+}
+
+std::vector<index::SearchResult> EmbeddedStorage::IndexSearch(
+      const std::vector<std::string>& terms, int limit)
+{
+  auto lowerTerms = LowerTerms(terms);
+  std::vector<index::SearchResult> results;
+
+  std::lock_guard<std::mutex> lock(indexMutex);
+  for (auto it = index.rbegin(); it != index.rend(); ++it)
+  {
+    if (limit > 0 && static_cast<int>(results.size()) >= limit) break;
+    const IndexEntry& entry = it->second;
+    if (MatchTerms(entry.lower, lowerTerms))
+      results.emplace_back(entry.path, entry.section, ToPosixTime(entry.created));
+  }
+
+  return results;
+}
+
+void EmbeddedStorage::TransferUpdate(const TransferKey& key, int files,
+      long long kBytes, long long xfertime)
+{
+  TransferMapKey mapKey(key.uid, key.year, key.month, key.week, key.day,
+                        static_cast<unsigned>(key.direction), key.section);
+
+  std::lock_guard<std::mutex> lock(transfersMutex);
+  TransferTotal& total = transfers[mapKey];
+  total.files += files;
+  total.kBytes += kBytes;
+  total.xfertime += xfertime;
+
+  util::Error e = transfersLog.Append({ "U", ToString(key.uid),
+        ToString(key.year), ToString(key.month), ToString(key.week),
+        ToString(key.day), ToString(static_cast<unsigned>(key.direction)),
+        key.section, ToString(files), ToString(kBytes), ToString(xfertime) });
+  if (!e) logs::Database("Unable to append to %1%: %2%", transfersLog.Path(), e.Message());
+  else if (NeedsCompact(transfersLog.Count(), transfers.size())) CompactTransfers();
+}
+
+std::vector< ::stats::Stat> EmbeddedStorage::TransferTotals(const TransferQuery& query)
+{
+  std::map<acl::UserID, ::stats::Stat> totals;
+
+  {
+    std::lock_guard<std::mutex> lock(transfersMutex);
+    for (const auto& kv : transfers)
+    {
+      acl::UserID uid = std::get<0>(kv.first);
+      if (query.uid && *query.uid != uid) continue;
+      if (query.direction && static_cast<unsigned>(*query.direction) != std::get<5>(kv.first))
+        continue;
+      if (!query.date.Matches(std::get<1>(kv.first), std::get<2>(kv.first),
+                              std::get<3>(kv.first), std::get<4>(kv.first)))
+        continue;
+      if (!query.SectionMatches(std::get<6>(kv.first))) continue;
+
+      acl::UserID id = query.groupByUser ? uid : -1;
+      ::stats::Stat stat(id, kv.second.files, kv.second.kBytes, kv.second.xfertime);
+      auto it = totals.insert(std::make_pair(id, stat));
+      if (!it.second) it.first->second.Incr(stat);
+    }
+  }
+
+  std::vector< ::stats::Stat> results;
+  results.reserve(totals.size());
+  for (const auto& kv : totals) results.emplace_back(kv.second);
+  return results;
+}
+
+void EmbeddedStorage::ProtocolUpdate(acl::UserID uid, const ::stats::Date& date,
+      long long sendKBytes, long long receiveKBytes)
+{
+  ProtocolMapKey key(uid, date.Year(), date.Month(), date.Week(), date.Day());
+
+  std::lock_guard<std::mutex> lock(protocolMutex);
+  auto& total = protocol[key];
+  total.first += sendKBytes;
+  total.second += receiveKBytes;
+
+  util::Error e = protocolLog.Append({ "U", ToString(uid), ToString(date.Year()),
+        ToString(date.Month()), ToString(date.Week()), ToString(date.Day()),
+        ToString(sendKBytes), ToString(receiveKBytes) });
+  if (!e) logs::Database("Unable to append to %1%: %2%", protocolLog.Path(), e.Message());
+  else if (NeedsCompact(protocolLog.Count(), protocol.size())) CompactProtocol();
+}
+
+stats::Traffic EmbeddedStorage::ProtocolTotal(const boost::optional<acl::UserID>& uid,
+      const DateMatch& date)
+{
+  long long sendKBytes = 0;
+  long long receiveKBytes = 0;
+
+  std::lock_guard<std::mutex> lock(protocolMutex);
+  for (const auto& kv : protocol)
+  {
+    if (uid && *uid != std::get<0>(kv.first)) continue;
+    if (!date.Matches(std::get<1>(kv.first), std::get<2>(kv.first),
+                      std::get<3>(kv.first), std::get<4>(kv.first)))
+      continue;
+    sendKBytes += kv.second.first;
+    receiveKBytes += kv.second.second;
+  }
+
+  return stats::Traffic(sendKBytes, receiveKBytes);
+}
+
+acl::UserID EmbeddedStorage::UserCreate(const acl::UserData& user)
+{
+  std::lock_guard<std::mutex> lock(usersMutex);
+  if (userNames.find(user.name) != userNames.end()) return -1;
+
+  acl::UserData created(user);
+  created.id = users.empty() ? 0 : users.rbegin()->first + 1;
+  StoreUser(created);
+
+  if (!AppendUser(UserRecord(created)))
+  {
+    userNames.erase(created.name);
+    users.erase(created.id);
+    return -1;
+  }
+
+  return created.id;
+}
+
+bool EmbeddedStorage::UserSave(const acl::UserData& user, const std::vector<std::string>& fields)
+{
+  std::lock_guard<std::mutex> lock(usersMutex);
+  auto it = users.find(user.id);
+  if (it == users.end()) return false;
+
+  auto nameIt = userNames.find(user.name);
+  if (nameIt != userNames.end() && nameIt->second != user.id &&
+      std::find(fields.begin(), fields.end(), "name") != fields.end())
+    return false;
+
+  acl::UserData updated(it->second);
+  for (const auto& field : fields)
+  {
+    if (!CopyUserField(user, updated, field))
+    {
+      logs::Database("Unable to save unknown user field: %1%", field);
+      return false;
+    }
+  }
+
+  StoreUser(updated);
+  return AppendUser(UserRecord(updated));
+}
+
+void EmbeddedStorage::UserPurge(acl::UserID uid)
+{
+  std::lock_guard<std::mutex> lock(usersMutex);
+  auto it = users.find(uid);
+  if (it == users.end()) return;
+
+  userNames.erase(it->second.name);
+  users.erase(it);
+  AppendUser({ "D", ToString(uid) });
+}
+
+boost::optional<acl::UserData> EmbeddedStorage::UserLoad(acl::UserID uid)
+{
+  std::lock_guard<std::mutex> lock(usersMutex);
+  auto it = users.find(uid);
+  if (it == users.end()) return boost::none;
+  return boost::optional<acl::UserData>(it->second);
+}
+
+boost::optional<acl::UserData> EmbeddedStorage::UserLoad(const std::string& name)
+{
+  std::lock_guard<std::mutex> lock(usersMutex);
+  auto it = userNames.find(name);
+  if (it == userNames.end()) return boost::none;
+  return boost::optional<acl::UserData>(users[it->second]);
+}
+
+std::vector<acl::UserData> EmbeddedStorage::UserLoad(const std::vector<acl::UserID>& uids,
+      std::vector<acl::UserID>& /* unreadable */)
+{
+  std::vector<acl::UserData> loaded;
+  std::lock_guard<std::mutex> lock(usersMutex);
+  for (acl::UserID uid : uids)
+  {
+    auto it = users.find(uid);
+    if (it != users.end()) loaded.emplace_back(it->second);
+  }
+  return loaded;
+}
+
+std::vector<acl::UserData> EmbeddedStorage::UserList(const std::string& multiStr)
+{
+  std::vector<std::string> toks;
+  util::Split(toks, multiStr, " ", true);
+
+  bool all = std::find(toks.begin(), toks.end(), "*") != toks.end();
+  std::unordered_set<std::string> names;
+  std::unordered_set<acl::GroupID> gids;
+  if (!all)
+  {
+    // resolved up front so the groups and users locks are never held together
+    std::lock_guard<std::mutex> lock(groupsMutex);
+    for (std::string tok : toks)
+    {
+      if (tok[0] == '=')
+      {
+        auto it = groupNames.find(tok.substr(1));
+        if (it != groupNames.end()) gids.insert(it->second);
+        continue;
+      }
+
+      if (tok[0] == '-') tok.erase(0, 1);
+      names.insert(tok);
+    }
+  }
+
+  std::vector<acl::UserData> results;
+  std::lock_guard<std::mutex> lock(usersMutex);
+  for (const auto& kv : users)
+  {
+    const acl::UserData& user = kv.second;
+    if (all || names.count(user.name) || gids.count(user.primaryGid) ||
+        std::any_of(user.secondaryGids.begin(), user.secondaryGids.end(),
+                    [&](acl::GroupID gid) { return gids.count(gid) > 0; }))
+      results.emplace_back(user);
+  }
+
+  return results;
+}
+
+std::vector<acl::UserID> EmbeddedStorage::UserIDs(const std::string& multiStr)
+{
+  std::vector<acl::UserID> uids;
+  for (const auto& user : UserList(multiStr)) uids.emplace_back(user.id);
+  return uids;
+}
+
+std::vector<std::string> EmbeddedStorage::UserIPMasks(acl::UserID uid)
+{
+  std::vector<std::string> ipMasks;
+  std::lock_guard<std::mutex> lock(usersMutex);
+  for (const auto& kv : users)
+  {
+    if (uid != -1 && uid != kv.first) continue;
+    ipMasks.insert(ipMasks.end(), kv.second.ipMasks.begin(), kv.second.ipMasks.end());
+  }
+  return ipMasks;
+}
+
+void EmbeddedStorage::UserIncrCredits(acl::UserID uid, const std::string& section, long long kBytes)
+{
+  std::lock_guard<std::mutex> lock(usersMutex);
+  auto it = users.find(uid);
+  if (it == users.end())
+  {
+    logs::Database("Unable to increment credits for UID %1%%2%", uid,
+                   !section.empty() ? " in section " + section : 
+                   std::string(""));
+    return;
+  }
+
+  long long& credits = it->second.credits[section];
+  credits += kBytes;
+  AppendUser({ "C", ToString(uid), section, ToString(credits) });
+}
+
+bool EmbeddedStorage::UserDecrCredits(acl::UserID uid, const std::string& section,
+      long long kBytes, bool force)
+{
+  std::lock_guard<std::mutex> lock(usersMutex);
+  auto it = users.find(uid);
+  if (it == users.end()) return force;
+
+  auto creditsIt = it->second.credits.find(section);
+  if (creditsIt == it->second.credits.end()) return force;
+  if (!force && creditsIt->second < kBytes) return false;
+
+  creditsIt->second -= kBytes;
+  AppendUser({ "C", ToString(uid), section, ToString(creditsIt->second) });
+  return true;
+}
+
+acl::GroupID EmbeddedStorage::GroupCreate(const acl::GroupData& group)
+{
+  std::lock_guard<std::mutex> lock(groupsMutex);
+  if (groupNames.find(group.name) != groupNames.end()) return -1;
+
+  acl::GroupData created(group);
+  created.id = groups.empty() ? 0 : groups.rbegin()->first + 1;
+  StoreGroup(created);
+
+  if (!AppendGroup(GroupRecord(created)))
+  {
+    groupNames.erase(created.name);
+    groups.erase(created.id);
+    return -1;
+  }
+
+  return created.id;
+}
+
+bool EmbeddedStorage::GroupSave(const acl::GroupData& group, const std::vector<std::string>& fields)
+{
+  std::lock_guard<std::mutex> lock(groupsMutex);
+  auto it = groups.find(group.id);
+  if (it == groups.end()) return false;
+
+  auto nameIt = groupNames.find(group.name);
+  if (nameIt != groupNames.end() && nameIt->second != group.id &&
+      std::find(fields.begin(), fields.end(), "name") != fields.end())
+    return false;
+
+  acl::GroupData updated(it->second);
+  for (const auto& field : fields)
+  {
+    if (!CopyGroupField(group, updated, field))
+    {
+      logs::Database("Unable to save unknown group field: %1%", field);
+      return false;
+    }
+  }
+
+  StoreGroup(updated);
+  return AppendGroup(GroupRecord(updated));
+}
+
+void EmbeddedStorage::GroupPurge(acl::GroupID gid)
+{
+  std::lock_guard<std::mutex> lock(groupsMutex);
+  auto it = groups.find(gid);
+  if (it == groups.end()) return;
+
+  groupNames.erase(it->second.name);
+  groups.erase(it);
+  AppendGroup({ "D", ToString(gid) });
+}
+
+boost::optional<acl::GroupData> EmbeddedStorage::GroupLoad(acl::GroupID gid)
+{
+  std::lock_guard<std::mutex> lock(groupsMutex);
+  auto it = groups.find(gid);
+  if (it == groups.end()) return boost::none;
+  return boost::optional<acl::GroupData>(it->second);
+}
+
+boost::optional<acl::GroupData> EmbeddedStorage::GroupLoad(const std::string& name)
+{
+  std::lock_guard<std::mutex> lock(groupsMutex);
+  auto it = groupNames.find(name);
+  if (it == groupNames.end()) return boost::none;
+  return boost::optional<acl::GroupData>(groups[it->second]);
+}
+
+std::vector<acl::GroupData> EmbeddedStorage::GroupLoad(const std::vector<acl::GroupID>& gids,
+      std::vector<acl::GroupID>& /* unreadable */)
+{
+  std::vector<acl::GroupData> loaded;
+  std::lock_guard<std::mutex> lock(groupsMutex);
+  for (acl::GroupID gid : gids)
+  {
+    auto it = groups.find(gid);
+    if (it != groups.end()) loaded.emplace_back(it->second);
+  }
+  return loaded;
+}
+
+std::vector<acl::GroupData> EmbeddedStorage::GroupList(const std::string& multiStr)
+{
+  std::vector<std::string> toks;
+  util::Split(toks, multiStr, " ", true);
+
+  bool all = std::find(toks.begin(), toks.end(), "*") != toks.end();
+  std::unordered_set<std::string> names;
+  for (std::string tok : toks)
+  {
+    if (tok[0] == '=') tok.erase(0, 1);
+    names.insert(tok);
+  }
+
+  std::vector<acl::GroupData> results;
+  std::lock_guard<std::mutex> lock(groupsMutex);
+  for (const auto& kv : groups)
+  {
+    if (all || names.count(kv.second.name)) results.emplace_back(kv.second);
+  }
+
+  return results;
+}
+
+std::vector<acl::GroupID> EmbeddedStorage::GroupIDs(const std::string& multiStr)
+{
+  std::vector<acl::GroupID> gids;
+  for (const auto& group : GroupList(multiStr)) gids.emplace_back(group.id);
+  return gids;
+}
+
+int EmbeddedStorage::GroupSlotsUsed(acl::GroupID gid)
+{
+  std::lock_guard<std::mutex> lock(usersMutex);
+  return std::count_if(users.begin(), users.end(),
+      [gid](const std::pair<const acl::UserID, acl::UserData>& kv)
+      {
+        return kv.second.primaryGid == gid && 
+               kv.second.flags.find('6') == std::string::npos;
+      });
+}
+
+int EmbeddedStorage::GroupMembers(acl::GroupID gid)
+{
+  std::lock_guard<std::mutex> lock(usersMutex);
+  return std::count_if(users.begin(), users.end(),
+      [gid](const std::pair<const acl::UserID, acl::UserData>& kv)
+      {
+        const auto& secondary = kv.second.secondaryGids;
+        return kv.second.primaryGid == gid ||
+               std::find(secondary.begin(), secondary.end(), gid) != secondary.end();
+      });
+}
+
+int EmbeddedStorage::GroupLeeches(acl::GroupID gid)
+{
+  std::lock_guard<std::mutex> lock(usersMutex);
+  return std::count_if(users.begin(), users.end(),
+      [gid](const std::pair<const acl::UserID, acl::UserData>& kv)
+      {
+        auto it = kv.second.ratio.find("");
+        return kv.second.primaryGid == gid && 
+               it != kv.second.ratio.end() && it->second == 0;
+      });
+}
+
+int EmbeddedStorage::GroupAllotments(acl::GroupID gid)
+{
+  std::lock_guard<std::mutex> lock(usersMutex);
+  return std::count_if(users.begin(), users.end(),
+      [gid](const std::pair<const acl::UserID, acl::UserData>& kv)
+      {
+        auto it = kv.second.weeklyAllotment.find("");
+        return kv.second.primaryGid == gid && 
+               it != kv.second.weeklyAllotment.end() && it->second > 0;
+      });
+}
+
+long long EmbeddedStorage::GroupAllotmentTotal(acl::GroupID gid)
+{
+  bool found = false;
+  long long total = 0;
+
+  std::lock_guard<std::mutex> lock(usersMutex);
+  for (const auto& kv : users)
+  {
+    if (kv.second.primaryGid != gid) continue;
+    auto it = kv.second.weeklyAllotment.find("");
+    if (it == kv.second.weeklyAllotment.end()) continue;
+    total += it->second;
+    found = true;
+  }
+
+  return found ? total : -1;
+}
+
+// this process is the only writer, so changes go straight to
+// the replicator rather than through a shared update log
+void EmbeddedStorage::UpdateLog(const std::string& collection, int32_t id)
+{
+  Replicator::Get().Queue(collection, id);
+}
+
+// index counts a recipient's messages in the order they were sent
+std::map<unsigned long long, EmbeddedStorage::MailEntry>::iterator 
+EmbeddedStorage::FindMail(acl::UserID recipient, int index)
+{
+  for (auto it = mail.begin(); it != mail.end(); ++it)
+  {
+    if (it->second.recipient == recipient && index-- == 0) return it;
+  }
+  return mail.end();
+}
+
+void EmbeddedStorage::MailSend(const mail::Message& message)
+{
+  std::lock_guard<std::mutex> lock(mailMutex);
+  unsigned long long seq = mailSequence++;
+  mail.insert(std::make_pair(seq, MailEntry(message.Sender(), message.Recipient(),
+        message.Body(), message.TimeSent(), message.Status())));
+
+  AppendMail({ "A", ToString(seq), message.Sender(), ToString(message.Recipient()),
+               message.Body(), boost::posix_time::to_iso_string(message.TimeSent()),
+               util::EnumToString(message.Status()) });
+}
+
+std::vector<mail::Message> EmbeddedStorage::MailGet(acl::UserID recipient)
+{
+  std::vector<mail::Message> messages;
+  std::lock_guard<std::mutex> lock(mailMutex);
+  for (const auto& kv : mail)
+  {
+    const MailEntry& entry = kv.second;
+    if (entry.recipient != recipient) continue;
+    messages.emplace_back(entry.sender, entry.recipient, entry.body,
+                          entry.timeSent, entry.status, ToString(kv.first));
+  }
+  return messages;
+}
+
+bool EmbeddedStorage::MailSave(acl::UserID recipient, int index)
+{
+  std::lock_guard<std::mutex> lock(mailMutex);
+  auto it = FindMail(recipient, index);
+  if (it == mail.end()) return false;
+
+  it->second.status = mail::Status::Saved;
+  AppendMail({ "S", ToString(it->first), util::EnumToString(mail::Status::Saved) });
+  return true;
+}
+
+int EmbeddedStorage::MailSaveTrash(acl::UserID recipient)
+{
+  int count = 0;
+  std::lock_guard<std::mutex> lock(mailMutex);
+  for (auto& kv : mail)
+  {
+    if (kv.second.recipient != recipient || kv.second.status != mail::Status::Trash) continue;
+    kv.second.status = mail::Status::Saved;
+    AppendMail({ "S", ToString(kv.first), util::EnumToString(mail::Status::Saved) });
+    ++count;
+  }
+  return count;
+}
+
+bool EmbeddedStorage::MailPurge(acl::UserID recipient, int index)
+{
+  std::lock_guard<std::mutex> lock(mailMutex);
+  auto it = FindMail(recipient, index);
+  if (it == mail.end()) return false;
+
+  unsigned long long seq = it->first;
+  mail.erase(it);
+  AppendMail({ "D", ToString(seq) });
+  return true;
+}
+
+int EmbeddedStorage::MailPurgeTrash(acl::UserID recipient)
+{
+  int count = 0;
+  std::lock_guard<std::mutex> lock(mailMutex);
+  for (auto it = mail.begin(); it != mail.end();)
+  {
+    if (it->second.recipient != recipient || it->second.status != mail::Status::Trash)
+    {
+      ++it;
+      continue;
+    }
+
+    unsigned long long seq = it->first;
+    mail.erase(it++);
+    AppendMail({ "D", ToString(seq) });
+    ++count;
+  }
+  return count;
+}
+
+void EmbeddedStorage::MailTrash(const mail::Message& message)
+{
+  unsigned long long seq;
+  try
+  {
+    seq = boost::lexical_cast<unsigned long long>(message.ID());
+  }
+  catch (const boost::bad_lexical_cast&)
+  {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mailMutex);
+  auto it = mail.find(seq);
+  if (it == mail.end()) return;
+
+  it->second.status = mail::Status::Trash;
+  AppendMail({ "S", ToString(seq), util::EnumToString(mail::Status::Trash) });
+}
+
+} /* db namespace */
@@ -0,0 +1,190 @@
+#ifndef __DB_EMBEDDEDSTORAGE_HPP
+#define __DB_EMBEDDEDSTORAGE_HPP
+
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include "db/storage.hpp"
+#include "db/recordlog.hpp"
+
+namespace db
+{
+
+class EmbeddedStorage : public Storage
+{
+  struct DupeEntry
+  {
+    std::string directory;
+    std::string lower;
+    std::string section;
+    time_t created;
+
+    DupeEntry(const std::string& directory, const std::string& section, time_t created);
+  };
+
+  struct IndexEntry
+  {
+    std::string path;
+    std::string lower;
+    std::string section;
+    time_t created;
+
+    IndexEntry(const std::string& path, const std::string& section, time_t created);
+  };
+
+  struct TransferTotal
+  {
+    long long files;
+    long long kBytes;
+    long long xfertime;
+
+    TransferTotal() : files(0), kBytes(0), xfertime(0) { }
+  };
+
+  struct MailEntry
+  {
+    std::string sender;
+    acl::UserID recipient;
+    std::string body;
+    boost::posix_time::ptime timeSent;
+    mail::Status status;
+
+    MailEntry(const std::string& sender, acl::UserID recipient, const std::string& body,
+          const boost::posix_time::ptime& timeSent, mail::Status status);
+  };
+
+  // uid, year, month, week, day, direction, section
+  typedef std::tuple<acl::UserID, int, int, int, int, unsigned, std::string> TransferMapKey;
+  // uid, year, month, week, day
+  typedef std::tuple<acl::UserID, int, int, int, int> ProtocolMapKey;
+
+  std::string dataPath;
+
+  std::mutex dupeMutex;
+  RecordLog dupeLog;
+  std::vector<DupeEntry> dupes;
+  std::unordered_set<std::string> dupeDirectories;
+
+  std::mutex indexMutex;
+  RecordLog indexLog;
+  unsigned long long indexSequence;
+  std::map<unsigned long long, IndexEntry> index;
+  std::unordered_map<std::string, unsigned long long> indexPaths;
+
+  std::mutex transfersMutex;
+  RecordLog transfersLog;
+  std::map<TransferMapKey, TransferTotal> transfers;
+
+  std::mutex protocolMutex;
+  RecordLog protocolLog;
+  std::map<ProtocolMapKey, std::pair<long long, long long>> protocol;
+
+  std::mutex usersMutex;
+  RecordLog usersLog;
+  std::map<acl::UserID, acl::UserData> users;
+  std::unordered_map<std::string, acl::UserID> userNames;
+
+  std::mutex groupsMutex;
+  RecordLog groupsLog;
+  std::map<acl::GroupID, acl::GroupData> groups;
+  std::unordered_map<std::string, acl::GroupID> groupNames;
+
+  std::mutex mailMutex;
+  RecordLog mailLog;
+  unsigned long long mailSequence;
+  std::map<unsigned long long, MailEntry> mail;
+
+  void ReplayDupe(const RecordLog::Record& record);
+  void ReplayIndex(const RecordLog::Record& record);
+  void ReplayTransfer(const RecordLog::Record& record);
+  void ReplayProtocol(const RecordLog::Record& record);
+  void ReplayUser(const RecordLog::Record& record);
+  void ReplayGroup(const RecordLog::Record& record);
+  void ReplayMail(const RecordLog::Record& record);
+
+  void CompactIndex();
+  void CompactTransfers();
+  void CompactProtocol();
+  void CompactUsers();
+  void CompactGroups();
+  void CompactMail();
+
+  void InsertIndex(const std::string& path, const std::string& section, time_t created);
+  void EraseIndex(const std::string& path);
+
+  void StoreUser(const acl::UserData& user);
+  void StoreGroup(const acl::GroupData& group);
+
+  bool AppendUser(const RecordLog::Record& record);
+  bool AppendGroup(const RecordLog::Record& record);
+  bool AppendMail(const RecordLog::Record& record);
+  std::map<unsigned long long, MailEntry>::iterator FindMail(acl::UserID recipient, int index);
+
+public:
+  EmbeddedStorage(const std::string& dataPath);
+
+  bool Initialise();
+
+  void DupeAdd(const std::string& directory, const std::string& section);
+  std::vector<dupe::DupeResult> DupeSearch(const std::vector<std::string>& terms, int limit);
+  std::vector<dupe::DupeResult> DupeSince(const boost::posix_time::ptime& since);
+
+  void IndexAdd(const std::string& path, const std::string& section);
+  void IndexDelete(const std::string& path);
+  void IndexDelete(const std::vector<std::string>& paths);
+  std::vector<index::SearchResult> IndexSearch(const std::vector<std::string>& terms, int limit);
+
+  void TransferUpdate(const TransferKey& key, int files, long long kBytes, long long xfertime);
+  std::vector< ::stats::Stat> TransferTotals(const TransferQuery& query);
+
+  void ProtocolUpdate(acl::UserID uid, const ::stats::Date& date,
+        long long sendKBytes, long long receiveKBytes);
+  stats::Traffic ProtocolTotal(const boost::optional<acl::UserID>& uid,
+        const DateMatch& date);
+
+  acl::UserID UserCreate(const acl::UserData& user);
+  bool UserSave(const acl::UserData& user, const std::vector<std::string>& fields);
+  void UserPurge(acl::UserID uid);
+  boost::optional<acl::UserData> UserLoad(acl::UserID uid);
+  boost::optional<acl::UserData> UserLoad(const std::string& name);
+  std::vector<acl::UserData> UserLoad(const std::vector<acl::UserID>& uids,
+        std::vector<acl::UserID>& unreadable);
+  std::vector<acl::UserData> UserList(const std::string& multiStr);
+  std::vector<acl::UserID> UserIDs(const std::string& multiStr);
+  std::vector<std::string> UserIPMasks(acl::UserID uid);
+  void UserIncrCredits(acl::UserID uid, const std::string& section, long long kBytes);
+  bool UserDecrCredits(acl::UserID uid, const std::string& section,
+        long long kBytes, bool force);
+
+  acl::GroupID GroupCreate(const acl::GroupData& group);
+  bool GroupSave(const acl::GroupData& group, const std::vector<std::string>& fields);
+  void GroupPurge(acl::GroupID gid);
+  boost::optional<acl::GroupData> GroupLoad(acl::GroupID gid);
+  boost::optional<acl::GroupData> GroupLoad(const std::string& name);
+  std::vector<acl::GroupData> GroupLoad(const std::vector<acl::GroupID>& gids,
+        std::vector<acl::GroupID>& unreadable);
+  std::vector<acl::GroupData> GroupList(const std::string& multiStr);
+  std::vector<acl::GroupID> GroupIDs(const std::string& multiStr);
+  int GroupSlotsUsed(acl::GroupID gid);
+  int GroupMembers(acl::GroupID gid);
+  int GroupLeeches(acl::GroupID gid);
+  int GroupAllotments(acl::GroupID gid);
+  long long GroupAllotmentTotal(acl::GroupID gid);
+
+  void UpdateLog(const std::string& collection, int32_t id);
+
+  void MailSend(const mail::Message& message);
+  std::vector<mail::Message> MailGet(acl::UserID recipient);
+  bool MailSave(acl::UserID recipient, int index);
+  int MailSaveTrash(acl::UserID recipient);
+  bool MailPurge(acl::UserID recipient, int index);
+  int MailPurgeTrash(acl::UserID recipient);
+  void MailTrash(const mail::Message& message);
+};
+
+} /* db namespace */
+
+#endif
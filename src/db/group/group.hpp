@@ -3,15 +3,10 @@
 
 #include <string>
 #include <memory>
+#include <vector>
 #include <boost/optional/optional_fwd.hpp>
 #include "acl/types.hpp"
 
-namespace mongo
-{
-class BSONObj;
-class Query;
-}
-
 namespace acl
 {
 class Group;
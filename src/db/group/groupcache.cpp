@@ -1,9 +1,11 @@
+#include <algorithm>
+#include <unordered_set>
 #include "db/group/groupcache.hpp"
-#include "db/connection.hpp"
+#include "db/storage.hpp"
+#include "db/error.hpp"
 #include "util/string.hpp"
 #include "db/group/group.hpp"
 #include "acl/groupdata.hpp"
-#include "db/group/serialization.hpp"
 
 namespace db
 {
@@ -25,36 +27,40 @@ acl::GroupID GroupCache::NameToGID(const std::string& name)
   return it->second;
 }
 
-bool GroupCache::Replicate(const mongo::BSONElement& id)
+bool GroupCache::Replicate(const std::vector<acl::GroupID>& changed)
 {
-  if (id.type() != 16) return true;
-  acl::GroupID gid = id.Int();
-
   try
   {
-    SafeConnection conn;  
-    auto fields = BSON("gid" << 1 << "name" << 1);
-    auto data = conn.QueryOne<GroupPair>("groups", QUERY("gid" << gid), &fields);
-    if (data)
+    std::vector<acl::GroupID> unreadable;
+    auto results = GetStorage().GroupLoad(changed, unreadable);
+    
+    std::unordered_set<acl::GroupID> missing(changed.begin(), changed.end());
+    
+    // keep the cached copy of groups that can't be read, we can't tell
+    // they were deleted, nor any others if we don't know which they are
+    bool evict = std::find(unreadable.begin(), unreadable.end(), -1) == unreadable.end();
+    for (acl::GroupID gid : unreadable) missing.erase(gid);
+    
+    std::lock(gidsMutex, namesMutex);
+    std::lock_guard<std::mutex> gidsLock(gidsMutex, std::adopt_lock);
+    std::lock_guard<std::mutex> namesLock(namesMutex, std::adopt_lock);
+    
+    for (const auto& data : results)
     {
       // group found, refresh cached data
-      {
-        std::lock_guard<std::mutex> lock(gidsMutex);
-        gids[data->name] = data->gid;
-      }
+      missing.erase(data.id);
       
-      {
-        std::lock_guard<std::mutex> lock(namesMutex);
-        names[data->gid] = data->name;
-      }
+      auto it = names.find(data.id);
+      if (it != names.end() && it->second != data.name) gids.erase(it->second);
+      
+      gids[data.name] = data.id;
+      names[data.id] = data.name;
     }
-    else
+    
+    // groups not found, must be deleted, remove from cache
+    if (!evict) missing.clear();
+    for (acl::GroupID gid : missing)
     {
-      // group not found, must be deleted, remove from cache
-      std::lock(gidsMutex, namesMutex);
-      std::lock_guard<std::mutex> gidsLock(gidsMutex, std::adopt_lock);
-      std::lock_guard<std::mutex> namesLock(namesMutex, std::adopt_lock);
-      
       auto it = names.find(gid);
       if (it != names.end())
       {
@@ -3,16 +3,12 @@
 
 #include <string>
 #include <unordered_map>
+#include <vector>
 #include <mutex>
 #include "acl/types.hpp"
 #include "db/replicable.hpp"
 #include "db/group/groupcachebase.hpp"
 
-namespace mongo
-{
-class BSONElement;
-}
-
 namespace db
 {
 
@@ -31,7 +27,7 @@ public:
   std::string GIDToName(acl::GroupID gid);
   acl::GroupID NameToGID(const std::string& name);
 
-  bool Replicate(const mongo::BSONElement& id);
+  bool Replicate(const std::vector<acl::GroupID>& changed);
   bool Populate();
 };
 
@@ -1,8 +1,7 @@
 #include <cassert>
 #include "db/group/util.hpp"
 #include "db/group/groupcache.hpp"
-#include "db/group/serialization.hpp"
-#include "db/connection.hpp"
+#include "db/storage.hpp"
 
 namespace db
 {
@@ -18,20 +17,16 @@ struct GroupNoCache : public GroupCacheBase
 
 std::string GroupNoCache::GIDToName(acl::GroupID gid)
 {
-  NoErrorConnection conn;  
-  auto fields = BSON("gid" << 1 << "name" << 1 << "primary gid" << 1);
-  auto data = conn.QueryOne<GroupPair>("groups", QUERY("gid" << gid), &fields);
+  auto data = GetStorage().GroupLoad(gid);
   if (!data) return "unknown";
   return data->name;
 }
 
 acl::GroupID GroupNoCache::NameToGID(const std::string& name)
 {
-  NoErrorConnection conn;  
-  auto fields = BSON("gid" << 1 << "name" << 1 << "primary gid" << 1);
-  auto data = conn.QueryOne<GroupPair>("groups", QUERY("name" << name), &fields);
+  auto data = GetStorage().GroupLoad(name);
   if (!data) return -1;
-  return data->gid;
+  return data->id;
 }
 
 std::shared_ptr<GroupCacheBase> groupCache(new GroupNoCache());
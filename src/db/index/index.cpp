@@ -1,48 +1,38 @@
-#include <boost/regex.hpp>
-#include <future>
 #include "db/index/index.hpp"
-#include "util/misc.hpp"
-#include "db/connection.hpp"
+#include "db/index/pathindex.hpp"
+#include "db/storage.hpp"
+#include "cfg/get.hpp"
 
-namespace db
+namespace db { namespace index
 {
 
-template <> index::SearchResult Unserialize<index::SearchResult>(const mongo::BSONObj& obj)
+void Add(const std::string& path, const std::string& section)
 {
-  mongo::BSONElement oid;
-  obj.getObjectID(oid);
-  return index::SearchResult(obj["path"].String(),
-                             obj["section"].String(),
-                             ToPosixTime(oid.OID().asDateT()));
+  GetStorage().IndexAdd(path, section);
+  if (PathIndex::Get())
+  {
+    PathIndex::Get()->Add(path, section, 
+                          boost::posix_time::second_clock::local_time());
+  }
 }
 
-namespace index
-{
-
-
-void Add(const std::string& path, const std::string& section)
+void Delete(const std::string& path)
 {
-  FastConnection conn;
-  conn.Insert("index", BSON("path" << path << "section" << section));
+  GetStorage().IndexDelete(path);
+  if (PathIndex::Get()) PathIndex::Get()->Delete(path);
 }
 
-void Delete(const std::string& path)
+void Delete(const std::vector<std::string>& paths)
 {
-  NoErrorConnection conn;
-  conn.Remove("index", QUERY("path" << path));
+  if (paths.empty()) return;
+  GetStorage().IndexDelete(paths);
+  if (PathIndex::Get()) PathIndex::Get()->Delete(paths);
 }
 
 std::vector<SearchResult> Search(const std::vector<std::string>& terms, int limit)
 {
-  mongo::BSONObjBuilder bob;
-  for (const std::string& term : terms)
-  {
-    bob.appendRegex("path", util::EscapeRegex(term), "i");
-  }
-  
-  mongo::Query query(bob.obj());
-  NoErrorConnection conn;
-  return conn.QueryMulti<SearchResult>("index", query.sort("_id", -1), limit);
+  if (PathIndex::Get()) return PathIndex::Get()->Search(terms, limit);
+  return GetStorage().IndexSearch(terms, limit);
 }
 
 std::vector<SearchResult> Newest(int limit)
@@ -50,5 +40,21 @@ std::vector<SearchResult> Newest(int limit)
   return Search(std::vector<std::string>(), limit);
 }
 
+void CacheSize(const std::string& path, long long kBytes)
+{
+  if (PathIndex::Get()) PathIndex::Get()->CacheSize(path, kBytes);
+}
+
+void AdjustSize(const std::string& filePath, long long kBytes)
+{
+  if (PathIndex::Get()) 
+    PathIndex::Get()->AdjustSize(filePath, kBytes, cfg::Get().DirSizeDepth());
+}
+
+void InvalidateSize(const std::string& path)
+{
+  if (PathIndex::Get()) PathIndex::Get()->InvalidateSize(path);
+}
+
 } /* index namespace */
 } /* db namespace */
@@ -10,22 +10,28 @@ namespace db { namespace index
 
 void Add(const std::string& path, const std::string& section);
 void Delete(const std::string& path);
+void Delete(const std::vector<std::string>& paths);
 
 struct SearchResult
 {
   std::string path;
   std::string section;
   boost::posix_time::ptime dateTime;
+  long long kBytes;
   
   SearchResult(const std::string& path, const std::string& section, 
-               const boost::posix_time::ptime& dateTime) :
-    path(path), section(section), dateTime(dateTime)
+               const boost::posix_time::ptime& dateTime, long long kBytes = -1) :
+    path(path), section(section), dateTime(dateTime), kBytes(kBytes)
   { }
 };
 
 std::vector<SearchResult> Search(const std::vector<std::string>& terms, int limit);
 std::vector<SearchResult> Newest(int limit);
 
+void CacheSize(const std::string& path, long long kBytes);
+void AdjustSize(const std::string& filePath, long long kBytes);
+void InvalidateSize(const std::string& path);
+
 } /* index namespace */
 } /* db namespace */
 
@@ -0,0 +1,322 @@
+#include <algorithm>
+#include <cctype>
+#include <functional>
+#include "db/index/pathindex.hpp"
+#include "db/storage.hpp"
+#include "util/string.hpp"
+#include "logs/logs.hpp"
+
+namespace db { namespace index
+{
+
+namespace
+{
+
+bool IsTokenChar(char ch)
+{
+  unsigned char uch = static_cast<unsigned char>(ch);
+  return uch >= 0x80 || std::isalnum(uch);
+}
+
+std::string::size_type ParentEnd(const std::string& path, std::string::size_type end)
+{
+  if (end == 0) return std::string::npos;
+  auto pos = path.rfind('/', end - 1);
+  if (pos == std::string::npos) return std::string::npos;
+  return pos == 0 ? 1 : pos;
+}
+
+}
+
+std::unique_ptr<PathIndex> PathIndex::instance;
+
+PathIndex::Entry::Entry(const std::string& path, const std::string& section,
+      const boost::posix_time::ptime& dateTime) :
+  path(path), lower(util::ToLowerCopy(path)), section(section),
+  dateTime(dateTime), kBytes(-1)
+{
+}
+
+std::vector<std::string> PathIndex::Tokenize(const std::string& lower)
+{
+  std::vector<std::string> tokens;
+  auto it = lower.begin();
+  while (it != lower.end())
+  {
+    it = std::find_if(it, lower.end(), IsTokenChar);
+    auto end = std::find_if_not(it, lower.end(), IsTokenChar);
+    if (it != end) tokens.emplace_back(it, end);
+    it = end;
+  }
+
+  std::sort(tokens.begin(), tokens.end());
+  tokens.erase(std::unique(tokens.begin(), tokens.end()), tokens.end());
+  return tokens;
+}
+
+void PathIndex::Insert(const std::string& path, const std::string& section,
+      const boost::posix_time::ptime& dateTime)
+{
+  if (paths.find(path) != paths.end()) return;
+
+  EntryID id = nextID++;
+  auto it = entries.insert(std::make_pair(id, Entry(path, section, dateTime))).first;
+  paths.insert(std::make_pair(path, id));
+
+  for (auto& token : Tokenize(it->second.lower))
+  {
+    auto result = postings.insert(std::make_pair(token, Postings()));
+    result.first->second.emplace_back(id);
+    if (result.second) InsertToken(&result.first->first);
+  }
+}
+
+// every gram of up to 3 characters when indexing a token, a piece longer
+// than that only needs its trigrams to narrow down the tokens
+std::vector<std::string> PathIndex::Grams(const std::string& token, bool all)
+{
+  std::vector<std::string> grams;
+  if (!all && token.length() <= 3) grams.emplace_back(token);
+  else
+  {
+    for (std::string::size_type len = all ? 1 : 3; len <= 3; ++len)
+    {
+      for (std::string::size_type pos = 0; pos + len <= token.length(); ++pos)
+      {
+        grams.emplace_back(token, pos, len);
+      }
+    }
+  }
+
+  std::sort(grams.begin(), grams.end());
+  grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+  return grams;
+}
+
+void PathIndex::InsertToken(const std::string* token)
+{
+  for (const auto& gram : Grams(*token, true))
+  {
+    Tokens& tokens = grams[gram];
+    tokens.insert(std::lower_bound(tokens.begin(), tokens.end(), token,
+                                    std::less<const std::string*>()), token);
+  }
+}
+
+void PathIndex::EraseToken(const std::string* token)
+{
+  for (const auto& gram : Grams(*token, true))
+  {
+    auto it = grams.find(gram);
+    if (it == grams.end()) continue;
+    Tokens& tokens = it->second;
+    auto pos = std::lower_bound(tokens.begin(), tokens.end(), token,
+                                std::less<const std::string*>());
+    if (pos != tokens.end() && *pos == token) tokens.erase(pos);
+    if (tokens.empty()) grams.erase(it);
+  }
+}
+
+PathIndex::Postings PathIndex::Lookup(const std::string& piece) const
+{
+  Tokens tokens;
+  auto pieceGrams = Grams(piece, false);
+  for (auto it = pieceGrams.begin(); it != pieceGrams.end(); ++it)
+  {
+    auto gramIt = grams.find(*it);
+    if (gramIt == grams.end()) return Postings();
+
+    if (it == pieceGrams.begin()) tokens = gramIt->second;
+    else
+    {
+      Tokens intersection;
+      std::set_intersection(tokens.begin(), tokens.end(),
+                            gramIt->second.begin(), gramIt->second.end(),
+                            std::back_inserter(intersection),
+                            std::less<const std::string*>());
+      tokens.swap(intersection);
+    }
+    if (tokens.empty()) return Postings();
+  }
+
+  Postings ids;
+  for (const std::string* token : tokens)
+  {
+    if (piece.length() > 3 && token->find(piece) == std::string::npos) continue;
+    const Postings& list = postings.find(*token)->second;
+    ids.insert(ids.end(), list.begin(), list.end());
+  }
+
+  std::sort(ids.begin(), ids.end());
+  ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+  return ids;
+}
+
+void PathIndex::Add(const std::string& path, const std::string& section,
+      const boost::posix_time::ptime& dateTime)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  Insert(path, section, dateTime);
+}
+
+void PathIndex::Delete(const std::string& path)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  Erase(path);
+}
+
+void PathIndex::Delete(const std::vector<std::string>& paths)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  for (const auto& path : paths)
+    Erase(path);
+}
+
+void PathIndex::Erase(const std::string& path)
+{
+  auto it = paths.find(path);
+  if (it == paths.end()) return;
+
+  EntryID id = it->second;
+  auto entryIt = entries.find(id);
+  for (auto& token : Tokenize(entryIt->second.lower))
+  {
+    auto postIt = postings.find(token);
+    if (postIt == postings.end()) continue;
+    Postings& list = postIt->second;
+    auto pos = std::lower_bound(list.begin(), list.end(), id);
+    if (pos != list.end() && *pos == id) list.erase(pos);
+    if (list.empty())
+    {
+      EraseToken(&postIt->first);
+      postings.erase(postIt);
+    }
+  }
+
+  entries.erase(entryIt);
+  paths.erase(it);
+}
+
+std::vector<SearchResult> PathIndex::Search(const std::vector<std::string>& terms, int limit) const
+{
+  std::vector<std::string> lowerTerms;
+  std::vector<std::string> pieces;
+  for (const auto& term : terms)
+  {
+    if (term.empty()) continue;
+    lowerTerms.emplace_back(util::ToLowerCopy(term));
+    auto termPieces = Tokenize(lowerTerms.back());
+    pieces.insert(pieces.end(), termPieces.begin(), termPieces.end());
+  }
+
+  std::vector<SearchResult> results;
+  auto accept = [&](const Entry& entry) -> bool
+    {
+      for (const auto& term : lowerTerms)
+      {
+        if (entry.lower.find(term) == std::string::npos) return true;
+      }
+
+      results.emplace_back(entry.path, entry.section, entry.dateTime, entry.kBytes);
+      return limit <= 0 || static_cast<int>(results.size()) < limit;
+    };
+
+  std::lock_guard<std::mutex> lock(mutex);
+  if (pieces.empty())
+  {
+    for (auto it = entries.rbegin(); it != entries.rend(); ++it)
+    {
+      if (!accept(it->second)) break;
+    }
+    return results;
+  }
+
+  std::sort(pieces.begin(), pieces.end());
+  pieces.erase(std::unique(pieces.begin(), pieces.end()), pieces.end());
+
+  Postings candidates;
+  for (auto it = pieces.begin(); it != pieces.end(); ++it)
+  {
+    Postings ids = Lookup(*it);
+    if (it == pieces.begin()) candidates.swap(ids);
+    else
+    {
+      Postings intersection;
+      std::set_intersection(candidates.begin(), candidates.end(),
+                            ids.begin(), ids.end(),
+                            std::back_inserter(intersection));
+      candidates.swap(intersection);
+    }
+    if (candidates.empty()) return results;
+  }
+
+  for (auto it = candidates.rbegin(); it != candidates.rend(); ++it)
+  {
+    auto entryIt = entries.find(*it);
+    if (entryIt != entries.end() && !accept(entryIt->second)) break;
+  }
+
+  return results;
+}
+
+void PathIndex::CacheSize(const std::string& path, long long kBytes)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = paths.find(path);
+  if (it != paths.end()) entries.find(it->second)->second.kBytes = kBytes;
+}
+
+void PathIndex::AdjustSize(const std::string& filePath, long long kBytes, int depth)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  std::string::size_type end = filePath.length();
+  for (int level = 1; level <= depth; ++level)
+  {
+    end = ParentEnd(filePath, end);
+    if (end == std::string::npos) break;
+
+    auto it = paths.find(filePath.substr(0, end));
+    if (it != paths.end())
+    {
+      Entry& entry = entries.find(it->second)->second;
+      if (entry.kBytes >= 0) entry.kBytes = std::max(0LL, entry.kBytes + kBytes);
+    }
+
+    if (end == 1) break;
+  }
+}
+
+void PathIndex::InvalidateSize(const std::string& path)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  std::string::size_type end = path.length();
+  while (end != std::string::npos)
+  {
+    auto it = paths.find(path.substr(0, end));
+    if (it != paths.end()) entries.find(it->second)->second.kBytes = -1;
+    if (end == 1) break;
+    end = ParentEnd(path, end);
+  }
+}
+
+bool PathIndex::Initialise()
+{
+  instance.reset(new PathIndex());
+
+  auto results = GetStorage().IndexSearch(std::vector<std::string>(), 0);
+  for (auto it = results.rbegin(); it != results.rend(); ++it)
+  {
+    instance->Insert(it->path, it->section, it->dateTime);
+  }
+
+  logs::Debug("Path index loaded with %1% entries", instance->entries.size());
+  return true;
+}
+
+void PathIndex::Cleanup()
+{
+  instance.reset();
+}
+
+} /* index namespace */
+} /* db namespace */
@@ -0,0 +1,82 @@
+#ifndef __DB_INDEX_PATHINDEX_HPP
+#define __DB_INDEX_PATHINDEX_HPP
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include "db/index/index.hpp"
+
+namespace db { namespace index
+{
+
+// inverted index of path tokens, tokens are the runs of alphanumerics in
+// the lowercased path, a search term matches any token it is a substring
+// of and candidates are confirmed against the full path. tokens are found
+// through their 1, 2 and 3 character grams, so a search never scans the
+// whole dictionary. the index is loaded from storage at startup and after
+// that only sees changes made through this daemon
+class PathIndex
+{
+  struct Entry
+  {
+    std::string path;
+    std::string lower;
+    std::string section;
+    boost::posix_time::ptime dateTime;
+    long long kBytes;
+
+    Entry(const std::string& path, const std::string& section,
+          const boost::posix_time::ptime& dateTime);
+  };
+
+  typedef uint64_t EntryID;
+  typedef std::vector<EntryID> Postings;
+  // tokens are the keys of postings, sorted by address
+  typedef std::vector<const std::string*> Tokens;
+
+  mutable std::mutex mutex;
+  EntryID nextID;
+  std::map<EntryID, Entry> entries;
+  std::unordered_map<std::string, EntryID> paths;
+  std::unordered_map<std::string, Postings> postings;
+  std::unordered_map<std::string, Tokens> grams;
+
+  static std::unique_ptr<PathIndex> instance;
+
+  PathIndex() : nextID(0) { }
+
+  void Insert(const std::string& path, const std::string& section,
+              const boost::posix_time::ptime& dateTime);
+  void Erase(const std::string& path);
+  void InsertToken(const std::string* token);
+  void EraseToken(const std::string* token);
+  Postings Lookup(const std::string& piece) const;
+
+  static std::vector<std::string> Tokenize(const std::string& lower);
+  static std::vector<std::string> Grams(const std::string& token, bool all);
+
+public:
+  void Add(const std::string& path, const std::string& section,
+           const boost::posix_time::ptime& dateTime);
+  void Delete(const std::string& path);
+  void Delete(const std::vector<std::string>& paths);
+  std::vector<SearchResult> Search(const std::vector<std::string>& terms, int limit) const;
+
+  void CacheSize(const std::string& path, long long kBytes);
+  void AdjustSize(const std::string& filePath, long long kBytes, int depth);
+  void InvalidateSize(const std::string& path);
+
+  static bool Initialise();
+  static void Cleanup();
+  static PathIndex* Get() { return instance.get(); }
+};
+
+} /* index namespace */
+} /* db namespace */
+
+#endif
@@ -1,64 +1,19 @@
 #include "db/initialise.hpp"
-#include "db/connection.hpp"
+#include "db/error.hpp"
 #include "db/replicator.hpp"
 #include "db/user/usercache.hpp"
 #include "db/group/groupcache.hpp"
 #include "db/user/util.hpp"
 #include "db/group/util.hpp"
+#include "db/storage.hpp"
+#include "db/dupe/dupeindex.hpp"
+#include "db/index/pathindex.hpp"
+#include "logs/logs.hpp"
 
 namespace db
 {
 
-bool CreateUpdateLog()
-{
-  try
-  {
-    SafeConnection conn;
-    mongo::BSONObj info;
-    conn.RunCommand(BSON("create" << "updatelog" << 
-                         "capped" << true << 
-                         "size" << 102400 << 
-                         "max" << 100), info);
-    return true;
-  }
-  catch (const mongo::DBException&)
-  { }
-  catch (const DBError&)
-  { }
-  
-  return false;
-}
-
-bool EnsureIndexes()
-{
-  try
-  {
-    SafeConnection conn;
-    conn.EnsureIndex("users", BSON("uid" << 1), true);
-    conn.EnsureIndex("users", BSON("name" << 1), true);
-    conn.EnsureIndex("groups", BSON("gid" << 1), true);
-    conn.EnsureIndex("groups", BSON("name" << 1), true);
-    conn.EnsureIndex("index", BSON("path" << 1), true);
-    conn.EnsureIndex("dupe", BSON("directory" << 1), true);
-    conn.EnsureIndex("updatelog", BSON("timestamp" << 1), false);
-    conn.EnsureIndex("transfers", BSON("uid" << 1 << 
-                                       "direction" << 1 << 
-                                       "section" << 1 << 
-                                       "day" << 1 << 
-                                       "week" << 1 << 
-                                       "month" << 1 << 
-                                       "year" << 1), true);
-    return true;
-  }
-  catch (const mongo::DBException&)
-  { }
-  catch (const DBError&)
-  { }
-  
-  return false;
-}
-
-bool RegisterCaches(const std::function<void(acl::UserID)>& userUpdatedCB)
+bool RegisterCaches(const std::function<void(const std::vector<acl::UserID>&)>& userUpdatedCB)
 {
   try
   {
@@ -73,25 +28,29 @@ bool RegisterCaches(const std::function<void(acl::UserID)>& userUpdatedCB)
     
     return true;
   }
-  catch (const mongo::DBException&)
-  { }
   catch (const DBError&)
   { }
   
   return false;
 }
 
-bool Initialise(const std::function<void(acl::UserID)>& userUpdatedCB)
+bool Initialise(const std::function<void(const std::vector<acl::UserID>&)>& userUpdatedCB)
 {
-  if (!CreateUpdateLog())
+  if (!InitialiseStorage())
+  {
+    logs::Database("Error while initialising storage backend");
+    return false;
+  }
+
+  if (!dupe::DupeIndex::Initialise())
   {
-    logs::Database("Error while creating update log");
+    logs::Database("Error while loading dupe index");
     return false;
   }
 
-  if (!EnsureIndexes())
+  if (!index::PathIndex::Initialise())
   {
-    logs::Database("Error while building database indexes");
+    logs::Database("Error while loading path index");
     return false;
   }
 
@@ -104,4 +63,10 @@ bool Initialise(const std::function<void(acl::UserID)>& userUpdatedCB)
   return true;
 }
 
+void Cleanup()
+{
+  dupe::DupeIndex::Cleanup();
+  index::PathIndex::Cleanup();
+}
+
 } /* db namespace */
@@ -2,12 +2,14 @@
 #define __DB_UTIL_HPP
 
 #include <functional>
+#include <vector>
 #include "acl/types.hpp"
 
 namespace db
 {
 
-bool Initialise(const std::function<void(acl::UserID)>& userUpdatedCB);
+bool Initialise(const std::function<void(const std::vector<acl::UserID>&)>& userUpdatedCB);
+void Cleanup();
 
 } /* db namespace */
 
@@ -1,95 +1,38 @@
-#include <boost/optional.hpp>
 #include "db/mail/mail.hpp"
 #include "db/mail/message.hpp"
-#include "db/connection.hpp"
+#include "db/storage.hpp"
 
-namespace db
-{
-
-template <> mongo::BSONObj Serialize<mail::Message>(const mail::Message& message)
-{
-  mongo::BSONObjBuilder bob;
-  bob.append("recipient", message.recipient);
-  bob.append("sender", message.sender);
-  bob.append("time sent", ToDateT(message.timeSent));
-  bob.append("body", message.body);
-  bob.append("status", util::EnumToString(message.status));
-  return bob.obj();
-}
-
-template <> mail::Message Unserialize<mail::Message>(const mongo::BSONObj& obj)
-{
-  mail::Message message;
-  message.recipient = obj["recipient"].Int();
-  message.sender = obj["sender"].String();
-  message.timeSent = ToPosixTime(obj["time sent"].Date());
-  message.body = obj["body"].String();
-  message.status = util::EnumFromString<db::mail
-      ::Status>(obj["status"].String());
-  mongo::BSONElement oid;
-  obj.getObjectID(oid);
-  message.oid = oid.OID();
-  return message;
-}
-
-namespace mail
+namespace db { namespace mail
 {
 
 void Send(const Message& message)
 {
-  NoErrorConnection conn;
-  conn.Insert("mail", db::Serialize<mail::Message>(message));
+  GetStorage().MailSend(message);
 }
 
 std::vector<Message> Get(acl::UserID recipient)
 {
-  NoErrorConnection conn;
-  return conn.QueryMulti<Message>("mail", QUERY("recipient" << recipient));
-}
-
-boost::optional<mongo::OID> IndexToOID(acl::UserID recipient, int index)
-{
-  NoErrorConnection conn;
-  mongo::Query query = QUERY("recipient" << recipient);
-  auto results = conn.Query("mail", query, 1, index);
-  if (results.empty()) return boost::none;
-  
-  mongo::BSONElement oidElem;
-  results.front().getObjectID(oidElem);
-  return boost::optional<mongo::OID>(oidElem.OID());
+  return GetStorage().MailGet(recipient);
 }
 
 bool Save(acl::UserID recipient, int index)
 {
-  auto oid = IndexToOID(recipient, index);
-  if (!oid) return false;
-  
-  NoErrorConnection conn;
-  mongo::Query query = QUERY("_id" << *oid);
-  return conn.Update("mail", query, BSON("$set" << BSON("status" << "saved"))) > 0;
+  return GetStorage().MailSave(recipient, index);
 }
 
 int SaveTrash(acl::UserID recipient)
 {
-  mongo::Query query = QUERY("recipient" << recipient << "status" << "trash");
-  NoErrorConnection conn;
-  return conn.Update("mail", query, BSON("$set" << BSON("status" << "saved")));
+  return GetStorage().MailSaveTrash(recipient);
 }
 
 bool Purge(acl::UserID recipient, int index)
 {
-  auto oid = IndexToOID(recipient, index);
-  if (!oid) return false;
-
-  NoErrorConnection conn;
-  return conn.Remove("mail", QUERY("_id" << *oid)) > 0;
+  return GetStorage().MailPurge(recipient, index);
 }
 
 int PurgeTrash(acl::UserID recipient)
 {
-  mongo::Query query = QUERY("recipient" << recipient << "status" << "trash");
-  NoErrorConnection conn;
-  return conn.Remove("mail", query);
+  return GetStorage().MailPurgeTrash(recipient);
 }
 
 void LogOffPurgeTrash(acl::UserID recipient)
@@ -99,9 +42,7 @@ void LogOffPurgeTrash(acl::UserID recipient)
 
 void Trash(const Message& message)
 {
-  mongo::Query query = QUERY("_id" << message.oid);
-  NoErrorConnection conn;
-  conn.Update("mail", query, BSON("$set" << BSON("status" << "trash")));
+  GetStorage().MailTrash(message);
 }
 
 } /* mail namespace */
@@ -4,11 +4,6 @@
 #include <vector>
 #include "acl/types.hpp"
 
-namespace mongo
-{
-class BSONObj;
-}
-
 namespace db { namespace mail
 {
 
@@ -24,10 +19,6 @@ void LogOffPurgeTrash(acl::UserID recipient);
 void Trash(const Message& message);
 
 } /* mail namespace */
-/*
-template <> mongo::BSONObj Serialize<mail::Message>(const mail::Message& message);
-template <> mail::Message Unserialize<mail::Message>(const mongo::BSONObj& obj);
-*/
 } /* db namespace */
 
 #endif
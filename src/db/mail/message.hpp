@@ -3,24 +3,12 @@
 
 #include <string>
 #include <boost/date_time/posix_time/posix_time.hpp>
-#include <mongo/client/dbclient.h>
 #include "acl/types.hpp"
 #include "util/enumstrings.hpp"
 
 namespace db
 {
 
-namespace mail
-{
-class Message;
-}
-
-template <typename T> mongo::BSONObj Serialize(const mail::Message& message);
-template <> mongo::BSONObj Serialize<mail::Message>(const mail::Message& message);
-
-template <typename T> T Unserialize(const mongo::BSONObj& obj);
-template <> mail::Message Unserialize<mail::Message>(const mongo::BSONObj& obj);
-
 namespace mail
 {
 
@@ -34,9 +22,7 @@ private:
   std::string body;
   boost::posix_time::ptime timeSent;
   ::db::mail::Status status;
-  mongo::OID oid;
-  
-  Message() : recipient(-1), status(db::mail::Status::Unread) { }
+  std::string id;
   
 public:
   Message(const std::string& sender, acl::UserID recipient, 
@@ -44,16 +30,21 @@ public:
           boost::posix_time::ptime& timeSent) :
     sender(sender), recipient(recipient),
     body(body), timeSent(timeSent), status(db::mail::Status::Unread) { }
+
+  // as loaded by the storage backend, id is its key for the message
+  Message(const std::string& sender, acl::UserID recipient, 
+          const std::string& body, 
+          const boost::posix_time::ptime& timeSent,
+          ::db::mail::Status status, const std::string& id) :
+    sender(sender), recipient(recipient),
+    body(body), timeSent(timeSent), status(status), id(id) { }
   
   const std::string& Sender() const { return sender; }
   acl::UserID Recipient() const { return recipient; }
   const std::string& Body() const { return body; }
   const boost::posix_time::ptime& TimeSent() const { return timeSent; }
   ::db::mail::Status Status() const { return status; }
-  
-  friend void Trash(const Message& message);
-  friend Message db::Unserialize<Message>(const mongo::BSONObj& obj);
-  friend mongo::BSONObj db::Serialize<Message>(const Message& message);
+  const std::string& ID() const { return id; }
 };
 
 std::string StatusToString(Status status);
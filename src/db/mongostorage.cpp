@@ -0,0 +1,856 @@
+#include <algorithm>
+#include "db/mongostorage.hpp"
+#include "db/connection.hpp"
+#include "db/serialization.hpp"
+#include "db/stats/serialization.hpp"
+#include "db/group/util.hpp"
+#include "stats/date.hpp"
+#include "util/misc.hpp"
+#include "util/string.hpp"
+
+namespace db
+{
+
+template <> dupe::DupeResult Unserialize<dupe::DupeResult>(const mongo::BSONObj& obj)
+{
+  try
+  {
+    mongo::BSONElement oid;
+    obj.getObjectID(oid);
+    return dupe::DupeResult(obj["directory"].String(),
+                            obj["section"].String(),
+                            db::ToPosixTime(oid.OID().asDateT()));
+  }
+  catch (const mongo::DBException& e)
+  {
+    LogException("Dupe result unserialize", e, obj);
+    throw e;
+  }
+}
+
+template <> index::SearchResult Unserialize<index::SearchResult>(const mongo::BSONObj& obj)
+{
+  mongo::BSONElement oid;
+  obj.getObjectID(oid);
+  return index::SearchResult(obj["path"].String(),
+                             obj["section"].String(),
+                             ToPosixTime(oid.OID().asDateT()));
+}
+
+template <> mongo::BSONObj Serialize<acl::UserData>(const acl::UserData& user)
+{
+  mongo::BSONObjBuilder bob;
+
+  bob.append("uid", user.id);
+  bob.append("name", user.name);
+  bob.append("ip masks", SerializeContainer(user.ipMasks));
+  bob.append("password", user.password);
+  bob.append("salt", user.salt);
+  bob.append("flags", user.flags);
+  bob.append("primary gid", user.primaryGid);
+  bob.append("secondary gids", SerializeContainer(user.secondaryGids));
+  bob.append("gadmin gids", SerializeContainer(user.gadminGids));
+  bob.append("creator", user.creator);
+  bob.append("created", ToDateT(user.created));
+  bob.append("home dir", user.homeDir);
+  bob.append("idle time", user.idleTime);
+  
+  if (user.expires)
+    bob.append("expires", ToDateT(*user.expires));
+  else
+    bob.appendNull("expires");
+    
+  bob.append("num logins", user.numLogins);
+  bob.append("comment", user.comment);
+  bob.append("tagline", user.tagline);
+  bob.append("max down speed", user.maxDownSpeed);
+  bob.append("max up speed", user.maxUpSpeed);
+  bob.append("max sim down", user.maxSimDown);
+  bob.append("max sim up", user.maxSimUp);
+  bob.append("logged in", user.loggedIn);
+  
+  if (user.lastLogin)
+    bob.append("last login", ToDateT(*user.lastLogin));
+  else
+    bob.appendNull("last login");
+    
+  bob.append("ratio", SerializeMap(user.ratio, "section", "value"));
+  bob.append("credits", SerializeMap(user.credits, "section", "value"));
+  bob.append("weekly allotment", SerializeMap(user.weeklyAllotment, "section", "value"));
+  
+  return bob.obj();
+}
+
+template <> acl::UserData Unserialize<acl::UserData>(const mongo::BSONObj& obj)
+{
+  try
+  { 
+    acl::UserData user;
+    user.id = obj["uid"].Int();
+    user.name = obj["name"].String();
+    UnserializeContainer(obj["ip masks"].Array(), user.ipMasks);
+    user.password = obj["password"].String();
+    user.salt = obj["salt"].String();
+    user.flags = obj["flags"].String();
+    user.primaryGid = obj["primary gid"].Int();
+    UnserializeContainer(obj["secondary gids"].Array(), user.secondaryGids);
+    UnserializeContainer(obj["gadmin gids"].Array(), user.gadminGids);
+    
+    user.creator = obj["creator"].Int();
+    mongo::BSONElement oid;
+    obj.getObjectID(oid);
+    user.created = ToGregDate(oid.OID().asDateT());
+    
+    user.homeDir = obj["home dir"].String();
+    user.idleTime = obj["idle time"].Int();
+    
+    if (obj["expires"].type() != mongo::jstNULL)
+      user.expires.reset(ToGregDate(obj["expires"].Date()));
+    
+    user.numLogins = obj["num logins"].Int();
+    user.comment = obj["comment"].String();
+    user.tagline = obj["tagline"].String();
+    user.maxDownSpeed = obj["max down speed"].Long();
+    user.maxUpSpeed = obj["max up speed"].Long();
+    user.maxSimDown = obj["max sim down"].Int();
+    user.maxSimUp = obj["max sim up"].Int();
+    user.loggedIn = obj["logged in"].Int();
+    if (obj["last login"].type() != mongo::jstNULL)
+      user.lastLogin.reset(ToPosixTime(obj["last login"].Date()));
+    
+    UnserializeMap(obj["ratio"].Array(), "section", "value", user.ratio);
+    UnserializeMap(obj["credits"].Array(), "section", "value", user.credits);
+    UnserializeMap(obj["weekly allotment"].Array(), "section", "value", user.weeklyAllotment);
+    
+    return user;
+  }
+  catch (const mongo::DBException& e)
+  {
+    LogException("Unserialize user", e, obj);
+    throw e;
+  }
+}
+
+template <> mongo::BSONObj Serialize<acl::GroupData>(const acl::GroupData& group)
+{
+  mongo::BSONObjBuilder bob;
+  bob.append("name", group.name);
+  bob.append("gid", group.id);
+  bob.append("description", group.description);
+  bob.append("slots", group.slots);
+  bob.append("leech slots", group.leechSlots);
+  bob.append("allotment slots", group.allotmentSlots);
+  bob.append("max allotment size", group.maxAllotmentSize);
+  bob.append("max logins", group.maxLogins);
+  bob.append("comment", group.comment);
+  return bob.obj();
+}
+
+template <> acl::GroupData Unserialize<acl::GroupData>(const mongo::BSONObj& obj)
+{
+  try
+  {
+    acl::GroupData group;
+    group.id = obj["gid"].Int();
+    group.name = obj["name"].String();
+    group.description = obj["description"].String();
+    group.comment = obj["comment"].String();
+    group.slots = obj["slots"].Int();
+    group.leechSlots = obj["leech slots"].Int();
+    group.allotmentSlots = obj["allotment slots"].Int();
+    group.maxAllotmentSize = obj["max allotment size"].Long();
+    group.maxLogins = obj["max logins"].Int();
+    return group;
+  }
+  catch (const mongo::DBException& e)
+  {
+    LogException("Unserialize group", e, obj);
+    throw e;
+  }
+}
+
+template <> mongo::BSONObj Serialize<mail::Message>(const mail::Message& message)
+{
+  mongo::BSONObjBuilder bob;
+  bob.append("recipient", message.Recipient());
+  bob.append("sender", message.Sender());
+  bob.append("time sent", ToDateT(message.TimeSent()));
+  bob.append("body", message.Body());
+  bob.append("status", util::EnumToString(message.Status()));
+  return bob.obj();
+}
+
+template <> mail::Message Unserialize<mail::Message>(const mongo::BSONObj& obj)
+{
+  mongo::BSONElement oid;
+  obj.getObjectID(oid);
+  return mail::Message(obj["sender"].String(), obj["recipient"].Int(), obj["body"].String(),
+                       ToPosixTime(obj["time sent"].Date()),
+                       util::EnumFromString<mail::Status>(obj["status"].String()),
+                       oid.OID().str());
+}
+
+namespace
+{
+
+template <typename T>
+std::vector<T> GetUsersGeneric(const std::string& multiStr, const mongo::BSONObj* fields)
+{
+  std::vector<std::string> toks;
+  util::Split(toks, multiStr, " ", true);
+  
+  mongo::Query query;
+  if (std::find(toks.begin(), toks.end(), "*") == toks.end())
+  {
+    mongo::BSONArrayBuilder namesBab;
+    mongo::BSONArrayBuilder gidsBab;
+    
+    for (std::string tok : toks)
+    {
+      if (tok[0] == '=')
+      {
+        acl::GroupID gid = NameToGID(tok.substr(1));
+        if (gid != -1)
+        {
+          gidsBab.append(gid);
+        }
+        continue;
+      }
+      
+      if (tok[0] == '-') tok.erase(0, 1);
+      namesBab.append(tok);
+    }
+    
+    auto gids = gidsBab.arr();
+    query = QUERY("$or" << 
+      BSON_ARRAY(BSON("name" << BSON("$in" << namesBab.arr())) <<
+                 BSON("primary gid" << BSON("$in" << gids)) <<
+                 BSON("secondary gids" << BSON("$in" << gids))));
+  }
+
+  NoErrorConnection conn;
+  return conn.QueryMulti<T>("users", query, 0, 0, fields);
+}
+
+template <typename T>
+std::vector<T> GetGroupsGeneric(const std::string& multiStr, const mongo::BSONObj* fields)
+{
+  std::vector<std::string> toks;
+  util::Split(toks, multiStr, " ", true);
+  
+  mongo::Query query;
+  if (std::find(toks.begin(), toks.end(), "*") == toks.end())
+  {
+    mongo::BSONArrayBuilder namesBab;
+    
+    for (std::string tok : toks)
+    {
+      if (tok[0] == '=') tok.erase(0, 1);
+      namesBab.append(tok);
+    }
+    
+    query = QUERY("name" << BSON("$in" << namesBab.arr()));
+  }
+  
+  NoErrorConnection conn;
+  return conn.QueryMulti<T>("groups", query, 0, 0, fields);
+}
+
+// unserializes each result on its own so one bad record doesn't hide the
+// rest, the id of any that fail goes in unreadable, -1 if even that fails
+template <typename T, typename ID>
+std::vector<T> LoadMulti(const std::string& collection, const std::string& idField,
+      const std::vector<ID>& ids, std::vector<ID>& unreadable)
+{
+  mongo::BSONArrayBuilder in;
+  for (ID id : ids) in.append(id);
+  
+  SafeConnection conn;
+  auto results = conn.Query(collection, QUERY(idField << BSON("$in" << in.arr())), 0, 0);
+  
+  std::vector<T> loaded;
+  for (const auto& obj : results)
+  {
+    try
+    {
+      loaded.emplace_back(Unserialize<T>(obj));
+    }
+    catch (const mongo::DBException&)
+    {
+      auto id = obj[idField];
+      unreadable.emplace_back(id.isNumber() ? id.numberInt() : -1);
+    }
+  }
+  return loaded;
+}
+
+boost::optional<mongo::OID> MailIndexToOID(acl::UserID recipient, int index)
+{
+  NoErrorConnection conn;
+  mongo::Query query = QUERY("recipient" << recipient);
+  auto results = conn.Query("mail", query, 1, index);
+  if (results.empty()) return boost::none;
+  
+  mongo::BSONElement oidElem;
+  results.front().getObjectID(oidElem);
+  return boost::optional<mongo::OID>(oidElem.OID());
+}
+
+}
+
+bool MongoStorage::Initialise()
+{
+  try
+  {
+    SafeConnection conn;
+    mongo::BSONObj info;
+    conn.RunCommand(BSON("create" << "updatelog" << 
+                         "capped" << true << 
+                         "size" << 102400 << 
+                         "max" << 100), info);
+    
+    conn.EnsureIndex("users", BSON("uid" << 1), true);
+    conn.EnsureIndex("users", BSON("name" << 1), true);
+    conn.EnsureIndex("groups", BSON("gid" << 1), true);
+    conn.EnsureIndex("groups", BSON("name" << 1), true);
+    conn.EnsureIndex("updatelog", BSON("timestamp" << 1), false);
+    conn.EnsureIndex("index", BSON("path" << 1), true);
+    conn.EnsureIndex("dupe", BSON("directory" << 1), true);
+    conn.EnsureIndex("transfers", BSON("uid" << 1 << 
+                                       "direction" << 1 << 
+                                       "section" << 1 << 
+                                       "day" << 1 << 
+                                       "week" << 1 << 
+                                       "month" << 1 << 
+                                       "year" << 1), true);
+    return true;
+  }
+  catch (const mongo::DBException&)
+  { }
+  catch (const DBError&)
+  { }
+  
+  return false;
+}
+
+void MongoStorage::DupeAdd(const std::string& directory, const std::string& section)
+{
+  FastConnection conn;
+  conn.Insert("dupe", BSON("directory" << directory <<
+                           "section" << section <<
+                           "nuked" << false));
+}
+
+std::vector<dupe::DupeResult> MongoStorage::DupeSearch(const std::vector<std::string>& terms, int limit)
+{
+  mongo::BSONObjBuilder bob;
+  for (const std::string& term : terms)
+  {
+    bob.appendRegex("directory", util::EscapeRegex(term), "i");
+  }
+
+  mongo::Query query(bob.obj());
+
+  NoErrorConnection conn;
+  return conn.QueryMulti<dupe::DupeResult>("dupe", query, limit);
+}
+
+std::vector<dupe::DupeResult> MongoStorage::DupeSince(const boost::posix_time::ptime& since)
+{
+  mongo::BSONObjBuilder bob;
+  if (!since.is_special())
+  {
+    mongo::OID oid;
+    oid.init(ToDateT(since));
+    bob.append("_id", BSON("$gte" << oid));
+  }
+
+  mongo::Query query(bob.obj());
+
+  NoErrorConnection conn;
+  return conn.QueryMulti<dupe::DupeResult>("dupe", query.sort("_id", 1));
+}
+
+void MongoStorage::IndexAdd(const std::string& path, const std::string& section)
+{
+  FastConnection conn;
+  conn.Insert("index", BSON("path" << path << "section" << section));
+}
+
+void MongoStorage::IndexDelete(const std::string& path)
+{
+  NoErrorConnection conn;
+  conn.Remove("index", QUERY("path" << path));
+}
+
+void MongoStorage::IndexDelete(const std::vector<std::string>& paths)
+{
+  mongo::BSONArrayBuilder pathsArr;
+  for (const auto& path : paths)
+    pathsArr.append(path);
+
+  NoErrorConnection conn;
+  conn.Remove("index", QUERY("path" << BSON("$in" << pathsArr.arr())));
+}
+
+std::vector<index::SearchResult> MongoStorage::IndexSearch(const std::vector<std::string>& terms, int limit)
+{
+  mongo::BSONObjBuilder bob;
+  for (const std::string& term : terms)
+  {
+    bob.appendRegex("path", util::EscapeRegex(term), "i");
+  }
+
+  mongo::Query query(bob.obj());
+  NoErrorConnection conn;
+  return conn.QueryMulti<index::SearchResult>("index", query.sort("_id", -1), limit);
+}
+
+void MongoStorage::TransferUpdate(const TransferKey& key, int files,
+      long long kBytes, long long xfertime)
+{
+  mongo::BSONObjBuilder query;
+  query.append("uid", key.uid);
+  query.append("day", key.day);
+  query.append("week", key.week);
+  query.append("month", key.month);
+  query.append("year", key.year);
+  query.append("direction", util::EnumToString(key.direction));
+  query.append("section", key.section);
+
+  mongo::BSONObj update = BSON(
+    "$inc" << BSON("files" << files) <<
+    "$inc" << BSON("kbytes" << kBytes) <<
+    "$inc" << BSON("xfertime" << xfertime));
+
+  FastConnection conn;
+  conn.Update("transfers", query.obj(), update, true);
+}
+
+std::vector< ::stats::Stat> MongoStorage::TransferTotals(const TransferQuery& query)
+{
+  mongo::BSONObjBuilder match;
+  if (query.direction)
+    match.append("direction", util::EnumToString(*query.direction));
+  match.appendElements(stats::Serialize(query.date));
+
+  if (query.sectionFilter != TransferQuery::SectionFilter::Any)
+  {
+    mongo::BSONArrayBuilder sections;
+    for (const auto& section : query.sections)
+      sections.append(section);
+    const char* op = query.sectionFilter == TransferQuery::SectionFilter::Include ? "$in" : "$nin";
+    match.appendElements(BSON("section" << BSON(op << sections.arr())));
+  }
+
+  if (query.uid) match.append("uid", *query.uid);
+
+  mongo::BSONObjBuilder group;
+  if (query.groupByUser) group.append("_id", "$uid");
+  else group.append("_id", "");
+  group.append("total kbytes", BSON("$sum" << "$kbytes"));
+  group.append("total files", BSON("$sum" << "$files"));
+  group.append("total xfertime", BSON("$sum" << "$xfertime"));
+
+  auto cmd = BSON("aggregate" << "transfers" << "pipeline" <<
+                  BSON_ARRAY(BSON("$match" << match.obj()) <<
+                             BSON("$group" << group.obj())));
+
+  std::vector< ::stats::Stat> totals;
+  mongo::BSONObj result;
+  NoErrorConnection conn;
+  if (conn.RunCommand(cmd, result))
+  {
+    try
+    {
+      for (const auto& elem : result["result"].Array())
+      {
+        totals.emplace_back(stats::Unserialize(elem.Obj()));
+      }
+    }
+    catch (const mongo::DBException& e)
+    {
+      LogException("Unserialize transfer totals", e, result);
+    }
+  }
+
+  return totals;
+}
+
+void MongoStorage::ProtocolUpdate(acl::UserID uid, const ::stats::Date& date,
+      long long sendKBytes, long long receiveKBytes)
+{
+  mongo::BSONObjBuilder qbob;
+  qbob.append("uid", uid);
+  qbob.append("day", date.Day());
+  qbob.append("week", date.Week());
+  qbob.append("month", date.Month());
+  qbob.append("year", date.Year());
+  mongo::Query query(qbob.obj());
+
+  mongo::BSONObj obj = BSON("$inc" << BSON("send kbytes" << sendKBytes) <<
+                            "$inc" << BSON("receive kbytes" << receiveKBytes));
+  NoErrorConnection conn;
+  conn.Update("protocol", query, obj, true);
+}
+
+stats::Traffic MongoStorage::ProtocolTotal(const boost::optional<acl::UserID>& uid,
+      const DateMatch& date)
+{
+  mongo::BSONObjBuilder match;
+  match.appendElements(stats::Serialize(date));
+  if (uid) match.append("uid", *uid);
+
+  mongo::BSONObj cmd = BSON("aggregate" << "protocol" << "pipeline" <<
+    BSON_ARRAY(
+      BSON("$match" << match.obj()) <<
+      BSON("$group" <<
+        BSON("_id" << "" <<
+          "send total" << BSON("$sum" << "$send kbytes") <<
+          "receive total" << BSON("$sum" << "$receive kbytes")
+        ))));
+
+  mongo::BSONObj result;
+  NoErrorConnection conn;
+  if (conn.RunCommand(cmd, result))
+  {
+    auto elems = result["result"].Array();
+    if (!elems.empty())
+    {
+      try
+      {
+        return stats::Traffic(elems[0]["send total"].Long(),
+                              elems[0]["receive total"].Long());
+      }
+      catch (const mongo::DBException& e)
+      {
+        LogException("Unserialize protocol total", e, result);
+      }
+    }
+  }
+
+  return stats::Traffic();
+}
+
+acl::UserID MongoStorage::UserCreate(const acl::UserData& user)
+{
+  NoErrorConnection conn;
+  return conn.InsertAutoIncrement("users", user, "uid");
+}
+
+bool MongoStorage::UserSave(const acl::UserData& user, const std::vector<std::string>& fields)
+{
+  try
+  {
+    SafeConnection conn;
+    conn.SetFields("users", QUERY("uid" << user.id), user, fields);
+    return true;
+  }
+  catch (const DBError&)
+  {
+    return false;
+  }
+}
+
+void MongoStorage::UserPurge(acl::UserID uid)
+{
+  NoErrorConnection conn;
+  conn.Remove("users", QUERY("uid" << uid));
+}
+
+boost::optional<acl::UserData> MongoStorage::UserLoad(acl::UserID uid)
+{
+  NoErrorConnection conn;                  
+  return conn.QueryOne<acl::UserData>("users", QUERY("uid" << uid));
+}
+
+boost::optional<acl::UserData> MongoStorage::UserLoad(const std::string& name)
+{
+  NoErrorConnection conn;                  
+  return conn.QueryOne<acl::UserData>("users", QUERY("name" << name));
+}
+
+std::vector<acl::UserData> MongoStorage::UserLoad(const std::vector<acl::UserID>& uids,
+      std::vector<acl::UserID>& unreadable)
+{
+  return LoadMulti<acl::UserData>("users", "uid", uids, unreadable);
+}
+
+std::vector<acl::UserData> MongoStorage::UserList(const std::string& multiStr)
+{
+  return GetUsersGeneric<acl::UserData>(multiStr, nullptr);
+}
+
+std::vector<acl::UserID> MongoStorage::UserIDs(const std::string& multiStr)
+{
+  auto fields = BSON("uid" << 1);
+  return GetUsersGeneric<acl::UserID>(multiStr, &fields);
+}
+
+std::vector<std::string> MongoStorage::UserIPMasks(acl::UserID uid)
+{
+  mongo::Query query;
+  if (uid != -1) query = QUERY("uid" << uid);
+  auto fields = BSON("ip masks" << 1);
+  
+  NoErrorConnection conn;
+  std::vector<std::string> ipMasks;
+  auto results = conn.Query("users", query, 0, 0, &fields);
+  for (const auto& obj : results)
+  {
+    try
+    {
+      std::vector<std::string> masks;
+      UnserializeContainer(obj["ip masks"].Array(), masks);
+      ipMasks.insert(ipMasks.end(), masks.begin(), masks.end());
+    }
+    catch (const mongo::DBException& e)
+    {
+      LogException("Unserialize ip masks", e, "users", query, fields);
+    }
+  }
+  return ipMasks;
+}
+
+void MongoStorage::UserIncrCredits(acl::UserID uid, const std::string& section, long long kBytes)
+{
+  NoErrorConnection conn;
+  auto updateExisting = [&]() -> bool
+    {
+      auto query = BSON("uid" << uid << 
+                        "credits" << BSON("$elemMatch" << BSON("section" << section)));
+                        
+      auto update = BSON("$inc" << BSON("credits.$.value" << kBytes));
+                        
+      auto cmd = BSON("findandmodify" << "users" <<
+                      "query" << query <<
+                      "update" << update);
+                      
+      mongo::BSONObj result;
+      return conn.RunCommand(cmd, result) && 
+             result["value"].type() != mongo::jstNULL;
+    };
+
+  auto doInsert = [&]() -> bool
+  {
+    auto query = QUERY("uid" << uid << "credits" << BSON("$not" << 
+                       BSON("$elemMatch" << BSON("section" << section))));
+    auto update = BSON("$push" << BSON("credits" << BSON("section" << section << "value" << kBytes)));
+    return conn.Update("users", query, update, false) > 0;
+  };
+  
+  if (updateExisting()) return;
+  if (doInsert()) return;
+  if (updateExisting()) return;
+
+  logs::Database("Unable to increment credits for UID %1%%2%", uid,
+                 !section.empty() ? " in section " + section : 
+                 std::string(""));
+}
+
+bool MongoStorage::UserDecrCredits(acl::UserID uid, const std::string& section,
+      long long kBytes, bool force)
+{
+  mongo::BSONObjBuilder elemQuery;
+  elemQuery.append("section", section);
+  if (!force) elemQuery.append("value", BSON("$gte" << kBytes));
+  
+  auto query = BSON("uid" << uid << 
+                    "credits" << BSON("$elemMatch" << elemQuery.obj()));
+                    
+  auto update = BSON("$inc" << BSON("credits.$.value" << -kBytes));
+                    
+  auto cmd = BSON("findandmodify" << "users" <<
+                  "query" << query <<
+                  "update" << update);
+  NoErrorConnection conn;                  
+  mongo::BSONObj result;
+  bool ret = conn.RunCommand(cmd, result);
+  return force || (ret && result["value"].type() != mongo::jstNULL);
+}
+
+acl::GroupID MongoStorage::GroupCreate(const acl::GroupData& group)
+{
+  NoErrorConnection conn;
+  return conn.InsertAutoIncrement("groups", group, "gid");
+}
+
+bool MongoStorage::GroupSave(const acl::GroupData& group, const std::vector<std::string>& fields)
+{
+  try
+  {
+    SafeConnection conn;
+    conn.SetFields("groups", QUERY("gid" << group.id), group, fields);
+    return true;
+  }
+  catch (const DBError&)
+  {
+    return false;
+  }
+}
+
+void MongoStorage::GroupPurge(acl::GroupID gid)
+{
+  NoErrorConnection conn;
+  conn.Remove("groups", QUERY("gid" << gid));
+}
+
+boost::optional<acl::GroupData> MongoStorage::GroupLoad(acl::GroupID gid)
+{
+  NoErrorConnection conn;
+  return conn.QueryOne<acl::GroupData>("groups", QUERY("gid" << gid));
+}
+
+boost::optional<acl::GroupData> MongoStorage::GroupLoad(const std::string& name)
+{
+  NoErrorConnection conn;
+  return conn.QueryOne<acl::GroupData>("groups", QUERY("name" << name));
+}
+
+std::vector<acl::GroupData> MongoStorage::GroupLoad(const std::vector<acl::GroupID>& gids,
+      std::vector<acl::GroupID>& unreadable)
+{
+  return LoadMulti<acl::GroupData>("groups", "gid", gids, unreadable);
+}
+
+std::vector<acl::GroupData> MongoStorage::GroupList(const std::string& multiStr)
+{
+  return GetGroupsGeneric<acl::GroupData>(multiStr, nullptr);
+}
+
+std::vector<acl::GroupID> MongoStorage::GroupIDs(const std::string& multiStr)
+{
+  auto fields = BSON("gid" << 1);
+  return GetGroupsGeneric<acl::GroupID>(multiStr, &fields);
+}
+
+int MongoStorage::GroupSlotsUsed(acl::GroupID gid)
+{
+  NoErrorConnection conn;
+  mongo::BSONObjBuilder bob;
+  bob.append("primary gid", gid);
+  bob.appendRegex("flags", "^[^6]*$");
+  return conn.Count("users", bob.obj());  
+}
+
+int MongoStorage::GroupMembers(acl::GroupID gid)
+{
+  mongo::BSONArrayBuilder bab;
+  bab.append(gid);
+  auto query = BSON("$or" << BSON_ARRAY(BSON("primary gid" << gid) <<
+                                        BSON("secondary gids" << BSON("$in" << bab.arr()))));
+  NoErrorConnection conn;
+  return conn.Count("users", query);
+}
+
+int MongoStorage::GroupLeeches(acl::GroupID gid)
+{
+  NoErrorConnection conn;
+  auto query = BSON("primary gid" << gid <<
+                    "ratio" << BSON("$elemMatch" << BSON("section" << "" << 
+                                                         "value" << 0)));
+  return conn.Count("users", query);
+}
+
+int MongoStorage::GroupAllotments(acl::GroupID gid)
+{
+  NoErrorConnection conn;
+  auto query = BSON("primary gid" << gid <<
+                    "weekly allotment" << BSON("$elemMatch" << BSON("section" << "" << 
+                                                                    "value" << BSON("$gt" << 0))));
+  return conn.Count("users", query);
+}
+
+long long MongoStorage::GroupAllotmentTotal(acl::GroupID gid)
+{
+  NoErrorConnection conn;
+  auto cmd = BSON("aggregate" << "users" << "pipeline" <<
+    BSON_ARRAY(
+      BSON("$unwind" << "$weekly allotment") <<
+      BSON("$match" << 
+        BSON("primary gid" << gid <<
+             "weekly allotment.section" << "")
+      ) <<
+      BSON("$group" << 
+        BSON("_id" << "" <<
+             "total" << BSON("$sum" << "$weekly allotment.value"))
+     )));
+  mongo::BSONObj result;
+  if (conn.RunCommand(cmd, result))
+  {
+    auto elems = result["result"].Array();
+    if (!elems.empty())
+    {
+      try
+      {
+        return elems[0]["total"].Long();
+      }
+      catch (const mongo::DBException& e)
+      {
+        LogException("Unserialize allotment size total", e, result);
+      }
+    }
+  }
+  
+  return -1;
+}
+
+void MongoStorage::UpdateLog(const std::string& collection, int32_t id)
+{
+  FastConnection conn;
+  conn.Insert("updatelog", BSON("collection" << collection << "id" << id));
+}
+
+void MongoStorage::MailSend(const mail::Message& message)
+{
+  NoErrorConnection conn;
+  conn.Insert("mail", Serialize<mail::Message>(message));
+}
+
+std::vector<mail::Message> MongoStorage::MailGet(acl::UserID recipient)
+{
+  NoErrorConnection conn;
+  return conn.QueryMulti<mail::Message>("mail", QUERY("recipient" << recipient));
+}
+
+bool MongoStorage::MailSave(acl::UserID recipient, int index)
+{
+  auto oid = MailIndexToOID(recipient, index);
+  if (!oid) return false;
+  
+  NoErrorConnection conn;
+  mongo::Query query = QUERY("_id" << *oid);
+  return conn.Update("mail", query, BSON("$set" << BSON("status" << "saved"))) > 0;
+}
+
+int MongoStorage::MailSaveTrash(acl::UserID recipient)
+{
+  mongo::Query query = QUERY("recipient" << recipient << "status" << "trash");
+  NoErrorConnection conn;
+  return conn.Update("mail", query, BSON("$set" << BSON("status" << "saved")));
+}
+
+bool MongoStorage::MailPurge(acl::UserID recipient, int index)
+{
+  auto oid = MailIndexToOID(recipient, index);
+  if (!oid) return false;
+
+  NoErrorConnection conn;
+  return conn.Remove("mail", QUERY("_id" << *oid)) > 0;
+}
+
+int MongoStorage::MailPurgeTrash(acl::UserID recipient)
+{
+  mongo::Query query = QUERY("recipient" << recipient << "status" << "trash");
+  NoErrorConnection conn;
+  return conn.Remove("mail", query);
+}
+
+void MongoStorage::MailTrash(const mail::Message& message)
+{
+  mongo::Query query = QUERY("_id" << mongo::OID(message.ID()));
+  NoErrorConnection conn;
+  conn.Update("mail", query, BSON("$set" << BSON("status" << "trash")));
+}
+
+} /* db namespace */
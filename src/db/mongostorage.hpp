@@ -0,0 +1,73 @@
+#ifndef __DB_MONGOSTORAGE_HPP
+#define __DB_MONGOSTORAGE_HPP
+
+#include "db/storage.hpp"
+
+namespace db
+{
+
+class MongoStorage : public Storage
+{
+public:
+  bool Initialise();
+
+  void DupeAdd(const std::string& directory, const std::string& section);
+  std::vector<dupe::DupeResult> DupeSearch(const std::vector<std::string>& terms, int limit);
+  std::vector<dupe::DupeResult> DupeSince(const boost::posix_time::ptime& since);
+
+  void IndexAdd(const std::string& path, const std::string& section);
+  void IndexDelete(const std::string& path);
+  void IndexDelete(const std::vector<std::string>& paths);
+  std::vector<index::SearchResult> IndexSearch(const std::vector<std::string>& terms, int limit);
+
+  void TransferUpdate(const TransferKey& key, int files, long long kBytes, long long xfertime);
+  std::vector< ::stats::Stat> TransferTotals(const TransferQuery& query);
+
+  void ProtocolUpdate(acl::UserID uid, const ::stats::Date& date,
+        long long sendKBytes, long long receiveKBytes);
+  stats::Traffic ProtocolTotal(const boost::optional<acl::UserID>& uid,
+        const DateMatch& date);
+
+  acl::UserID UserCreate(const acl::UserData& user);
+  bool UserSave(const acl::UserData& user, const std::vector<std::string>& fields);
+  void UserPurge(acl::UserID uid);
+  boost::optional<acl::UserData> UserLoad(acl::UserID uid);
+  boost::optional<acl::UserData> UserLoad(const std::string& name);
+  std::vector<acl::UserData> UserLoad(const std::vector<acl::UserID>& uids,
+        std::vector<acl::UserID>& unreadable);
+  std::vector<acl::UserData> UserList(const std::string& multiStr);
+  std::vector<acl::UserID> UserIDs(const std::string& multiStr);
+  std::vector<std::string> UserIPMasks(acl::UserID uid);
+  void UserIncrCredits(acl::UserID uid, const std::string& section, long long kBytes);
+  bool UserDecrCredits(acl::UserID uid, const std::string& section,
+        long long kBytes, bool force);
+
+  acl::GroupID GroupCreate(const acl::GroupData& group);
+  bool GroupSave(const acl::GroupData& group, const std::vector<std::string>& fields);
+  void GroupPurge(acl::GroupID gid);
+  boost::optional<acl::GroupData> GroupLoad(acl::GroupID gid);
+  boost::optional<acl::GroupData> GroupLoad(const std::string& name);
+  std::vector<acl::GroupData> GroupLoad(const std::vector<acl::GroupID>& gids,
+        std::vector<acl::GroupID>& unreadable);
+  std::vector<acl::GroupData> GroupList(const std::string& multiStr);
+  std::vector<acl::GroupID> GroupIDs(const std::string& multiStr);
+  int GroupSlotsUsed(acl::GroupID gid);
+  int GroupMembers(acl::GroupID gid);
+  int GroupLeeches(acl::GroupID gid);
+  int GroupAllotments(acl::GroupID gid);
+  long long GroupAllotmentTotal(acl::GroupID gid);
+
+  void UpdateLog(const std::string& collection, int32_t id);
+
+  void MailSend(const mail::Message& message);
+  std::vector<mail::Message> MailGet(acl::UserID recipient);
+  bool MailSave(acl::UserID recipient, int index);
+  int MailSaveTrash(acl::UserID recipient);
+  bool MailPurge(acl::UserID recipient, int index);
+  int MailPurgeTrash(acl::UserID recipient);
+  void MailTrash(const mail::Message& message);
+};
+
+} /* db namespace */
+
+#endif
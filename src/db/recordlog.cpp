@@ -0,0 +1,214 @@
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "db/recordlog.hpp"
+#include "util/crc32.hpp"
+
+namespace db
+{
+
+namespace
+{
+
+const size_t headerSize = sizeof(uint32_t) * 2;
+
+uint32_t Checksum(const char* data, size_t len)
+{
+  util::CRC32 crc;
+  crc.Update(reinterpret_cast<const uint8_t*>(data), len);
+  return crc.Checksum();
+}
+
+util::Error WriteAll(int fd, const std::string& buffer)
+{
+  const char* p = buffer.data();
+  size_t left = buffer.size();
+  while (left > 0)
+  {
+    ssize_t len = write(fd, p, left);
+    if (len < 0)
+    {
+      if (errno == EINTR) continue;
+      return util::Error::Failure(errno);
+    }
+    p += len;
+    left -= len;
+  }
+  return util::Error::Success();
+}
+
+}
+
+RecordLog::~RecordLog()
+{
+  if (fd >= 0) close(fd);
+}
+
+void RecordLog::Encode(const Record& record, std::string& buffer)
+{
+  uint32_t length = 0;
+  for (const auto& field : record) length += field.size() + 1;
+
+  size_t start = buffer.size();
+  buffer.append(headerSize, '\0');
+  for (const auto& field : record)
+  {
+    buffer += field;
+    buffer += '\0';
+  }
+  
+  uint32_t checksum = Checksum(buffer.data() + start + headerSize, length);
+  memcpy(&buffer[start], &length, sizeof(length));
+  memcpy(&buffer[start + sizeof(length)], &checksum, sizeof(checksum));
+}
+
+util::Error RecordLog::Write(const std::string& buffer)
+{
+  if (fd < 0) return util::Error::Failure(EBADF);
+  
+  // a failed write is cut back off so later records aren't appended
+  // after a torn one
+  off_t offset = lseek(fd, 0, SEEK_END);
+  if (offset < 0) return util::Error::Failure(errno);
+  
+  util::Error e = WriteAll(fd, buffer);
+  if (!e)
+  {
+    while (ftruncate(fd, offset) < 0 && errno == EINTR);
+  }
+  return e;
+}
+
+util::Error RecordLog::Open(const std::function<void(const Record&)>& replay)
+{
+  fd = open(path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0600);
+  if (fd < 0) return util::Error::Failure(errno);
+
+  // closed again unless it's opened successfully
+  bool opened = false;
+  std::shared_ptr<void> fdGuard(nullptr, [this, &opened](void*)
+    {
+      if (opened) return;
+      close(fd);
+      fd = -1;
+    });
+  
+  struct stat st;
+  if (fstat(fd, &st) < 0) return util::Error::Failure(errno);
+  if (st.st_size == 0)
+  {
+    opened = true;
+    return util::Error::Success();
+  }
+
+  void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (map == MAP_FAILED) return util::Error::Failure(errno);
+  size_t mapSize = st.st_size;
+  std::shared_ptr<void> mapGuard(map, [mapSize](void* map) { munmap(map, mapSize); });
+  const char* data = static_cast<const char*>(map);
+
+  // replay stops at the first record that's short or fails its checksum,
+  // it and anything after it are the remains of a torn write
+  off_t pos = 0;
+  Record record;
+  while (pos + static_cast<off_t>(headerSize) <= st.st_size)
+  {
+    uint32_t length;
+    uint32_t checksum;
+    memcpy(&length, data + pos, sizeof(length));
+    memcpy(&checksum, data + pos + sizeof(length), sizeof(checksum));
+    if (pos + static_cast<off_t>(headerSize + length) > st.st_size) break;
+
+    const char* begin = data + pos + headerSize;
+    const char* end = begin + length;
+    if (Checksum(begin, length) != checksum) break;
+    
+    record.clear();
+    while (begin < end)
+    {
+      const char* nul = static_cast<const char*>(memchr(begin, '\0', end - begin));
+      if (!nul) nul = end;
+      record.emplace_back(begin, nul);
+      begin = nul + 1;
+    }
+
+    try
+    {
+      replay(record);
+    }
+    catch (const std::exception&)
+    {
+      // dropped for good at the next compaction
+      ++malformed;
+    }
+
+    ++count;
+    pos += headerSize + length;
+  }
+
+  if (pos != st.st_size && ftruncate(fd, pos) < 0)
+    return util::Error::Failure(errno);
+
+  opened = true;
+  return util::Error::Success();
+}
+
+util::Error RecordLog::Append(const Record& record)
+{
+  std::string buffer;
+  Encode(record, buffer);
+  util::Error e = Write(buffer);
+  if (e) ++count;
+  return e;
+}
+
+util::Error RecordLog::Append(const std::vector<Record>& records)
+{
+  std::string buffer;
+  for (const auto& record : records)
+  {
+    Encode(record, buffer);
+  }
+  
+  util::Error e = Write(buffer);
+  if (e) count += records.size();
+  return e;
+}
+
+util::Error RecordLog::Rewrite(const std::vector<Record>& records)
+{
+  std::string tmpPath = path + ".tmp";
+  int tmpFd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0600);
+  if (tmpFd < 0) return util::Error::Failure(errno);
+
+  std::string buffer;
+  for (const auto& record : records)
+  {
+    Encode(record, buffer);
+  }
+
+  util::Error e = WriteAll(tmpFd, buffer);
+  if (e && fsync(tmpFd) < 0) e = util::Error::Failure(errno);
+  if (e && rename(tmpPath.c_str(), path.c_str()) < 0) e = util::Error::Failure(errno);
+
+  if (!e)
+  {
+    close(tmpFd);
+    unlink(tmpPath.c_str());
+    return e;
+  }
+
+  if (fd >= 0) close(fd);
+  fd = tmpFd;
+  count = records.size();
+  return e;
+}
+
+} /* db namespace */
@@ -0,0 +1,44 @@
+#ifndef __DB_RECORDLOG_HPP
+#define __DB_RECORDLOG_HPP
+
+#include <functional>
+#include <string>
+#include <vector>
+#include "util/error.hpp"
+
+namespace db
+{
+
+// append-only file of length and checksum prefixed records, each record
+// being a list of nul separated fields, a torn record at the tail is
+// discarded. records the replay function throws on are skipped and counted
+// as malformed
+class RecordLog
+{
+  std::string path;
+  int fd;
+  unsigned long long count;
+  unsigned long long malformed;
+
+  static void Encode(const std::vector<std::string>& record, std::string& buffer);
+  util::Error Write(const std::string& buffer);
+
+public:
+  typedef std::vector<std::string> Record;
+
+  RecordLog(const std::string& path) : path(path), fd(-1), count(0), malformed(0) { }
+  ~RecordLog();
+
+  util::Error Open(const std::function<void(const Record&)>& replay);
+  util::Error Append(const Record& record);
+  util::Error Append(const std::vector<Record>& records);
+  util::Error Rewrite(const std::vector<Record>& records);
+
+  unsigned long long Count() const { return count; }
+  unsigned long long Malformed() const { return malformed; }
+  const std::string& Path() const { return path; }
+};
+
+} /* db namespace */
+
+#endif
@@ -1,12 +1,9 @@
 #ifndef __DB_REPLICABLE_HPP
 #define __DB_REPLICABLE_HPP
 
+#include <cstdint>
 #include <string>
-
-namespace mongo
-{
-class BSONElement;
-}
+#include <vector>
 
 namespace db
 {
@@ -33,7 +30,7 @@ public:
   
   virtual ~Replicable() { }
 
-  virtual bool Replicate(const mongo::BSONElement& id) = 0;
+  virtual bool Replicate(const std::vector<int32_t>& ids) = 0;
   virtual bool Populate() = 0;
   
   const std::string& Collection() const { return collection; }
@@ -1,6 +1,8 @@
 #include <mongo/client/dbclient.h>
 #include <boost/optional.hpp>
+#include <algorithm>
 #include <list>
+#include <map>
 #include <csignal>
 #include "db/replicator.hpp"
 #include "logs/logs.hpp"
@@ -45,8 +47,11 @@ public:
     InitialiseLastOID();
   }
   
-  mongo::BSONObj Next()
+  // blocks until at least one entry is available, then drains whatever
+  // else the server has already sent so bursts are replicated together
+  void NextBatch(std::vector<mongo::BSONObj>& entries)
   {
+    entries.clear();
     while (true)
     {
       if (!cursor.get())
@@ -84,9 +89,14 @@ public:
           }
         }
         
-        auto entry = cursor->next();
-        SetLastOID(entry);
-        return entry;
+        do
+        {
+          auto entry = cursor->next();
+          SetLastOID(entry);
+          entries.emplace_back(entry.getOwned());
+        }
+        while (cursor->moreInCurrentBatch());
+        return;
       }
     }
   }
@@ -108,21 +118,39 @@ void Replicator::LogFailed(const std::list<std::shared_ptr<Replicable>>& failed)
   logs::Database(os.str());
 }
 
-void Replicator::Replicate(const mongo::BSONObj& entry)
+void Replicator::Replicate(const std::vector<mongo::BSONObj>& entries)
 {
-  try
+  std::map<std::string, std::vector<int32_t>> changed;
+  for (const auto& entry : entries)
   {
-    std::string collection = entry["collection"].String();
-    auto id = entry["id"];
-    for (auto& cache : caches)
+    try
     {
-      if (cache->Collection() == collection)
-        cache->Replicate(id);
+      auto id = entry["id"];
+      if (id.type() != mongo::NumberInt) continue;
+      changed[entry["collection"].String()].emplace_back(id.Int());
+    }
+    catch (const mongo::DBException& e)
+    {
+      LogException("Replicate unserialize", e, entry);
     }
   }
-  catch (const mongo::DBException& e)
+  
+  Replicate(changed);
+}
+
+void Replicator::Replicate(std::map<std::string, std::vector<int32_t>>& changed)
+{
+  for (auto& kv : changed)
   {
-    LogException("Replicate unserialize", e, entry);
+    auto& ids = kv.second;
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    
+    for (auto& cache : caches)
+    {
+      if (cache->Collection() == kv.first)
+        cache->Replicate(ids);
+    }
   }
 }
 
@@ -138,9 +166,42 @@ void Replicator::Populate()
   }
 }
 
+void Replicator::Queue(const std::string& collection, int32_t id)
+{
+  boost::lock_guard<boost::mutex> lock(queueMutex);
+  queued[collection].emplace_back(id);
+  queueCond.notify_one();
+}
+
+// embedded storage has no update log to tail, this process
+// is the only one making changes and queues them itself
+void Replicator::RunLocal()
+{
+  Populate();
+  
+  std::map<std::string, std::vector<int32_t>> changed;
+  while (true)
+  {
+    {
+      boost::unique_lock<boost::mutex> lock(queueMutex);
+      while (queued.empty()) queueCond.wait(lock);
+      changed.swap(queued);
+    }
+    
+    Replicate(changed);
+    changed.clear();
+  }
+}
+
 void Replicator::Run()
 {
   util::SetProcessTitle("DB REPLICATOR");
+  if (cfg::Get().DatabaseBackend() == cfg::DatabaseBackend::Embedded)
+  {
+    RunLocal();
+    return;
+  }
+  
   mongo::DBClientConnection conn;
   while (true)
   {
@@ -170,10 +231,11 @@ void Replicator::Run()
     try
     {
       Tail tail(dbConfig.Name() + ".updatelog", conn);
+      std::vector<mongo::BSONObj> entries;
       while (true)
       {
-        auto entry = tail.Next();
-        Replicate(entry);
+        tail.NextBatch(entries);
+        Replicate(entries);
       }
     }
     catch (const mongo::DBException& e)
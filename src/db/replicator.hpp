@@ -5,7 +5,14 @@
 #include <future>
 #include <memory>
 #include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <cstdint>
+#include <list>
+#include <map>
 #include <mutex>
+#include <string>
+#include <vector>
 #include "db/replicable.hpp"
 
 namespace mongo
@@ -20,6 +27,10 @@ class Replicator
 {
   boost::thread thread;
   std::vector<std::shared_ptr<Replicable>> caches;
+  
+  boost::mutex queueMutex;
+  boost::condition_variable queueCond;
+  std::map<std::string, std::vector<int32_t>> queued;
 
   static std::unique_ptr<Replicator> instance;
   static const int maximumRetries = 20;
@@ -27,14 +38,19 @@ class Replicator
   Replicator() = default;
   
   void Run();  
+  void RunLocal();
   void LogFailed(const std::list<std::shared_ptr<Replicable>>& failed);
-  void Replicate(const mongo::BSONObj& entry);
+  void Replicate(const std::vector<mongo::BSONObj>& entries);
+  void Replicate(std::map<std::string, std::vector<int32_t>>& changed);
   void Populate();
   
 public:
   void Start();
   void Stop();
   
+  // changes made by this process when there's no shared update log
+  void Queue(const std::string& collection, int32_t id);
+  
   bool Register(const std::shared_ptr<Replicable>& cache);
 
   static Replicator& Get()
@@ -1,44 +1,19 @@
 #include <mongo/client/dbclient.h>
 #include "db/stats/serialization.hpp"
-#include "stats/date.hpp"
+#include "db/storage.hpp"
 #include "stats/stat.hpp"
-#include "cfg/get.hpp"
-#include "util/verify.hpp"
-#include "stats/types.hpp"
 #include "db/error.hpp"
 
 namespace db { namespace stats
 {
 
-mongo::BSONObj Serialize(::stats::Timeframe timeframe)
+mongo::BSONObj Serialize(const DateMatch& date)
 {
-  ::stats::Date date(cfg::Get().WeekStart() == cfg::WeekStart::Monday);
   mongo::BSONObjBuilder bob;
-  
-  switch (timeframe)
-  {
-    case ::stats::Timeframe::Alltime :
-      break;
-    case ::stats::Timeframe::Year    :
-      bob.append("year", date.Year());
-      break;
-    case ::stats::Timeframe::Month   :
-      bob.append("year", date.Year());
-      bob.append("month", date.Month());
-      break;
-    case ::stats::Timeframe::Week    :
-      bob.append("year", date.Year());
-      bob.append("week", date.Week());
-      break;
-    case ::stats::Timeframe::Day     :
-      bob.append("year", date.Year());
-      bob.append("month", date.Month());
-      bob.append("day", date.Day());
-      break;
-    default                          :
-      verify(false);
-  }
-
+  if (date.year) bob.append("year", *date.year);
+  if (date.month) bob.append("month", *date.month);
+  if (date.week) bob.append("week", *date.week);
+  if (date.day) bob.append("day", *date.day);
   return bob.obj();
 }
 
@@ -46,7 +21,7 @@ mongo::BSONObj Serialize(::stats::Timeframe timeframe)
 {
   try
   {
-    return ::stats::Stat(obj["_id"].Int(),
+    return ::stats::Stat(obj["_id"].isNumber() ? obj["_id"].Int() : -1,
                          obj["total files"].Int(),
                          obj["total kbytes"].Long(),
                          obj["total xfertime"].Long());
@@ -59,4 +34,4 @@ mongo::BSONObj Serialize(::stats::Timeframe timeframe)
 }
 
 } /* stats namespace */
-} /* db namespace */
\ No newline at end of file
+} /* db namespace */
@@ -8,14 +8,18 @@ class BSONObj;
 
 namespace stats
 {
-enum class Timeframe : unsigned;
 class Stat;
 }
 
-namespace db { namespace stats
+namespace db 
 {
 
-mongo::BSONObj Serialize(::stats::Timeframe timeframe);
+struct DateMatch;
+
+namespace stats
+{
+
+mongo::BSONObj Serialize(const DateMatch& date);
 ::stats::Stat Unserialize(const mongo::BSONObj& obj);
 
 } /* stats namespace */
@@ -1,18 +1,17 @@
 #include <algorithm>
 #include <functional>
 #include <cmath>
-#include <mongo/client/dbclient.h>
+#include <unordered_map>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include "db/stats/stats.hpp"
 #include "acl/user.hpp"
 #include "stats/date.hpp"
 #include "cfg/get.hpp"
 #include "util/time.hpp"
-#include "db/stats/serialization.hpp"
 #include "logs/logs.hpp"
 #include "stats/stat.hpp"
-#include "db/connection.hpp"
-#include "db/serialization.hpp"
+#include "db/storage.hpp"
+#include "util/verify.hpp"
 
 namespace db { namespace stats
 {
@@ -29,22 +28,8 @@ void Update(const acl::User& user, long long kBytes, long long xfertime,
   }
 
   ::stats::Date date(cfg::Get().WeekStart() == cfg::WeekStart::Monday);
-  mongo::BSONObjBuilder query;
-  query.append("uid", user.ID());
-  query.append("day", date.Day());
-  query.append("week", date.Week());
-  query.append("month", date.Month());
-  query.append("year", date.Year());
-  query.append("direction", util::EnumToString(direction));
-  query.append("section", section);
-
-  mongo::BSONObj update = BSON(
-    "$inc" << BSON("files" << files) <<
-    "$inc" << BSON("kbytes" << kBytes) <<
-    "$inc" << BSON("xfertime" << xfertime));
-  
-  FastConnection conn;
-  conn.Update("transfers", query.obj(), update, true);
+  GetStorage().TransferUpdate(TransferKey(user.ID(), date, direction, section), 
+                              files, kBytes, xfertime);
 }
 
 void UploadDecr(const acl::User& user, long long kBytes, time_t modTime, const std::string& section)
@@ -52,38 +37,21 @@ void UploadDecr(const acl::User& user, long long kBytes, time_t modTime, const s
   long long xfertime = -1;
   util::Time t(modTime);
 
-  auto cmd = BSON("aggregate" << "transfers" << "pipeline" << 
-    BSON_ARRAY(
-        BSON("$match" << 
-          BSON("year" << t.Year() << "month" << t.Month()  <<
-               "week" << t.Week() << "day" << t.Day())) <<
-        BSON("$group" << 
-          BSON("_id" << user.ID() << 
-            "total kbytes" << BSON("$sum" << "$kbytes") <<
-            "total xfertime" << BSON("$sum" << "$xfertime")
-      ))));
-
-  NoErrorConnection conn;
-  mongo::BSONObj result;
-  if (conn.RunCommand(cmd, result))
+  TransferQuery query;
+  query.date.year = t.Year();
+  query.date.month = t.Month();
+  query.date.week = t.Week();
+  query.date.day = t.Day();
+  query.groupByUser = false;
+  
+  auto totals = GetStorage().TransferTotals(query);
+  if (!totals.empty())
   {
-    auto elems = result["result"].Array();
-    if (!elems.empty())
-    {
-      try
-      {
-        long long totalXfertime = elems[0]["total xfertime"].Long();
-        if (totalXfertime > 0)
-          xfertime = std::ceil(static_cast<double>(totalXfertime) / elems[0]["total kbytes"].Long() * kBytes);
-        else
-          xfertime = 0;
-      }
-      catch (const mongo::DBException& e)
-      {
-        LogException("Unserialize upload decr avg speed", e, result);
-      }
-    }
-
+    long long totalXfertime = totals.front().Xfertime();
+    if (totalXfertime > 0)
+      xfertime = std::ceil(static_cast<double>(totalXfertime) / totals.front().KBytes() * kBytes);
+    else
+      xfertime = 0;
   }
 
   if (xfertime < 0)
@@ -110,6 +78,32 @@ void Download(const acl::User& user, long long kBytes, long long xfertime, const
   Update(user, kBytes, xfertime, section, ::stats::Direction::Download, false);
 }
 
+std::function<bool(const ::stats::Stat& s1, const ::stats::Stat& s2)> 
+SortCompare(::stats::SortField sortField)
+{
+  switch (sortField)
+  {
+    case ::stats::SortField::Files  :
+      return [](const ::stats::Stat& s1, const ::stats::Stat& s2)
+             {
+               return s1.Files() > s2.Files();
+             };
+    case ::stats::SortField::KBytes  :
+      return [](const ::stats::Stat& s1, const ::stats::Stat& s2)
+             {
+               return s1.KBytes() > s2.KBytes();
+             };
+    case ::stats::SortField::Speed  :
+      return [](const ::stats::Stat& s1, const ::stats::Stat& s2)
+             {
+               return s1.Speed() > s2.Speed();
+             };
+  }
+  
+  verify(false);
+  return nullptr;
+}
+
 std::vector< ::stats::Stat> RetrieveUsers(
       const std::string& section, 
       ::stats::Timeframe timeframe, 
@@ -117,59 +111,24 @@ std::vector< ::stats::Stat> RetrieveUsers(
       boost::optional< ::stats::SortField> sortField = boost::none, 
       boost::optional<acl::UserID> uid = boost::none)
 {
-  static const char* sortFields[] =
-  {
-    "total kbytes",
-    "total files",
-    "avg speed"
-  };
-
-  mongo::BSONObjBuilder match;
-  match.append("direction", util::EnumToString(direction));
-  match.appendElements(Serialize(timeframe));
+  TransferQuery query;
+  query.direction = direction;
+  query.date = DateMatch(timeframe);
+  query.sectionFilter = TransferQuery::SectionFilter::Include;
   
   if (!section.empty())
-    match.append("section", section);
+    query.sections.emplace_back(section);
   else
   {
-    mongo::BSONArrayBuilder sections;
     for (const auto& kv : cfg::Get().Sections())
-      sections.append(kv.first);
-    match.appendElements(BSON("section" << BSON("$in" << sections.arr())));
+      query.sections.emplace_back(kv.first);
   }
   
-  if (uid) match.append("uid", *uid);
-  
-  mongo::BSONArrayBuilder ops;
-  ops.append(BSON("$match" << match.obj()));
-  ops.append(BSON("$group" << BSON("_id" << "$uid" <<
-             "total kbytes" << BSON("$sum" << "$kbytes") <<
-             "total files" << BSON("$sum" << "$files") <<
-             "total xfertime" << BSON("$sum" << "$xfertime"))));
-  
-  ops.append(BSON("$project" << BSON("total kbytes" << 1 <<
-             "total files" << 1 <<
-             "total xfertime" << 1 <<
-             "avg speed" << BSON("$divide" << 
-             BSON_ARRAY("$total kbytes" << "$total xfertime")))));
-           
-  if (sortField)
-  {
-    ops.append(BSON("$sort" << BSON(sortFields[static_cast<unsigned>(*sortField)] << -1)));
-  }
-
-  auto cmd = BSON("aggregate" << "transfers" << "pipeline" << ops.arr());
+  query.uid = uid;
 
-  std::vector< ::stats::Stat> users;
-  mongo::BSONObj result;
-  NoErrorConnection conn;
-  if (conn.RunCommand(cmd, result))
-  {
-    for (const auto& elem : result["result"].Array())
-    {
-      users.emplace_back(Unserialize(elem.Obj()));
-    }
-  }
+  auto users = GetStorage().TransferTotals(query);
+  if (sortField)
+    std::stable_sort(users.begin(), users.end(), SortCompare(*sortField));
   
   return users;
 }
@@ -198,30 +157,7 @@ std::vector< ::stats::Stat> RetrieveGroups(
   
   if (sortField)
   {
-    std::function<bool(const ::stats::Stat& s1, const ::stats::Stat& s2)> sortCompare;
-    
-    switch (*sortField)
-    {
-      case ::stats::SortField::Files  :
-        sortCompare = [&](const ::stats::Stat& s1, const ::stats::Stat& s2)
-                      {
-                        return s1.Files() > s2.Files();
-                      };
-        break;
-      case ::stats::SortField::KBytes  :
-        sortCompare = [&](const ::stats::Stat& s1, const ::stats::Stat& s2)
-                      {
-                        return s1.KBytes() > s2.KBytes();
-                      };
-        break;
-      case ::stats::SortField::Speed  :
-        sortCompare = [&](const ::stats::Stat& s1, const ::stats::Stat& s2)
-                      {
-                        return s1.Speed() > s2.Speed();
-                      };
-        break;
-    }
-    
+    auto sortCompare = SortCompare(*sortField);
     for (const auto& kv : stats)
     {
       auto pos = std::lower_bound(groups.begin(), groups.end(), kv.second, sortCompare);
@@ -1,10 +1,8 @@
 #include "db/stats/transfers.hpp"
-#include "db/error.hpp"
-#include "db/stats/serialization.hpp"
 #include "cfg/get.hpp"
 #include "stats/types.hpp"
 #include "db/stats/traffic.hpp"
-#include "db/connection.hpp"
+#include "db/storage.hpp"
 
 namespace db { namespace stats
 {
@@ -12,46 +10,26 @@ namespace db { namespace stats
 long long TransfersUser(acl::UserID uid, ::stats::Timeframe timeframe, 
       const std::string& section, ::stats::Direction direction)
 {
-  mongo::BSONObjBuilder match;
-  match.append("direction", util::EnumToString(direction));
+  TransferQuery query;
+  query.date = DateMatch(timeframe);
+  query.direction = direction;
   if (!section.empty())
-    match.append("section", section);
+  {
+    query.sectionFilter = TransferQuery::SectionFilter::Include;
+    query.sections.emplace_back(section);
+  }
   else
   {
-    mongo::BSONArrayBuilder sections;
+    query.sectionFilter = TransferQuery::SectionFilter::Exclude;
     for (const auto& kv : cfg::Get().Sections())
-      sections.append(kv.first);
-    match.appendElements(BSON("section" << BSON("$nin" << sections.arr())));
+      query.sections.emplace_back(kv.first);
   }
-  match.appendElements(Serialize(timeframe));
-  
-  mongo::BSONObj cmd = BSON("aggregate" << "transfers" << "pipeline" <<
-    BSON_ARRAY(
-      BSON("$match" << match.obj()) <<
-      BSON("$group" << 
-        BSON("_id" << (uid == -1 ? "" : "$uid") <<
-          "total" << BSON("$sum" << "$kbytes")
-        ))));
   
+  if (uid != -1) query.uid = uid;
+  query.groupByUser = false;
   
-  mongo::BSONObj result;
-  NoErrorConnection conn;
-  if (conn.RunCommand(cmd, result))
-  {
-    try
-    {
-      auto elems = result["result"].Array();
-      if (!elems.empty())
-      {
-        return elems[0]["total"].Long();
-      }
-    }
-    catch (const mongo::DBException& e)
-    {
-      LogException("Unserialize transfers total", e, result);
-    }
-  }
-  
+  auto totals = GetStorage().TransferTotals(query);
+  if (!totals.empty()) return totals.front().KBytes();
   return 0;
 }
 
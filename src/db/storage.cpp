@@ -0,0 +1,90 @@
+#include <memory>
+#include <algorithm>
+#include "db/storage.hpp"
+#include "db/mongostorage.hpp"
+#include "db/embeddedstorage.hpp"
+#include "stats/date.hpp"
+#include "cfg/get.hpp"
+#include "util/verify.hpp"
+#include "logs/logs.hpp"
+
+namespace db
+{
+
+namespace
+{
+std::unique_ptr<Storage> storage;
+}
+
+DateMatch::DateMatch(::stats::Timeframe timeframe)
+{
+  ::stats::Date date(cfg::Get().WeekStart() == cfg::WeekStart::Monday);
+
+  switch (timeframe)
+  {
+    case ::stats::Timeframe::Alltime :
+      break;
+    case ::stats::Timeframe::Year    :
+      year = date.Year();
+      break;
+    case ::stats::Timeframe::Month   :
+      year = date.Year();
+      month = date.Month();
+      break;
+    case ::stats::Timeframe::Week    :
+      year = date.Year();
+      week = date.Week();
+      break;
+    case ::stats::Timeframe::Day     :
+      year = date.Year();
+      month = date.Month();
+      day = date.Day();
+      break;
+    default                          :
+      verify(false);
+  }
+}
+
+bool DateMatch::Matches(int year, int month, int week, int day) const
+{
+  return (!this->year || *this->year == year) &&
+         (!this->month || *this->month == month) &&
+         (!this->week || *this->week == week) &&
+         (!this->day || *this->day == day);
+}
+
+TransferKey::TransferKey(acl::UserID uid, const ::stats::Date& date,
+      ::stats::Direction direction, const std::string& section) :
+  uid(uid), day(date.Day()), week(date.Week()),
+  month(date.Month()), year(date.Year()),
+  direction(direction), section(section)
+{
+}
+
+bool TransferQuery::SectionMatches(const std::string& section) const
+{
+  if (sectionFilter == SectionFilter::Any) return true;
+  bool found = std::find(sections.begin(), sections.end(), section) != sections.end();
+  return found == (sectionFilter == SectionFilter::Include);
+}
+
+bool InitialiseStorage()
+{
+  if (cfg::Get().DatabaseBackend() == cfg::DatabaseBackend::Embedded)
+  {
+    logs::Debug("Using embedded storage backend..");
+    storage.reset(new EmbeddedStorage(cfg::Get().Datapath() + "/db"));
+  }
+  else
+    storage.reset(new MongoStorage());
+
+  return storage->Initialise();
+}
+
+Storage& GetStorage()
+{
+  verify(storage);
+  return *storage;
+}
+
+} /* db namespace */
@@ -0,0 +1,149 @@
+#ifndef __DB_STORAGE_HPP
+#define __DB_STORAGE_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <boost/optional.hpp>
+#include "acl/types.hpp"
+#include "acl/userdata.hpp"
+#include "acl/groupdata.hpp"
+#include "db/mail/message.hpp"
+#include "db/dupe/dupe.hpp"
+#include "db/index/index.hpp"
+#include "db/stats/traffic.hpp"
+#include "stats/stat.hpp"
+#include "stats/types.hpp"
+
+namespace stats
+{
+class Date;
+}
+
+namespace db
+{
+
+struct DateMatch
+{
+  boost::optional<int> year;
+  boost::optional<int> month;
+  boost::optional<int> week;
+  boost::optional<int> day;
+
+  DateMatch() { }
+  DateMatch(::stats::Timeframe timeframe);
+
+  bool Matches(int year, int month, int week, int day) const;
+};
+
+struct TransferKey
+{
+  acl::UserID uid;
+  int day;
+  int week;
+  int month;
+  int year;
+  ::stats::Direction direction;
+  std::string section;
+
+  TransferKey(acl::UserID uid, const ::stats::Date& date,
+        ::stats::Direction direction, const std::string& section);
+};
+
+struct TransferQuery
+{
+  enum class SectionFilter { Any, Include, Exclude };
+
+  DateMatch date;
+  boost::optional< ::stats::Direction> direction;
+  boost::optional<acl::UserID> uid;
+  SectionFilter sectionFilter;
+  std::vector<std::string> sections;
+  bool groupByUser;
+
+  TransferQuery() : sectionFilter(SectionFilter::Any), groupByUser(true) { }
+
+  bool SectionMatches(const std::string& section) const;
+};
+
+class Storage
+{
+public:
+  virtual ~Storage() { }
+
+  virtual bool Initialise() = 0;
+
+  virtual void DupeAdd(const std::string& directory, const std::string& section) = 0;
+  virtual std::vector<dupe::DupeResult> DupeSearch(
+        const std::vector<std::string>& terms, int limit) = 0;
+  virtual std::vector<dupe::DupeResult> DupeSince(
+        const boost::posix_time::ptime& since) = 0;
+
+  virtual void IndexAdd(const std::string& path, const std::string& section) = 0;
+  virtual void IndexDelete(const std::string& path) = 0;
+  virtual void IndexDelete(const std::vector<std::string>& paths) = 0;
+  virtual std::vector<index::SearchResult> IndexSearch(
+        const std::vector<std::string>& terms, int limit) = 0;
+
+  virtual void TransferUpdate(const TransferKey& key, int files,
+        long long kBytes, long long xfertime) = 0;
+  virtual std::vector< ::stats::Stat> TransferTotals(const TransferQuery& query) = 0;
+
+  virtual void ProtocolUpdate(acl::UserID uid, const ::stats::Date& date,
+        long long sendKBytes, long long receiveKBytes) = 0;
+  virtual stats::Traffic ProtocolTotal(const boost::optional<acl::UserID>& uid,
+        const DateMatch& date) = 0;
+
+  // ids are assigned on create, -1 if the name is taken or the insert
+  // failed. saves only write the fields named, false if that failed
+  virtual acl::UserID UserCreate(const acl::UserData& user) = 0;
+  virtual bool UserSave(const acl::UserData& user, const std::vector<std::string>& fields) = 0;
+  virtual void UserPurge(acl::UserID uid) = 0;
+  virtual boost::optional<acl::UserData> UserLoad(acl::UserID uid) = 0;
+  virtual boost::optional<acl::UserData> UserLoad(const std::string& name) = 0;
+  // users that exist but can't be read are left out and added to
+  // unreadable, -1 if not even their uid could be read. throws DBError
+  virtual std::vector<acl::UserData> UserLoad(const std::vector<acl::UserID>& uids,
+        std::vector<acl::UserID>& unreadable) = 0;
+  virtual std::vector<acl::UserData> UserList(const std::string& multiStr) = 0;
+  virtual std::vector<acl::UserID> UserIDs(const std::string& multiStr) = 0;
+  // every user's masks when uid is -1
+  virtual std::vector<std::string> UserIPMasks(acl::UserID uid) = 0;
+  virtual void UserIncrCredits(acl::UserID uid, const std::string& section, long long kBytes) = 0;
+  virtual bool UserDecrCredits(acl::UserID uid, const std::string& section,
+        long long kBytes, bool force) = 0;
+
+  virtual acl::GroupID GroupCreate(const acl::GroupData& group) = 0;
+  virtual bool GroupSave(const acl::GroupData& group, const std::vector<std::string>& fields) = 0;
+  virtual void GroupPurge(acl::GroupID gid) = 0;
+  virtual boost::optional<acl::GroupData> GroupLoad(acl::GroupID gid) = 0;
+  virtual boost::optional<acl::GroupData> GroupLoad(const std::string& name) = 0;
+  virtual std::vector<acl::GroupData> GroupLoad(const std::vector<acl::GroupID>& gids,
+        std::vector<acl::GroupID>& unreadable) = 0;
+  virtual std::vector<acl::GroupData> GroupList(const std::string& multiStr) = 0;
+  virtual std::vector<acl::GroupID> GroupIDs(const std::string& multiStr) = 0;
+  virtual int GroupSlotsUsed(acl::GroupID gid) = 0;
+  virtual int GroupMembers(acl::GroupID gid) = 0;
+  virtual int GroupLeeches(acl::GroupID gid) = 0;
+  virtual int GroupAllotments(acl::GroupID gid) = 0;
+  virtual long long GroupAllotmentTotal(acl::GroupID gid) = 0;
+
+  // tells the caches of every process using the storage that a
+  // user or group changed, collection is users or groups
+  virtual void UpdateLog(const std::string& collection, int32_t id) = 0;
+
+  virtual void MailSend(const mail::Message& message) = 0;
+  virtual std::vector<mail::Message> MailGet(acl::UserID recipient) = 0;
+  virtual bool MailSave(acl::UserID recipient, int index) = 0;
+  virtual int MailSaveTrash(acl::UserID recipient) = 0;
+  virtual bool MailPurge(acl::UserID recipient, int index) = 0;
+  virtual int MailPurgeTrash(acl::UserID recipient) = 0;
+  virtual void MailTrash(const mail::Message& message) = 0;
+};
+
+bool InitialiseStorage();
+Storage& GetStorage();
+
+} /* db namespace */
+
+#endif
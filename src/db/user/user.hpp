@@ -7,11 +7,6 @@
 #include <boost/optional.hpp>
 #include "acl/types.hpp"
 
-namespace mongo
-{
-class BSONObj;
-}
-
 namespace acl
 {
 struct UserData;
@@ -28,6 +23,7 @@ class User
   acl::UserData& user;
 
   void UpdateLog() const;
+  void SaveFields(const std::vector<std::string>& fields, bool updateLog = true) const;
   void SaveField(const std::string& field, bool updateLog = true) const;
   
 public:
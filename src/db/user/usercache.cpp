@@ -1,9 +1,11 @@
+#include <algorithm>
+#include <unordered_set>
 #include "db/user/usercache.hpp"
-#include "db/connection.hpp"
+#include "db/storage.hpp"
+#include "db/error.hpp"
 #include "util/string.hpp"
 #include "db/user/user.hpp"
 #include "acl/userdata.hpp"
-#include "db/user/serialization.hpp"
 #include "db/user/util.hpp"
 
 namespace db
@@ -51,68 +53,55 @@ bool UserCache::IdentIPAllowed(const std::string& identAddress, acl::UserID uid)
   return util::WildcardMatch(it->second, identAddress, true);
 }
 
-bool UserCache::Replicate(const mongo::BSONElement& id)
+bool UserCache::Replicate(const std::vector<acl::UserID>& changed)
 {
-  if (id.type() != 16) return true;
-  acl::UserID uid = id.Int();
-
-  updatedCallback(uid);
+  updatedCallback(changed);
   
   try
   {
-    SafeConnection conn;  
-    auto fields = BSON("uid" << 1 << "name" << 1 << "primary gid" << 1);
-    auto data = conn.QueryOne<UserTriple>("users", QUERY("uid" << uid), &fields);
-    if (data)
+    std::vector<acl::UserID> unreadable;
+    auto results = GetStorage().UserLoad(changed, unreadable);
+    
+    std::unordered_set<acl::UserID> missing(changed.begin(), changed.end());
+    
+    // keep the cached copy of users that can't be read, we can't tell
+    // they were deleted, nor any others if we don't know which they are
+    bool evict = std::find(unreadable.begin(), unreadable.end(), -1) == unreadable.end();
+    for (acl::UserID uid : unreadable) missing.erase(uid);
+    
+    std::lock(namesMutex, uidsMutex, primaryGidsMutex, ipMasksMutex);
+    std::lock_guard<std::mutex> namesLock(namesMutex, std::adopt_lock);
+    std::lock_guard<std::mutex> uidsLock(uidsMutex, std::adopt_lock);
+    std::lock_guard<std::mutex> primaryGidsLock(primaryGidsMutex, std::adopt_lock);
+    std::lock_guard<std::mutex> ipMasksLock(ipMasksMutex, std::adopt_lock);
+    
+    for (auto& data : results)
     {
       // user found, refresh cached data
-      {
-        std::lock_guard<std::mutex> lock(uidsMutex);
-        uids[data->name] = data->uid;
-      }
-      
-      {
-        std::lock_guard<std::mutex> lock(namesMutex);
-        names[data->uid] = data->name;
-      }
-      
-      {
-        std::lock_guard<std::mutex> lock(primaryGidsMutex);
-        primaryGids[data->uid] = data->primaryGid;
-      }
+      missing.erase(data.id);
       
-      auto masks = LookupIPMasks(conn, uid);
+      auto it = names.find(data.id);
+      if (it != names.end() && it->second != data.name) uids.erase(it->second);
       
-      {
-        std::lock_guard<std::mutex> lock(ipMasksMutex);
-        ipMasks[data->uid] = std::move(masks);
-      }
+      uids[data.name] = data.id;
+      names[data.id] = data.name;
+      primaryGids[data.id] = data.primaryGid;
+      ipMasks[data.id] = std::move(data.ipMasks);
     }
-    else
+    
+    // users not found, must be deleted, remove from cache
+    if (!evict) missing.clear();
+    for (acl::UserID uid : missing)
     {
-      // user not found, must be deleted, remove from cache
-      {
-        std::lock(uidsMutex, namesMutex);
-        std::lock_guard<std::mutex> uidsLock(uidsMutex, std::adopt_lock);
-        std::lock_guard<std::mutex> namesLock(namesMutex, std::adopt_lock);
-        
-        auto it = names.find(uid);
-        if (it != names.end())
-        {
-          uids.erase(it->second);
-          names.erase(it);
-        }
-      }
-      
+      auto it = names.find(uid);
+      if (it != names.end())
       {
-        std::lock_guard<std::mutex> lock(primaryGidsMutex);
-        primaryGids.erase(uid);
+        uids.erase(it->second);
+        names.erase(it);
       }
       
-      {
-        std::lock_guard<std::mutex> lock(ipMasksMutex);
-        ipMasks.erase(uid);
-      }
+      primaryGids.erase(uid);
+      ipMasks.erase(uid);
     }
   }
   catch (const DBError&)
@@ -10,11 +10,6 @@
 #include "db/replicable.hpp"
 #include "db/user/usercachebase.hpp"
 
-namespace mongo
-{
-class BSONElement;
-}
-
 namespace db
 {
 
@@ -34,10 +29,10 @@ class UserCache :
   std::mutex ipMasksMutex;
   std::unordered_map<acl::UserID, std::vector<std::string>> ipMasks;
   
-  std::function<void(acl::UserID)> updatedCallback;
+  std::function<void(const std::vector<acl::UserID>&)> updatedCallback;
   
 public:  
-  UserCache(const std::function<void(acl::UserID)>& updatedCallback) : 
+  UserCache(const std::function<void(const std::vector<acl::UserID>&)>& updatedCallback) : 
     Replicable("users"),
     updatedCallback(updatedCallback)
   { }
@@ -48,7 +43,7 @@ public:
   bool IdentIPAllowed(const std::string& identAddress);
   bool IdentIPAllowed(const std::string& identAddress, acl::UserID uid);
 
-  bool Replicate(const mongo::BSONElement& id);
+  bool Replicate(const std::vector<acl::UserID>& changed);
   bool Populate();  
 };
 
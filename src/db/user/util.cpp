@@ -4,9 +4,8 @@
 #include "db/user/usercache.hpp"
 #include "db/group/group.hpp"
 #include "acl/user.hpp"
-#include "db/connection.hpp"
+#include "db/storage.hpp"
 #include "db/user/usercachebase.hpp"
-#include "db/user/serialization.hpp"
 
 namespace db
 {
@@ -25,41 +24,33 @@ struct UserNoCache : public UserCacheBase
 
 std::string UserNoCache::UIDToName(acl::UserID uid)
 {
-  NoErrorConnection conn;  
-  auto fields = BSON("uid" << 1 << "name" << 1 << "primary gid" << 1);
-  auto data = conn.QueryOne<UserTriple>("users", QUERY("uid" << uid), &fields);
+  auto data = GetStorage().UserLoad(uid);
   if (!data) return "unknown";
   return data->name;
 }
 
 acl::UserID UserNoCache::NameToUID(const std::string& name)
 {
-  NoErrorConnection conn;  
-  auto fields = BSON("uid" << 1 << "name" << 1 << "primary gid" << 1);
-  auto data = conn.QueryOne<UserTriple>("users", QUERY("name" << name), &fields);
+  auto data = GetStorage().UserLoad(name);
   if (!data) return -1;
-  return data->uid;
+  return data->id;
 }
 
 acl::GroupID UserNoCache::UIDToPrimaryGID(acl::UserID uid)
 {
-  NoErrorConnection conn;  
-  auto fields = BSON("uid" << 1 << "name" << 1 << "primary gid" << 1);
-  auto data = conn.QueryOne<UserTriple>("users", QUERY("uid" << uid), &fields);
+  auto data = GetStorage().UserLoad(uid);
   if (!data) return -1;
   return data->primaryGid;
 }
 
 bool UserNoCache::IdentIPAllowed(const std::string& identAddress)
 {
-  NoErrorConnection conn;
-  return util::WildcardMatch(LookupIPMasks(conn), identAddress, true);
+  return util::WildcardMatch(GetStorage().UserIPMasks(-1), identAddress, true);
 }
 
 bool UserNoCache::IdentIPAllowed(const std::string& identAddress, acl::UserID uid)
 {
-  NoErrorConnection conn;
-  return util::WildcardMatch(LookupIPMasks(conn, uid), identAddress, true);
+  return util::WildcardMatch(GetStorage().UserIPMasks(uid), identAddress, true);
 }
 
 std::shared_ptr<UserCacheBase> userCache(new UserNoCache());
@@ -100,28 +91,4 @@ bool IdentIPAllowed(const std::string& identAddress, acl::UserID uid)
   return userCache->IdentIPAllowed(identAddress, uid);
 }
 
-std::vector<std::string> LookupIPMasks(Connection& conn, acl::UserID uid)
-{
-  mongo::Query query;
-  if (uid != -1) query = QUERY("uid" << uid);
-  auto fields = BSON("ip masks" << 1);
-  
-  std::vector<std::string> ipMasks;
-  auto results = conn.Query("users", query, 0, 0, &fields);
-  for (const auto& obj : results)
-  {
-    try
-    {
-      std::vector<std::string> masks;
-      UnserializeContainer(obj["ip masks"].Array(), masks);
-      ipMasks.insert(ipMasks.end(), masks.begin(), masks.end());
-    }
-    catch (const mongo::DBException& e)
-    {
-      LogException("Unserialize ip masks", e, "users", query, fields);
-    }
-  }
-  return ipMasks;
-}
-
-} /* db namespace */
\ No newline at end of file
+} /* db namespace */
@@ -3,12 +3,17 @@
 #include "ftp/client.hpp"
 #include "fs/path.hpp"
 #include "exec/reader.hpp"
+#include "exec/util.hpp"
+#include "exec/worker.hpp"
 
 namespace exec
 {
 
 int Script(ftp::Client& client, const util::ProcessReader::ArgvType& argv, std::string& messages)
 {
+  int exitStatus;
+  if (WorkerPool::Run(argv, BuildEnv(client), messages, exitStatus)) return exitStatus;
+
   exec::Reader reader(client, argv);
   messages.clear();
 
@@ -0,0 +1,420 @@
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread/thread.hpp>
+#include "exec/worker.hpp"
+#include "util/spawn.hpp"
+#include "cfg/get.hpp"
+#include "logs/logs.hpp"
+
+namespace exec
+{
+
+namespace
+{
+
+// idle workers are pinged before reuse once they've sat this long
+const std::chrono::seconds healthInterval(30);
+const std::chrono::seconds pingTimeout(2);
+
+// blocking waits are split up so a kicked client isn't held up
+const std::chrono::milliseconds interruptInterval(100);
+
+// how long a stopping worker gets to exit after its input is closed, and
+// again after SIGTERM, before it's killed
+const std::chrono::seconds exitGrace(1);
+const std::chrono::milliseconds exitPollInterval(10);
+
+bool Reap(pid_t pid, std::chrono::steady_clock::duration grace)
+{
+  auto deadline = std::chrono::steady_clock::now() + grace;
+  while (true)
+  {
+    int result = waitpid(pid, nullptr, WNOHANG);
+    if (result == pid || (result < 0 && errno != EINTR)) return true;
+    if (std::chrono::steady_clock::now() >= deadline) return false;
+    usleep(std::chrono::microseconds(exitPollInterval).count());
+  }
+}
+
+void Escape(const std::string& s, std::string& out)
+{
+  for (char ch : s)
+  {
+    if (ch == '\\') out += "\\\\";
+    else if (ch == '\n') out += "\\n";
+    else out += ch;
+  }
+}
+
+std::string Unescape(const std::string& s, size_t pos)
+{
+  std::string out;
+  out.reserve(s.length() - pos);
+  for (; pos < s.length(); ++pos)
+  {
+    if (s[pos] == '\\' && pos + 1 < s.length())
+    {
+      ++pos;
+      out += s[pos] == 'n' ? '\n' : s[pos];
+    }
+    else
+      out += s[pos];
+  }
+  return out;
+}
+
+bool StartsWith(const std::string& s, const char* prefix, size_t len)
+{
+  return s.compare(0, len, prefix) == 0;
+}
+
+}
+
+std::mutex WorkerPool::poolsMutex;
+std::unordered_map<std::string, std::shared_ptr<WorkerPool>> WorkerPool::pools;
+
+Worker::Worker(const std::string& path) :
+  path(path), pid(-1), lastUsed(std::chrono::steady_clock::now())
+{
+  pid = util::Spawn(path, { path }, { "EBFTPD_WORKER=1" }, input.ReadFd(), output.WriteFd());
+  input.CloseRead();
+  output.CloseWrite();
+}
+
+Worker::~Worker()
+{
+  // closing stdin asks it to exit, anything still running after the
+  // grace period is sent SIGTERM and then killed
+  input.Close();
+  output.Close();
+  if (pid == -1) return;
+
+  if (Reap(pid, exitGrace)) return;
+  kill(pid, SIGTERM);
+  if (Reap(pid, exitGrace)) return;
+
+  kill(pid, SIGKILL);
+  while (waitpid(pid, nullptr, 0) < 0 && errno == EINTR);
+}
+
+void Worker::Write(const std::string& data)
+{
+  const char* p = data.data();
+  size_t len = data.length();
+  while (len > 0)
+  {
+    ssize_t n = write(input.WriteFd(), p, len);
+    if (n < 0)
+    {
+      if (errno == EINTR) continue;
+      if (errno == EPIPE) throw WorkerError("Worker closed its input");
+      throw util::SystemError(errno);
+    }
+    p += n;
+    len -= n;
+  }
+}
+
+bool Worker::Getline(std::string& line, std::chrono::steady_clock::time_point deadline)
+{
+  while (true)
+  {
+    auto nl = buffer.find('\n');
+    if (nl != std::string::npos)
+    {
+      line.assign(buffer, 0, nl);
+      if (!line.empty() && line.back() == '\r') line.pop_back();
+      buffer.erase(0, nl + 1);
+      return true;
+    }
+
+    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+                        deadline - std::chrono::steady_clock::now());
+    if (remaining.count() <= 0) throw util::SystemError(ETIMEDOUT);
+
+    struct pollfd pfd;
+    pfd.fd = output.ReadFd();
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    int n = poll(&pfd, 1, std::min(remaining, interruptInterval).count());
+    boost::this_thread::interruption_point();
+    if (n < 0)
+    {
+      if (errno == EINTR) continue;
+      throw util::SystemError(errno);
+    }
+    if (n == 0) continue;
+
+    char chunk[4096];
+    ssize_t len = read(output.ReadFd(), chunk, sizeof(chunk));
+    if (len < 0)
+    {
+      if (errno == EINTR) continue;
+      throw util::SystemError(errno);
+    }
+    if (len == 0) return false;
+    buffer.append(chunk, len);
+  }
+}
+
+bool Worker::Alive()
+{
+  int result;
+  while ((result = waitpid(pid, nullptr, WNOHANG)) < 0 && errno == EINTR);
+  if (result == 0) return true;
+  pid = -1;
+  return false;
+}
+
+bool Worker::Ping()
+{
+  try
+  {
+    Write("PING\n");
+    std::string line;
+    return Getline(line, std::chrono::steady_clock::now() + pingTimeout) && line == "PONG";
+  }
+  catch (const util::RuntimeError&)
+  {
+    return false;
+  }
+}
+
+bool Worker::Healthy()
+{
+  if (!Alive()) return false;
+  if (std::chrono::steady_clock::now() - lastUsed < healthInterval) return true;
+  if (!Ping()) return false;
+  lastUsed = std::chrono::steady_clock::now();
+  return true;
+}
+
+int Worker::Run(const std::vector<std::string>& argv, const std::vector<std::string>& env,
+                std::string& messages, int timeout)
+{
+  std::string request;
+  for (const auto& arg : argv)
+  {
+    request += "ARG ";
+    Escape(arg, request);
+    request += '\n';
+  }
+
+  for (const auto& var : env)
+  {
+    request += "ENV ";
+    Escape(var, request);
+    request += '\n';
+  }
+
+  request += "RUN\n";
+  Write(request);
+
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(timeout);
+  messages.clear();
+  std::string line;
+  while (true)
+  {
+    if (!Getline(line, deadline)) throw WorkerError("Worker exited mid request");
+    
+    if (StartsWith(line, "MSG ", 4))
+    {
+      if (!messages.empty()) messages += '\n';
+      messages += Unescape(line, 4);
+      continue;
+    }
+    
+    if (StartsWith(line, "EXIT ", 5))
+    {
+      try
+      {
+        int exitStatus = boost::lexical_cast<int>(line.substr(5));
+        lastUsed = std::chrono::steady_clock::now();
+        return exitStatus;
+      }
+      catch (const boost::bad_lexical_cast&)
+      {
+      }
+    }
+    
+    throw WorkerError("Unexpected reply from worker: " + line);
+  }
+}
+
+std::unique_ptr<Worker> WorkerPool::Acquire(int workers, int timeout)
+{
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(timeout);
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true)
+  {
+    // most recently used first, they're the least likely to need a ping
+    while (!idle.empty())
+    {
+      std::unique_ptr<Worker> worker(std::move(idle.back()));
+      idle.pop_back();
+      ++busy;
+      lock.unlock();
+
+      bool healthy;
+      try
+      {
+        healthy = worker->Healthy();
+      }
+      catch (...)
+      {
+        // interrupted mid ping, the worker's state is unknown
+        Release(nullptr);
+        throw;
+      }
+      
+      if (healthy) return worker;
+      logs::Debug("Replacing unresponsive script worker: %1%", path);
+      worker.reset();
+
+      lock.lock();
+      --busy;
+    }
+
+    if (busy < workers)
+    {
+      ++busy;
+      lock.unlock();
+      try
+      {
+        return std::unique_ptr<Worker>(new Worker(path));
+      }
+      catch (const util::SystemError& e)
+      {
+        logs::Error("Unable to start script worker: %1%: %2%", path, e.Message());
+        Release(nullptr);
+        return nullptr;
+      }
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (now >= deadline) throw util::SystemError(ETIMEDOUT);
+    available.wait_for(lock, std::min<std::chrono::steady_clock::duration>(deadline - now, interruptInterval));
+
+    lock.unlock();
+    boost::this_thread::interruption_point();
+    lock.lock();
+  }
+}
+
+void WorkerPool::Release(std::unique_ptr<Worker> worker)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    --busy;
+    if (worker) idle.emplace_back(std::move(worker));
+  }
+  available.notify_one();
+}
+
+bool WorkerPool::Run(const std::vector<std::string>& argv, const std::vector<std::string>& env,
+                     std::string& messages, int& exitStatus)
+{
+  const auto& entries = cfg::Get().ScriptWorker();
+  auto it = std::find_if(entries.begin(), entries.end(),
+                         [&argv](const cfg::ScriptWorker& entry)
+                         { return entry.Path() == argv[0]; });
+  if (it == entries.end()) return false;
+
+  std::shared_ptr<WorkerPool> pool;
+  {
+    std::lock_guard<std::mutex> lock(poolsMutex);
+    auto& entry = pools[it->Path()];
+    if (!entry) entry = std::make_shared<WorkerPool>(it->Path());
+    pool = entry;
+  }
+
+  std::unique_ptr<Worker> worker = pool->Acquire(it->Workers(), it->Timeout());
+  if (!worker) return false;
+
+  try
+  {
+    exitStatus = worker->Run(argv, env, messages, it->Timeout());
+  }
+  catch (const WorkerError& e)
+  {
+    pool->Release(nullptr);
+    logs::Error("Script worker failed, executing script instead: %1%: %2%", argv[0], e.Message());
+    return false;
+  }
+  catch (...)
+  {
+    // timed out or the client was kicked, the worker's killed on the
+    // way out as it may still be busy with the request
+    pool->Release(nullptr);
+    throw;
+  }
+
+  pool->Release(std::move(worker));
+  return true;
+}
+
+void WorkerPool::Prune()
+{
+  cfg::UpdateLocal();
+  const auto& entries = cfg::Get().ScriptWorker();
+  
+  std::vector<std::shared_ptr<WorkerPool>> stopping;
+  {
+    std::lock_guard<std::mutex> lock(poolsMutex);
+    for (auto it = pools.begin(); it != pools.end();)
+    {
+      if (std::find_if(entries.begin(), entries.end(),
+                       [&it](const cfg::ScriptWorker& entry)
+                       { return entry.Path() == it->first; }) == entries.end())
+      {
+        stopping.emplace_back(it->second);
+        it = pools.erase(it);
+      }
+      else
+        ++it;
+    }
+  }
+  
+  for (auto& pool : stopping)
+  {
+    // busy workers are stopped when released to the dropped pool
+    logs::Debug("Stopping script workers no longer configured: %1%", pool->path);
+    std::vector<std::unique_ptr<Worker>> workers;
+    {
+      std::lock_guard<std::mutex> lock(pool->mutex);
+      workers.swap(pool->idle);
+    }
+  }
+}
+
+void WorkerPool::Initialise()
+{
+  cfg::ConnectUpdatedSlot([]() { Prune(); });
+}
+
+void WorkerPool::Cleanup()
+{
+  std::unordered_map<std::string, std::shared_ptr<WorkerPool>> stopping;
+  {
+    std::lock_guard<std::mutex> lock(poolsMutex);
+    stopping.swap(pools);
+  }
+
+  for (auto& entry : stopping)
+  {
+    // stopped outside the lock
+    std::vector<std::unique_ptr<Worker>> workers;
+    {
+      std::lock_guard<std::mutex> lock(entry.second->mutex);
+      workers.swap(entry.second->idle);
+    }
+  }
+}
+
+} /* exec namespace */
@@ -0,0 +1,94 @@
+#ifndef __EXEC_WORKER_HPP
+#define __EXEC_WORKER_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include <sys/types.h>
+#include "util/error.hpp"
+#include "util/pipe.hpp"
+
+namespace exec
+{
+
+// the worker exited or broke protocol, the request may be retried by
+// executing the script
+struct WorkerError : public util::RuntimeError
+{
+  WorkerError(const std::string& message) : std::runtime_error(message) { }
+};
+
+// a long running script answering one request at a time over its stdin
+// and stdout, the protocol is described with script_worker in config.txt
+class Worker : boost::noncopyable
+{
+  std::string path;
+  pid_t pid;
+  util::Pipe input;
+  util::Pipe output;
+  std::string buffer;
+  std::chrono::steady_clock::time_point lastUsed;
+
+  void Write(const std::string& data);
+  bool Getline(std::string& line, std::chrono::steady_clock::time_point deadline);
+  bool Alive();
+  bool Ping();
+
+public:
+  // throws util::SystemError if the script can't be started
+  explicit Worker(const std::string& path);
+  ~Worker();
+
+  // throws util::SystemError(ETIMEDOUT) when there's no reply in time,
+  // the worker must not be reused after any exception
+  int Run(const std::vector<std::string>& argv, const std::vector<std::string>& env,
+          std::string& messages, int timeout);
+
+  // checks a worker that has sat idle still answers
+  bool Healthy();
+};
+
+// the workers for one script, at most the configured number are started
+// and requests beyond that wait for one to come free
+class WorkerPool : boost::noncopyable
+{
+  std::string path;
+  std::mutex mutex;
+  std::condition_variable available;
+  std::vector<std::unique_ptr<Worker>> idle;
+  int busy;
+
+  static std::mutex poolsMutex;
+  static std::unordered_map<std::string, std::shared_ptr<WorkerPool>> pools;
+
+  std::unique_ptr<Worker> Acquire(int workers, int timeout);
+  void Release(std::unique_ptr<Worker> worker);
+  
+  static void Prune();
+
+public:
+  WorkerPool(const std::string& path) : path(path), busy(0) { }
+
+  // runs the script on one of its workers if it has a script_worker entry,
+  // false if it doesn't or the worker failed and it should be executed
+  // instead. throws util::SystemError(ETIMEDOUT) if no worker is free or
+  // the reply doesn't come in time
+  static bool Run(const std::vector<std::string>& argv, const std::vector<std::string>& env,
+                  std::string& messages, int& exitStatus);
+
+  // stops the workers of scripts dropped from script_worker whenever the
+  // config is reloaded
+  static void Initialise();
+
+  // stops every idle worker
+  static void Cleanup();
+};
+
+} /* exec namespace */
+
+#endif
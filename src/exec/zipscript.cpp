@@ -0,0 +1,521 @@
+#include <cerrno>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <unordered_set>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "exec/zipscript.hpp"
+#include "fs/path.hpp"
+#include "fs/file.hpp"
+#include "fs/dircache.hpp"
+#include "util/crc32.hpp"
+#include "util/error.hpp"
+#include "util/string.hpp"
+#include "logs/logs.hpp"
+
+namespace exec
+{
+
+namespace
+{
+
+const size_t maxReleases = 4096;
+const std::string missingSuffix("-missing");
+
+bool IsSfv(const std::string& name)
+{
+  return util::EndsWith(util::ToLowerCopy(name), ".sfv");
+}
+
+bool IsProgressMarker(const std::string& name)
+{
+  return util::StartsWith(name, "[ ") && util::EndsWith(name, " files ]");
+}
+
+std::string ProgressMarker(size_t present, size_t total)
+{
+  std::ostringstream os;
+  if (present == total) os << "[ complete - " << total << " files ]";
+  else os << "[ " << present << " of " << total << " files ]";
+  return os.str();
+}
+
+std::string CRCString(uint32_t crc)
+{
+  std::ostringstream os;
+  os << std::hex << std::uppercase << std::setw(8) << std::setfill('0') << crc;
+  return os.str();
+}
+
+// lines are a file name followed by its crc, comments start with ;
+bool ParseSfv(const std::string& path, std::vector<std::pair<std::string, uint32_t>>& entries)
+{
+  std::ifstream in(path.c_str());
+  if (!in) return false;
+
+  std::string line;
+  while (std::getline(in, line))
+  {
+    util::Trim(line);
+    if (line.empty() || line[0] == ';') continue;
+
+    auto pos = line.find_last_of(" \t");
+    if (pos == std::string::npos) continue;
+
+    std::string name(util::TrimRightCopy(line.substr(0, pos)));
+    std::string hex(line.substr(pos + 1));
+    if (name.empty() || name.find('/') != std::string::npos ||
+        hex.empty() || hex.length() > 8 ||
+        hex.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos)
+      continue;
+
+    entries.emplace_back(name, std::stoul(hex, nullptr, 16));
+  }
+
+  return !entries.empty();
+}
+
+uint32_t FileCRC(const std::string& path)
+{
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) throw util::SystemError(errno);
+
+  util::CRC32 crc;
+  char buffer[65536];
+  while (true)
+  {
+    ssize_t len = read(fd, buffer, sizeof(buffer));
+    if (len < 0)
+    {
+      if (errno == EINTR) continue;
+      int errno_ = errno;
+      close(fd);
+      throw util::SystemError(errno_);
+    }
+    if (len == 0) break;
+    crc.Update(reinterpret_cast<uint8_t*>(buffer), len);
+  }
+
+  close(fd);
+  return crc.Checksum();
+}
+
+// markers are only ever created whole, an existing one is left alone
+void CreateMarker(const std::string& path)
+{
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+  if (fd >= 0) close(fd);
+}
+
+std::vector<std::string> ListDirectory(const std::string& path)
+{
+  std::vector<std::string> names;
+  DIR* dp = opendir(path.c_str());
+  if (!dp) return names;
+
+  while (struct dirent* de = readdir(dp))
+  {
+    if (de->d_name[0] == '.' && (!de->d_name[1] || (de->d_name[1] == '.' && !de->d_name[2])))
+      continue;
+    names.emplace_back(de->d_name);
+  }
+
+  closedir(dp);
+  return names;
+}
+
+}
+
+struct Zipscript::Release
+{
+  struct Entry
+  {
+    std::string name;
+    uint32_t crc;
+    bool present;
+
+    Entry(const std::string& name, uint32_t crc) : name(name), crc(crc), present(false) { }
+  };
+
+  std::mutex mutex;
+  std::string dir;
+  bool loaded;
+  bool stale;
+  unsigned long long lastUsed;
+  std::string sfv;
+  std::unordered_map<std::string, Entry> entries; // by lower case name
+  size_t present;
+  std::string marker;
+
+  Release(const std::string& dir) : 
+    dir(dir), loaded(false), stale(false), lastUsed(0), present(0) { }
+
+  std::string PathTo(const std::string& name) const { return dir + "/" + name; }
+  void Changed(const std::string& name) const { fs::DirectoryCache::Invalidate(fs::RealPath(PathTo(name))); }
+
+  Entry* Find(const std::string& name)
+  {
+    auto it = entries.find(util::ToLowerCopy(name));
+    return it == entries.end() ? nullptr : &it->second;
+  }
+
+  // progress moves to its next name with a rename, so there's never a
+  // moment with no marker or two of them
+  void UpdateMarker()
+  {
+    std::string next(ProgressMarker(present, entries.size()));
+    if (next == marker) return;
+
+    if (marker.empty() || rename(PathTo(marker).c_str(), PathTo(next).c_str()) < 0)
+      CreateMarker(PathTo(next));
+    marker = next;
+  }
+
+  void RemoveMarkers()
+  {
+    for (const auto& kv : entries)
+    {
+      if (!kv.second.present) unlink(PathTo(kv.second.name + missingSuffix).c_str());
+    }
+
+    if (!marker.empty()) unlink(PathTo(marker).c_str());
+    marker.clear();
+  }
+
+  void SetPresent(Entry& entry)
+  {
+    if (entry.present) return;
+    unlink(PathTo(entry.name + missingSuffix).c_str());
+    entry.present = true;
+    ++present;
+    UpdateMarker();
+  }
+
+  void SetMissing(Entry& entry)
+  {
+    if (!entry.present) return;
+    CreateMarker(PathTo(entry.name + missingSuffix));
+    entry.present = false;
+    --present;
+    UpdateMarker();
+  }
+
+  void Reset()
+  {
+    sfv.clear();
+    entries.clear();
+    present = 0;
+  }
+
+  void SetSfv(const std::string& name, const std::vector<std::pair<std::string, uint32_t>>& parsed)
+  {
+    Reset();
+    sfv = name;
+    for (const auto& p : parsed)
+    {
+      entries.emplace(util::ToLowerCopy(p.first), Entry(p.first, p.second));
+    }
+  }
+
+  // loads on first use, again once forgotten and again if the sfv has gone
+  // from under us, as when the directory is wiped and recreated. true if
+  // it was loaded
+  bool Refresh()
+  {
+    struct stat st;
+    if (loaded && !stale && (sfv.empty() || stat(PathTo(sfv).c_str(), &st) == 0)) 
+      return false;
+
+    stale = false;
+    Reset();
+    marker.clear();
+    Load();
+    return true;
+  }
+
+  // uploads are chmodded out of the incomplete mode when they finish,
+  // anything still in it was cut off part way
+  bool Complete(const std::string& name)
+  {
+    std::string path(PathTo(name));
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && !(st.st_mode & S_IXUSR) && 
+           !instance.IsUploading(path);
+  }
+
+  // brings the markers in line with what's on disk, files already here
+  // are trusted as they were checked on upload, unless they're still
+  // being uploaded
+  void Load()
+  {
+    loaded = true;
+    std::vector<std::string> names(ListDirectory(dir));
+    std::unordered_map<std::string, std::string> lowerNames;
+    for (const auto& name : names)
+    {
+      if (IsProgressMarker(name)) marker = name;
+      else if (sfv.empty() && IsSfv(name)) sfv = name;
+      lowerNames.emplace(util::ToLowerCopy(name), name);
+    }
+
+    std::vector<std::pair<std::string, uint32_t>> parsed;
+    if (sfv.empty() || !ParseSfv(PathTo(sfv), parsed))
+    {
+      // left over from an sfv since deleted
+      if (!marker.empty())
+      {
+        for (const auto& name : names)
+        {
+          struct stat st;
+          if (util::EndsWith(name, missingSuffix) &&
+              stat(PathTo(name).c_str(), &st) == 0 && st.st_size == 0)
+            unlink(PathTo(name).c_str());
+        }
+        
+        unlink(PathTo(marker).c_str());
+        Changed(marker);
+      }
+      marker.clear();
+      Reset();
+      return;
+    }
+
+    std::string name(sfv);
+    std::string current(marker);
+    SetSfv(name, parsed);
+    marker = current;
+    for (auto& kv : entries)
+    {
+      Entry& entry = kv.second;
+      auto it = lowerNames.find(kv.first);
+      entry.present = it != lowerNames.end() && Complete(it->second);
+      if (entry.present)
+      {
+        ++present;
+        if (lowerNames.count(kv.first + missingSuffix))
+          unlink(PathTo(entry.name + missingSuffix).c_str());
+      }
+      else
+        CreateMarker(PathTo(entry.name + missingSuffix));
+    }
+
+    UpdateMarker();
+    Changed(sfv);
+  }
+
+  // files uploaded before the sfv are checked now, bad ones removed. those
+  // still being uploaded are left to be checked when they finish
+  void Verify(std::ostringstream& os)
+  {
+    std::unordered_map<std::string, std::string> names;
+    for (const auto& name : ListDirectory(dir))
+    {
+      names.emplace(util::ToLowerCopy(name), name);
+    }
+
+    for (auto& kv : entries)
+    {
+      Entry& entry = kv.second;
+      auto it = names.find(kv.first);
+      if (it == names.end() || !Complete(it->second))
+      {
+        CreateMarker(PathTo(entry.name + missingSuffix));
+        continue;
+      }
+
+      std::string path(PathTo(it->second));
+      try
+      {
+        entry.present = FileCRC(path) == entry.crc;
+        if (entry.present)
+        {
+          ++present;
+          continue;
+        }
+
+        util::Error e = fs::DeleteFile(fs::RealPath(path));
+        if (!e) logs::Error("Unable to delete bad file %1%: %2%", path, e.Message());
+        os << "\n" << it->second << " doesn't match the sfv and was deleted.";
+      }
+      catch (const util::SystemError& e)
+      {
+        logs::Error("Unable to check %1% against sfv: %2%", path, e.Message());
+      }
+
+      CreateMarker(PathTo(entry.name + missingSuffix));
+    }
+  }
+};
+
+Zipscript Zipscript::instance;
+
+std::shared_ptr<Zipscript::Release> Zipscript::Get(const std::string& dir)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = releases.find(dir);
+  if (it == releases.end())
+  {
+    if (releases.size() >= maxReleases)
+    {
+      auto oldest = releases.begin();
+      for (auto it = releases.begin(); it != releases.end(); ++it)
+      {
+        if (it->second->lastUsed < oldest->second->lastUsed) oldest = it;
+      }
+      releases.erase(oldest);
+    }
+
+    it = releases.emplace(dir, std::make_shared<Release>(dir)).first;
+  }
+
+  it->second->lastUsed = ++clock;
+  return it->second;
+}
+
+bool Zipscript::IsUploading(const std::string& path)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return uploads.count(path) > 0;
+}
+
+void Zipscript::Finished(const std::string& path)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  uploads.erase(path);
+}
+
+void Zipscript::Uploading(const fs::RealPath& path)
+{
+  std::lock_guard<std::mutex> lock(instance.mutex);
+  instance.uploads.insert(path.ToString());
+}
+
+bool Zipscript::Uploaded(const fs::RealPath& path, const boost::optional<uint32_t>& crc,
+                         std::string& message)
+{
+  message.clear();
+  instance.Finished(path.ToString());
+  const std::string& name = path.Basename().ToString();
+  auto release = instance.Get(path.Dirname().ToString());
+  std::lock_guard<std::mutex> lock(release->mutex);
+  release->Refresh();
+
+  if (IsSfv(name))
+  {
+    if (!release->sfv.empty() && util::ToLowerCopy(release->sfv) != util::ToLowerCopy(name))
+    {
+      message = "An sfv file already exists: " + release->sfv;
+      return false;
+    }
+
+    std::vector<std::pair<std::string, uint32_t>> parsed;
+    if (!ParseSfv(path.ToString(), parsed))
+    {
+      message = "The sfv file contains no valid entries.";
+      return false;
+    }
+
+    release->RemoveMarkers();
+    release->SetSfv(name, parsed);
+
+    std::ostringstream os;
+    os << "SFV okay, " << parsed.size() << " files listed.";
+    release->Verify(os);
+    release->UpdateMarker();
+    release->Changed(release->sfv);
+
+    if (release->present > 0)
+      os << "\n" << release->present << " of " << release->entries.size() << " files already uploaded.";
+    message = os.str();
+    return true;
+  }
+
+  auto entry = release->Find(name);
+  if (!entry) return true;
+
+  uint32_t checksum;
+  try
+  {
+    checksum = crc ? *crc : FileCRC(path.ToString());
+  }
+  catch (const util::SystemError& e)
+  {
+    message = "Unable to calculate crc: " + e.Message();
+    return false;
+  }
+
+  if (checksum != entry->crc)
+  {
+    release->SetMissing(*entry);
+    release->Changed(release->sfv);
+    message = "CRC mismatch, expected " + CRCString(entry->crc) + " got " + CRCString(checksum) + ".";
+    return false;
+  }
+
+  release->SetPresent(*entry);
+  release->Changed(release->sfv);
+
+  std::ostringstream os;
+  os << "CRC okay, " << release->present << " of " << release->entries.size() << " files";
+  if (release->present == release->entries.size()) os << ", release complete";
+  os << ".";
+  message = os.str();
+  return true;
+}
+
+void Zipscript::Deleted(const fs::RealPath& path)
+{
+  const std::string& name = path.Basename().ToString();
+  auto release = instance.Get(path.Dirname().ToString());
+  std::lock_guard<std::mutex> lock(release->mutex);
+  // a failed upload may not be gone yet, it's not counted by the load
+  // while still marked as uploading. loading catches up with any other
+  // deletion
+  bool loaded = release->Refresh();
+  instance.Finished(path.ToString());
+  if (loaded) return;
+
+  if (!release->sfv.empty() && util::ToLowerCopy(release->sfv) == util::ToLowerCopy(name))
+  {
+    release->RemoveMarkers();
+    release->Changed(release->sfv);
+    release->Reset();
+    return;
+  }
+
+  auto entry = release->Find(name);
+  if (entry && entry->present)
+  {
+    release->SetMissing(*entry);
+    release->Changed(release->sfv);
+  }
+}
+
+void Zipscript::Forget(const fs::RealPath& path)
+{
+  const std::string& dir = path.ToString();
+  std::vector<std::shared_ptr<Release>> forgotten;
+  {
+    std::lock_guard<std::mutex> lock(instance.mutex);
+    for (const auto& kv : instance.releases)
+    {
+      const std::string& key = kv.first;
+      if (util::StartsWith(key, dir) && (key.length() == dir.length() || key[dir.length()] == '/'))
+        forgotten.emplace_back(kv.second);
+    }
+  }
+  
+  // kept rather than dropped so a thread part way through an upload and
+  // the next one share the same state
+  for (auto& release : forgotten)
+  {
+    std::lock_guard<std::mutex> lock(release->mutex);
+    release->stale = true;
+  }
+}
+
+} /* exec namespace */
@@ -0,0 +1,63 @@
+#ifndef __EXEC_ZIPSCRIPT_HPP
+#define __EXEC_ZIPSCRIPT_HPP
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <boost/optional.hpp>
+
+namespace fs
+{
+class RealPath;
+}
+
+namespace exec
+{
+
+// built in zipscript for directories matching the zipscript masks. each
+// directory's .sfv is parsed once and kept with a count of the files it
+// lists that are present, so an upload is checked without rereading the
+// sfv or the directory. the state is loaded from disk when a directory
+// is first seen, so it survives restarts and eviction
+class Zipscript
+{
+  struct Release;
+
+  std::mutex mutex;
+  std::unordered_map<std::string, std::shared_ptr<Release>> releases;
+  std::unordered_set<std::string> uploads;
+  unsigned long long clock;
+
+  static Zipscript instance;
+
+  Zipscript() : clock(0) { }
+
+  std::shared_ptr<Release> Get(const std::string& dir);
+  bool IsUploading(const std::string& path);
+  void Finished(const std::string& path);
+
+public:
+  // an upload has started, the file isn't counted when its directory is
+  // loaded until it's been checked or deleted
+  static void Uploading(const fs::RealPath& path);
+
+  // checks a finished upload, crc is calculated from the file when not
+  // given. returns false when the upload must be deleted, message is
+  // always set for files the zipscript has anything to say about
+  static bool Uploaded(const fs::RealPath& path, const boost::optional<uint32_t>& crc,
+                       std::string& message);
+
+  // a file was removed, its missing marker is recreated if it was listed
+  static void Deleted(const fs::RealPath& path);
+
+  // a directory was removed or renamed, anything cached under it is
+  // reloaded from disk when next used
+  static void Forget(const fs::RealPath& path);
+};
+
+} /* exec namespace */
+
+#endif
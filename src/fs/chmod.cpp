@@ -9,6 +9,7 @@
 #include "acl/path.hpp"
 #include "cfg/get.hpp"
 #include "fs/path.hpp"
+#include "fs/dircache.hpp"
 
 namespace fs
 {
@@ -22,6 +23,7 @@ util::Error Chmod(const RealPath& path, const Mode& mode)
   
     if (chmod(MakeReal(path).CString(), newMode) < 0)
       return util::Error::Failure(errno);
+    DirectoryCache::Invalidate(MakeReal(path));
   }
   catch (const util::SystemError& e)
   { return util::Error::Failure(e.Errno()); }
@@ -52,6 +54,7 @@ util::Error Chmod(const acl::User& user, const VirtualPath& path, const Mode& mo
     
     if (chmod(MakeReal(path).CString(), newMode) < 0)
       return util::Error::Failure(errno);
+    DirectoryCache::Invalidate(MakeReal(path));
   }
   catch (const util::SystemError& e)
   {
@@ -0,0 +1,539 @@
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#if defined(__linux__)
+# include <poll.h>
+# include <sys/inotify.h>
+# include <sys/syscall.h>
+#endif
+#include "fs/dircache.hpp"
+#include "fs/owner.hpp"
+#include "fs/ownertable.hpp"
+#include "util/error.hpp"
+#include "logs/logs.hpp"
+
+namespace fs
+{
+
+namespace
+{
+
+bool Hidden(const char* name)
+{
+  if (name[0] != '.') return false;
+  return !name[1] || (name[1] == '.' && !name[2]) ||
+         !strncmp(name, OwnerTable::filename, strlen(OwnerTable::filename));
+}
+
+// the table store loads a whole directory's owners up front, anything
+// missing from it or the xattr store is read per entry by path
+class DirectoryOwners
+{
+  std::shared_ptr<const OwnerMap> table;
+  std::string entryPath;
+  size_t dirLength;
+
+public:
+  DirectoryOwners(const RealPath& path) :
+    table(GetDirectoryOwners(path)),
+    entryPath(path.ToString())
+  {
+    if (entryPath.empty() || entryPath[entryPath.length() - 1] != '/') entryPath += '/';
+    dirLength = entryPath.length();
+  }
+
+  Owner Get(const char* name)
+  {
+    if (table)
+    {
+      auto it = table->find(name);
+      if (it != table->end()) return it->second;
+    }
+
+    entryPath.resize(dirLength);
+    entryPath += name;
+    return GetOwner(entryPath);
+  }
+};
+
+}
+
+std::unique_ptr<DirectoryCache> DirectoryCache::instance;
+
+DirectoryCache::~DirectoryCache()
+{
+  close(inotifyFd);
+}
+
+#if defined(__linux__)
+
+namespace
+{
+
+struct linux_dirent64
+{
+  ino64_t d_ino;
+  off64_t d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[1]; // really as long as d_reclen allows
+};
+
+}
+
+// entries are read in large batches with getdents64 and stat'd relative
+// to the directory descriptor
+DirListingPtr DirectoryCache::Load(const RealPath& path, bool loadOwners)
+{
+  int fd = open(path.CString(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0) throw util::SystemError(errno);
+  std::shared_ptr<void> fdGuard(nullptr, [fd](void*) { close(fd); });
+
+  std::unique_ptr<DirectoryOwners> owners;
+  if (loadOwners) owners.reset(new DirectoryOwners(path));
+
+  auto listing = std::make_shared<DirListing>();
+  std::vector<char> buffer(65536);
+  while (true)
+  {
+    long len = syscall(SYS_getdents64, fd, buffer.data(), buffer.size());
+    if (len < 0)
+    {
+      if (errno == EINTR) continue;
+      throw util::SystemError(errno);
+    }
+    if (len == 0) break;
+
+    for (long pos = 0; pos < len; )
+    {
+      const linux_dirent64* de = reinterpret_cast<const linux_dirent64*>(buffer.data() + pos);
+      pos += de->d_reclen;
+
+      const char* name = reinterpret_cast<const char*>(de) + offsetof(linux_dirent64, d_name);
+      if (Hidden(name)) continue;
+
+      try
+      {
+        util::path::Status status(fd, name);
+        listing->totalBytes += status.Size();
+
+        Owner owner(0, 0);
+        if (owners) owner = owners->Get(name);
+        listing->entries.emplace_back(fs::Path(name), status, owner);
+      }
+      catch (const util::SystemError&)
+      {
+        continue;
+      }
+    }
+  }
+
+  return listing;
+}
+
+#else
+
+DirListingPtr DirectoryCache::Load(const RealPath& path, bool loadOwners)
+{
+  DIR* dp = opendir(path.CString());
+  if (!dp) throw util::SystemError(errno);
+  std::shared_ptr<DIR> dpGuard(dp, closedir);
+
+  std::unique_ptr<DirectoryOwners> owners;
+  if (loadOwners) owners.reset(new DirectoryOwners(path));
+
+  auto listing = std::make_shared<DirListing>();
+  struct dirent* de;
+  while ((de = readdir(dp)))
+  {
+    if (Hidden(de->d_name)) continue;
+
+    try
+    {
+      util::path::Status status(dirfd(dp), de->d_name);
+      listing->totalBytes += status.Size();
+
+      Owner owner(0, 0);
+      if (owners) owner = owners->Get(de->d_name);
+      listing->entries.emplace_back(fs::Path(de->d_name), status, owner);
+    }
+    catch (const util::SystemError&)
+    {
+      continue;
+    }
+  }
+
+  return listing;
+}
+
+#endif
+
+#if defined(__linux__)
+
+namespace
+{
+
+const uint32_t watchMask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                           IN_ATTRIB | IN_CLOSE_WRITE | IN_DELETE_SELF |
+                           IN_MOVE_SELF | IN_ONLYDIR;
+
+}
+
+DirListingPtr DirectoryCache::Lookup(const RealPath& path, bool loadOwners)
+{
+  const std::string& key = path.ToString();
+  unsigned long long generation = 0;
+  unsigned long long load = 0;
+
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+      auto it = entries.find(key);
+      if (it != entries.end())
+      {
+        Entry& entry = it->second;
+        lru.splice(lru.end(), lru, entry.lru);
+
+        bool usable = entry.listing && (entry.owners || !loadOwners);
+        if (usable && time(nullptr) - entry.loaded <= maximumAge)
+          return entry.listing;
+
+        if (entry.loading)
+        {
+          // a listing that has only aged is good enough while it's reloaded
+          if (usable) return entry.listing;
+          loadDone.wait(lock);
+          continue;
+        }
+
+        entry.loading = load = ++loads;
+        generation = entry.generation;
+      }
+      else if (!failed)
+      {
+        // watch is added before reading so no change can slip in unnoticed,
+        // a second path to an already watched directory is left uncached
+        int wd = inotify_add_watch(inotifyFd, key.c_str(), watchMask);
+        if (wd >= 0 && watches.find(wd) == watches.end())
+        {
+          Entry& entry = entries[key];
+          entry.wd = wd;
+          entry.lru = lru.insert(lru.end(), key);
+          entry.loading = load = ++loads;
+          watches.insert(std::make_pair(wd, key));
+          generation = entry.generation;
+          Evict();
+        }
+      }
+      break;
+    }
+  }
+
+  if (!load) return Load(path, loadOwners);
+
+  DirListingPtr listing;
+  try
+  {
+    listing = Load(path, loadOwners);
+  }
+  catch (...)
+  {
+    LoadFinished(key, load, generation, nullptr, loadOwners);
+    throw;
+  }
+
+  LoadFinished(key, load, generation, listing, loadOwners);
+  return listing;
+}
+
+// the listing is only kept if nothing changed while it was read, waiting
+// sessions are woken either way and load it themselves if it wasn't
+void DirectoryCache::LoadFinished(const std::string& key, unsigned long long load,
+      unsigned long long generation, const DirListingPtr& listing, bool loadOwners)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(key);
+    if (it != entries.end() && it->second.loading == load)
+    {
+      Entry& entry = it->second;
+      entry.loading = 0;
+      if (listing && entry.generation == generation)
+      {
+        entry.listing = listing;
+        entry.loaded = time(nullptr);
+        entry.owners = loadOwners;
+      }
+    }
+  }
+
+  loadDone.notify_all();
+}
+
+void DirectoryCache::Erase(std::unordered_map<std::string, Entry>::iterator it)
+{
+  inotify_rm_watch(inotifyFd, it->second.wd);
+  watches.erase(it->second.wd);
+  lru.erase(it->second.lru);
+  entries.erase(it);
+}
+
+void DirectoryCache::Evict()
+{
+  while (entries.size() > maximumEntries)
+  {
+    Erase(entries.find(lru.front()));
+  }
+}
+
+void DirectoryCache::InvalidateDirectory(const std::string& path)
+{
+  auto it = entries.find(path);
+  if (it != entries.end())
+  {
+    ++it->second.generation;
+    it->second.listing.reset();
+  }
+}
+
+void DirectoryCache::EraseTree(const std::string& path)
+{
+  std::string prefix(path);
+  if (prefix.empty() || prefix[prefix.length() - 1] != '/') prefix += '/';
+
+  for (auto it = entries.begin(); it != entries.end();)
+  {
+    if (it->first == path || !it->first.compare(0, prefix.length(), prefix))
+    {
+      auto next = std::next(it);
+      Erase(it);
+      it = next;
+    }
+    else
+      ++it;
+  }
+}
+
+void DirectoryCache::HandleEvents(const char* buffer, ssize_t len)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  for (const char* p = buffer; p < buffer + len; )
+  {
+    const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(p);
+    p += sizeof(struct inotify_event) + event->len;
+
+    if (event->mask & IN_Q_OVERFLOW)
+    {
+      for (auto& kv : entries)
+      {
+        ++kv.second.generation;
+        kv.second.listing.reset();
+      }
+      continue;
+    }
+
+    auto it = watches.find(event->wd);
+    if (it == watches.end()) continue;
+
+    if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED))
+    {
+      // copy, erasing the entry erases the watch
+      std::string path(it->second);
+      EraseTree(path);
+    }
+    else
+      InvalidateDirectory(it->second);
+  }
+}
+
+void DirectoryCache::Run()
+{
+  char buffer[16384] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+  while (true)
+  {
+    boost::this_thread::interruption_point();
+
+    struct pollfd pfd;
+    pfd.fd = inotifyFd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    int n = poll(&pfd, 1, 250);
+    if (n == 0) continue;
+
+    ssize_t len = n < 0 ? -1 : read(inotifyFd, buffer, sizeof(buffer));
+    if (len < 0)
+    {
+      if (errno == EINTR || errno == EAGAIN) continue;
+
+      logs::Error("Directory cache disabled, inotify failure: %1%", util::Error::Failure(errno).Message());
+      std::lock_guard<std::mutex> lock(mutex);
+      failed = true;
+      while (!entries.empty()) Erase(entries.begin());
+      return;
+    }
+
+    HandleEvents(buffer, len);
+  }
+}
+
+DirListingPtr DirectoryCache::Listing(const RealPath& path, bool loadOwners)
+{
+  if (!instance) return Load(path, loadOwners);
+  return instance->Lookup(path, loadOwners);
+}
+
+void DirectoryCache::Invalidate(const RealPath& path)
+{
+  if (!instance) return;
+  std::lock_guard<std::mutex> lock(instance->mutex);
+  instance->InvalidateDirectory(path.Dirname().ToString());
+}
+
+void DirectoryCache::InvalidateTree(const RealPath& path)
+{
+  if (!instance) return;
+  std::lock_guard<std::mutex> lock(instance->mutex);
+  instance->InvalidateDirectory(path.Dirname().ToString());
+  instance->EraseTree(path.ToString());
+}
+
+void DirectoryCache::Initialise()
+{
+  int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (fd < 0)
+  {
+    logs::Error("Directory cache disabled, unable to initialise inotify: %1%",
+                util::Error::Failure(errno).Message());
+    return;
+  }
+
+  logs::Debug("Starting directory cache thread..");
+  instance.reset(new DirectoryCache(fd));
+  instance->thread = boost::thread(&DirectoryCache::Run, instance.get());
+}
+
+void DirectoryCache::Cleanup()
+{
+  if (!instance) return;
+
+  logs::Debug("Stopping directory cache thread..");
+  instance->thread.interrupt();
+  instance->thread.join();
+  instance.reset();
+}
+
+#else
+
+DirListingPtr DirectoryCache::Listing(const RealPath& path, bool loadOwners)
+{
+  return Load(path, loadOwners);
+}
+
+void DirectoryCache::Invalidate(const RealPath&)
+{
+}
+
+void DirectoryCache::InvalidateTree(const RealPath&)
+{
+}
+
+void DirectoryCache::Initialise()
+{
+  logs::Debug("Directory cache requires inotify, disabled on this platform.");
+}
+
+void DirectoryCache::Cleanup()
+{
+}
+
+#endif
+
+} /* fs namespace */
+
+#ifdef DIRCACHE_TEST
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+// compares Load against the previous readdir_r and absolute path enumeration
+// usage: dircachetest [entries]
+
+namespace
+{
+
+fs::DirListingPtr LoadByPath(const fs::RealPath& path)
+{
+  DIR* dp = opendir(path.CString());
+  if (!dp) throw util::SystemError(errno);
+  std::shared_ptr<DIR> dpGuard(dp, closedir);
+
+  auto listing = std::make_shared<fs::DirListing>();
+  struct dirent de;
+  struct dirent* dep;
+  while (true)
+  {
+    readdir_r(dp, &de, &dep);
+    if (!dep) break;
+    if (!strcmp(de.d_name, ".") || !strcmp(de.d_name, "..")) continue;
+
+    fs::RealPath entryPath(path / de.d_name);
+    util::path::Status status(entryPath.ToString());
+    listing->totalBytes += status.Size();
+    listing->entries.emplace_back(fs::Path(de.d_name), status, fs::GetOwner(entryPath));
+  }
+
+  return listing;
+}
+
+template <typename Function>
+double Time(Function fn, int iterations)
+{
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) fn();
+  std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count() / iterations;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+  int count = argc > 1 ? atoi(argv[1]) : 20000;
+  const int iterations = 10;
+
+  char dir[] = "/tmp/dircachetest.XXXXXX";
+  if (!mkdtemp(dir)) return 1;
+
+  fs::RealPath path(dir);
+  for (int i = 0; i < count; ++i)
+  {
+    char name[32];
+    snprintf(name, sizeof(name), "file%06d.rar", i);
+    fs::RealPath entry(path / name);
+    close(open(entry.CString(), O_CREAT | O_WRONLY, 0644));
+    fs::SetOwner(entry, fs::Owner(i % 100, i % 10));
+  }
+
+  size_t byPath = 0;
+  size_t relative = 0;
+  double pathMs = Time([&]() { byPath = LoadByPath(path)->entries.size(); }, iterations);
+  double relativeMs = Time([&]() { relative = fs::DirectoryCache::Load(path)->entries.size(); }, iterations);
+
+  std::cout << count << " entries" << std::endl;
+  std::cout << "readdir_r + path:    " << pathMs << "ms (" << byPath << ")" << std::endl;
+  std::cout << "getdents64 + dirfd:  " << relativeMs << "ms (" << relative << ")" << std::endl;
+
+  std::string cmd("rm -rf ");
+  cmd += dir;
+  return system(cmd.c_str());
+}
+
+#endif
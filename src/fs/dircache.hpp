@@ -0,0 +1,94 @@
+#ifndef __FS_DIRCACHE_HPP
+#define __FS_DIRCACHE_HPP
+
+#include <condition_variable>
+#include <ctime>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <boost/thread/thread.hpp>
+#include "fs/direnumerator.hpp"
+#include "fs/path.hpp"
+
+namespace fs
+{
+
+struct DirListing
+{
+  std::vector<DirEntry> entries;
+  unsigned long long totalBytes;
+
+  DirListing() : totalBytes(0) { }
+};
+
+typedef std::shared_ptr<const DirListing> DirListingPtr;
+
+// server wide cache of unfiltered directory listings including owners,
+// kept coherent with an inotify watch on each cached directory and by
+// explicit invalidation from our own filesystem operations. only one
+// session reloads a directory at a time, the others are given the aged
+// listing or wait for the reload when there isn't one
+class DirectoryCache
+{
+  struct Entry
+  {
+    int wd;
+    unsigned long long generation;
+    unsigned long long loading;   // id of the load in progress, 0 for none
+    time_t loaded;
+    bool owners;
+    DirListingPtr listing;
+    std::list<std::string>::iterator lru;
+
+    Entry() : wd(-1), generation(0), loading(0), loaded(0), owners(false) { }
+  };
+
+  int inotifyFd;
+  bool failed;
+  boost::thread thread;
+  std::mutex mutex;
+  std::condition_variable loadDone;
+  unsigned long long loads;
+  std::unordered_map<std::string, Entry> entries;
+  std::unordered_map<int, std::string> watches;
+  std::list<std::string> lru;
+
+  static std::unique_ptr<DirectoryCache> instance;
+  static const size_t maximumEntries = 4096;
+  static const time_t maximumAge = 1;
+
+  DirectoryCache(int inotifyFd) : inotifyFd(inotifyFd), failed(false), loads(0) { }
+
+  void Run();
+  void HandleEvents(const char* buffer, ssize_t len);
+  void Erase(std::unordered_map<std::string, Entry>::iterator it);
+  void Evict();
+
+  DirListingPtr Lookup(const RealPath& path, bool loadOwners);
+  void LoadFinished(const std::string& key, unsigned long long load, 
+                    unsigned long long generation, const DirListingPtr& listing,
+                    bool loadOwners);
+  void InvalidateDirectory(const std::string& path);
+  void EraseTree(const std::string& path);
+
+public:
+  ~DirectoryCache();
+
+  static DirListingPtr Listing(const RealPath& path, bool loadOwners = true);
+  static DirListingPtr Load(const RealPath& path, bool loadOwners = true);
+  
+  // path was created, removed or changed, refreshes the parent's listing
+  static void Invalidate(const RealPath& path);
+  // directory was removed or renamed, also drops any listings under path
+  static void InvalidateTree(const RealPath& path);
+
+  static void Initialise();
+  static void Cleanup();
+};
+
+} /* fs namespace */
+
+#endif
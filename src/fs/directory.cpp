@@ -7,6 +7,8 @@
 #include "acl/user.hpp"
 #include "fs/owner.hpp"
 #include "fs/direnumerator.hpp"
+#include "fs/dircache.hpp"
+#include "fs/pathcache.hpp"
 #include "acl/path.hpp"
 #include "cfg/get.hpp"
 #include "fs/dircontainer.hpp"
@@ -119,6 +121,7 @@ util::Error ChangeCdpath(const acl::User& user, const fs::Path& path, VirtualPat
 util::Error CreateDirectory(const RealPath& path)
 {
   if (mkdir(MakeReal(path).CString(), 0777) < 0) return util::Error::Failure(errno);
+  DirectoryCache::Invalidate(path);
   return util::Error::Success();
 }
 
@@ -135,6 +138,9 @@ util::Error CreateDirectory(const acl::User& user, const VirtualPath& path)
 util::Error RemoveDirectory(const RealPath& path)
 {
   if (rmdir(MakeReal(path).CString()) < 0) return util::Error::Failure(errno);
+  RemoveOwner(path);
+  DirectoryCache::InvalidateTree(path);
+  PathCache::Invalidate(path);
   return util::Error::Success();
 }
 
@@ -176,7 +182,11 @@ util::Error RenameDirectory(const RealPath& oldPath, const RealPath& newPath)
 {
   if (rename(oldPath.CString(), newPath.CString()) < 0) 
     return util::Error::Failure(errno);
-    
+  
+  MoveOwner(oldPath, newPath);
+  DirectoryCache::InvalidateTree(oldPath);
+  PathCache::Invalidate(oldPath);
+  DirectoryCache::Invalidate(newPath);
   return util::Error::Success();
 }
 
@@ -192,45 +202,4 @@ util::Error RenameDirectory(const acl::User& user, const VirtualPath& oldPath,
   return RenameDirectory(MakeReal(oldPath), MakeReal(newPath));
 }
 
-util::Error DirectorySize(const RealPath& path, int depth, long long& kBytes)
-{
-  kBytes = 0;
-  if (depth < 0) return util::Error::Failure(EINVAL);
-  if (depth == 0) return util::Error::Success();
-  
-  try
-  {
-    for (auto& entry : util::path::DirContainer(path.ToString()))
-    {
-      try
-      {
-        auto entryPath = path / entry;
-        util::path::Status status(entryPath.ToString());
-        if (status.IsDirectory())
-        {
-          if (!status.IsSymLink())
-          {
-            long long subKBytes;
-            if (DirectorySize(entryPath, depth - 1, subKBytes))
-              kBytes += subKBytes;
-          }
-        }
-        else
-        if (status.IsRegularFile())
-        {
-          kBytes += status.Size() / 1024;
-        }
-      }
-      catch (const util::SystemError& e)
-      { std::cout << (path / entry) << " " << e.Message() << std::endl; }
-    }
-  }
-  catch (const util::SystemError& e)
-  {
-    return util::Error::Failure(e.Errno());
-  }
-  
-  return util::Error::Success();
-}
-
 } /* fs namespace */
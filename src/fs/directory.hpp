@@ -36,6 +36,8 @@ util::Error ChangeCdpath(const acl::User& user, const Path& path, VirtualPath& m
 util::Error ChangeDirectory(const acl::User& user, const VirtualPath& path);
 
 util::Error DirectorySize(const RealPath& path, int depth, long long& kBytes);
+// contents of a file directly inside directory changed size in place
+void InvalidateDirectorySize(const RealPath& directory);
 
 const VirtualPath& WorkDirectory();
 void SetWorkDirectory(const VirtualPath& path);
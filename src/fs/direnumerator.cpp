@@ -1,8 +1,7 @@
 #include <cassert>
 #include <memory>
-#include <cstring>
-#include <dirent.h>
 #include "fs/direnumerator.hpp"
+#include "fs/dircache.hpp"
 #include "acl/user.hpp"
 #include "acl/path.hpp"
 #include "cfg/config.hpp"
@@ -61,56 +60,43 @@ void DirEnumerator::Readdir()
     return;
   }
 
-  DIR* dp = opendir(path.CString());
-  if (!dp) throw util::SystemError(errno);
-  std::shared_ptr<DIR> dpGuard(dp, closedir);
+  // client listings share the server wide cache, user visibility and
+  // hideowner are still applied per client below
+  DirListingPtr listing = user ? DirectoryCache::Listing(path, loadOwners) :
+                                 DirectoryCache::Load(path, loadOwners);
+  totalBytes += listing->totalBytes;
   
-  struct dirent de;
-  struct dirent* dep;
-  while (true)
+  if (!user)
   {
-    readdir_r(dp, &de, &dep);
-    if (!dep) break;
-
-     if (!strcmp(de.d_name, ".") || !strcmp(de.d_name, "..")) continue;
-
-    fs::RealPath entryPath(path / de.d_name);
-
-    try
+    entries = listing->entries;
+    return;
+  }
+  
+  std::string virtBuffer(MakeVirtual(path).ToString());
+  if (virtBuffer.empty() || virtBuffer[virtBuffer.length() - 1] != '/') virtBuffer += '/';
+  const size_t dirLength = virtBuffer.length();
+  
+  entries.reserve(listing->entries.size());
+  for (const auto& de : listing->entries)
+  {
+    virtBuffer.resize(dirLength);
+    virtBuffer += de.Path().ToString();
+    fs::VirtualPath virtPath(virtBuffer);
+    util::Error hideOwner;
+    if (de.Status().IsDirectory())
     {
-      util::path::Status status(entryPath.ToString());
-      totalBytes += status.Size();
-      
-      if (user)
-      {
-        fs::VirtualPath virtPath(MakeVirtual(entryPath));
-        util::Error hideOwner;
-        if (status.IsDirectory())
-        {
-          if (!PP::DirAllowed<PP::View>(*user, virtPath)) continue;
-          hideOwner = PP::DirAllowed<PP::Hideowner>(*user, virtPath);
-        }
-        else
-        {
-          if (!PP::FileAllowed<PP::View>(*user, virtPath)) continue;
-          hideOwner = PP::FileAllowed<PP::Hideowner>(*user, virtPath);
-        }
-        
-        Owner owner(0, 0);
-        if (!hideOwner && loadOwners) owner = GetOwner(entryPath);
-        entries.emplace_back(fs::Path(de.d_name), status, owner);
-      }
-      else
-      {
-        Owner owner(0, 0);
-        if (loadOwners) owner = GetOwner(entryPath);
-        entries.emplace_back(fs::Path(de.d_name), status, owner);
-      }
+      if (!PP::DirAllowed<PP::View>(*user, virtPath)) continue;
+      hideOwner = PP::DirAllowed<PP::Hideowner>(*user, virtPath);
     }
-    catch (const util::SystemError&)
+    else
     {
-      continue;
+      if (!PP::FileAllowed<PP::View>(*user, virtPath)) continue;
+      hideOwner = PP::FileAllowed<PP::Hideowner>(*user, virtPath);
     }
+    
+    Owner owner(0, 0);
+    if (!hideOwner && loadOwners) owner = de.Owner();
+    entries.emplace_back(de.Path(), de.Status(), owner);
   }
 }
 
@@ -0,0 +1,204 @@
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#if defined(__FreeBSD__)
+# include <sys/extattr.h>
+#else
+# include <sys/xattr.h>
+#endif
+
+#include "fs/directory.hpp"
+#include "fs/path.hpp"
+#include "fs/ownertable.hpp"
+#include "util/path/status.hpp"
+#include "util/error.hpp"
+
+namespace fs
+{
+
+namespace
+{
+
+#if defined(__FreeBSD__)
+
+int setxattr(const char *path, const char *name, const void *value, size_t size, int /* flags */)
+{
+  int ret = extattr_set_file(path, EXTATTR_NAMESPACE_USER, name, value, size);
+  return ret >= 0 ? 0 : ret;
+}
+
+ssize_t getxattr(const char *path, const char *name, void *value, size_t size)
+{
+  return extattr_get_file(path, EXTATTR_NAMESPACE_USER, name, value, size);
+}
+
+int removexattr(const char *path, const char *name)
+{
+  return extattr_delete_file(path, EXTATTR_NAMESPACE_USER, name);
+}
+
+#endif
+
+// total of the regular files directly inside a directory, valid while the
+// directory's mtime is unchanged. entries being added, removed or renamed
+// move the mtime, uploads bump the generation once they complete. files
+// grown in place by anything else aren't seen until the mtime next moves
+const char* sizeAttributeName = "user.ebftpd.dirsize";
+
+struct StoredSize
+{
+  int64_t kBytes;
+  int64_t mtimeSec;
+  int64_t mtimeNsec;
+  int64_t generation;
+};
+
+// don't trust an mtime this recent, a second change inside the same
+// timestamp tick would go unnoticed
+const time_t minimumAge = 2;
+
+// makes the generation check and store below a compare and set
+std::mutex storedMutex;
+
+int64_t LoadStoredSize(const std::string& path, StoredSize& stored)
+{
+  if (getxattr(path.c_str(), sizeAttributeName, &stored, sizeof(stored)) != sizeof(stored))
+  {
+    stored.kBytes = -1;
+    stored.generation = 0;
+  }
+  return stored.generation;
+}
+
+bool ReadStoredSize(const std::string& path, const struct stat& st, 
+                    long long& kBytes, int64_t& generation)
+{
+  StoredSize stored;
+  generation = LoadStoredSize(path, stored);
+  if (stored.kBytes < 0) return false;
+  if (stored.mtimeSec != st.st_mtim.tv_sec || stored.mtimeNsec != st.st_mtim.tv_nsec)
+    return false;
+  kBytes = stored.kBytes;
+  return true;
+}
+
+// only stored if no invalidation happened since generation was read
+void WriteStoredSize(const std::string& path, const struct stat& st, 
+                     long long kBytes, int64_t generation)
+{
+  if (time(nullptr) - st.st_mtim.tv_sec < minimumAge) return;
+
+  std::lock_guard<std::mutex> lock(storedMutex);
+  StoredSize stored;
+  if (LoadStoredSize(path, stored) != generation) return;
+  
+  stored.kBytes = kBytes;
+  stored.mtimeSec = st.st_mtim.tv_sec;
+  stored.mtimeNsec = st.st_mtim.tv_nsec;
+  stored.generation = generation;
+  setxattr(path.c_str(), sizeAttributeName, &stored, sizeof(stored), 0);
+}
+
+// returns the total of the files directly inside path, rebuilding and
+// storing it when missing or stale, subdirs is filled when requested
+util::Error FilesSize(const RealPath& path, long long& kBytes, std::vector<std::string>* subdirs)
+{
+  DIR* dp = opendir(path.CString());
+  if (!dp) return util::Error::Failure(errno);
+  std::shared_ptr<DIR> dpGuard(dp, closedir);
+
+  struct stat st;
+  if (fstat(dirfd(dp), &st) < 0) return util::Error::Failure(errno);
+
+  int64_t generation;
+  bool stored = ReadStoredSize(path.ToString(), st, kBytes, generation);
+  if (stored && !subdirs) return util::Error::Success();
+  if (!stored) kBytes = 0;
+
+  struct dirent* de;
+  while ((de = readdir(dp)))
+  {
+    const char* name = de->d_name;
+    if (name[0] == '.' && (!name[1] || (name[1] == '.' && !name[2]))) continue;
+    if (!strncmp(name, OwnerTable::filename, strlen(OwnerTable::filename))) continue;
+
+    if (de->d_type == DT_DIR)
+    {
+      if (subdirs) subdirs->emplace_back(name);
+      continue;
+    }
+
+    // regular files and symlinks only matter when rebuilding
+    if (stored && de->d_type != DT_UNKNOWN) continue;
+
+    try
+    {
+      util::path::Status status(dirfd(dp), name);
+      if (status.IsDirectory())
+      {
+        if (!status.IsSymLink() && subdirs) subdirs->emplace_back(name);
+      }
+      else
+      if (!stored && status.IsRegularFile())
+      {
+        kBytes += status.Size() / 1024;
+      }
+    }
+    catch (const util::SystemError&)
+    {
+      // entry removed while reading, the mtime check catches it next time
+    }
+  }
+
+  if (!stored) WriteStoredSize(path.ToString(), st, kBytes, generation);
+  return util::Error::Success();
+}
+
+}
+
+util::Error DirectorySize(const RealPath& path, int depth, long long& kBytes)
+{
+  kBytes = 0;
+  if (depth < 0) return util::Error::Failure(EINVAL);
+  if (depth == 0) return util::Error::Success();
+
+  std::vector<std::string> subdirs;
+  auto e = FilesSize(path, kBytes, depth > 1 ? &subdirs : nullptr);
+  if (!e) return e;
+
+  for (const auto& name : subdirs)
+  {
+    long long subKBytes;
+    if (DirectorySize(path / name, depth - 1, subKBytes))
+      kBytes += subKBytes;
+  }
+
+  return util::Error::Success();
+}
+
+// bumping the generation also voids a total that a rebuild running now is
+// about to store, the directory's mtime is left alone
+void InvalidateDirectorySize(const RealPath& directory)
+{
+  std::lock_guard<std::mutex> lock(storedMutex);
+  StoredSize stored;
+  int64_t generation = LoadStoredSize(directory.ToString(), stored);
+  
+  stored.kBytes = -1;
+  stored.mtimeSec = 0;
+  stored.mtimeNsec = 0;
+  stored.generation = generation + 1;
+  if (setxattr(directory.CString(), sizeAttributeName, &stored, sizeof(stored), 0) < 0)
+    removexattr(directory.CString(), sizeAttributeName);
+}
+
+} /* fs namespace */
@@ -6,6 +6,9 @@
 #include "acl/user.hpp"
 #include "fs/path.hpp"
 #include "fs/owner.hpp"
+#include "fs/dircache.hpp"
+#include "fs/freespace.hpp"
+#include "fs/pathcache.hpp"
 #include "util/misc.hpp"
 #include "acl/path.hpp"
 #include "cfg/config.hpp"
@@ -23,6 +26,9 @@ namespace fs
 util::Error DeleteFile(const RealPath& path)
 {
   if (unlink(path.CString()) < 0) return util::Error::Failure(errno);
+  RemoveOwner(path);
+  DirectoryCache::Invalidate(path);
+  PathCache::Invalidate(path);
   return util::Error::Success();
 }
 
@@ -53,6 +59,10 @@ util::Error RenameFile(const RealPath& oldPath, const RealPath& newPath)
 {
   if (rename(oldPath.CString(), newPath.CString()) < 0) 
     return util::Error::Failure(errno);
+  MoveOwner(oldPath, newPath);
+  DirectoryCache::Invalidate(oldPath);
+  PathCache::Invalidate(oldPath);
+  DirectoryCache::Invalidate(newPath);
   return util::Error::Success();
 }
 
@@ -74,7 +84,7 @@ FileSinkPtr CreateFile(const acl::User& user, const VirtualPath& path)
   if (!e) throw util::SystemError(e.Errno());
   
   unsigned long long freeBytes;
-  e = util::path::FreeDiskSpace(MakeReal(path).Dirname().ToString(), freeBytes);
+  e = FreeSpaceMonitor::FreeBytes(MakeReal(path).Dirname(), freeBytes);
   if (!e) throw util::SystemError(e.Errno());
   
   if (static_cast<unsigned long long>(cfg::Get().FreeSpace()) > freeBytes / 1024)
@@ -116,7 +126,7 @@ FileSinkPtr AppendFile(const acl::User& user, const VirtualPath& path, off_t off
   }
 
   unsigned long long freeBytes;
-  e = util::path::FreeDiskSpace(real.Dirname().ToString(), freeBytes);
+  e = FreeSpaceMonitor::FreeBytes(real.Dirname(), freeBytes);
   if (!e) throw util::SystemError(e.Errno());
   
   if (static_cast<unsigned long long>(cfg::Get().FreeSpace()) > freeBytes / 1024)
@@ -0,0 +1,178 @@
+#include <algorithm>
+#include <cstdio>
+#if defined(__linux__)
+# include <mntent.h>
+#elif defined(__FreeBSD__)
+# include <sys/param.h>
+# include <sys/ucred.h>
+# include <sys/mount.h>
+#endif
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include "fs/freespace.hpp"
+#include "cfg/get.hpp"
+#include "util/path/status.hpp"
+#include "util/error.hpp"
+#include "logs/logs.hpp"
+
+namespace fs
+{
+
+std::unique_ptr<FreeSpaceMonitor> FreeSpaceMonitor::instance;
+
+std::vector<std::string> FreeSpaceMonitor::LoadMountPoints()
+{
+  std::vector<std::string> mountPoints;
+#if defined(__linux__)
+  FILE* fp = setmntent("/proc/self/mounts", "r");
+  if (fp)
+  {
+    struct mntent* me;
+    while ((me = getmntent(fp))) mountPoints.emplace_back(me->mnt_dir);
+    endmntent(fp);
+  }
+#elif defined(__FreeBSD__)
+  struct statfs* mounts;
+  int count = getmntinfo(&mounts, MNT_NOWAIT);
+  for (int i = 0; i < count; ++i) mountPoints.emplace_back(mounts[i].f_mntonname);
+#else
+  mountPoints.emplace_back("/");
+#endif
+
+  // longest first, the first match is then the innermost mount
+  std::sort(mountPoints.begin(), mountPoints.end(),
+            [](const std::string& a, const std::string& b)
+            { return a.length() != b.length() ? a.length() > b.length() : a < b; });
+  mountPoints.erase(std::unique(mountPoints.begin(), mountPoints.end()), mountPoints.end());
+  return mountPoints;
+}
+
+const std::string* FreeSpaceMonitor::MountPoint(const std::string& path) const
+{
+  for (const auto& mountPoint : mountPoints)
+  {
+    if (mountPoint == "/") return &mountPoint;
+    if (!path.compare(0, mountPoint.length(), mountPoint) &&
+        (path.length() == mountPoint.length() || path[mountPoint.length()] == '/'))
+      return &mountPoint;
+  }
+  return nullptr;
+}
+
+void FreeSpaceMonitor::Poll()
+{
+  auto latest = LoadMountPoints();
+  std::vector<std::string> polling;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!latest.empty()) mountPoints.swap(latest);
+    for (const auto& kv : filesystems) polling.emplace_back(kv.first);
+  }
+
+  for (const auto& mountPoint : polling)
+  {
+    unsigned long long freeBytes;
+    auto e = util::path::FreeDiskSpace(mountPoint, freeBytes);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!e)
+    {
+      // likely unmounted, the next upload polls it again if it isn't
+      filesystems.erase(mountPoint);
+      continue;
+    }
+
+    auto it = filesystems.find(mountPoint);
+    if (it != filesystems.end())
+    {
+      it->second.freeBytes = freeBytes;
+      it->second.polled = true;
+    }
+  }
+}
+
+void FreeSpaceMonitor::Run()
+{
+  while (true)
+  {
+    cfg::UpdateLocal();
+    boost::this_thread::sleep(boost::posix_time::seconds(cfg::Get().FreeSpaceInterval()));
+    Poll();
+  }
+}
+
+util::Error FreeSpaceMonitor::FreeBytes(const RealPath& path, unsigned long long& freeBytes)
+{
+  if (!instance) return util::path::FreeDiskSpace(path.ToString(), freeBytes);
+
+  std::string mountPoint;
+  {
+    std::lock_guard<std::mutex> lock(instance->mutex);
+    const std::string* match = instance->MountPoint(path.ToString());
+    if (match)
+    {
+      auto it = instance->filesystems.find(*match);
+      if (it != instance->filesystems.end() && it->second.polled)
+      {
+        freeBytes = it->second.freeBytes;
+        return util::Error::Success();
+      }
+      mountPoint = *match;
+    }
+  }
+
+  // first use of this filesystem, read once here and by the monitor after
+  auto e = util::path::FreeDiskSpace(path.ToString(), freeBytes);
+  if (!e || mountPoint.empty()) return e;
+
+  std::lock_guard<std::mutex> lock(instance->mutex);
+  Filesystem& filesystem = instance->filesystems[mountPoint];
+  if (!filesystem.polled)
+  {
+    filesystem.freeBytes = freeBytes;
+    filesystem.polled = true;
+  }
+
+  return util::Error::Success();
+}
+
+void FreeSpaceMonitor::Consumed(const RealPath& path, unsigned long long bytes)
+{
+  if (!instance) return;
+
+  std::lock_guard<std::mutex> lock(instance->mutex);
+  const std::string* match = instance->MountPoint(path.ToString());
+  if (!match) return;
+
+  auto it = instance->filesystems.find(*match);
+  if (it == instance->filesystems.end()) return;
+
+  Filesystem& filesystem = it->second;
+  filesystem.freeBytes = bytes > filesystem.freeBytes ? 0 : filesystem.freeBytes - bytes;
+}
+
+void FreeSpaceMonitor::Initialise()
+{
+  auto mountPoints = LoadMountPoints();
+  if (mountPoints.empty())
+  {
+    logs::Error("Free space monitor disabled, unable to read mount points");
+    return;
+  }
+
+  logs::Debug("Starting free space monitor thread..");
+  instance.reset(new FreeSpaceMonitor());
+  instance->mountPoints.swap(mountPoints);
+  instance->thread = boost::thread(&FreeSpaceMonitor::Run, instance.get());
+}
+
+void FreeSpaceMonitor::Cleanup()
+{
+  if (!instance) return;
+
+  logs::Debug("Stopping free space monitor thread..");
+  instance->thread.interrupt();
+  instance->thread.join();
+  instance.reset();
+}
+
+} /* fs namespace */
@@ -0,0 +1,59 @@
+#ifndef __FS_FREESPACE_HPP
+#define __FS_FREESPACE_HPP
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <boost/thread/thread.hpp>
+#include "fs/path.hpp"
+
+namespace util
+{
+class Error;
+}
+
+namespace fs
+{
+
+// polls free space on each filesystem uploads are made to from a
+// background thread, so a slow statvfs on network filesystems is never
+// in the path of a transfer. between polls the estimate is reduced by
+// the bytes uploads report as written
+class FreeSpaceMonitor
+{
+  struct Filesystem
+  {
+    unsigned long long freeBytes;
+    bool polled;
+
+    Filesystem() : freeBytes(0), polled(false) { }
+  };
+
+  boost::thread thread;
+  std::mutex mutex;
+  std::vector<std::string> mountPoints;
+  std::unordered_map<std::string, Filesystem> filesystems;
+
+  static std::unique_ptr<FreeSpaceMonitor> instance;
+
+  FreeSpaceMonitor() = default;
+
+  void Run();
+  void Poll();
+  const std::string* MountPoint(const std::string& path) const;
+
+  static std::vector<std::string> LoadMountPoints();
+
+public:
+  static util::Error FreeBytes(const RealPath& path, unsigned long long& freeBytes);
+  static void Consumed(const RealPath& path, unsigned long long bytes);
+
+  static void Initialise();
+  static void Cleanup();
+};
+
+} /* fs namespace */
+
+#endif
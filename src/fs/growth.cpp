@@ -0,0 +1,224 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <unistd.h>
+#if defined(__linux__)
+# include <poll.h>
+# include <sys/inotify.h>
+#endif
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include "fs/growth.hpp"
+#include "util/error.hpp"
+#include "logs/logs.hpp"
+
+namespace fs
+{
+
+namespace
+{
+const int fallbackInterval = 500; // milliseconds
+}
+
+std::unique_ptr<GrowthNotifier> GrowthNotifier::instance;
+
+GrowthNotifier::~GrowthNotifier()
+{
+  if (inotifyFd >= 0) close(inotifyFd);
+}
+
+GrowthNotifier::Watch::Watch(const RealPath& path) :
+  path(path.ToString()), seen(0)
+{
+  if (!instance) return;
+
+  std::lock_guard<std::mutex> lock(instance->mutex);
+  auto& file = instance->files[this->path];
+  if (!file) file.reset(new File());
+
+#if defined(__linux__)
+  if (file->wd < 0 && instance->inotifyFd >= 0)
+  {
+    file->wd = inotify_add_watch(instance->inotifyFd, this->path.c_str(),
+                                 IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB);
+    if (file->wd >= 0) instance->watches[file->wd].emplace_back(file);
+  }
+#endif
+
+  ++file->waiters;
+  ++instance->waiting;
+  seen = file->generation;
+  this->file = file;
+}
+
+GrowthNotifier::Watch::~Watch()
+{
+  if (!instance || !file) return;
+
+  std::lock_guard<std::mutex> lock(instance->mutex);
+  --instance->waiting;
+  if (--file->waiters > 0) return;
+
+#if defined(__linux__)
+  if (file->wd >= 0)
+  {
+    auto& shared = instance->watches[file->wd];
+    shared.erase(std::remove(shared.begin(), shared.end(), file), shared.end());
+    if (shared.empty())
+    {
+      inotify_rm_watch(instance->inotifyFd, file->wd);
+      instance->watches.erase(file->wd);
+    }
+  }
+#endif
+
+  instance->files.erase(path);
+}
+
+void GrowthNotifier::Watch::Wait()
+{
+  if (!instance || !file)
+  {
+    boost::this_thread::sleep(boost::posix_time::milliseconds(fallbackInterval));
+    return;
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(instance->mutex);
+    file->cond.wait_for(lock, std::chrono::milliseconds(fallbackInterval),
+                        [&] { return file->generation != seen; });
+    seen = file->generation;
+  }
+  
+  // the wait itself isn't an interruption point, a kicked client following
+  // a stalled upload would otherwise never notice
+  boost::this_thread::interruption_point();
+}
+
+void GrowthNotifier::Grown(const RealPath& path)
+{
+  if (!instance || instance->waiting == 0) return;
+
+  std::lock_guard<std::mutex> lock(instance->mutex);
+  auto it = instance->files.find(path.ToString());
+  if (it == instance->files.end()) return;
+
+  ++it->second->generation;
+  it->second->cond.notify_all();
+}
+
+#if defined(__linux__)
+
+void GrowthNotifier::HandleEvents(const char* buffer, ssize_t len)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  for (const char* p = buffer; p < buffer + len; )
+  {
+    const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(p);
+    p += sizeof(struct inotify_event) + event->len;
+
+    if (event->mask & IN_Q_OVERFLOW)
+    {
+      // events were lost, wake everyone to check their file
+      for (const auto& kv : watches)
+      {
+        for (const auto& file : kv.second)
+        {
+          ++file->generation;
+          file->cond.notify_all();
+        }
+      }
+      continue;
+    }
+
+    auto it = watches.find(event->wd);
+    if (it == watches.end()) continue;
+
+    for (const auto& file : it->second)
+    {
+      ++file->generation;
+      file->cond.notify_all();
+    }
+
+    if (event->mask & IN_IGNORED)
+    {
+      // file is gone, waiters fall back to polling until they notice
+      for (const auto& file : it->second) file->wd = -1;
+      watches.erase(it);
+    }
+  }
+}
+
+void GrowthNotifier::Run()
+{
+  char buffer[16384] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+  while (true)
+  {
+    boost::this_thread::interruption_point();
+
+    struct pollfd pfd;
+    pfd.fd = inotifyFd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    int n = poll(&pfd, 1, 250);
+    if (n == 0) continue;
+
+    ssize_t len = n < 0 ? -1 : read(inotifyFd, buffer, sizeof(buffer));
+    if (len < 0)
+    {
+      if (errno == EINTR || errno == EAGAIN) continue;
+
+      logs::Error("Growth notifier falling back to polling, inotify failure: %1%",
+                  util::Error::Failure(errno).Message());
+      return;
+    }
+
+    HandleEvents(buffer, len);
+  }
+}
+
+void GrowthNotifier::Initialise()
+{
+  int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (fd < 0)
+  {
+    logs::Error("Growth notifier unable to initialise inotify, only local uploads "
+                "will wake downloads: %1%", util::Error::Failure(errno).Message());
+    instance.reset(new GrowthNotifier(-1));
+    return;
+  }
+
+  logs::Debug("Starting growth notifier thread..");
+  instance.reset(new GrowthNotifier(fd));
+  instance->thread = boost::thread(&GrowthNotifier::Run, instance.get());
+}
+
+void GrowthNotifier::Cleanup()
+{
+  if (!instance) return;
+
+  if (instance->inotifyFd >= 0)
+  {
+    logs::Debug("Stopping growth notifier thread..");
+    instance->thread.interrupt();
+    instance->thread.join();
+  }
+
+  instance.reset();
+}
+
+#else
+
+void GrowthNotifier::Initialise()
+{
+  instance.reset(new GrowthNotifier(-1));
+}
+
+void GrowthNotifier::Cleanup()
+{
+  instance.reset();
+}
+
+#endif
+
+} /* fs namespace */
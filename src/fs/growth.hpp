@@ -0,0 +1,75 @@
+#ifndef __FS_GROWTH_HPP
+#define __FS_GROWTH_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <boost/thread/thread.hpp>
+#include "fs/path.hpp"
+
+namespace fs
+{
+
+// wakes downloads following a file that's still being uploaded when it
+// grows. uploads in this daemon signal directly, anything else is seen
+// through inotify. without inotify waiters fall back to polling
+class GrowthNotifier
+{
+  struct File
+  {
+    int wd;
+    unsigned waiters;
+    unsigned long long generation;
+    std::condition_variable cond;
+
+    File() : wd(-1), waiters(0), generation(0) { }
+  };
+
+  int inotifyFd;
+  boost::thread thread;
+  std::mutex mutex;
+  std::atomic<unsigned> waiting;
+  std::unordered_map<std::string, std::shared_ptr<File>> files;
+  // paths to the same inode share a watch descriptor, it's removed along
+  // with the last of their files
+  std::unordered_map<int, std::vector<std::shared_ptr<File>>> watches;
+
+  static std::unique_ptr<GrowthNotifier> instance;
+
+  GrowthNotifier(int inotifyFd) : inotifyFd(inotifyFd), waiting(0) { }
+
+  void Run();
+  void HandleEvents(const char* buffer, ssize_t len);
+
+public:
+  ~GrowthNotifier();
+
+  // registers interest in a file, growth between two waits is never missed
+  class Watch
+  {
+    std::string path;
+    std::shared_ptr<File> file;
+    unsigned long long seen;
+
+  public:
+    Watch(const RealPath& path);
+    ~Watch();
+
+    // returns once the file has grown, or the fallback interval passes,
+    // throws boost::thread_interrupted if the thread is interrupted
+    void Wait();
+  };
+
+  static void Grown(const RealPath& path);
+
+  static void Initialise();
+  static void Cleanup();
+};
+
+} /* fs namespace */
+
+#endif
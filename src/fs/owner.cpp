@@ -7,6 +7,10 @@
 #endif
 
 #include "fs/owner.hpp"
+#include "fs/dircache.hpp"
+#include "fs/ownertable.hpp"
+#include "cfg/config.hpp"
+#include "util/path/path.hpp"
 #include "util/error.hpp"
 #include "logs/logs.hpp"
 
@@ -39,6 +43,8 @@ ssize_t getxattr(const char *path, const char *name, void *value, size_t size)
 
 #endif
 
+::cfg::OwnershipStore ownershipStore = ::cfg::OwnershipStore::Xattr;
+
 const char* uidAttributeName = "user.ebftpd.uid";
 const char* gidAttributeName = "user.ebftpd.gid";
 
@@ -85,6 +91,13 @@ util::Error SetAttribute(const std::string& path, const char* attribute, int32_t
 
 Owner GetOwner(const std::string& path)
 {
+  if (ownershipStore == ::cfg::OwnershipStore::Table)
+  {
+    auto owners = OwnerTable::Load(util::path::Dirname(path));
+    auto it = owners->find(util::path::Basename(path));
+    if (it != owners->end()) return it->second;
+  }
+  
   return Owner(GetAttribute(path, uidAttributeName),
                GetAttribute(path, gidAttributeName));
 
@@ -92,6 +105,17 @@ Owner GetOwner(const std::string& path)
 
 util::Error SetOwner(const std::string& path, const Owner& owner)
 {
+  if (ownershipStore == ::cfg::OwnershipStore::Table)
+  {
+    // entries from before the table existed only have the attributes
+    return OwnerTable::Set(util::path::Dirname(path), util::path::Basename(path), owner,
+                           [&path]() 
+                           {
+                             return Owner(GetAttribute(path, uidAttributeName),
+                                          GetAttribute(path, gidAttributeName));
+                           });
+  }
+  
   if (owner.UID() != -1)
   {
     auto e = SetAttribute(path, uidAttributeName, owner.UID());
@@ -114,7 +138,40 @@ Owner GetOwner(const RealPath& path)
 
 util::Error SetOwner(const RealPath& path, const Owner& owner)
 {
-  return SetOwner(path.ToString(), owner);
+  auto e = SetOwner(path.ToString(), owner);
+  DirectoryCache::Invalidate(path);
+  return e;
+}
+
+void SetOwnershipStore(::cfg::OwnershipStore store)
+{
+  ownershipStore = store;
+}
+
+std::shared_ptr<const OwnerMap> GetDirectoryOwners(const RealPath& directory)
+{
+  if (ownershipStore != ::cfg::OwnershipStore::Table) return nullptr;
+  return OwnerTable::Load(directory.ToString());
+}
+
+void RemoveOwner(const RealPath& path)
+{
+  if (ownershipStore != ::cfg::OwnershipStore::Table) return;
+  OwnerTable::Remove(path.Dirname().ToString(), path.Basename().ToString());
+}
+
+void MoveOwner(const RealPath& oldPath, const RealPath& newPath)
+{
+  if (ownershipStore != ::cfg::OwnershipStore::Table) return;
+  
+  auto owners = OwnerTable::Load(oldPath.Dirname().ToString());
+  auto it = owners->find(oldPath.Basename().ToString());
+  if (it == owners->end()) return;
+  
+  Owner owner(it->second);
+  OwnerTable::Remove(oldPath.Dirname().ToString(), oldPath.Basename().ToString());
+  OwnerTable::Set(newPath.Dirname().ToString(), newPath.Basename().ToString(), owner,
+                  [&owner]() { return owner; });
 }
 
 } /* fs namespace */
@@ -1,7 +1,10 @@
 #ifndef __FS_OWNER_HPP
 #define __FS_OWNER_HPP
 
+#include <memory>
 #include <ostream>
+#include <string>
+#include <unordered_map>
 #include "acl/types.hpp"
 #include "fs/path.hpp"
 
@@ -10,6 +13,11 @@ namespace util
 class Error;
 }
 
+namespace cfg
+{
+enum class OwnershipStore;
+}
+
 namespace fs
 {
 
@@ -31,6 +39,17 @@ util::Error SetOwner(const std::string& path, const Owner& owner);
 Owner GetOwner(const RealPath& path);
 util::Error SetOwner(const RealPath& path, const Owner& owner);
 
+void SetOwnershipStore(::cfg::OwnershipStore store);
+
+// owners of every entry in directory keyed by name in a single read,
+// only the table store supports this, nullptr is returned otherwise
+std::shared_ptr<const std::unordered_map<std::string, Owner>> 
+GetDirectoryOwners(const RealPath& directory);
+
+// keep the table store in step with entries being removed or renamed
+void RemoveOwner(const RealPath& path);
+void MoveOwner(const RealPath& oldPath, const RealPath& newPath);
+
 inline std::ostream& operator<<(std::ostream& os, const Owner& owner)
 {
   os << owner.UID() << "," << owner.GID();
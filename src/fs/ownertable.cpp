@@ -0,0 +1,280 @@
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "fs/ownertable.hpp"
+#include "fs/filelock.hpp"
+#include "util/error.hpp"
+#include "logs/logs.hpp"
+
+namespace fs
+{
+
+namespace
+{
+
+// record: type (1 byte), name length (2 bytes), uid (4 bytes), gid (4 bytes), name
+enum : uint8_t { SetRecord = 1, RemoveRecord = 2 };
+const size_t headerSize = 1 + 2 + 4 + 4;
+
+struct CachedTable
+{
+  ino_t ino;
+  off_t size;
+  struct timespec mtime;
+  size_t records;
+  std::shared_ptr<const OwnerMap> owners;
+};
+
+std::mutex cacheMutex;
+std::unordered_map<std::string, CachedTable> cache;
+const size_t maximumCached = 1024;
+
+std::string TablePath(const std::string& directory)
+{
+  std::string path(directory);
+  if (path.empty() || path[path.length() - 1] != '/') path += '/';
+  path += OwnerTable::filename;
+  return path;
+}
+
+bool ReadTable(const std::string& path, std::string& data, struct stat& st)
+{
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return false;
+
+  bool okay = fstat(fd, &st) == 0;
+  if (okay)
+  {
+    data.resize(st.st_size);
+    size_t total = 0;
+    while (total < data.size())
+    {
+      ssize_t len = read(fd, &data[total], data.size() - total);
+      if (len < 0 && errno == EINTR) continue;
+      if (len <= 0) break;
+      total += len;
+    }
+    data.resize(total);
+  }
+
+  close(fd);
+  return okay;
+}
+
+size_t Parse(const std::string& data, OwnerMap& owners)
+{
+  size_t records = 0;
+  size_t pos = 0;
+  while (data.size() - pos >= headerSize)
+  {
+    const char* p = data.data() + pos;
+    uint8_t type = p[0];
+    uint16_t nameLen;
+    int32_t uid;
+    int32_t gid;
+    memcpy(&nameLen, p + 1, sizeof(nameLen));
+    memcpy(&uid, p + 3, sizeof(uid));
+    memcpy(&gid, p + 7, sizeof(gid));
+
+    // partial record at the tail is an interrupted append
+    if (data.size() - pos - headerSize < nameLen) break;
+
+    std::string name(p + headerSize, nameLen);
+    if (type == SetRecord)
+    {
+      auto it = owners.find(name);
+      if (it == owners.end()) owners.insert(std::make_pair(name, Owner(uid, gid)));
+      else it->second = Owner(uid, gid);
+    }
+    else
+      owners.erase(name);
+
+    pos += headerSize + nameLen;
+    ++records;
+  }
+
+  return records;
+}
+
+void AppendRecord(std::string& buffer, uint8_t type, const std::string& name, const Owner& owner)
+{
+  uint16_t nameLen = name.length();
+  int32_t uid = owner.UID();
+  int32_t gid = owner.GID();
+  buffer.append(reinterpret_cast<const char*>(&type), sizeof(type));
+  buffer.append(reinterpret_cast<const char*>(&nameLen), sizeof(nameLen));
+  buffer.append(reinterpret_cast<const char*>(&uid), sizeof(uid));
+  buffer.append(reinterpret_cast<const char*>(&gid), sizeof(gid));
+  buffer.append(name);
+}
+
+// caller holds the directory's lock
+util::Error Append(const std::string& directory, const std::string& record, bool create)
+{
+  int flags = O_WRONLY | O_APPEND | O_CLOEXEC;
+  if (create) flags |= O_CREAT;
+  int fd = open(TablePath(directory).c_str(), flags, 0644);
+  if (fd < 0)
+  {
+    if (errno == ENOENT && !create) return util::Error::Success();
+    return util::Error::Failure(errno);
+  }
+
+  ssize_t len = write(fd, record.data(), record.length());
+  int errno_ = errno;
+  close(fd);
+  if (len != static_cast<ssize_t>(record.length()))
+    return util::Error::Failure(len < 0 ? errno_ : EIO);
+
+  return util::Error::Success();
+}
+
+// caller holds the directory's lock, compacts once the table is mostly
+// superseded records going by the last time it was loaded
+void Compact(const std::string& directory)
+{
+  {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto it = cache.find(directory);
+    if (it == cache.end() || 
+        it->second.records <= it->second.owners->size() * 2 + 64) 
+      return;
+  }
+
+  try
+  {
+    std::string path(TablePath(directory));
+    std::string data;
+    struct stat st;
+    if (!ReadTable(path, data, st)) return;
+
+    OwnerMap owners;
+    Parse(data, owners);
+
+    std::string compacted;
+    for (const auto& kv : owners)
+      AppendRecord(compacted, SetRecord, kv.first, kv.second);
+
+    std::string tmpPath(path + ".tmp");
+    int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) throw util::SystemError(errno);
+    bool okay = write(fd, compacted.data(), compacted.length()) ==
+                static_cast<ssize_t>(compacted.length());
+    close(fd);
+
+    if (!okay || rename(tmpPath.c_str(), path.c_str()) < 0)
+    {
+      unlink(tmpPath.c_str());
+      throw util::SystemError(okay ? errno : EIO);
+    }
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    cache.erase(directory);
+  }
+  catch (const util::SystemError& e)
+  {
+    logs::Error("Unable to compact ownership table: %1%: %2%", directory, e.Message());
+  }
+}
+
+}
+
+const char* OwnerTable::filename = ".ebftpd-owners";
+
+std::shared_ptr<const OwnerMap> OwnerTable::Load(const std::string& directory)
+{
+  static const std::shared_ptr<const OwnerMap> empty(new OwnerMap());
+
+  std::string path(TablePath(directory));
+  struct stat st;
+  if (stat(path.c_str(), &st) < 0) return empty;
+
+  {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto it = cache.find(directory);
+    if (it != cache.end() &&
+        it->second.ino == st.st_ino &&
+        it->second.size == st.st_size &&
+        it->second.mtime.tv_sec == st.st_mtim.tv_sec &&
+        it->second.mtime.tv_nsec == st.st_mtim.tv_nsec)
+    {
+      return it->second.owners;
+    }
+  }
+
+  std::string data;
+  if (!ReadTable(path, data, st)) return empty;
+
+  auto owners = std::make_shared<OwnerMap>();
+  size_t records = Parse(data, *owners);
+
+  std::lock_guard<std::mutex> lock(cacheMutex);
+  if (cache.size() >= maximumCached) cache.clear();
+  CachedTable& cached = cache[directory];
+  cached.ino = st.st_ino;
+  cached.size = st.st_size;
+  cached.mtime = st.st_mtim;
+  cached.records = records;
+  cached.owners = owners;
+  return owners;
+}
+
+util::Error OwnerTable::Set(const std::string& directory, const std::string& name, 
+      const Owner& owner, const std::function<Owner()>& current)
+{
+  util::Error e = util::Error::Success();
+  try
+  {
+    // the current owner is read under the lock so two partial changes
+    // at once can't lose either of them
+    auto lock = FileLock::Create(directory);
+
+    Owner resolved(owner);
+    if (owner.UID() == -1 || owner.GID() == -1)
+    {
+      auto owners = Load(directory);
+      auto it = owners->find(name);
+      Owner existing(it == owners->end() ? current() : it->second);
+      resolved = Owner(owner.UID() == -1 ? existing.UID() : owner.UID(),
+                       owner.GID() == -1 ? existing.GID() : owner.GID());
+    }
+
+    std::string record;
+    AppendRecord(record, SetRecord, name, resolved);
+    e = Append(directory, record, true);
+    if (e) Compact(directory);
+  }
+  catch (const util::SystemError& se)
+  {
+    e = util::Error::Failure(se.Errno());
+  }
+
+  if (!e)
+  {
+    logs::Error("Error while updating ownership table: %1%: %2%",
+                TablePath(directory), e.Message());
+  }
+  return e;
+}
+
+util::Error OwnerTable::Remove(const std::string& directory, const std::string& name)
+{
+  std::string record;
+  AppendRecord(record, RemoveRecord, name, Owner(0, 0));
+  try
+  {
+    auto lock = FileLock::Create(directory);
+    util::Error e = Append(directory, record, false);
+    if (e) Compact(directory);
+    return e;
+  }
+  catch (const util::SystemError& e)
+  {
+    return util::Error::Failure(e.Errno());
+  }
+}
+
+} /* fs namespace */
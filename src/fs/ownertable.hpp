@@ -0,0 +1,39 @@
+#ifndef __FS_OWNERTABLE_HPP
+#define __FS_OWNERTABLE_HPP
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include "fs/owner.hpp"
+
+namespace util
+{
+class Error;
+}
+
+namespace fs
+{
+
+typedef std::unordered_map<std::string, Owner> OwnerMap;
+
+// per directory table of entry owners, stored as an append only file of
+// binary records inside the directory itself. writers hold an flock on the
+// directory and compact the table when needed, readers rely on appends
+// and compaction renames being atomic
+class OwnerTable
+{
+public:
+  static const char* filename;
+
+  static std::shared_ptr<const OwnerMap> Load(const std::string& directory);
+  // an id of -1 keeps the entry's current one, current gives the owner
+  // of an entry that isn't in the table yet
+  static util::Error Set(const std::string& directory, const std::string& name, 
+                         const Owner& owner, const std::function<Owner()>& current);
+  static util::Error Remove(const std::string& directory, const std::string& name);
+};
+
+} /* fs namespace */
+
+#endif
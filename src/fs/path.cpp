@@ -3,6 +3,7 @@
 #include "cfg/get.hpp"
 #include "logs/logs.hpp"
 #include "fs/directory.hpp"
+#include "fs/pathcache.hpp"
 
 namespace fs
 {
@@ -67,22 +68,9 @@ const RealPath& MakeReal(const Path& path)
 {
   if (!path.cache.real)
   {
-    auto virt = Resolve(WorkDirectory() / path);
-    path.cache.real = new RealPath(RealPath(cfg::Get().Sitepath()) & virt);
-    std::string& p = path.cache.real->path;
-    std::string noSymlinks;
-    if (util::path::Realpath(p, noSymlinks))
-    {
-      p = noSymlinks;
-    }
-    else
-    {
-      // deal with paths that don't exist yet
-      if (util::path::Realpath(util::path::Dirname(p), noSymlinks))
-      {
-        p = util::path::Join(noSymlinks, util::path::Basename(p));
-      }
-    }
+    std::string virt(util::path::Join(WorkDirectory().ToString(), path.ToString()));
+    util::path::ResolveInPlace(virt);
+    path.cache.real = new RealPath(PathCache::Resolve(virt));
   }
   return *path.cache.real;
 }
@@ -0,0 +1,336 @@
+#include <cerrno>
+#include <unistd.h>
+#include <sys/stat.h>
+#if defined(__linux__)
+# include <poll.h>
+# include <sys/inotify.h>
+#endif
+#include "fs/pathcache.hpp"
+#include "cfg/get.hpp"
+#include "util/error.hpp"
+#include "logs/logs.hpp"
+
+namespace fs
+{
+
+std::unique_ptr<PathCache> PathCache::instance;
+
+PathCache::~PathCache()
+{
+  close(inotifyFd);
+}
+
+// the final component is never cached, it's lstat'd on every call so
+// files and symlinks appearing in a cached directory are always seen
+std::string PathCache::Resolve(const std::string& virtPath)
+{
+  const std::string& sitepath = cfg::Get().Sitepath();
+  std::string real;
+  if (virtPath == "/")
+  {
+    if (ResolveDirectory(virtPath, real)) return real;
+    return util::path::Append(sitepath, virtPath);
+  }
+
+  std::string::size_type pos = virtPath.rfind('/');
+  if (pos == std::string::npos ||
+      !ResolveDirectory(pos == 0 ? std::string("/") : virtPath.substr(0, pos), real))
+  {
+    // deal with paths whose parent doesn't exist
+    return util::path::Append(sitepath, virtPath);
+  }
+
+  if (real.empty() || real[real.length() - 1] != '/') real += '/';
+  real.append(virtPath, pos + 1, std::string::npos);
+
+  struct stat st;
+  if (lstat(real.c_str(), &st) == 0 && S_ISLNK(st.st_mode))
+  {
+    std::string target;
+    if (util::path::Realpath(real, target)) return target;
+  }
+
+  return real;
+}
+
+#if defined(__linux__)
+
+namespace
+{
+
+const uint32_t watchMask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                           IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+
+}
+
+bool PathCache::Watch(std::string path)
+{
+  while (true)
+  {
+    if (watched.find(path) == watched.end())
+    {
+      int wd = inotify_add_watch(inotifyFd, path.c_str(), watchMask);
+      if (wd < 0) return false;
+      watched.insert(std::make_pair(path, wd));
+      watches[wd].emplace_back(path);
+    }
+
+    if (path == sitepath || path == "/") return true;
+    path = util::path::Dirname(path);
+  }
+}
+
+void PathCache::Unwatch(const std::string& path)
+{
+  auto it = watched.find(path);
+  if (it == watched.end()) return;
+
+  int wd = it->second;
+  watched.erase(it);
+
+  auto wit = watches.find(wd);
+  if (wit == watches.end()) return;
+
+  auto& paths = wit->second;
+  for (auto pit = paths.begin(); pit != paths.end(); ++pit)
+  {
+    if (*pit == path)
+    {
+      paths.erase(pit);
+      break;
+    }
+  }
+
+  if (paths.empty())
+  {
+    inotify_rm_watch(inotifyFd, wd);
+    watches.erase(wit);
+  }
+}
+
+void PathCache::InvalidateUnder(const std::string& path)
+{
+  std::string prefix(path);
+  if (prefix.empty() || prefix[prefix.length() - 1] != '/') prefix += '/';
+
+  auto under = [&](const std::string& p)
+    {
+      return p == path || !p.compare(0, prefix.length(), prefix);
+    };
+
+  for (auto it = entries.begin(); it != entries.end();)
+  {
+    if (under(it->second.literal) || under(it->second.real))
+      it = entries.erase(it);
+    else
+      ++it;
+  }
+
+  std::vector<std::string> stale;
+  for (const auto& kv : watched)
+  {
+    if (under(kv.first)) stale.emplace_back(kv.first);
+  }
+
+  for (const auto& p : stale) Unwatch(p);
+  ++generation;
+}
+
+void PathCache::Clear()
+{
+  for (const auto& kv : watches)
+  {
+    inotify_rm_watch(inotifyFd, kv.first);
+  }
+
+  watches.clear();
+  watched.clear();
+  entries.clear();
+  ++generation;
+}
+
+bool PathCache::Lookup(const std::string& sitepath, const std::string& virtDir, std::string& real)
+{
+  std::string literal(util::path::Append(sitepath, virtDir));
+  unsigned long long generation;
+  bool failed;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (this->sitepath != sitepath)
+    {
+      Clear();
+      this->sitepath = sitepath;
+    }
+
+    auto it = entries.find(virtDir);
+    if (it != entries.end())
+    {
+      real = it->second.real;
+      return true;
+    }
+
+    generation = this->generation;
+    failed = this->failed;
+  }
+
+  if (!util::path::Realpath(literal, real)) return false;
+  if (failed) return true;
+
+  {
+    // watches are added before the path is resolved a second time, a
+    // change after the second resolve can't slip in unnoticed
+    std::lock_guard<std::mutex> lock(mutex);
+    if (generation != this->generation) return true;
+    if (entries.size() >= maximumEntries)
+    {
+      Clear();
+      generation = this->generation;
+    }
+
+    if (!Watch(literal) || !Watch(real)) return true;
+  }
+
+  std::string verify;
+  if (!util::path::Realpath(literal, verify)) return false;
+  if (verify != real)
+  {
+    real.swap(verify);
+    return true;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex);
+  if (generation == this->generation)
+    entries.insert(std::make_pair(virtDir, Entry(literal, real)));
+  return true;
+}
+
+bool PathCache::ResolveDirectory(const std::string& virtDir, std::string& real)
+{
+  std::string sitepath(util::path::TrimTrailingSlashCopy(cfg::Get().Sitepath()));
+  if (!instance) return util::path::Realpath(util::path::Append(sitepath, virtDir), real);
+  return instance->Lookup(sitepath, virtDir, real);
+}
+
+void PathCache::HandleEvents(const char* buffer, ssize_t len)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  for (const char* p = buffer; p < buffer + len; )
+  {
+    const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(p);
+    p += sizeof(struct inotify_event) + event->len;
+
+    if (event->mask & IN_Q_OVERFLOW)
+    {
+      Clear();
+      continue;
+    }
+
+    auto it = watches.find(event->wd);
+    if (it == watches.end()) continue;
+
+    // copy, invalidating can remove the watch
+    std::vector<std::string> paths(it->second);
+    if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED))
+    {
+      for (const auto& path : paths) InvalidateUnder(path);
+    }
+    else
+    if (event->len > 0)
+    {
+      // only names that are part of a cached path matter
+      for (const auto& path : paths)
+      {
+        std::string child(util::path::Join(path, event->name));
+        if (watched.find(child) != watched.end()) InvalidateUnder(child);
+      }
+    }
+  }
+}
+
+void PathCache::Run()
+{
+  char buffer[16384] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+  while (true)
+  {
+    boost::this_thread::interruption_point();
+
+    struct pollfd pfd;
+    pfd.fd = inotifyFd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    int n = poll(&pfd, 1, 250);
+    if (n == 0) continue;
+
+    ssize_t len = n < 0 ? -1 : read(inotifyFd, buffer, sizeof(buffer));
+    if (len < 0)
+    {
+      if (errno == EINTR || errno == EAGAIN) continue;
+
+      logs::Error("Path cache disabled, inotify failure: %1%", util::Error::Failure(errno).Message());
+      std::lock_guard<std::mutex> lock(mutex);
+      failed = true;
+      Clear();
+      return;
+    }
+
+    HandleEvents(buffer, len);
+  }
+}
+
+void PathCache::Invalidate(const RealPath& path)
+{
+  if (!instance) return;
+  std::lock_guard<std::mutex> lock(instance->mutex);
+  if (instance->watched.find(path.ToString()) != instance->watched.end())
+    instance->InvalidateUnder(path.ToString());
+}
+
+void PathCache::Initialise()
+{
+  int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (fd < 0)
+  {
+    logs::Error("Path cache disabled, unable to initialise inotify: %1%",
+                util::Error::Failure(errno).Message());
+    return;
+  }
+
+  logs::Debug("Starting path cache thread..");
+  instance.reset(new PathCache(fd));
+  instance->thread = boost::thread(&PathCache::Run, instance.get());
+}
+
+void PathCache::Cleanup()
+{
+  if (!instance) return;
+
+  logs::Debug("Stopping path cache thread..");
+  instance->thread.interrupt();
+  instance->thread.join();
+  instance.reset();
+}
+
+#else
+
+bool PathCache::ResolveDirectory(const std::string& virtDir, std::string& real)
+{
+  return util::path::Realpath(util::path::Append(cfg::Get().Sitepath(), virtDir), real);
+}
+
+void PathCache::Invalidate(const RealPath&)
+{
+}
+
+void PathCache::Initialise()
+{
+}
+
+void PathCache::Cleanup()
+{
+}
+
+#endif
+
+} /* fs namespace */
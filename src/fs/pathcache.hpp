@@ -0,0 +1,70 @@
+#ifndef __FS_PATHCACHE_HPP
+#define __FS_PATHCACHE_HPP
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <boost/thread/thread.hpp>
+#include "fs/path.hpp"
+
+namespace fs
+{
+
+// server wide cache of resolved virtual directories to their symlink free
+// real paths. every directory along both the literal and the resolved
+// path is watched with inotify, a change to any of them drops the
+// affected entries
+class PathCache
+{
+  struct Entry
+  {
+    std::string literal;
+    std::string real;
+
+    Entry(const std::string& literal, const std::string& real) :
+      literal(literal), real(real) { }
+  };
+
+  int inotifyFd;
+  bool failed;
+  boost::thread thread;
+  std::mutex mutex;
+  std::string sitepath;
+  unsigned long long generation;
+  std::unordered_map<std::string, Entry> entries;
+  std::unordered_map<std::string, int> watched;
+  std::unordered_map<int, std::vector<std::string>> watches;
+
+  static std::unique_ptr<PathCache> instance;
+  static const size_t maximumEntries = 4096;
+
+  PathCache(int inotifyFd) : inotifyFd(inotifyFd), failed(false), generation(0) { }
+
+  void Run();
+  void HandleEvents(const char* buffer, ssize_t len);
+  bool Watch(std::string path);
+  void Unwatch(const std::string& path);
+  void InvalidateUnder(const std::string& path);
+  void Clear();
+
+  bool Lookup(const std::string& sitepath, const std::string& virtDir, std::string& real);
+  static bool ResolveDirectory(const std::string& virtDir, std::string& real);
+
+public:
+  ~PathCache();
+
+  // virtual path must already be absolute and normalised
+  static std::string Resolve(const std::string& virtPath);
+
+  // path was removed or renamed, drops anything resolved through it
+  static void Invalidate(const RealPath& path);
+
+  static void Initialise();
+  static void Cleanup();
+};
+
+} /* fs namespace */
+
+#endif
@@ -29,6 +29,7 @@
 #include "util/misc.hpp"
 #include "ftp/task/task.hpp"
 #include "ftp/online.hpp"
+#include "ftp/metrics.hpp"
 #include "fs/directory.hpp"
 
 namespace ftp
@@ -75,7 +76,7 @@ void ClientImpl::SetState(ClientState state)
                  logs::QuoteOn(), "user", user->Name(), 
                 "group", user->PrimaryGroup(), 
                 "tagline", user->Tagline());
-    OnlineWriter::Get().LoggedOut(boost::this_thread::get_id());
+    OnlineWriter::Get().LoggedOut();
   }
 }
 
@@ -117,7 +118,7 @@ void ClientImpl::SetLoggedIn(bool kicked)
               "group", user->PrimaryGroup(), 
               "tagline", user->Tagline());
               
-  OnlineWriter::Get().LoggedIn(boost::this_thread::get_id(), parent, fs::WorkDirectory().ToString());
+  OnlineWriter::Get().LoggedIn(parent, fs::WorkDirectory().ToString());
 }
 
 void ClientImpl::SetWaitingPassword(const acl::User& user, bool kickLogin)
@@ -200,9 +201,7 @@ void ClientImpl::DisplayBanner()
 
 void ClientImpl::IdleReset(std::string commandLine)
 {
-  for (auto & mask : cfg::Get().IdleCommands())
-    if (util::WildcardMatch(mask, commandLine, true))
-      return;
+  if (cfg::Get().IdleCommandMasks().MatchAny(commandLine)) return;
   idleTime = boost::posix_time::second_clock::local_time();
   idleExpires = idleTime + idleTimeout;
 }
@@ -223,7 +222,7 @@ void ClientImpl::ExecuteCommand(const std::string& commandLine)
   
   if (State() == ClientState::LoggedIn)
   {
-    OnlineWriter::Get().Command(boost::this_thread::get_id(), currentCommand);
+    OnlineWriter::Get().Command(currentCommand);
   }
   
   cmd::rfc::CommandDefOptRef def(cmd::rfc::Factory::Lookup(args[0]));
@@ -247,6 +246,7 @@ void ClientImpl::ExecuteCommand(const std::string& commandLine)
     }
     else
     {
+      CommandTimer timer(args[0]);
       try
       {
         command->Execute();
@@ -272,7 +272,7 @@ void ClientImpl::ExecuteCommand(const std::string& commandLine)
   
   if (State() == ClientState::LoggedIn)
   {
-    OnlineWriter::Get().Idle(boost::this_thread::get_id());
+    OnlineWriter::Get().Idle();
   }
 }
 
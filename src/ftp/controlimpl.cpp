@@ -11,6 +11,7 @@
 #include "logs/logs.hpp"
 #include "ftp/error.hpp"
 #include "ftp/util.hpp"
+#include "ftp/metrics.hpp"
 
 namespace ftp
 {
@@ -95,7 +96,16 @@ void ControlImpl::MultiReply(ReplyCode code, bool final, const std::string& mess
 
 void ControlImpl::NegotiateTLS()
 {
-  socket.HandshakeTLS(util::net::TLSSocket::Server);
+  try
+  {
+    socket.HandshakeTLS(util::net::TLSSocket::Server);
+  }
+  catch (...)
+  {
+    Metrics::Add(Metric::TLSFailures);
+    throw;
+  }
+  Metrics::Add(Metric::TLSHandshakes);
 }
 
 std::string ControlImpl::NextCommand(const boost::posix_time::time_duration* timeout)
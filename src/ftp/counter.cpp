@@ -29,8 +29,8 @@ long long DownloadSpeedLimit(const cfg::SpeedLimit& limit)
 }
 
 LoginCounter Counter::logins;
-TransferCounter Counter::uploads(MaximumUploads);
-TransferCounter Counter::downloads(MaximumDownloads);
+TransferCounter Counter::uploads(Occupancy::Uploads, MaximumUploads);
+TransferCounter Counter::downloads(Occupancy::Downloads, MaximumDownloads);
 SpeedCounter Counter::uploadSpeeds(UploadSpeedLimit);
 SpeedCounter Counter::downloadSpeeds(DownloadSpeedLimit);
 
@@ -12,6 +12,7 @@
 #include "cfg/get.hpp"
 #include "ftp/error.hpp"
 #include "ftp/control.hpp"
+#include "ftp/metrics.hpp"
 #include "util/verify.hpp"
 
 namespace util
@@ -201,7 +202,16 @@ void Data::Open(TransferType transferType)
         (transferType == TransferType::Upload ||
          transferType == TransferType::Download))
       role = util::net::TLSSocket::Client;  
-    socket.HandshakeTLS(role);
+    try
+    {
+      socket.HandshakeTLS(role);
+    }
+    catch (...)
+    {
+      Metrics::Add(Metric::TLSFailures);
+      throw;
+    }
+    Metrics::Add(Metric::TLSHandshakes);
   }
   
   state.Start(transferType);
@@ -2,6 +2,7 @@
 #include "ftp/logincounter.hpp"
 #include "cfg/get.hpp"
 #include "ftp/counter.hpp"
+#include "ftp/metrics.hpp"
 
 namespace ftp
 {
@@ -22,6 +23,7 @@ CounterResult LoginCounter::Start(acl::UserID uid, int limit, bool kickLogin, bo
   }
   ++count;
   ++global;
+  Metrics::Set(Occupancy::Logins, global);
   return CounterResult::Okay;
 }
 
@@ -33,6 +35,7 @@ void LoginCounter::Stop(acl::UserID uid)
   --count;
   assert(global > 0);
   --global;
+  Metrics::Set(Occupancy::Logins, global);
 }
 
 int LoginCounter::GlobalCount() const
@@ -0,0 +1,244 @@
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <thread>
+#include <functional>
+#if defined(__linux__)
+# include <sched.h>
+#endif
+#include <boost/interprocess/shared_memory_object.hpp>
+#include "ftp/metrics.hpp"
+#include "logs/logs.hpp"
+
+using namespace boost::interprocess;
+
+namespace ftp
+{
+
+namespace
+{
+
+// sorted for lookup, anything else is counted as the last entry
+const char* verbs[] =
+{
+  "ABOR", "ACCT", "ADAT", "ALLO", "APPE", "AUTH", "CCC",  "CDUP", "CPSV", "CWD",
+  "DELE", "ENC",  "EPRT", "EPSV", "FEAT", "HELP", "LANG", "LIST", "LPRT", "LPSV",
+  "MDTM", "MFCT", "MFF",  "MFMT", "MIC",  "MKD",  "MLSD", "MLST", "MODE", "NLST",
+  "NOOP", "OPTS", "PASS", "PASV", "PBSZ", "PORT", "PROT", "PWD",  "QUIT", "REIN",
+  "REST", "RETR", "RMD",  "RNFR", "RNTO", "SITE", "SIZE", "SMNT", "SSCN", "STAT",
+  "STOR", "STOU", "STRU", "SYST", "TYPE", "USER",
+  "OTHER"
+};
+
+static_assert(sizeof(verbs) / sizeof(verbs[0]) == MetricsShard::numVerbs,
+              "verb table doesn't match the shard layout");
+
+const unsigned maximumShards = 64;
+const uint32_t shardsOffset = 64;
+
+static_assert(sizeof(MetricsHeader) <= shardsOffset, "metrics header overlaps the shards");
+
+}
+
+std::unique_ptr<Metrics> Metrics::instance;
+
+Metrics::~Metrics()
+{
+  shared_memory_object::remove(id.c_str());
+}
+
+MetricsShard& Metrics::Shard()
+{
+#if defined(__linux__)
+  int cpu = sched_getcpu();
+  if (cpu >= 0) return shards[cpu % shardCount];
+#endif
+  return shards[std::hash<std::thread::id>()(std::this_thread::get_id()) % shardCount];
+}
+
+void Metrics::Record(MetricsHistogram& histogram, long long microseconds)
+{
+  if (microseconds < 0) microseconds = 0;
+
+  unsigned i = 0;
+  while (i < MetricsHistogram::numBuckets - 1 &&
+         microseconds > db::LatencyHistogram::bucketBounds[i]) ++i;
+  histogram.buckets[i].fetch_add(1, std::memory_order_relaxed);
+  histogram.count.fetch_add(1, std::memory_order_relaxed);
+  histogram.total.fetch_add(microseconds, std::memory_order_relaxed);
+}
+
+void Metrics::Command(unsigned verb, long long microseconds)
+{
+  if (!instance) return;
+  MetricsShard& shard = instance->Shard();
+  shard.counters[static_cast<unsigned>(Metric::Commands)].fetch_add(1, std::memory_order_relaxed);
+  Record(shard.commands[verb], microseconds);
+}
+
+void Metrics::Database(db::Operation op, long long microseconds)
+{
+  if (!instance) return;
+  Record(instance->Shard().database[static_cast<unsigned>(op)], microseconds);
+}
+
+unsigned Metrics::VerbIndex(const std::string& verb)
+{
+  static const unsigned other = MetricsShard::numVerbs - 1;
+  auto it = std::lower_bound(std::begin(verbs), std::begin(verbs) + other, verb,
+                             [](const char* a, const std::string& b) { return b.compare(a) > 0; });
+  if (it == std::begin(verbs) + other || verb != *it) return other;
+  return it - std::begin(verbs);
+}
+
+const char* Metrics::VerbName(unsigned index)
+{
+  return verbs[std::min(index, MetricsShard::numVerbs - 1)];
+}
+
+std::string Metrics::MetricName(Metric metric)
+{
+  switch (metric)
+  {
+    case Metric::BytesIn            : return "bytes_in";
+    case Metric::BytesOut           : return "bytes_out";
+    case Metric::UploadsStarted     : return "uploads_started";
+    case Metric::UploadsFinished    : return "uploads_finished";
+    case Metric::UploadsAborted     : return "uploads_aborted";
+    case Metric::DownloadsStarted   : return "downloads_started";
+    case Metric::DownloadsFinished  : return "downloads_finished";
+    case Metric::DownloadsAborted   : return "downloads_aborted";
+    case Metric::TLSHandshakes      : return "tls_handshakes";
+    case Metric::TLSFailures        : return "tls_failures";
+    case Metric::Commands           : return "commands";
+  }
+  return "unknown";
+}
+
+std::string Metrics::OccupancyName(Occupancy occupancy)
+{
+  switch (occupancy)
+  {
+    case Occupancy::Logins     : return "logins";
+    case Occupancy::Uploads    : return "uploads";
+    case Occupancy::Downloads  : return "downloads";
+  }
+  return "unknown";
+}
+
+void Metrics::Initialise(const std::string& id)
+{
+  unsigned shardCount = std::max(1u, std::min(std::thread::hardware_concurrency(), maximumShards));
+  std::unique_ptr<Metrics> metrics(new Metrics(id));
+  try
+  {
+    shared_memory_object::remove(id.c_str());
+    shared_memory_object shm(create_only, id.c_str(), read_write);
+    shm.truncate(shardsOffset + sizeof(MetricsShard) * shardCount);
+    mapped_region(shm, read_write).swap(metrics->region);
+  }
+  catch (const interprocess_exception& e)
+  {
+    logs::Error("Metrics segment failed to initialise: %1%", e.what());
+    return;
+  }
+
+  char* base = static_cast<char*>(metrics->region.get_address());
+  metrics->header = reinterpret_cast<MetricsHeader*>(base);
+  metrics->shards = reinterpret_cast<MetricsShard*>(base + shardsOffset);
+  metrics->shardCount = shardCount;
+
+  // the mapping is zero filled, which is what every counter starts at
+  MetricsHeader* header = metrics->header;
+  header->shardSize = sizeof(MetricsShard);
+  header->shardCount = shardCount;
+  header->shardsOffset = shardsOffset;
+  header->headerVersion = MetricsHeader::version;
+  std::atomic_thread_fence(std::memory_order_release);
+  header->headerMagic = MetricsHeader::magic;
+
+  instance = std::move(metrics);
+}
+
+void Metrics::Cleanup()
+{
+  instance = nullptr;
+}
+
+MetricsSnapshot::Histogram::Histogram() :
+  count(0), total(0)
+{
+  std::fill(std::begin(buckets), std::end(buckets), 0);
+}
+
+void MetricsSnapshot::Histogram::Add(const MetricsHistogram& histogram)
+{
+  for (unsigned i = 0; i < MetricsHistogram::numBuckets; ++i)
+    buckets[i] += histogram.buckets[i].load(std::memory_order_relaxed);
+  count += histogram.count.load(std::memory_order_relaxed);
+  total += histogram.total.load(std::memory_order_relaxed);
+}
+
+MetricsSnapshot::MetricsSnapshot()
+{
+  std::fill(std::begin(counters), std::end(counters), 0);
+  std::fill(std::begin(occupancy), std::end(occupancy), 0);
+}
+
+MetricsReader::MetricsReader(const std::string& id) :
+  header(nullptr), shards(nullptr)
+{
+  try
+  {
+    shared_memory_object shm(open_only, id.c_str(), read_only);
+    region.reset(new mapped_region(shm, read_only));
+  }
+  catch (const interprocess_exception& e)
+  {
+    // server must not be loaded
+    return;
+  }
+
+  if (region->get_size() < sizeof(MetricsHeader)) return;
+
+  const char* base = static_cast<const char*>(region->get_address());
+  header = reinterpret_cast<const MetricsHeader*>(base);
+  if (header->headerMagic != MetricsHeader::magic) return;
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (header->headerVersion != MetricsHeader::version ||
+      header->shardSize != sizeof(MetricsShard) ||
+      region->get_size() < static_cast<size_t>(header->shardsOffset) +
+                           sizeof(MetricsShard) * header->shardCount)
+    return;
+
+  shards = reinterpret_cast<const MetricsShard*>(base + header->shardsOffset);
+}
+
+MetricsSnapshot MetricsReader::Snapshot() const
+{
+  MetricsSnapshot snapshot;
+  if (!shards) return snapshot;
+
+  for (unsigned i = 0; i < MetricsHeader::numOccupancies; ++i)
+    snapshot.occupancy[i] = header->occupancy[i].load(std::memory_order_relaxed);
+
+  for (unsigned s = 0; s < header->shardCount; ++s)
+  {
+    const MetricsShard& shard = shards[s];
+    for (unsigned i = 0; i < MetricsShard::numMetrics; ++i)
+      snapshot.counters[i] += shard.counters[i].load(std::memory_order_relaxed);
+    for (unsigned i = 0; i < MetricsShard::numVerbs; ++i)
+      snapshot.commands[i].Add(shard.commands[i]);
+    for (unsigned i = 0; i < MetricsShard::numOperations; ++i)
+      snapshot.database[i].Add(shard.database[i]);
+  }
+
+  return snapshot;
+}
+
+std::string MetricsSharedMemoryID(const std::string& onlineID)
+{
+  return onlineID + "-metrics";
+}
+
+} /* ftp namespace */
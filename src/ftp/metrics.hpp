@@ -0,0 +1,173 @@
+#ifndef __FTP_METRICS_HPP
+#define __FTP_METRICS_HPP
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include "db/connectionstats.hpp"
+
+namespace ftp
+{
+
+enum class Metric : unsigned
+{
+  BytesIn,
+  BytesOut,
+  UploadsStarted,
+  UploadsFinished,
+  UploadsAborted,
+  DownloadsStarted,
+  DownloadsFinished,
+  DownloadsAborted,
+  TLSHandshakes,
+  TLSFailures,
+  Commands
+};
+
+enum class Occupancy : unsigned
+{
+  Logins,
+  Uploads,
+  Downloads
+};
+
+// same buckets as the database connection stats
+struct MetricsHistogram
+{
+  static const unsigned numBuckets = db::LatencyHistogram::numBuckets;
+
+  std::atomic<unsigned long long> buckets[numBuckets];
+  std::atomic<unsigned long long> count;
+  std::atomic<unsigned long long> total;
+};
+
+// one per core, writers only ever touch the shard of the core they're on
+struct alignas(64) MetricsShard
+{
+  static const unsigned numMetrics = static_cast<unsigned>(Metric::Commands) + 1;
+  static const unsigned numVerbs = 57; // every rfc command and one for the rest
+  static const unsigned numOperations = static_cast<unsigned>(db::Operation::LastError) + 1;
+
+  std::atomic<unsigned long long> counters[numMetrics];
+  MetricsHistogram commands[numVerbs];
+  MetricsHistogram database[numOperations];
+};
+
+struct MetricsHeader
+{
+  static const uint32_t magic = 0x6562666d; // "ebfm"
+  static const uint32_t version = 1;
+  static const unsigned numOccupancies = static_cast<unsigned>(Occupancy::Downloads) + 1;
+
+  uint32_t headerMagic;
+  uint32_t headerVersion;
+  uint32_t shardSize;
+  uint32_t shardCount;
+  uint32_t shardsOffset;
+  std::atomic<long long> occupancy[numOccupancies];
+};
+
+// counters and histograms published to a shared memory segment for
+// tools/metrics, updates are relaxed atomic adds to a per core shard
+class Metrics
+{
+  std::string id;
+  boost::interprocess::mapped_region region;
+  MetricsHeader* header;
+  MetricsShard* shards;
+  unsigned shardCount;
+
+  static std::unique_ptr<Metrics> instance;
+
+  Metrics(const std::string& id) : id(id), header(nullptr), shards(nullptr), shardCount(0) { }
+
+  MetricsShard& Shard();
+  static void Record(MetricsHistogram& histogram, long long microseconds);
+
+public:
+  ~Metrics();
+
+  static void Add(Metric metric, unsigned long long n = 1)
+  {
+    if (instance)
+      instance->Shard().counters[static_cast<unsigned>(metric)].fetch_add(n, std::memory_order_relaxed);
+  }
+
+  static void Set(Occupancy occupancy, long long value)
+  {
+    if (instance)
+      instance->header->occupancy[static_cast<unsigned>(occupancy)].store(value, std::memory_order_relaxed);
+  }
+
+  static void Command(unsigned verb, long long microseconds);
+  static void Database(db::Operation op, long long microseconds);
+
+  static void Initialise(const std::string& id);
+  static void Cleanup();
+
+  static unsigned VerbIndex(const std::string& verb);
+  static const char* VerbName(unsigned index);
+  static std::string MetricName(Metric metric);
+  static std::string OccupancyName(Occupancy occupancy);
+};
+
+class CommandTimer
+{
+  unsigned verb;
+  boost::posix_time::ptime start;
+
+public:
+  CommandTimer(const std::string& verb) :
+    verb(Metrics::VerbIndex(verb)), 
+    start(boost::posix_time::microsec_clock::universal_time()) { }
+
+  ~CommandTimer()
+  {
+    auto elapsed = boost::posix_time::microsec_clock::universal_time() - start;
+    Metrics::Command(verb, elapsed.total_microseconds());
+  }
+};
+
+struct MetricsSnapshot
+{
+  struct Histogram
+  {
+    unsigned long long buckets[MetricsHistogram::numBuckets];
+    unsigned long long count;
+    unsigned long long total;
+
+    Histogram();
+    void Add(const MetricsHistogram& histogram);
+  };
+
+  unsigned long long counters[MetricsShard::numMetrics];
+  long long occupancy[MetricsHeader::numOccupancies];
+  Histogram commands[MetricsShard::numVerbs];
+  Histogram database[MetricsShard::numOperations];
+
+  MetricsSnapshot();
+};
+
+// sums every shard, counters are monotonic so a snapshot can be taken
+// at any time without coordinating with the daemon
+class MetricsReader
+{
+  std::unique_ptr<boost::interprocess::mapped_region> region;
+  const MetricsHeader* header;
+  const MetricsShard* shards;
+
+public:
+  MetricsReader(const std::string& id);
+
+  bool Valid() const { return shards != nullptr; }
+  MetricsSnapshot Snapshot() const;
+};
+
+std::string MetricsSharedMemoryID(const std::string& onlineID);
+
+} /* ftp namespace */
+
+#endif
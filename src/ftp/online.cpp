@@ -1,4 +1,6 @@
+#include <algorithm>
 #include <cstring>
+#include <new>
 #include <sstream>
 #include <fstream>
 #include "ftp/online.hpp"
@@ -12,18 +14,6 @@ using namespace boost::interprocess;
 namespace ftp
 {
 
-namespace
-{
-long ThreadIdToLong(const boost::thread::id& tid)
-{
-  std::stringstream ss;
-  ss << tid;
-  long ltid;
-  ss >> std::hex >> ltid;
-  return ltid;
-}
-}
-
 std::unique_ptr<OnlineWriter> OnlineWriter::instance;
 boost::posix_time::milliseconds OnlineTransferUpdater::interval(10);
 
@@ -34,228 +24,451 @@ OnlineXfer::OnlineXfer(stats::Direction direction, const boost::posix_time::ptim
 {
 }
 
-OnlineClient::OnlineClient(
-      acl::UserID uid, const std::string& ident, 
-      const std::string& ip, const std::string& hostname,
-      const std::string& workDir) :
-  uid(uid), 
-  lastCommand(boost::posix_time::second_clock::local_time()),
-  command{0}
+OnlineWriter::OnlineWriter(const std::string& id, int maxClients) :
+  id(id), slots(nullptr), generations(nullptr), arena(nullptr), 
+  blockCount(0), nextGeneration(0)
 {
-  strncpy(this->ident, ident.c_str(), sizeof(this->ident));
-  strncpy(this->ip, ip.c_str(), sizeof(this->ip));
-  strncpy(this->hostname, hostname.c_str(), sizeof(this->hostname));
-  strncpy(this->workDir, workDir.c_str(), sizeof(this->workDir));
+  OpenSharedMemory(maxClients);
 }
 
-OnlineData::OnlineData(boost::interprocess::managed_shared_memory& segment, int maxClients) :
-  clients(maxClients, std::hash<long>(), std::equal_to<long>(), segment.get_allocator<ShmOnlineMap::mapped_type>())
+namespace
+{
+
+const size_t lengthSize = sizeof(uint16_t);
+
+uint32_t Align(uint32_t offset)
 {
+  return (offset + 63) & ~63;
 }
 
-OnlineWriter::OnlineWriter(const std::string& id, int maxClients) :
-  id(id), data(nullptr)
+int RunClass(uint32_t blocks)
 {
-  OpenSharedMemory(maxClients);
+  int cls = 0;
+  while ((1u << cls) < blocks) ++cls;
+  return cls;
+}
+
 }
 
 void OnlineWriter::OpenSharedMemory(int maxClients)
-{  
+{
+  // always room for one of the largest strings on top of the average,
+  // rounded to whole runs of the largest class
+  const uint32_t largestRun = 1 << (runClasses - 1);
+  blockCount = maxClients * blocksPerClient + largestRun;
+  blockCount = (blockCount + largestRun - 1) & ~(largestRun - 1);
+  
+  uint32_t slotsOffset = Align(sizeof(OnlineHeader));
+  uint32_t generationsOffset = Align(slotsOffset + sizeof(OnlineSlot) * maxClients);
+  uint32_t arenaOffset = Align(generationsOffset + sizeof(std::atomic<uint32_t>) * blockCount);
+  
   try
   {
-    segment.reset(new managed_shared_memory(open_or_create, id.c_str(), clientSize * (maxClients + 1)));
-
-    segment->construct<OnlineData>("online")(*segment, maxClients);
-    data = segment->find<OnlineData>("online").first;
-    if (!data) throw util::SystemError(ENOMEM);
-    scoped_lock<interprocess_mutex> lock(data->mutex);
-    data->clients.clear();
+    shared_memory_object::remove(id.c_str());
+    shared_memory_object shm(create_only, id.c_str(), read_write);
+    shm.truncate(arenaOffset + OnlineHeader::blockSize * blockCount);
+    mapped_region(shm, read_write).swap(region);
   }
   catch (const interprocess_exception& e)
   {
     throw util::SystemError(ENOMEM);
   }
+
+  char* base = static_cast<char*>(region.get_address());
+  slots = reinterpret_cast<OnlineSlot*>(base + slotsOffset);
+  generations = reinterpret_cast<std::atomic<uint32_t>*>(base + generationsOffset);
+  arena = base + arenaOffset;
+  
+  for (uint32_t i = 0; i < blockCount; ++i)
+  {
+    new (&generations[i]) std::atomic<uint32_t>(0);
+  }
+  
+  for (uint32_t i = 0; i < blockCount; i += largestRun)
+  {
+    freeRuns[runClasses - 1].insert(i);
+  }
+  
+  freeSlots.reserve(maxClients);
+  runs.resize(maxClients);
+  for (int i = maxClients - 1; i >= 0; --i)
+  {
+    new (&slots[i]) OnlineSlot();
+    slots[i].sequence = 0;
+    slots[i].data.used = false;
+    freeSlots.emplace_back(i);
+  }
+
+  // header last, readers check it before touching anything else
+  OnlineHeader* header = reinterpret_cast<OnlineHeader*>(base);
+  header->slotSize = sizeof(OnlineSlot);
+  header->maxClients = maxClients;
+  header->headerBlockSize = OnlineHeader::blockSize;
+  header->blockCount = blockCount;
+  header->slotsOffset = slotsOffset;
+  header->generationsOffset = generationsOffset;
+  header->arenaOffset = arenaOffset;
+  header->headerVersion = OnlineHeader::version;
+  std::atomic_thread_fence(std::memory_order_release);
+  header->headerMagic = OnlineHeader::magic;
 }
 
 OnlineWriter::~OnlineWriter()
 {
-  segment = nullptr;
   shared_memory_object::remove(id.c_str());
 }
 
-void OnlineWriter::LoggedIn(long tid, Client& client, const std::string& workDir)
+template <typename Function>
+void OnlineWriter::Write(int slot, Function&& function)
 {
-  scoped_lock<interprocess_mutex> lock(data->mutex);
-  data->clients.insert(std::make_pair(tid, OnlineClient(client.User().ID(), client.Ident(), 
-              client.IP(), client.Hostname(), workDir)));  
+  OnlineSlot& s = slots[slot];
+  uint32_t sequence = s.sequence.load(std::memory_order_relaxed);
+  s.sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  function(s.data);
+  s.sequence.store(sequence + 2, std::memory_order_release);
 }
 
-void OnlineWriter::LoggedIn(const boost::thread::id& tid, Client& client, const std::string& workDir)
+bool OnlineWriter::Allocate(uint32_t blocks, Run& run)
 {
-  LoggedIn(ThreadIdToLong(tid), client, workDir);
-}
-
-void OnlineWriter::LoggedOut(long tid)
-{
-  scoped_lock<interprocess_mutex> lock(data->mutex);
-  data->clients.erase(tid);
+  int cls = RunClass(blocks);
+  
+  std::lock_guard<std::mutex> lock(mutex);
+  int larger = cls;
+  while (larger < runClasses && freeRuns[larger].empty()) ++larger;
+  if (larger == runClasses) return false;
+  
+  uint32_t block = *freeRuns[larger].begin();
+  freeRuns[larger].erase(freeRuns[larger].begin());
+  
+  // split down to the size wanted, freeing the upper halves
+  while (larger > cls)
+  {
+    --larger;
+    freeRuns[larger].insert(block + (1 << larger));
+  }
+  
+  run.block = block;
+  run.blocks = 1 << cls;
+  return true;
 }
 
-void OnlineWriter::LoggedOut(const boost::thread::id& tid)
+void OnlineWriter::Free(Run& run)
 {
-  LoggedOut(ThreadIdToLong(tid));
+  if (run.blocks == 0) return;
+  
+  int cls = RunClass(run.blocks);
+  uint32_t block = run.block;
+  run = Run();
+  
+  std::lock_guard<std::mutex> lock(mutex);
+  while (cls < runClasses - 1)
+  {
+    auto it = freeRuns[cls].find(block ^ (1 << cls));
+    if (it == freeRuns[cls].end()) break;
+    freeRuns[cls].erase(it);
+    block &= ~(1 << cls);
+    ++cls;
+  }
+  
+  freeRuns[cls].insert(block);
 }
 
-void OnlineWriter::Command(long tid, const std::string& command)
+// a string that fits is rewritten in place, the new generation tells
+// readers part way through copying the old one to start again. strings
+// are truncated if the arena is exhausted
+OnlineString OnlineWriter::Store(int slot, int field, const std::string& str)
 {
-  scoped_lock<interprocess_mutex> lock(data->mutex);
-  auto it = data->clients.find(tid);
-  verify(it != data->clients.end());
-  strncpy(it->second.command, command.c_str(), sizeof(it->second.command));
+  static const size_t maximumLength = 
+      (1 << (runClasses - 1)) * OnlineHeader::blockSize - lengthSize;
+  
+  OnlineString ref = OnlineString();
+  Run& run = runs[slot][field];
+  size_t length = std::min(str.length(), maximumLength);
+  uint32_t blocks = (length + lengthSize + OnlineHeader::blockSize - 1) / OnlineHeader::blockSize;
+  if (length > 0 && blocks > run.blocks)
+  {
+    Run larger;
+    if (Allocate(blocks, larger))
+    {
+      Free(run);
+      run = larger;
+    }
+    else
+    if (run.blocks > 0)
+      length = run.blocks * OnlineHeader::blockSize - lengthSize;
+    else
+      length = 0;
+  }
+  
+  if (length == 0) return ref;
+  
+  ref.block = run.block;
+  ref.generation = ++nextGeneration;
+  if (ref.generation == 0) ref.generation = ++nextGeneration;
+  
+  for (uint32_t i = run.block; i < run.block + run.blocks; ++i)
+  {
+    generations[i].store(ref.generation, std::memory_order_relaxed);
+  }
+  
+  std::atomic_thread_fence(std::memory_order_release);
+  uint16_t length16 = length;
+  char* dest = arena + run.block * OnlineHeader::blockSize;
+  memcpy(dest, &length16, lengthSize);
+  memcpy(dest + lengthSize, str.data(), length);
+  return ref;
 }
 
-void OnlineWriter::Command(const boost::thread::id& tid, const std::string& command)
+void OnlineWriter::LoggedIn(Client& client, const std::string& workDir)
 {
-  Command(ThreadIdToLong(tid), command);
+  int slot;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (freeSlots.empty()) return;
+    slot = freeSlots.back();
+    freeSlots.pop_back();
+  }
+  
+  threadSlot.reset(new int(slot));
+  
+  std::string identity(client.Ident());
+  identity += '\0';
+  identity += client.IP();
+  identity += '\0';
+  identity += client.Hostname();
+  
+  OnlineString identityRef = Store(slot, OnlineSlot::Identity, identity);
+  OnlineString workDirRef = Store(slot, OnlineSlot::WorkDir, workDir);
+  OnlineString commandRef = Store(slot, OnlineSlot::Command, "");
+  
+  Write(slot, [&](OnlineSlot::Data& data)
+    {
+      data.used = true;
+      data.transferring = false;
+      data.uid = client.User().ID();
+      data.lastCommand = boost::posix_time::second_clock::local_time();
+      data.strings[OnlineSlot::Identity] = identityRef;
+      data.strings[OnlineSlot::WorkDir] = workDirRef;
+      data.strings[OnlineSlot::Command] = commandRef;
+    });
+}
+
+void OnlineWriter::LoggedOut()
+{
+  int slot = Slot();
+  if (slot < 0) return;
+  
+  Write(slot, [](OnlineSlot::Data& data) { data.used = false; });
+  threadSlot.reset();
+  
+  for (auto& run : runs[slot]) Free(run);
+  
+  std::lock_guard<std::mutex> lock(mutex);
+  freeSlots.emplace_back(slot);
 }
 
-void OnlineWriter::Idle(long tid)
+void OnlineWriter::Command(const std::string& command)
 {
-  scoped_lock<interprocess_mutex> lock(data->mutex);
-  auto it = data->clients.find(tid);
-  verify(it != data->clients.end());
-  it->second.command[0] = '\0';
-  it->second.lastCommand = boost::posix_time::second_clock::local_time();
+  int slot = Slot();
+  if (slot < 0) return;
+  
+  OnlineString ref = Store(slot, OnlineSlot::Command, command);
+  Write(slot, [&](OnlineSlot::Data& data)
+    {
+      data.strings[OnlineSlot::Command] = ref;
+    });
 }
 
-void OnlineWriter::Idle(const boost::thread::id& tid)
+void OnlineWriter::Idle()
 {
-  Idle(ThreadIdToLong(tid));
+  int slot = Slot();
+  if (slot < 0) return;
+  
+  Write(slot, [](OnlineSlot::Data& data)
+    {
+      data.strings[OnlineSlot::Command] = OnlineString();
+      data.lastCommand = boost::posix_time::second_clock::local_time();
+    });
 }
 
-void OnlineWriter::StartTransfer(long tid, stats::Direction direction, 
+void OnlineWriter::StartTransfer(int slot, stats::Direction direction, 
                                  const boost::posix_time::ptime& start)
 {
-  scoped_lock<interprocess_mutex> lock(data->mutex);
-  auto it = data->clients.find(tid);
-  verify(it != data->clients.end());
-  it->second.xfer.reset(OnlineXfer(direction, start));
-}
-
-void OnlineWriter::TransferUpdate(long tid, long long bytes)
-{
-  scoped_lock<interprocess_mutex> lock(data->mutex);
-  auto it = data->clients.find(tid);
-  verify(it != data->clients.end());
-  assert(it->second.xfer);
-  it->second.xfer->bytes = bytes;
-}
-
-void OnlineWriter::StopTransfer(long tid)
-{
-  scoped_lock<interprocess_mutex> lock(data->mutex);
-  auto it = data->clients.find(tid);
-  verify(it != data->clients.end());
-  assert(it->second.xfer);
-  it->second.xfer = boost::none;
+  Write(slot, [&](OnlineSlot::Data& data)
+    {
+      data.transferring = true;
+      data.direction = static_cast<uint8_t>(direction);
+      data.xferStart = start;
+      data.xferBytes = 0;
+    });
 }
 
-OnlineReaderIterator::OnlineReaderIterator(const OnlineReader* const reader) :
-  reader(reader)
+void OnlineWriter::TransferUpdate(int slot, long long bytes)
 {
-  if (reader && reader->data) iter.reset(reader->data->clients.begin());
+  Write(slot, [bytes](OnlineSlot::Data& data) { data.xferBytes = bytes; });
 }
 
-OnlineReaderIterator::OnlineReaderIterator(const OnlineReader* const reader, bool /* end */) :
-  reader(reader)
+void OnlineWriter::StopTransfer(int slot)
 {
-  if (reader && reader->data) iter.reset(reader->data->clients.end());
+  Write(slot, [](OnlineSlot::Data& data) { data.transferring = false; });
 }
 
-OnlineReaderIterator& OnlineReaderIterator::operator++()
+OnlineReaderIterator::OnlineReaderIterator(const OnlineReader* reader, int slot) :
+  reader(reader), slot(slot)
 {
-  client = boost::none;
-  verify(iter && reader && reader->locked);
-  ++(*iter);
-  return *this;
+  Next();
 }
 
-OnlineReaderIterator OnlineReaderIterator::operator++(int)
+void OnlineReaderIterator::Next()
 {
-  client = boost::none;
-  verify(iter && reader && reader->locked);
-  OnlineReaderIterator temp(*this);
-  ++(*iter);
-  return temp;
+  while (slot < reader->maxClients && !reader->Read(slot, client)) ++slot;
 }
 
 OnlineReader::OnlineReader(const std::string& id) :    
-  data(nullptr), locked(false)
+  slots(nullptr), generations(nullptr), arena(nullptr), blockCount(0), maxClients(0)
 {
   try
   {
-    segment.reset(new managed_shared_memory(open_only, id.c_str()));
-    data = segment->find<OnlineData>("online").first;
+    shared_memory_object shm(open_only, id.c_str(), read_only);
+    region.reset(new mapped_region(shm, read_only));
   }
   catch (const boost::interprocess::interprocess_exception& e)
   {
     // server must not be loaded, reader is empty
+    return;
   }
+  
+  if (region->get_size() < sizeof(OnlineHeader)) return;
+
+  const char* base = static_cast<const char*>(region->get_address());
+  const OnlineHeader* header = reinterpret_cast<const OnlineHeader*>(base);
+  if (header->headerMagic != OnlineHeader::magic) return;
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (header->headerVersion != OnlineHeader::version ||
+      header->slotSize != sizeof(OnlineSlot) ||
+      header->headerBlockSize != OnlineHeader::blockSize ||
+      region->get_size() < static_cast<size_t>(header->arenaOffset) + 
+                           OnlineHeader::blockSize * header->blockCount)
+    return;
+
+  slots = reinterpret_cast<const OnlineSlot*>(base + header->slotsOffset);
+  generations = reinterpret_cast<const std::atomic<uint32_t>*>(base + header->generationsOffset);
+  arena = base + header->arenaOffset;
+  blockCount = header->blockCount;
+  maxClients = header->maxClients;
+}
+
+// false if the string was changed while being copied
+bool OnlineReader::Copy(const OnlineString& ref, std::string& str) const
+{
+  if (ref.generation == 0)
+  {
+    str.clear();
+    return true;
+  }
+  
+  if (ref.block >= blockCount) return false;
+  
+  // the length may be torn too, it's only trusted once the generations match
+  const char* source = arena + ref.block * OnlineHeader::blockSize;
+  uint16_t length;
+  memcpy(&length, source, lengthSize);
+  uint32_t blocks = (length + lengthSize + OnlineHeader::blockSize - 1) / OnlineHeader::blockSize;
+  if (ref.block + blocks > blockCount) return false;
+  
+  str.assign(source + lengthSize, length);
+  std::atomic_thread_fence(std::memory_order_acquire);
+  for (uint32_t i = ref.block; i < ref.block + blocks; ++i)
+  {
+    if (generations[i].load(std::memory_order_relaxed) != ref.generation) return false;
+  }
+  return true;
 }
 
-OnlineReader::~OnlineReader()
+bool OnlineReader::Read(int slot, OnlineClient& client) const
 {
-  segment = nullptr;
-  shared_memory_object::remove(id.c_str());
+  // a writer that died mid write leaves its slot odd forever
+  static const int maximumAttempts = 10000;
+  
+  const OnlineSlot& s = slots[slot];
+  OnlineSlot::Data data;
+  std::string identity;
+  int attempts = 0;
+  while (true)
+  {
+    if (++attempts > maximumAttempts) return false;
+    if (attempts > 1) boost::this_thread::yield();
+  
+    uint32_t before = s.sequence.load(std::memory_order_acquire);
+    if (before & 1) continue;
+    
+    memcpy(&data, &s.data, sizeof(data));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (s.sequence.load(std::memory_order_relaxed) != before) continue;
+    if (!data.used) return false;
+    
+    if (Copy(data.strings[OnlineSlot::Identity], identity) &&
+        Copy(data.strings[OnlineSlot::WorkDir], client.workDir) &&
+        Copy(data.strings[OnlineSlot::Command], client.command))
+      break;
+  }
+  
+  std::string::size_type ipPos = identity.find('\0');
+  std::string::size_type hostnamePos = ipPos == std::string::npos ? 
+                                       ipPos : identity.find('\0', ipPos + 1);
+  client.ident.assign(identity, 0, ipPos);
+  client.ip.clear();
+  client.hostname.clear();
+  if (ipPos != std::string::npos)
+    client.ip.assign(identity, ipPos + 1, hostnamePos - ipPos - 1);
+  if (hostnamePos != std::string::npos)
+    client.hostname.assign(identity, hostnamePos + 1, std::string::npos);
+  
+  client.uid = data.uid;
+  client.lastCommand = data.lastCommand;
+  client.xfer = boost::none;
+  if (data.transferring)
+  {
+    client.xfer.reset(OnlineXfer(static_cast<stats::Direction>(data.direction), data.xferStart));
+    client.xfer->bytes = data.xferBytes;
+  }
+  
+  return true;
 }
 
 OnlineReaderIterator OnlineReader::begin() const
 {
-  verify(locked);
-  return OnlineReaderIterator(this);
+  return OnlineReaderIterator(this, 0);
 }
 
 OnlineReaderIterator OnlineReader::end() const
 {
-  verify(locked);
-  return OnlineReaderIterator(this, true);
+  return OnlineReaderIterator(this, maxClients);
 }
 
 OnlineReader::size_type OnlineReader::size() const
 {
-  if (!data) return 0;
-  if (locked) return data->clients.size();
-  else
+  OnlineClient client;
+  size_type count = 0;
+  for (int i = 0; i < maxClients; ++i)
   {
-    scoped_lock<interprocess_mutex> lock(data->mutex);
-    return data->clients.size();
+    if (Read(i, client)) ++count;
   }
+  return count;
 }
 
-void OnlineReader::Lock() const
-{
-  locked = true;
-  if (data) data->mutex.lock();
-}
-
-void OnlineReader::Unlock() const
-{
-  locked = false;
-  if (data) data->mutex.unlock();
-}
-
-OnlineTransferUpdater::OnlineTransferUpdater(
-        const boost::thread::id& tid, stats::Direction direction,
+OnlineTransferUpdater::OnlineTransferUpdater(stats::Direction direction, 
         const boost::posix_time::ptime& start) :
-  tid(ThreadIdToLong(tid)),
+  slot(OnlineWriter::Get().Slot()),
   nextUpdate(start)
 {
-  OnlineWriter::Get().StartTransfer(this->tid, direction, start);
+  if (slot >= 0) OnlineWriter::Get().StartTransfer(slot, direction, start);
 }
 
 OnlineTransferUpdater::~OnlineTransferUpdater()
 {
-  OnlineWriter::Get().StopTransfer(tid);
+  if (slot >= 0) OnlineWriter::Get().StopTransfer(slot);
 }
 
 std::string SharedMemoryID(pid_t pid)
@@ -1,22 +1,21 @@
+#ifndef __FTP_ONLINE_HPP
+#define __FTP_ONLINE_HPP
+
+#include <array>
+#include <atomic>
 #include <iterator>
-#include <boost/interprocess/sync/interprocess_mutex.hpp>
-#include <boost/interprocess/sync/scoped_lock.hpp>
-#include <boost/interprocess/segment_manager.hpp>
-#include <boost/interprocess/managed_shared_memory.hpp>
-#include <boost/interprocess/containers/map.hpp>
-#include <boost/interprocess/allocators/allocator.hpp>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+#include <boost/interprocess/shared_memory_object.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 #include <boost/thread/thread.hpp>
+#include <boost/thread/tss.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/optional.hpp>
-#include <boost/unordered_map.hpp>
-#include <limits.h>
-#if defined(__FreeBSD__)
-#include <sys/param.h>
-#endif
-#include <netinet/in.h>
 #include "acl/types.hpp"
 #include "stats/types.hpp"
-#include "util/verify.hpp"
 
 namespace ftp
 {
@@ -26,46 +25,78 @@ struct OnlineXfer
 	boost::posix_time::ptime start;
 	long long bytes;
 	stats::Direction direction;
-  
+
   OnlineXfer(stats::Direction direction, const boost::posix_time::ptime& start);
 };
 
 struct OnlineClient
 {
-  static const unsigned maximumIdentLength = 513;
-
 	acl::UserID uid;
 	boost::posix_time::ptime lastCommand;
-	char command[BUFSIZ];
-	char workDir[PATH_MAX];
-	char ident[maximumIdentLength];
-	char ip[INET6_ADDRSTRLEN];
-#if defined(__FreeBSD__)
-  char hostname[MAXHOSTNAMELEN];
-#else
-	char hostname[HOST_NAME_MAX];
-#endif
-	
+	std::string command;
+	std::string workDir;
+	std::string ident;
+	std::string ip;
+	std::string hostname;
   boost::optional<OnlineXfer> xfer;
 
-	OnlineClient(acl::UserID uid, const std::string& ident, 
-               const std::string& ip, const std::string& hostname,
-               const std::string& workDir);
-               
-  bool IsIdle() const { return command[0] == '\0'; }
+  bool IsIdle() const { return command.empty(); }
 };
 
-typedef boost::interprocess::managed_shared_memory::segment_manager SegmentManager;
-typedef boost::interprocess::allocator<std::pair<const long, OnlineClient>, 
-                                       SegmentManager> ShmOnlineMapAlloc;
-typedef boost::unordered_map<long, OnlineClient, std::hash<long>, std::equal_to<long>, ShmOnlineMapAlloc> ShmOnlineMap;
+// reference to a string in the arena, valid only while every block it
+// covers still carries its generation. the run starts with the string's
+// length, generation 0 is the empty string
+struct OnlineString
+{
+  uint32_t block;
+  uint32_t generation;
+};
 
-struct OnlineData
+// one cache line per session, claimed at login by the session's own thread
+// which is then its only writer. the sequence is odd while a write is in
+// progress, readers copy the slot and retry if the sequence moved
+// underneath them
+struct alignas(64) OnlineSlot
 {
-  ShmOnlineMap clients;
-  boost::interprocess::interprocess_mutex mutex;
+  // ident, ip and hostname are stored nul separated as the identity
+  enum { Identity, WorkDir, Command, Strings };
   
-  OnlineData(boost::interprocess::managed_shared_memory& segment, int maxClients);
+  struct Data
+  {
+    boost::posix_time::ptime lastCommand;
+    boost::posix_time::ptime xferStart;
+    long long xferBytes;
+    OnlineString strings[Strings];
+    acl::UserID uid;
+    uint8_t used;
+    uint8_t transferring;
+    uint8_t direction;
+  };
+
+  std::atomic<uint32_t> sequence;
+  Data data;
+};
+
+static_assert(sizeof(OnlineSlot) == 64, "online slot must fill one cache line");
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "online segment needs address free atomics");
+
+// segment layout is the header, the slots, one generation per arena block
+// and then the arena itself
+struct OnlineHeader
+{
+  static const uint32_t magic = 0x6562666f; // "ebfo"
+  static const uint32_t version = 3;
+  static const uint32_t blockSize = 64;
+
+  uint32_t headerMagic;
+  uint32_t headerVersion;
+  uint32_t slotSize;
+  uint32_t maxClients;
+  uint32_t headerBlockSize;
+  uint32_t blockCount;
+  uint32_t slotsOffset;
+  uint32_t generationsOffset;
+  uint32_t arenaOffset;
 };
 
 class Client;
@@ -73,167 +104,160 @@ class OnlineTransferUpdater;
 
 class OnlineWriter
 {
+  struct Run
+  {
+    uint32_t block;
+    uint32_t blocks;
+    
+    Run() : block(0), blocks(0) { }
+  };
+  
+  // arena runs are buddies of powers of two blocks up to the largest
+  // string, split when allocated and merged again when freed
+  static const int runClasses = 8;
+  static const uint32_t blocksPerClient = 16;
+
   std::string id;
-  std::unique_ptr<boost::interprocess::managed_shared_memory> segment;
-  OnlineData* data;
+  boost::interprocess::mapped_region region;
+  OnlineSlot* slots;
+  std::atomic<uint32_t>* generations;
+  char* arena;
+  uint32_t blockCount;
+  std::mutex mutex;
+  std::vector<int> freeSlots;
+  std::vector<std::array<Run, OnlineSlot::Strings>> runs;
+  std::set<uint32_t> freeRuns[runClasses];
+  std::atomic<uint32_t> nextGeneration;
+  boost::thread_specific_ptr<int> threadSlot;
 
 	static std::unique_ptr<OnlineWriter> instance;
-  constexpr static float clientOverhead = 0.02;
-  constexpr static size_t clientSize = sizeof(OnlineClient) * (1 + clientOverhead);
 
   OnlineWriter(const std::string& id, int maxClients);
   void OpenSharedMemory(int maxClients);
 
-  void LoggedIn(long tid, Client& client, const std::string& workDir);
-	void LoggedOut(long tid);
-	void Command(long tid, const std::string& command);
-	void Idle(long tid);
+  bool Allocate(uint32_t blocks, Run& run);
+  void Free(Run& run);
+  OnlineString Store(int slot, int field, const std::string& str);
+
+  // -1 if this thread isn't logged in or there were no free slots
+  int Slot() const { return threadSlot.get() ? *threadSlot : -1; }
+
+  template <typename Function>
+  void Write(int slot, Function&& function);
+
+	void StartTransfer(int slot, stats::Direction direction, const boost::posix_time::ptime& start);
+	void TransferUpdate(int slot, long long bytes);
+	void StopTransfer(int slot);
 
-	void StartTransfer(long tid, stats::Direction direction, const boost::posix_time::ptime& start);
-	void TransferUpdate(long tid, long long bytes);
-	void StopTransfer(long tid);
-  
 public:
   ~OnlineWriter();
-  
-  void LoggedIn(const boost::thread::id& tid, Client& client, const std::string& workDir);
-	void LoggedOut(const boost::thread::id& tid);
-	void Command(const boost::thread::id& tid, const std::string& command);
-	void Idle(const boost::thread::id& tid);
-  
+
+  // all apply to the calling thread's session
+  void LoggedIn(Client& client, const std::string& workDir);
+	void LoggedOut();
+	void Command(const std::string& command);
+	void Idle();
+
 	static void Initialise(const std::string& id, int maxClients)
   {
     instance.reset(new OnlineWriter(id, maxClients));
   }
-  
+
   static void Cleanup()
   {
     instance = nullptr;
   }
-  
+
   static OnlineWriter& Get() { return *instance; }
-  
+
   friend class OnlineTransferUpdater;
 };
 
-class OnlineReaderLock;
 class OnlineReader;
 
 class OnlineReaderIterator : public std::iterator<std::forward_iterator_tag, OnlineClient>
 {
-  const OnlineReader* const reader;
-  boost::optional<ShmOnlineMap::iterator> iter;
-  mutable boost::optional<OnlineClient> client;
-    
-  OnlineReaderIterator(const OnlineReader* const reader, bool end); 
-  OnlineReaderIterator(const OnlineReader* const reader);
-  
+  const OnlineReader* reader;
+  int slot;
+  OnlineClient client;
+
+  OnlineReaderIterator(const OnlineReader* reader, int slot);
+  void Next();
+
 public:
-    
-  OnlineReaderIterator& operator++();
-  OnlineReaderIterator operator++(int);
-  
-  bool operator==(const OnlineReaderIterator& rhs) const
-  {
-    if (!iter && !rhs.iter) return true;
-    verify(iter);
-    return *iter == *rhs.iter;
-  }
-  
-  bool operator!=(const OnlineReaderIterator& rhs) const
+  OnlineReaderIterator& operator++()
   {
-    return !operator==(rhs);
-  }
-  
-  const OnlineClient& operator*() const
-  {
-    if (!client) client.reset((*iter)->second);
-    return *client;
+    ++slot;
+    Next();
+    return *this;
   }
 
-  const OnlineClient* operator->() const
+  OnlineReaderIterator operator++(int)
   {
-    if (!client) client.reset((*iter)->second);
-    return &*client;
+    OnlineReaderIterator temp(*this);
+    ++*this;
+    return temp;
   }
-  
+
+  bool operator==(const OnlineReaderIterator& rhs) const
+  { return slot == rhs.slot; }
+
+  bool operator!=(const OnlineReaderIterator& rhs) const
+  { return !operator==(rhs); }
+
+  const OnlineClient& operator*() const { return client; }
+  const OnlineClient* operator->() const { return &client; }
+
   friend class OnlineReader;
 };
 
+// lock free, each client is a consistent snapshot of its slot though
+// clients may log in or out while iterating
 class OnlineReader
 {
-  std::string id;
-  std::unique_ptr<boost::interprocess::managed_shared_memory> segment;
-  OnlineData* data;
-  mutable bool locked;
-  
-  void Lock() const;
-  void Unlock() const;
-  
+  std::unique_ptr<boost::interprocess::mapped_region> region;
+  const OnlineSlot* slots;
+  const std::atomic<uint32_t>* generations;
+  const char* arena;
+  uint32_t blockCount;
+  int maxClients;
+
+  bool Copy(const OnlineString& ref, std::string& str) const;
+  bool Read(int slot, OnlineClient& client) const;
+
 public:
   typedef OnlineReaderIterator const_iterator;
   typedef OnlineClient value_type;
-  typedef ShmOnlineMap::size_type size_type;
+  typedef size_t size_type;
 
   OnlineReader(const std::string& id);
-  ~OnlineReader();
-  
+
   OnlineReaderIterator begin() const;
   OnlineReaderIterator end() const;
-  
+
   size_type size() const;
 
-  friend class OnlineReaderLock;
   friend class OnlineReaderIterator;
 };
 
-class OnlineReaderLock
-{
-  const OnlineReader& reader;
-  bool released;
-  
-public:
-  OnlineReaderLock(const OnlineReader& reader) :
-    reader(reader), released(false)
-  {
-    reader.Lock();
-  }
-  
-  ~OnlineReaderLock()
-  {
-    if (!released)
-    {
-      reader.Unlock();
-    }
-  }
-  
-  void Release()
-  {
-    verify(!released);
-    reader.Unlock();
-    released = true;
-  }
-};
-
 class OnlineTransferUpdater
 {
-  long tid;
+  int slot;
   boost::posix_time::ptime nextUpdate;
-  
+
   static boost::posix_time::milliseconds interval;
-  
+
 public:
-  OnlineTransferUpdater(const boost::thread::id& tid, stats::Direction direction,
-                        const boost::posix_time::ptime& start);
-  
+  OnlineTransferUpdater(stats::Direction direction, const boost::posix_time::ptime& start);
   ~OnlineTransferUpdater();
-  
+
   void Update(long long bytes)
   {
+    if (slot < 0) return;
     auto now = boost::posix_time::microsec_clock::local_time();
     if (now >= nextUpdate)
     {
-      OnlineWriter::Get().TransferUpdate(tid, bytes);
+      OnlineWriter::Get().TransferUpdate(slot, bytes);
       nextUpdate = now + interval;
     }
   }
@@ -243,3 +267,5 @@ std::string SharedMemoryID(pid_t pid = -1);
 bool SharedMemoryID(const std::string& pidFile, std::string& id);
 
 } /* ftp namespace */
+
+#endif
@@ -1,4 +1,5 @@
 #include <sstream>
+#include <unordered_set>
 #include "ftp/task/task.hpp"
 #include "ftp/server.hpp"
 #include "logs/logs.hpp"
@@ -112,9 +113,10 @@ void Exit::Execute(Server&)
 
 void UserUpdate::Execute(Server& server)
 {
+  std::unordered_set<acl::UserID> updated(uids.begin(), uids.end());
   for (auto& client: server.clients)
   {
-    if (client.State() == ClientState::LoggedIn && client.User().ID() == uid)
+    if (client.State() == ClientState::LoggedIn && updated.count(client.User().ID()))
     {
       client.SetUserUpdated();
     }
@@ -96,10 +96,10 @@ public:
 
 class UserUpdate : public Task
 {
-  acl::UserID uid;
+  std::vector<acl::UserID> uids;
   
 public:
-  UserUpdate(acl::UserID uid) : uid(uid) { }
+  UserUpdate(const std::vector<acl::UserID>& uids) : uids(uids) { }
   void Execute(Server& server);
 };
 
@@ -19,6 +19,7 @@ CounterResult TransferCounter::Start(acl::UserID uid, int limit, bool exempt)
   }
   ++count;
   ++global;
+  Metrics::Set(occupancy, global);
   return CounterResult::Okay;
 }
 
@@ -30,6 +31,7 @@ void TransferCounter::Stop(acl::UserID uid)
   --count;
   assert(global > 0);
   --global;
+  Metrics::Set(occupancy, global);
 }
 
 } /* ftp namespace */
@@ -5,6 +5,7 @@
 #include <unordered_map>
 #include <functional>
 #include "acl/types.hpp"
+#include "ftp/metrics.hpp"
 
 namespace ftp
 {
@@ -17,9 +18,10 @@ class TransferCounter
   int global;
   std::unordered_map<acl::UserID, int> personal;
   std::function<int(void)> getMaxGlobal;
+  Occupancy occupancy;
 
-  TransferCounter(const std::function<int(void)>& getMaxGlobal) :
-    global(0), getMaxGlobal(getMaxGlobal)
+  TransferCounter(Occupancy occupancy, const std::function<int(void)>& getMaxGlobal) :
+    global(0), getMaxGlobal(getMaxGlobal), occupancy(occupancy)
   { }
   
   TransferCounter& operator=(const TransferCounter&) = delete;
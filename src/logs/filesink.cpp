@@ -1,71 +1,37 @@
-#include <ctime>
-#include <fstream>
-#include <boost/lexical_cast.hpp>
-#include <boost/date_time/posix_time/posix_time.hpp>
 #include "logs/filesink.hpp"
-#include "logs/util.hpp"
+#include "logs/writer.hpp"
 
 namespace logs
 {
 
-void FileSink::Write(const char* field, int value)
+FileSink::FileSink(const std::string& path) :
+  quoteChar('\0'),
+  tag(false),
+  bracketChar{'\0', '\0'},
+  path(path),
+  file(Writer::Open(path))
 {
-  Write(field, boost::lexical_cast<std::string>(value));
 }
 
-void FileSink::Write(const char* field, long long value)
+LineBuffer& FileSink::Buffer()
 {
-  Write(field, boost::lexical_cast<std::string>(value));
-}
-
-void FileSink::Write(const char* field, double value)
-{
-  Write(field, boost::lexical_cast<std::string>(value));
-}
-
-void FileSink::Write(const char* field, bool value)
-{
-  Write(field, boost::lexical_cast<std::string>(value));
-}
-
-void FileSink::Write(const char* field, const boost::posix_time::ptime& value)
-{
-  Write(field, boost::lexical_cast<std::string>(value));
-}
-
-void FileSink::Write(const char* /* field */, const char* value)
-{
-  std::ostringstream* os = buffer.get();
-  if (!os)
-  {
-    os = new std::ostringstream();
-    buffer.reset(os);
-  }
-  else
-  if (!os->str().empty())
+  LineBuffer* line = buffer.get();
+  if (!line)
   {
-    *os << ' ';
+    line = new LineBuffer();
+    buffer.reset(line);
   }
-  
-  if (bracketChar.first != '\0') *os << bracketChar.first;
-  if (quoteChar != '\0') *os << quoteChar;
-  *os << value;
-  if (tag) *os << ':';
-  if (quoteChar != '\0') *os << quoteChar;
-  if (bracketChar.second != '\0') *os << bracketChar.second;
+  return *line;
 }
 
 void FileSink::Flush()
 {
-  std::ostringstream* os = buffer.get();
-  if (os)
+  LineBuffer* line = buffer.get();
+  if (line)
   {
-    std::ofstream of(path.c_str(), std::ios::app);
-    if (of)
-    {
-      of << Timestamp() << ' ' << os->str() << std::endl;
-    }
-    os->str(std::string());
+    auto text = line->Finish();
+    if (text.second > 0) Writer::Append(file, text.first, text.second);
+    line->Clear();
   }
 }
 
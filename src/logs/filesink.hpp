@@ -1,11 +1,9 @@
 #ifndef __LOGS_FILESINK_HPP
 #define __LOGS_FILESINK_HPP
 
-#include <memory>
-#include <ostream>
 #include <boost/thread/tss.hpp>
-#include <mutex>
 #include "logs/sink.hpp"
+#include "logs/linebuffer.hpp"
 
 namespace logs
 {
@@ -16,26 +14,31 @@ class FileSink : public Sink
   bool tag;
   std::pair<char, char> bracketChar;
   
+  LineBuffer& Buffer();
+
+  template <typename T>
+  void WriteValue(const T& value)
+  {
+    LineBuffer& line = Buffer();
+    LineBuffer::Field field(line, tag, quoteChar, bracketChar);
+    line.Value(value);
+  }
+  
 protected:
   std::string path;
-  boost::thread_specific_ptr<std::ostringstream> buffer;
+  int file;
+  boost::thread_specific_ptr<LineBuffer> buffer;
   
 public:
-  FileSink(const std::string& path) :
-    quoteChar('\0'),
-    tag(false),
-    bracketChar{'\0', '\0'},
-    path(path)
-  {
-  }
+  FileSink(const std::string& path);
 
-  void Write(const char* field, int value);
-  void Write(const char* field, long long value);
-  void Write(const char* field, double value);
-  void Write(const char* field, bool value); 
-  void Write(const char* field, const char* value);
-  void Write(const char* field, const std::string& value) { Write(field, value.c_str()); }
-  void Write(const char* field, const boost::posix_time::ptime& value);
+  void Write(const char* /* field */, int value) { WriteValue(value); }
+  void Write(const char* /* field */, long long value) { WriteValue(value); }
+  void Write(const char* /* field */, double value) { WriteValue(value); }
+  void Write(const char* /* field */, bool value) { WriteValue(value); }
+  void Write(const char* /* field */, const char* value) { WriteValue(value); }
+  void Write(const char* /* field */, const std::string& value) { WriteValue(value); }
+  void Write(const char* /* field */, const boost::posix_time::ptime& value) { WriteValue(value); }
   
   void Formatting(bool tag, char quoteChar, const std::pair<char, char>& bracketChar)
   {
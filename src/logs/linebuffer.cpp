@@ -0,0 +1,295 @@
+#include <cstdio>
+#include <boost/lexical_cast.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include "logs/linebuffer.hpp"
+#include "logs/util.hpp"
+
+namespace logs
+{
+
+namespace
+{
+
+const char* months[] =
+{
+  "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+  "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
+};
+
+// writes value zero padded to width digits, returns the end
+inline char* Digits(char* p, unsigned long long value, int width)
+{
+  char* end = p + width;
+  for (char* q = end; q > p; value /= 10) *--q = '0' + value % 10;
+  return end;
+}
+
+}
+
+void LineBuffer::Begin()
+{
+  time_t now = time(nullptr);
+  if (now != stampTime)
+  {
+    stampLength = Timestamp(now, stamp, sizeof(stamp));
+    stampTime = now;
+  }
+
+  Append(stamp, stampLength);
+  Append(' ');
+  start = length;
+}
+
+LineBuffer::Field::Field(LineBuffer& line, bool tag, char quoteChar, 
+                         const std::pair<char, char>& bracketChar) :
+  line(line), tag(tag), quoteChar(quoteChar), bracketChar(bracketChar)
+{
+  if (line.length == 0) line.Begin();
+  else if (line.length > line.start) line.Append(' ');
+
+  if (bracketChar.first != '\0') line.Append(bracketChar.first);
+  if (quoteChar != '\0') line.Append(quoteChar);
+}
+
+LineBuffer::Field::~Field()
+{
+  if (tag) line.Append(':');
+  if (quoteChar != '\0') line.Append(quoteChar);
+  if (bracketChar.second != '\0') line.Append(bracketChar.second);
+}
+
+void LineBuffer::Value(long long value)
+{
+  char buf[24];
+  char* end = buf + sizeof(buf);
+  char* p = end;
+  unsigned long long magnitude = value < 0 ? -static_cast<unsigned long long>(value) : value;
+  do
+  {
+    *--p = '0' + magnitude % 10;
+    magnitude /= 10;
+  }
+  while (magnitude > 0);
+  if (value < 0) *--p = '-';
+  Append(p, end - p);
+}
+
+void LineBuffer::Value(double value)
+{
+  // same precision as lexical_cast
+  char buf[32];
+  int len = snprintf(buf, sizeof(buf), "%.17g", value);
+  if (len > 0) Append(buf, std::min<size_t>(len, sizeof(buf) - 1));
+}
+
+void LineBuffer::Value(const boost::posix_time::ptime& value)
+{
+  if (value.is_special())
+  {
+    Value(boost::lexical_cast<std::string>(value));
+    return;
+  }
+
+  // same as to_simple_string, 2013-Oct-03 04:05:06[.000007]
+  auto date = value.date();
+  auto time = value.time_of_day();
+  char buf[32];
+  char* p = Digits(buf, date.year(), 4);
+  *p++ = '-';
+  memcpy(p, months[date.month() - 1], 3);
+  p += 3;
+  *p++ = '-';
+  p = Digits(p, date.day(), 2);
+  *p++ = ' ';
+  p = Digits(p, time.hours(), 2);
+  *p++ = ':';
+  p = Digits(p, time.minutes(), 2);
+  *p++ = ':';
+  p = Digits(p, time.seconds(), 2);
+  if (time.fractional_seconds() != 0)
+  {
+    *p++ = '.';
+    p = Digits(p, time.fractional_seconds(), time.num_fractional_digits());
+  }
+  Append(buf, p - buf);
+}
+
+std::pair<const char*, size_t> LineBuffer::Finish()
+{
+  if (length == 0) return std::make_pair(buffer, 0);
+  buffer[length++] = '\n';
+  return std::make_pair(buffer, length);
+}
+
+} /* logs namespace */
+
+#ifdef LINEBUFFER_TEST
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include "logs/logger.hpp"
+
+// compares records/sec against the previous ostringstream and lexical_cast
+// formatting, with the same entries logs::Event and logs::Transfer push
+// usage: linebuffertest [records]
+
+namespace
+{
+
+class LegacySink : public logs::Sink
+{
+  char quoteChar;
+  bool tag;
+  std::pair<char, char> bracketChar;
+  std::ostringstream os;
+
+public:
+  std::string last;
+
+  LegacySink() : quoteChar('\0'), tag(false), bracketChar{'\0', '\0'} { }
+
+  void Write(const char* field, int value) { Write(field, boost::lexical_cast<std::string>(value)); }
+  void Write(const char* field, long long value) { Write(field, boost::lexical_cast<std::string>(value)); }
+  void Write(const char* field, double value) { Write(field, boost::lexical_cast<std::string>(value)); }
+  void Write(const char* field, bool value) { Write(field, boost::lexical_cast<std::string>(value)); }
+  void Write(const char* field, const std::string& value) { Write(field, value.c_str()); }
+  void Write(const char* field, const boost::posix_time::ptime& value) 
+  { Write(field, boost::lexical_cast<std::string>(value)); }
+
+  void Write(const char* /* field */, const char* value)
+  {
+    if (!os.str().empty()) os << ' ';
+    if (bracketChar.first != '\0') os << bracketChar.first;
+    if (quoteChar != '\0') os << quoteChar;
+    os << value;
+    if (tag) os << ':';
+    if (quoteChar != '\0') os << quoteChar;
+    if (bracketChar.second != '\0') os << bracketChar.second;
+  }
+
+  void Formatting(bool tag, char quoteChar, const std::pair<char, char>& bracketChar)
+  {
+    this->tag = tag;
+    this->quoteChar = quoteChar;
+    this->bracketChar = bracketChar;
+  }
+
+  void Flush()
+  {
+    time_t now = time(nullptr);
+    char buf[26];
+    strftime(buf, sizeof(buf), "%a %b %d %T %Y", localtime(&now));
+    last = buf;
+    last += ' ';
+    last += os.str();
+    last += '\n';
+    os.str(std::string());
+  }
+};
+
+class BufferSink : public logs::Sink
+{
+  char quoteChar;
+  bool tag;
+  std::pair<char, char> bracketChar;
+  logs::LineBuffer line;
+
+  template <typename T>
+  void WriteValue(const T& value)
+  {
+    logs::LineBuffer::Field field(line, tag, quoteChar, bracketChar);
+    line.Value(value);
+  }
+
+public:
+  std::string last;
+
+  BufferSink() : quoteChar('\0'), tag(false), bracketChar{'\0', '\0'} { }
+
+  void Write(const char* /* field */, int value) { WriteValue(value); }
+  void Write(const char* /* field */, long long value) { WriteValue(value); }
+  void Write(const char* /* field */, double value) { WriteValue(value); }
+  void Write(const char* /* field */, bool value) { WriteValue(value); }
+  void Write(const char* /* field */, const char* value) { WriteValue(value); }
+  void Write(const char* /* field */, const std::string& value) { WriteValue(value); }
+  void Write(const char* /* field */, const boost::posix_time::ptime& value) { WriteValue(value); }
+
+  void Formatting(bool tag, char quoteChar, const std::pair<char, char>& bracketChar)
+  {
+    this->tag = tag;
+    this->quoteChar = quoteChar;
+    this->bracketChar = bracketChar;
+  }
+
+  void Flush()
+  {
+    auto text = line.Finish();
+    // only kept for comparison, an allocation here would skew the timing
+    if (last.empty()) last.assign(text.first, text.second);
+    line.Clear();
+  }
+};
+
+void Push(logs::Logger& logger, int i)
+{
+  using namespace logs;
+  if (i % 2)
+  {
+    logger.PushEntry("event", Tag(), "LOGIN", QuoteOn(), "ip", "192.168.1.100", 
+                     "hostname", "some.host.example.com", "username", "someuser", 
+                     "groupname", "somegroup", "tagline", "no tagline set", 
+                     "connections", i, "since", 
+                     boost::posix_time::ptime(boost::gregorian::date(2013, 10, 3), 
+                                              boost::posix_time::microseconds(i)));
+  }
+  else
+  {
+    logger.PushEntry(QuoteOn(), "epoch start", 1381234567.123456 + i, "direction", "up",
+                     "username", "someuser", "groupname", "somegroup",
+                     "size", static_cast<long long>(i) * 1024, "seconds", 12.345 + i, 
+                     "okay", "okay", "section", "MP3", 
+                     "path", "/site/mp3/Some-Artist-Some_Album-2013-GRP/01-some_track.mp3");
+  }
+}
+
+template <typename Sink>
+double RecordsPerSecond(int records)
+{
+  logs::Logger logger;
+  logger.PushSink(std::make_shared<Sink>());
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < records; ++i) Push(logger, i);
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  return records / elapsed.count();
+}
+
+}
+
+int main(int argc, char** argv)
+{
+  int records = argc > 1 ? atoi(argv[1]) : 500000;
+
+  for (int i = 0; i < 2; ++i)
+  {
+    auto legacy = std::make_shared<LegacySink>();
+    auto buffer = std::make_shared<BufferSink>();
+    logs::Logger logger;
+    logger.PushSink(legacy);
+    logger.PushSink(buffer);
+    Push(logger, i + 1);
+    if (legacy->last != buffer->last)
+    {
+      std::cerr << "output differs:\n" << legacy->last << buffer->last;
+      return 1;
+    }
+    std::cout << buffer->last;
+  }
+
+  std::cout << records << " records" << std::endl;
+  std::cout << "ostringstream + lexical_cast: " << RecordsPerSecond<LegacySink>(records) << "/s" << std::endl;
+  std::cout << "line buffer:                  " << RecordsPerSecond<BufferSink>(records) << "/s" << std::endl;
+}
+
+#endif
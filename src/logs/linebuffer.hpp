@@ -0,0 +1,80 @@
+#ifndef __LOGS_LINEBUFFER_HPP
+#define __LOGS_LINEBUFFER_HPP
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <utility>
+
+namespace boost { namespace posix_time
+{
+class ptime;
+}
+}
+
+namespace logs
+{
+
+// one log line formatted in place, the timestamp prefix is only
+// regenerated when the second changes. anything past the end of the
+// buffer is truncated
+class LineBuffer
+{
+  static const size_t maxLength = 16384;
+
+  char buffer[maxLength];
+  size_t length;
+  size_t start;
+  time_t stampTime;
+  char stamp[32];
+  size_t stampLength;
+
+  void Append(const char* s, size_t len)
+  {
+    // always leave room for the newline
+    len = std::min(len, maxLength - 1 - length);
+    memcpy(buffer + length, s, len);
+    length += len;
+  }
+
+  void Append(char ch)
+  {
+    if (length < maxLength - 1) buffer[length++] = ch;
+  }
+
+  void Begin();
+
+public:
+  LineBuffer() : length(0), start(0), stampTime(-1), stampLength(0) { }
+
+  // values are separated by spaces and surrounded by the optional
+  // brackets and quotes, tagged values are followed by a colon
+  class Field
+  {
+    LineBuffer& line;
+    bool tag;
+    char quoteChar;
+    std::pair<char, char> bracketChar;
+
+  public:
+    Field(LineBuffer& line, bool tag, char quoteChar, const std::pair<char, char>& bracketChar);
+    ~Field();
+  };
+
+  void Value(const char* value) { Append(value, strlen(value)); }
+  void Value(const std::string& value) { Append(value.data(), value.length()); }
+  void Value(long long value);
+  void Value(int value) { Value(static_cast<long long>(value)); }
+  void Value(double value);
+  void Value(bool value) { Append(value ? '1' : '0'); }
+  void Value(const boost::posix_time::ptime& value);
+
+  // finishes the line with a newline, empty if nothing was written
+  std::pair<const char*, size_t> Finish();
+  void Clear() { length = 0; }
+};
+
+} /* logs namespace */
+
+#endif
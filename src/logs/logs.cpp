@@ -41,7 +41,8 @@ void InitialiseLog(Logger& logger, const cfg::Log& config)
               "logs/" + config.Name() + ".log")));
   }
 
-  if (config.Database())
+  // there's no mongod to write to with the embedded backend
+  if (config.Database() && cfg::Get().DatabaseBackend() != cfg::DatabaseBackend::Embedded)
   {
     logger.PushSink(std::make_shared<db::LogSink>("log." + config.Name(), 
               config.CollectionSize()));
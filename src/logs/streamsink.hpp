@@ -5,7 +5,9 @@
 #include <ostream>
 #include <boost/thread/tss.hpp>
 #include <mutex>
+#include <vector>
 #include "logs/sink.hpp"
+#include "logs/linebuffer.hpp"
 
 namespace logs
 {
@@ -23,10 +25,12 @@ public:
     else this->stream.reset(stream, [](void*){});
   }
   
-  void Write(const std::string& line)
+  // line includes its newline
+  void Write(const char* line, size_t len)
   {
     std::lock_guard<std::mutex> lock(*mutex);
-    *stream << line << std::endl;
+    stream->write(line, len);
+    stream->flush();
   }
 };
 
@@ -36,9 +40,19 @@ class StreamSink : public Sink
   bool tag;
   std::pair<char, char> bracketChar;
   
+  LineBuffer& Buffer();
+
+  template <typename T>
+  void WriteValue(const T& value)
+  {
+    LineBuffer& line = Buffer();
+    LineBuffer::Field field(line, tag, quoteChar, bracketChar);
+    line.Value(value);
+  }
+  
 protected:
   std::vector<Stream> streams;
-  boost::thread_specific_ptr<std::ostringstream> buffer;
+  boost::thread_specific_ptr<LineBuffer> buffer;
   
 public:
   template <typename... Streams>
@@ -50,13 +64,13 @@ public:
   {
   }
 
-  void Write(const char* field, int value);
-  void Write(const char* field, long long value);
-  void Write(const char* field, double value);
-  void Write(const char* field, bool value); 
-  void Write(const char* field, const char* value);
-  void Write(const char* field, const std::string& value) { Write(field, value.c_str()); }
-  void Write(const char* field, const boost::posix_time::ptime& value);
+  void Write(const char* /* field */, int value) { WriteValue(value); }
+  void Write(const char* /* field */, long long value) { WriteValue(value); }
+  void Write(const char* /* field */, double value) { WriteValue(value); }
+  void Write(const char* /* field */, bool value) { WriteValue(value); }
+  void Write(const char* /* field */, const char* value) { WriteValue(value); }
+  void Write(const char* /* field */, const std::string& value) { WriteValue(value); }
+  void Write(const char* /* field */, const boost::posix_time::ptime& value) { WriteValue(value); }
   
   void Formatting(bool tag, char quoteChar, const std::pair<char, char>& bracketChar)
   {
@@ -1,18 +1,15 @@
 #ifndef __LOGS_UTIL_HPP
 #define __LOGS_UTIL_HPP
 
-#include <string>
 #include <ctime>
 
 namespace logs
 {
 
-inline std::string Timestamp()
+inline size_t Timestamp(time_t now, char* buf, size_t size)
 {
-  time_t now = time(nullptr);
-  char buf[26];
-  strftime(buf,sizeof(buf),"%a %b %d %T %Y", localtime(&now));
-  return buf;
+  struct tm tm;
+  return strftime(buf, size, "%a %b %d %T %Y", localtime_r(&now, &tm));
 }
 
 } /* logs namespace */
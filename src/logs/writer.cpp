@@ -0,0 +1,384 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include "logs/writer.hpp"
+#include "logs/logs.hpp"
+#include "util/misc.hpp"
+
+namespace logs
+{
+
+namespace
+{
+
+struct RecordHeader
+{
+  uint32_t length;
+  uint32_t file;
+};
+
+static_assert(sizeof(RecordHeader) == 8, "records are 8 byte aligned");
+
+inline size_t RecordSize(size_t length)
+{
+  return sizeof(RecordHeader) + ((length + 7) & ~size_t(7));
+}
+
+const int idleInterval = 250; // milliseconds
+const int droppedInterval = 60; // seconds
+
+int OpenFile(const std::string& path)
+{
+  return open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0666);
+}
+
+}
+
+Writer Writer::instance;
+
+Writer::Writer() :
+  fileCount(0),
+  ringsChanged(false),
+  running(false),
+  synchronous(false),
+  sleeping(false),
+  reopen(false),
+  totalDropped(0)
+{
+  for (auto& fd : fds) fd = -1;
+}
+
+Writer::~Writer()
+{
+  for (int i = 0; i < fileCount; ++i)
+  {
+    if (fds[i] >= 0) close(fds[i]);
+  }
+}
+
+Writer::RingHandle::~RingHandle()
+{
+  ring->orphaned = true;
+  instance.ringsChanged = true;
+}
+
+bool Writer::Ring::Push(int file, const char* data, size_t len)
+{
+  size_t size = RecordSize(len);
+  unsigned long long h = head.load(std::memory_order_relaxed);
+  if (size > ringSize - (h - tail.load(std::memory_order_acquire))) return false;
+
+  RecordHeader header;
+  header.length = len;
+  header.file = file;
+
+  size_t pos = h % ringSize;
+  memcpy(buffer + pos, &header, sizeof(header));
+  pos = (pos + sizeof(header)) % ringSize;
+
+  size_t first = std::min(len, ringSize - pos);
+  memcpy(buffer + pos, data, first);
+  memcpy(buffer, data + first, len - first);
+
+  // sequentially consistent so either we see the writer going to sleep
+  // or it sees this record before it does
+  head.store(h + size);
+  return true;
+}
+
+Writer::Ring& Writer::ThreadRing()
+{
+  RingHandle* handle = threadRing.get();
+  if (!handle)
+  {
+    auto ring = std::make_shared<Ring>();
+    {
+      std::lock_guard<std::mutex> lock(ringsMutex);
+      rings.emplace_back(ring);
+    }
+    ringsChanged = true;
+
+    handle = new RingHandle(ring);
+    threadRing.reset(handle);
+  }
+  return *handle->ring;
+}
+
+void Writer::Wake()
+{
+  if (sleeping)
+  {
+    std::lock_guard<std::mutex> lock(wakeMutex);
+    wakeCond.notify_one();
+  }
+}
+
+void Writer::WriteFile(int file, struct iovec* iov, int count)
+{
+  int fd = fds[file];
+  if (fd < 0)
+  {
+    // directory may not have existed when the file was first opened
+    std::lock_guard<std::mutex> lock(filesMutex);
+    fd = OpenFile(paths[file]);
+    if (fd < 0) return;
+    fds[file] = fd;
+  }
+
+  while (count > 0)
+  {
+    ssize_t len = writev(fd, iov, std::min(count, IOV_MAX));
+    if (len < 0)
+    {
+      if (errno == EINTR) continue;
+      return;
+    }
+
+    while (count > 0 && static_cast<size_t>(len) >= iov->iov_len)
+    {
+      len -= iov->iov_len;
+      ++iov;
+      --count;
+    }
+
+    if (count > 0)
+    {
+      iov->iov_base = static_cast<char*>(iov->iov_base) + len;
+      iov->iov_len -= len;
+    }
+  }
+}
+
+void Writer::WriteLine(int file, const char* data, size_t len)
+{
+  struct iovec iov;
+  iov.iov_base = const_cast<char*>(data);
+  iov.iov_len = len;
+
+  std::lock_guard<std::mutex> lock(filesMutex);
+  int fd = fds[file];
+  if (fd < 0)
+  {
+    fd = OpenFile(paths[file]);
+    if (fd < 0) return;
+    fds[file] = fd;
+  }
+
+  while (iov.iov_len > 0)
+  {
+    ssize_t n = writev(fd, &iov, 1);
+    if (n < 0)
+    {
+      if (errno == EINTR) continue;
+      return;
+    }
+    iov.iov_base = static_cast<char*>(iov.iov_base) + n;
+    iov.iov_len -= n;
+  }
+}
+
+void Writer::ReopenFiles()
+{
+  std::lock_guard<std::mutex> lock(filesMutex);
+  for (int i = 0; i < fileCount; ++i)
+  {
+    int fd = OpenFile(paths[i]);
+    if (fd < 0) continue;
+    int old = fds[i].exchange(fd);
+    if (old >= 0) close(old);
+  }
+}
+
+bool Writer::Pending(const std::vector<std::shared_ptr<Ring>>& active) const
+{
+  for (const auto& ring : active)
+  {
+    if (ring->head != ring->tail.load(std::memory_order_relaxed)) return true;
+  }
+  return false;
+}
+
+bool Writer::Drain(const std::vector<std::shared_ptr<Ring>>& active)
+{
+  std::vector<unsigned long long> heads;
+  heads.reserve(active.size());
+
+  bool drained = false;
+  for (const auto& ring : active)
+  {
+    unsigned long long head = ring->head.load(std::memory_order_acquire);
+    unsigned long long tail = ring->tail.load(std::memory_order_relaxed);
+    heads.emplace_back(head);
+
+    while (tail < head)
+    {
+      RecordHeader header;
+      memcpy(&header, ring->buffer + tail % ringSize, sizeof(header));
+
+      size_t pos = (tail + sizeof(header)) % ringSize;
+      size_t first = std::min<size_t>(header.length, ringSize - pos);
+      auto& batch = batches[header.file];
+      batch.push_back({ ring->buffer + pos, first });
+      if (first < header.length)
+        batch.push_back({ ring->buffer, header.length - first });
+
+      tail += RecordSize(header.length);
+      drained = true;
+    }
+  }
+
+  for (int i = 0; i < fileCount; ++i)
+  {
+    if (batches[i].empty()) continue;
+    WriteFile(i, batches[i].data(), batches[i].size());
+    batches[i].clear();
+  }
+
+  // records can only be overwritten once they're written out
+  for (size_t i = 0; i < active.size(); ++i)
+  {
+    active[i]->tail.store(heads[i], std::memory_order_release);
+  }
+
+  return drained;
+}
+
+void Writer::Run()
+{
+  util::SetProcessTitle("LOG WRITER");
+
+  std::vector<std::shared_ptr<Ring>> active;
+  unsigned long long reportedDropped = totalDropped;
+  auto nextReport = std::chrono::steady_clock::now() + std::chrono::seconds(droppedInterval);
+
+  while (true)
+  {
+    // anything appended before the stop is still written
+    bool stop = !running;
+    if (reopen.exchange(false)) ReopenFiles();
+
+    if (ringsChanged.exchange(false))
+    {
+      std::lock_guard<std::mutex> lock(ringsMutex);
+      rings.erase(std::remove_if(rings.begin(), rings.end(),
+                  [](const std::shared_ptr<Ring>& ring)
+                  {
+                    return ring->orphaned && ring->head == ring->tail;
+                  }), rings.end());
+      active = rings;
+      
+      // orphans with lines left are removed once they've been drained
+      for (const auto& ring : active)
+      {
+        if (ring->orphaned) ringsChanged = true;
+      }
+    }
+
+    bool drained = Drain(active);
+    if (stop) break;
+
+    auto now = std::chrono::steady_clock::now();
+    if (now >= nextReport)
+    {
+      unsigned long long dropped = totalDropped;
+      if (dropped != reportedDropped)
+      {
+        Error("Log writer dropped %1% lines as logging outpaced writing", dropped - reportedDropped);
+        reportedDropped = dropped;
+      }
+      nextReport = now + std::chrono::seconds(droppedInterval);
+    }
+
+    if (!drained)
+    {
+      std::unique_lock<std::mutex> lock(wakeMutex);
+      sleeping = true;
+      if (running && !reopen && !ringsChanged && !Pending(active))
+        wakeCond.wait_for(lock, std::chrono::milliseconds(idleInterval));
+      sleeping = false;
+    }
+  }
+}
+
+int Writer::Open(const std::string& path)
+{
+  std::lock_guard<std::mutex> lock(instance.filesMutex);
+  for (int i = 0; i < instance.fileCount; ++i)
+  {
+    if (instance.paths[i] == path) return i;
+  }
+
+  if (instance.fileCount == maxFiles) throw std::logic_error("Too many log files");
+
+  int file = instance.fileCount;
+  instance.paths[file] = path;
+  instance.fds[file] = OpenFile(path);
+  ++instance.fileCount;
+  return file;
+}
+
+void Writer::Append(int file, const char* line, size_t len)
+{
+  if (instance.synchronous || !instance.running)
+  {
+    instance.WriteLine(file, line, len);
+    return;
+  }
+
+  // nothing legitimate comes close, but a line must always fit
+  static const size_t maxLine = ringSize / 4;
+  std::string truncated;
+  if (len > maxLine)
+  {
+    truncated.assign(line, maxLine - 1);
+    truncated += '\n';
+    line = truncated.data();
+    len = truncated.size();
+  }
+
+  if (!instance.ThreadRing().Push(file, line, len))
+  {
+    ++instance.totalDropped;
+    return;
+  }
+
+  instance.Wake();
+}
+
+void Writer::Reopen()
+{
+  if (instance.running && !instance.synchronous)
+  {
+    instance.reopen = true;
+    instance.Wake();
+  }
+  else
+    instance.ReopenFiles();
+}
+
+void Writer::Start()
+{
+  if (instance.running) return;
+  Debug("Starting log writer thread..");
+  instance.running = true;
+  instance.thread = boost::thread(&Writer::Run, &instance);
+}
+
+void Writer::Stop()
+{
+  if (!instance.running) return;
+  Debug("Stopping log writer thread..");
+  instance.running = false;
+  {
+    std::lock_guard<std::mutex> lock(instance.wakeMutex);
+    instance.wakeCond.notify_one();
+  }
+  instance.thread.join();
+}
+
+} /* logs namespace */
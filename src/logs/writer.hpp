@@ -0,0 +1,111 @@
+#ifndef __LOGS_WRITER_HPP
+#define __LOGS_WRITER_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/tss.hpp>
+#include <sys/uio.h>
+
+namespace logs
+{
+
+// log files are held open for the life of the process. while the writer
+// thread runs, lines are appended to a ring owned by the logging thread
+// and written out in batches, one writev per file. before the thread starts,
+// after it stops or once switched to synchronous mode lines are written
+// directly by the caller
+class Writer
+{
+  static const int maxFiles = 32;
+  static const size_t ringSize = 64 * 1024;
+
+  // single producer, the owning thread, and single consumer, the writer
+  struct Ring
+  {
+    // head and tail are kept on separate cache lines
+    std::atomic<unsigned long long> head;
+    char padding1[64 - sizeof(std::atomic<unsigned long long>)];
+    std::atomic<unsigned long long> tail;
+    char padding2[64 - sizeof(std::atomic<unsigned long long>)];
+    std::atomic<bool> orphaned;
+    char buffer[ringSize];
+
+    Ring() : head(0), tail(0), orphaned(false) { }
+
+    bool Push(int file, const char* data, size_t len);
+  };
+
+  // marks the ring for removal once the thread that owns it exits
+  struct RingHandle
+  {
+    std::shared_ptr<Ring> ring;
+    RingHandle(const std::shared_ptr<Ring>& ring) : ring(ring) { }
+    ~RingHandle();
+  };
+
+  std::string paths[maxFiles];
+  std::atomic<int> fds[maxFiles];
+  std::atomic<int> fileCount;
+  std::mutex filesMutex;
+
+  std::mutex ringsMutex;
+  std::vector<std::shared_ptr<Ring>> rings;
+  std::atomic<bool> ringsChanged;
+  boost::thread_specific_ptr<RingHandle> threadRing;
+
+  boost::thread thread;
+  std::atomic<bool> running;
+  std::atomic<bool> synchronous;
+  std::atomic<bool> sleeping;
+  std::atomic<bool> reopen;
+  std::mutex wakeMutex;
+  std::condition_variable wakeCond;
+
+  std::atomic<unsigned long long> totalDropped;
+  std::vector<struct iovec> batches[maxFiles];
+
+  static Writer instance;
+
+  Writer();
+  ~Writer();
+
+  Ring& ThreadRing();
+  void Wake();
+  void Run();
+  bool Pending(const std::vector<std::shared_ptr<Ring>>& active) const;
+  bool Drain(const std::vector<std::shared_ptr<Ring>>& active);
+  void WriteFile(int file, struct iovec* iov, int count);
+  void WriteLine(int file, const char* data, size_t len);
+  void ReopenFiles();
+
+public:
+  // registers a log file, returning the index used to append to it
+  static int Open(const std::string& path);
+
+  // line must include its terminating newline
+  static void Append(int file, const char* line, size_t len);
+  static void Append(int file, const std::string& line)
+  { Append(file, line.data(), line.length()); }
+
+  // reopens every file, used for rotation
+  static void Reopen();
+
+  // total lines dropped because a ring was full
+  static unsigned long long Dropped() { return instance.totalDropped; }
+
+  // writes directly from here on, for crash handlers where the writer
+  // thread may never run again
+  static void Synchronous() { instance.synchronous = true; }
+
+  static void Start();
+  static void Stop();
+};
+
+} /* logs namespace */
+
+#endif
@@ -31,6 +31,13 @@
 #include "db/replicator.hpp"
 #include "ftp/online.hpp"
 #include "fs/mode.hpp"
+#include "fs/dircache.hpp"
+#include "fs/freespace.hpp"
+#include "fs/pathcache.hpp"
+#include "fs/growth.hpp"
+#include "ftp/metrics.hpp"
+#include "logs/writer.hpp"
+#include "exec/worker.hpp"
 
 #include "version.hpp"
 
@@ -165,6 +172,7 @@ int main(int argc, char** argv)
     ftp::InitialisePortAllocators();
     ftp::InitialiseAddrAllocators();
     fs::InitialiseUmask();
+    exec::WorkerPool::Initialise();
     
     try
     {
@@ -179,6 +187,8 @@ int main(int argc, char** argv)
     
     if (!logs::InitialisePostConfig()) return 1;
     
+    fs::SetOwnershipStore(cfg::Get().OwnershipStore());
+    
     if (cfg::Get().TlsCertificate().empty())
     {
       logs::Debug("No TLS certificate set in config, TLS disabled.");
@@ -211,8 +221,8 @@ int main(int argc, char** argv)
       return 1;
     }
     
-    if (!db::Initialise([](acl::UserID uid)
-          { std::make_shared<ftp::task::UserUpdate>(uid)->Push(); }))
+    if (!db::Initialise([](const std::vector<acl::UserID>& uids)
+          { std::make_shared<ftp::task::UserUpdate>(uids)->Push(); }))
     {
       return 1;
     }
@@ -242,15 +252,30 @@ int main(int argc, char** argv)
       }
       else if (Daemonise(foreground))
       {
+        logs::Writer::Start();
+        // after forking so the id matches the pid file
+        ftp::Metrics::Initialise(ftp::MetricsSharedMemoryID(ftp::SharedMemoryID()));
         db::Replicator::Get().Start();
+        fs::DirectoryCache::Initialise();
+        fs::PathCache::Initialise();
+        fs::FreeSpaceMonitor::Initialise();
+        fs::GrowthNotifier::Initialise();
         ftp::Server::Get().StartThread();
         ftp::Server::Get().JoinThread();
+        fs::GrowthNotifier::Cleanup();
+        fs::FreeSpaceMonitor::Cleanup();
+        fs::PathCache::Cleanup();
+        fs::DirectoryCache::Cleanup();
         db::Replicator::Get().Stop();
         ftp::Server::Cleanup();
+        exec::WorkerPool::Cleanup();
+        ftp::Metrics::Cleanup();
+        logs::Writer::Stop();
       }
     }
 
     ftp::OnlineWriter::Cleanup();
+    db::Cleanup();
   }
 
   return exitStatus;
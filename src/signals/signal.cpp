@@ -5,6 +5,7 @@
 #include "ftp/task/task.hpp"
 #include "signals/signal.hpp"
 #include "logs/logs.hpp"
+#include "logs/writer.hpp"
 #include "util/debug.hpp"
 #include "text/error.hpp"
 #include "text/factory.hpp"
@@ -50,6 +51,7 @@ void Handler::Run()
     {
       case SIGHUP   :
       {
+        logs::Writer::Reopen();
         try
         {
           cfg::UpdateShared(cfg::Config::Load());
@@ -95,6 +97,8 @@ void PropogateSignal(int signo)
 
 void CrashHandler(int signo)
 {
+  logs::Writer::Synchronous();
+  
   const char* signame = nullptr;
   
   switch (signo)
@@ -124,6 +128,8 @@ void CrashHandler(int signo)
 
 void TerminateHandler()
 {
+  logs::Writer::Synchronous();
+  
   static bool rethrown = false;
   std::stringstream ss;
   try
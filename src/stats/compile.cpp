@@ -22,6 +22,13 @@ std::string CompileUserRanks(const std::string& section, Timeframe tf, Direction
   os << head.Compile();
   
   text::TemplateSection& body = templ.Body();
+  const int indexSlot = body.Slot("index");
+  const int userSlot = body.Slot("user");
+  const int groupSlot = body.Slot("group");
+  const int taglineSlot = body.Slot("tagline");
+  const int filesSlot = body.Slot("files");
+  const int sizeSlot = body.Slot("size");
+  const int speedSlot = body.Slot("speed");
 
   long long totalBytes = 0;
   long long totalFiles = 0;
@@ -37,13 +44,13 @@ std::string CompileUserRanks(const std::string& section, Timeframe tf, Direction
       auto user = acl::User::Load(u.ID());      
       if (!user || (filter && !filter(*user))) continue;
       
-      body.RegisterValue("index", ++index);
-      body.RegisterValue("user", user->Name());
-      body.RegisterValue("group", user->PrimaryGroup());
-      body.RegisterValue("tagline", user->Tagline());
-      body.RegisterValue("files", u.Files());
-      body.RegisterSize("size", u.KBytes());
-      body.RegisterSpeed("speed", u.Speed());
+      body.RegisterValue(indexSlot, ++index);
+      body.RegisterValue(userSlot, user->Name());
+      body.RegisterValue(groupSlot, user->PrimaryGroup());
+      body.RegisterValue(taglineSlot, user->Tagline());
+      body.RegisterValue(filesSlot, u.Files());
+      body.RegisterSize(sizeSlot, u.KBytes());
+      body.RegisterSpeed(speedSlot, u.Speed());
       os << body.Compile();
     }
     
@@ -73,6 +80,12 @@ std::string CompileGroupRanks(const std::string& section, Timeframe tf, Directio
   os << head.Compile();
   
   text::TemplateSection& body = templ.Body();
+  const int indexSlot = body.Slot("index");
+  const int groupSlot = body.Slot("group");
+  const int descrSlot = body.Slot("descr");
+  const int filesSlot = body.Slot("files");
+  const int sizeSlot = body.Slot("size");
+  const int speedSlot = body.Slot("speed");
 
   long long totalKBytes = 0;
   long long totalFiles = 0;
@@ -86,12 +99,12 @@ std::string CompileGroupRanks(const std::string& section, Timeframe tf, Directio
     if (index < max)
     {
       auto group = acl::Group::Load(g.ID());
-      body.RegisterValue("index", ++index);
-      body.RegisterValue("group", group ? group->Name() : "unknown");
-      body.RegisterValue("descr", group ? group->Description() : "");
-      body.RegisterValue("files", g.Files());
-      body.RegisterSize("size", g.KBytes());
-      body.RegisterSpeed("speed", g.Speed());
+      body.RegisterValue(indexSlot, ++index);
+      body.RegisterValue(groupSlot, group ? group->Name() : "unknown");
+      body.RegisterValue(descrSlot, group ? group->Description() : "");
+      body.RegisterValue(filesSlot, g.Files());
+      body.RegisterSize(sizeSlot, g.KBytes());
+      body.RegisterSpeed(speedSlot, g.Speed());
       
       os << body.Compile();
     }
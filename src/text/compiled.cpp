@@ -0,0 +1,82 @@
+#include <algorithm>
+#include <cctype>
+#include "util/string.hpp"
+#include "text/compiled.hpp"
+#include "text/error.hpp"
+
+namespace text
+{
+
+void CompiledSection::Append(const std::string& text)
+{
+  if (text.empty()) return;
+  if (pieces.empty() || pieces.back().tag != -1)
+    pieces.emplace_back(text, -1, -1);
+  else
+    pieces.back().text += text;
+  length += text.length();
+}
+
+void CompiledSection::AppendTag(std::string tagStr)
+{
+  util::Trim(tagStr);
+  util::ToLower(tagStr);
+
+  std::vector<std::string> args;
+  util::Split(args, tagStr, "|");
+  if (args.empty()) throw TemplateError("Invalid tag: " + tagStr);
+  
+  const std::string& name = args.front();
+  Tag tag(name);
+
+  for (auto it = args.begin() + 1; it != args.end(); ++it)
+  {
+    tag.SetFilter(*it);
+  }
+
+  int slot = slots.insert(std::make_pair(name, static_cast<int>(slots.size()))).first->second;
+  tags.emplace_back(tag);
+
+  if (pieces.empty() || pieces.back().tag != -1)
+    pieces.emplace_back("", tags.size() - 1, slot);
+  else
+  {
+    pieces.back().tag = tags.size() - 1;
+    pieces.back().slot = slot;
+  }
+}
+
+int CompiledSection::Slot(const std::string& tagName) const
+{
+  auto it = slots.find(tagName);
+  if (it != slots.end()) return it->second;
+
+  // callers nearly always pass lower case names already
+  if (std::none_of(tagName.begin(), tagName.end(), 
+                   [](char ch) { return std::isupper(ch); }))
+    return -1;
+
+  it = slots.find(util::ToLowerCopy(tagName));
+  return it != slots.end() ? it->second : -1;
+}
+
+std::string CompiledSection::Render(const std::vector<TagValue>& values) const
+{
+  static const TagValue empty = std::string();
+
+  std::string out;
+  out.reserve(length + tags.size() * 16);
+  for (const Piece& piece : pieces)
+  {
+    out += piece.text;
+    if (piece.tag == -1) continue;
+
+    const TagValue& value = static_cast<size_t>(piece.slot) < values.size() ? 
+                            values[piece.slot] : empty;
+    tags[piece.tag].Compile(value, out);
+  }
+  return out;
+}
+
+// end
+}
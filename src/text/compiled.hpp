@@ -0,0 +1,55 @@
+#ifndef __TEXT_COMPILED_HPP
+#define __TEXT_COMPILED_HPP
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "text/tag.hpp"
+
+namespace text
+{
+
+// a section as it was parsed, runs of literal text each followed by a tag.
+// tag names are resolved to value slots once here, tags sharing a name
+// share a slot, so a loaded template is never searched or copied again
+class CompiledSection
+{
+  struct Piece
+  {
+    std::string text;
+    int tag;    // -1 for trailing text
+    int slot;
+
+    Piece(const std::string& text, int tag, int slot) :
+      text(text), tag(tag), slot(slot) { }
+  };
+
+  std::vector<Piece> pieces;
+  std::vector<Tag> tags;
+  std::unordered_map<std::string, int> slots;
+  size_t length;
+
+public:
+  CompiledSection() : length(0) { }
+
+  void Append(const std::string& text);
+  void AppendTag(std::string tagStr);
+
+  // -1 when no tag in the section has the name
+  int Slot(const std::string& tagName) const;
+  size_t Slots() const { return slots.size(); }
+
+  // values are indexed by slot, missing values are empty
+  std::string Render(const std::vector<TagValue>& values) const;
+};
+
+struct CompiledTemplate
+{
+  CompiledSection head;
+  CompiledSection body;
+  CompiledSection foot;
+};
+
+// end
+}
+#endif
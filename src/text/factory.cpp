@@ -37,7 +37,7 @@ util::Error Factory::Initialize()
       try
       {
         TemplateParser templ(file.ToString());
-        factory->templates.insert(std::make_pair(name, templ.Create()));
+        factory->templates.insert(std::make_pair(name, templ.Compile()));
       }
       catch (const text::TemplateError& e)
       {
@@ -68,10 +68,18 @@ Template Factory::GetTemplate(const std::string& templ)
 {
   std::string name = util::ToLowerCopy(templ);
   
-  std::lock_guard<std::mutex> lock(mutex);
-  if (!instance.get() || instance->templates.find(name) == instance->templates.end())
-    throw TemplateError("No such template (" + templ + ")");
-  return instance->templates.at(name);
+  std::shared_ptr<const CompiledTemplate> compiled;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (instance.get())
+    {
+      auto it = instance->templates.find(name);
+      if (it != instance->templates.end()) compiled = it->second;
+    }
+  }
+  
+  if (!compiled) throw TemplateError("No such template (" + templ + ")");
+  return Template(compiled);
 }
   
 // end
@@ -5,6 +5,7 @@
 #include <unordered_map>
 #include <memory>
 #include <mutex>
+#include "text/compiled.hpp"
 #include "text/template.hpp"
 #include "text/parser.hpp"
 #include "text/templatesection.hpp"
@@ -15,7 +16,7 @@ namespace text
 
 class Factory
 {
-  std::unordered_map<std::string, Template> templates;
+  std::unordered_map<std::string, std::shared_ptr<const CompiledTemplate>> templates;
   
   static std::mutex mutex;
   static std::unique_ptr<Factory> instance;
@@ -1,6 +1,7 @@
 #include "util/string.hpp"
 #include <fstream>
 #include <memory>
+#include <sstream>
 #include "text/parser.hpp"
 #include "text/templatesection.hpp"
 #include "text/error.hpp"
@@ -9,48 +10,45 @@
 namespace text
 {
 
-Template TemplateParser::Create()
+namespace
 {
-  std::ifstream io(file.c_str()); 
-  if (!io) throw TemplateError("Unable to open template file: " + file);
 
-  std::stringstream ss;
+bool ReadFile(const std::string& file, std::string& text)
+{
+  std::ifstream io(file.c_str());
+  if (!io) return false;
+  std::ostringstream os;
+  os << io.rdbuf();
+  text = os.str();
+  return true;
+}
 
-  while (io.good())
-  {
-    char c;
-    if (io >> std::noskipws >> c)
-      buf.Stream() << c;
-  }
+}
 
-  buf.Parse();
+std::shared_ptr<const CompiledTemplate> TemplateParser::Compile()
+{
+  std::string text;
+  if (!ReadFile(file, text)) throw TemplateError("Unable to open template file: " + file);
+
+  buf.Parse(text);
 
-  return buf.GetTemplate();
+  return buf.Compiled();
 }
 
 void TemplateBuffer::ParseInclude(const std::string& file)
 {
-  std::ifstream io(file.c_str());
-  if (!io) throw TemplateError("Unable to open include file (" + file + ")");
+  std::string text;
+  if (!ReadFile(file, text)) throw TemplateError("Unable to open include file (" + file + ")");
 
   state = TemplateState::None;
-
-  while (io.good())
-  {
-    char c;
-    if (io >> std::noskipws >> c)
-      ParseState(c);
-  }
-
+  Parse(text);
   state = TemplateState::None;
 }
 
-
-void TemplateBuffer::Parse()
+void TemplateBuffer::Parse(const std::string& text)
 { 
-  while (ss.good())
+  for (char c : text)
   {
-    char c = ss.get();
     ParseState(c);
   }
 }
@@ -60,7 +58,7 @@ void TemplateBuffer::ParseState(char c)
   switch (state)
   {
     case TemplateState::Escape:
-      buffer << c; 
+      buffer += c; 
       state = TemplateState::None;
       return;
 
@@ -152,38 +150,41 @@ void TemplateBuffer::ParseChar(char c)
   if (state == TemplateState::ReadLogic ||
       state == TemplateState::ReadFilter)
   {
-    var << c;
+    var += c;
   }
   else
   {
-    buffer << c;
+    buffer += c;
   }
 }
 
 void TemplateBuffer::ParseBlock()
 {
+  section.Append(buffer);
+
   if (block == TemplateBlock::Head)
-    templ.Head().RegisterBuffer(buffer.str());
+    templ->head = std::move(section);
   else if (block == TemplateBlock::Body)
-    templ.Body().RegisterBuffer(buffer.str());
+    templ->body = std::move(section);
   else if (block == TemplateBlock::Foot)
-    templ.Foot().RegisterBuffer(buffer.str());
+    templ->foot = std::move(section);
   
   /* reset */
   state = TemplateState::None;
   block = TemplateBlock::Head;
   linePos = 1;
   charPos = 1;
-  var.str(std::string());
-  buffer.str(std::string());
+  var.clear();
+  buffer.clear();
+  section = CompiledSection();
 }
 
 void TemplateBuffer::ParseLogic()
 {
-  std::string logic = var.str();
+  std::string logic = var;
 
   /* cleanup */
-  var.str(std::string());
+  var.clear();
 
   util::Trim(logic);
   util::ToLower(logic);
@@ -198,17 +199,20 @@ void TemplateBuffer::ParseLogic()
 
   else if (logic == "head")
   {
-    buffer.str(std::string()); /* clear buffer because the start of a new block */
+    buffer.clear(); /* clear buffer because the start of a new block */
+    section = CompiledSection();
     block = TemplateBlock::Head; 
   }
   else if (logic == "body")
   {
-    buffer.str(std::string());
+    buffer.clear();
+    section = CompiledSection();
     block = TemplateBlock::Body; 
   }
   else if (logic == "foot")
   {
-    buffer.str(std::string());
+    buffer.clear();
+    section = CompiledSection();
     block = TemplateBlock::Foot; 
   }
   else if (logic == "include")
@@ -227,27 +231,137 @@ void TemplateBuffer::ParseLogic()
 
 void TemplateBuffer::ParseFilter()
 {
-  std::string filter = var.str();
+  std::string filter = var;
 
   /* cleanup */
-  var.str(std::string());
+  var.clear();
 
-  util::Trim(filter);
-  util::ToLower(filter);
+  section.Append(buffer);
+  buffer.clear();
+  section.AppendTag(filter);
+}
 
-  buffer << "{{";
+}
 
-  if (block == TemplateBlock::Head)
-    buffer << templ.Head().RegisterTag(filter);
-  
-  else if (block == TemplateBlock::Body)
-    buffer << templ.Body().RegisterTag(filter);
+#ifdef TEMPLATE_TEST
 
-  else if (block == TemplateBlock::Foot)
-    buffer << templ.Foot().RegisterTag(filter);
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
 
-   buffer << "}}";
+// times loading a ranks style template, taking a copy of it and rendering
+// its rows with values filled in by name and by slot
+// usage: templatetest [rows]
+
+namespace
+{
 
+const char* ranksTemplate =
+  "{% head %}\n"
+  ".-------------------------------------------------------------.\n"
+  "| {{section|upper|10}} ranks                                    |\n"
+  "{% endblock %}\n"
+  "{% body %}\n"
+  "| {{index|3}}. {{user|left|12}} {{group|left|10}} {{tagline|left|20}} "
+  "{{files|6}} {{size|auto}} {{speed|kb}}/s |\n"
+  "{% endblock %}\n"
+  "{% foot %}\n"
+  "| {{users}} users, {{files}} files, {{size|auto}} at {{speed}}/s |\n"
+  "'-------------------------------------------------------------'\n"
+  "{% endblock %}\n";
+
+template <typename Function>
+double Time(Function fn, int iterations)
+{
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) fn();
+  std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count() / iterations;
+}
+
+std::string RenderByName(const text::Template& compiled, int rows)
+{
+  text::Template templ(compiled);
+  std::string out = templ.Head().Compile();
+  text::TemplateSection& body = templ.Body();
+  for (int i = 0; i < rows; ++i)
+  {
+    body.RegisterValue("index", i + 1);
+    body.RegisterValue("user", "someuser");
+    body.RegisterValue("group", "somegroup");
+    body.RegisterValue("tagline", "no tagline set");
+    body.RegisterValue("files", 1000 - i);
+    body.RegisterSize("size", 1024LL * 1024 * (1000 - i));
+    body.RegisterSpeed("speed", 12345.67);
+    out += body.Compile();
+  }
+  return out + templ.Foot().Compile();
+}
+
+std::string RenderBySlot(const text::Template& compiled, int rows)
+{
+  text::Template templ(compiled);
+  std::string out = templ.Head().Compile();
+  text::TemplateSection& body = templ.Body();
+  const int indexSlot = body.Slot("index");
+  const int userSlot = body.Slot("user");
+  const int groupSlot = body.Slot("group");
+  const int taglineSlot = body.Slot("tagline");
+  const int filesSlot = body.Slot("files");
+  const int sizeSlot = body.Slot("size");
+  const int speedSlot = body.Slot("speed");
+  for (int i = 0; i < rows; ++i)
+  {
+    body.RegisterValue(indexSlot, i + 1);
+    body.RegisterValue(userSlot, "someuser");
+    body.RegisterValue(groupSlot, "somegroup");
+    body.RegisterValue(taglineSlot, "no tagline set");
+    body.RegisterValue(filesSlot, 1000 - i);
+    body.RegisterSize(sizeSlot, 1024LL * 1024 * (1000 - i));
+    body.RegisterSpeed(speedSlot, 12345.67);
+    out += body.Compile();
+  }
+  return out + templ.Foot().Compile();
 }
 
 }
+
+int main(int argc, char** argv)
+{
+  int rows = argc > 1 ? atoi(argv[1]) : 100;
+  const int iterations = 1000;
+
+  char path[] = "/tmp/templatetest.XXXXXX";
+  int fd = mkstemp(path);
+  if (fd < 0) return 1;
+  FILE* fp = fdopen(fd, "w");
+  fputs(ranksTemplate, fp);
+  fclose(fp);
+
+  try
+  {
+    double loadMs = Time([&]() { text::TemplateParser(path).Create(); }, iterations);
+    text::Template templ(text::TemplateParser(path).Create());
+
+    size_t byName = 0;
+    size_t bySlot = 0;
+    double copyMs = Time([&]() { text::Template copy(templ); }, iterations * 100);
+    double nameMs = Time([&]() { byName = RenderByName(templ, rows).length(); }, iterations);
+    double slotMs = Time([&]() { bySlot = RenderBySlot(templ, rows).length(); }, iterations);
+
+    std::cout << rows << " rows" << std::endl;
+    std::cout << "load:            " << loadMs << "ms" << std::endl;
+    std::cout << "copy:            " << copyMs << "ms" << std::endl;
+    std::cout << "render by name:  " << nameMs << "ms (" << byName << ")" << std::endl;
+    std::cout << "render by slot:  " << slotMs << "ms (" << bySlot << ")" << std::endl;
+  }
+  catch (const text::TemplateError& e)
+  {
+    std::cerr << e.Message() << std::endl;
+  }
+
+  return unlink(path);
+}
+
+#endif
@@ -1,8 +1,9 @@
 #ifndef __TEXT_PARSER_HPP
 #define __TEXT_PARSER_HPP
 
+#include <memory>
 #include <string>
-#include <sstream>
+#include "text/compiled.hpp"
 #include "text/template.hpp"
 
 namespace text
@@ -28,26 +29,26 @@ enum class TemplateState
 
 class TemplateBuffer
 {
-  std::ostringstream buffer;
-  std::ostringstream var;
-  std::stringstream ss;
+  std::string buffer;
+  std::string var;
 
   TemplateState state;
   TemplateBlock block;
-  Template templ;
+  CompiledSection section;
+  std::shared_ptr<CompiledTemplate> templ;
 
   int charPos;
   int linePos;
 public:
   TemplateBuffer() : 
-    ss(),
     state(TemplateState::None), 
     block(TemplateBlock::Head),
+    templ(std::make_shared<CompiledTemplate>()),
     charPos(1),
     linePos(1)
   {}
 
-  void Parse();
+  void Parse(const std::string& text);
   void ParseState(char c); 
   void ParseChar(char c); 
   void ParseFilter();
@@ -55,9 +56,7 @@ public:
   void ParseBlock();
   void ParseInclude(const std::string& file);
 
-  std::stringstream& Stream() { return ss; }
-
-  void Append(char c) { buffer << c; }
+  void Append(char c) { buffer += c; }
 
   int LinePos() const { return linePos; }
   int CharPos() const { return charPos; }
@@ -65,7 +64,7 @@ public:
   const TemplateState& State() const { return state; }
   void State(const TemplateState& state) { this->state = state; }
 
-  Template GetTemplate() { return templ; }
+  std::shared_ptr<const CompiledTemplate> Compiled() { return templ; }
 };
 
 class TemplateParser
@@ -77,7 +76,8 @@ public:
     file(file)
   {}
 
-  Template Create();
+  std::shared_ptr<const CompiledTemplate> Compile();
+  Template Create() { return Template(Compile()); }
 
 };
 
@@ -1,4 +1,6 @@
 #include <cctype>
+#include <cstdarg>
+#include <cstdio>
 #include <boost/format.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/regex.hpp>
@@ -24,11 +26,35 @@ class comma_numpunct : public std::numpunct<char>
 
 std::locale prettyLocale(std::locale(), new comma_numpunct());
 
+std::string Sprintf(const char* format, ...)
+{
+  va_list args;
+  va_start(args, format);
+  va_list again;
+  va_copy(again, args);
+  
+  char buf[256];
+  int len = vsnprintf(buf, sizeof(buf), format, args);
+  va_end(args);
+
+  std::string result;
+  if (len >= 0 && len < static_cast<int>(sizeof(buf)))
+    result.assign(buf, len);
+  else if (len >= 0)
+  {
+    result.resize(len + 1);
+    vsnprintf(&result[0], len + 1, format, again);
+    result.resize(len);
+  }
+
+  va_end(again);
+  return result;
+}
+
 }
 
 Tag::Tag(const std::string& name) : 
   name(util::ToLowerCopy(name)),
-  value(""),
   alignment(Alignment::Right), 
   unitConv(UnitConversion::Kbyte), 
   caseConv(CaseConversion::None),
@@ -108,28 +134,25 @@ std::string Tag::Format(const std::string& format, const T& value) const
     return (boost::format("%" + AlignmentStr() + format) % value).str();
 }
 
-std::string Tag::CompileString() const
+// boost::format is only needed for what printf can't do, pretty numbers
+// and centering, the rest is formatted without parsing a format object
+
+std::string Tag::CompileString(const std::string& value) const
 {
-  std::string value;
-  try
-  {
-    value = boost::get<std::string>(this->value);
-  }
-  catch (const boost::bad_get&)
-  {
-    // no value registered for tag, continue with empty string
-  }
+  if (!pretty && alignment != Alignment::Center)
+    return Sprintf(("%" + AlignmentStr() + format + "s").c_str(), value.c_str());
   return Format(format + "s", value);
 }
 
-std::string Tag::CompileInteger() const
+std::string Tag::CompileInteger(long long value) const
 {
-  return Format(format + "li", boost::get<long long>(this->value));
+  if (!pretty && alignment != Alignment::Center)
+    return Sprintf(("%" + AlignmentStr() + format + "lli").c_str(), value);
+  return Format(format + "li", value);
 }
 
-std::string Tag::CompileDouble() const
+std::string Tag::CompileDouble(double value) const
 {
-  double value = boost::get<double>(this->value);
   std::string unitStr;
   switch (unitConv)
   {
@@ -160,33 +183,52 @@ std::string Tag::CompileDouble() const
   }
 
   std::string format(this->format.empty() ? ".2" : this->format);
+  if (!pretty && alignment != Alignment::Center)
+    return Sprintf(("%" + AlignmentStr() + format + "f").c_str(), value) + unitStr;
   return Format(format + "f", value) + unitStr;
 }
 
-std::string Tag::Compile() const
+void Tag::Compile(const TagValue& value, std::string& out) const
 { 
+  // plain tags are the most common by far and need no formatting
+  bool plain = format.empty() && alignment == Alignment::Right && !pretty;
+  if (plain && caseConv == CaseConversion::None)
+  {
+    if (const std::string* s = boost::get<std::string>(&value))
+    {
+      out += *s;
+      return;
+    }
+    
+    if (const long long* i = boost::get<long long>(&value))
+    {
+      out += std::to_string(*i);
+      return;
+    }
+  }
+
   std::string compiled;
   switch (value.which())
   {
     case 0  :
     {
-      compiled = CompileString();
+      compiled = CompileString(boost::get<std::string>(value));
       break;
     }
     case 1  :
     {
-      compiled = CompileInteger();
+      compiled = CompileInteger(boost::get<long long>(value));
       break;
     }
     case 2  :
     {
-      compiled = CompileDouble();
+      compiled = CompileDouble(boost::get<double>(value));
       break;
     }
   }
   
   CaseConvert(compiled);
-  return compiled;
+  out += compiled;
 }
 
 }
@@ -31,11 +31,12 @@ enum class CaseConversion
   Title
 };
 
+typedef boost::variant<std::string, long long, double> TagValue;
+
 class Tag
 {
 private:
   std::string name;
-  boost::variant<std::string, long long, double> value;
   Alignment alignment;
   UnitConversion unitConv;
   CaseConversion caseConv;
@@ -57,20 +58,17 @@ private:
   void CaseConvert(std::string& s) const;
   template <typename T> std::string Format(const std::string& format, const T& value) const;
   
-  std::string CompileString() const;
-  std::string CompileInteger() const;
-  std::string CompileDouble() const;
+  std::string CompileString(const std::string& value) const;
+  std::string CompileInteger(long long value) const;
+  std::string CompileDouble(double value) const;
   
 public:
   explicit Tag(const std::string& name);
 
   void SetFilter(std::string filter);
-  std::string Compile() const;
-  
-  void RegisterValue(std::string value) { this->value = value; }
-  void RegisterValue(long long value) { this->value = value; }
-  void RegisterSize(long long kBytes) { this->value = static_cast<double>(kBytes); }
-  void RegisterSpeed(double speed) { this->value = speed; }
+
+  // appends the value formatted by this tag's filters
+  void Compile(const TagValue& value, std::string& out) const;
 
   const std::string& Name() const { return name; }
 };
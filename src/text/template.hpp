@@ -1,26 +1,34 @@
 #ifndef __TEXT_TEMPLATE_HPP
 #define __TEXT_TEMPLATE_HPP
 
+#include <memory>
+#include "text/compiled.hpp"
 #include "text/templatesection.hpp"
 
 namespace text
 {
 
+// shares its compiled sections with every other copy, so copies are
+// cheap and only carry the values being filled in
 class Template
 {
+  std::shared_ptr<const CompiledTemplate> compiled;
   TemplateSection head;
   TemplateSection body;
   TemplateSection foot;
 public:
+  explicit Template(const std::shared_ptr<const CompiledTemplate>& compiled) :
+    compiled(compiled),
+    head(compiled->head),
+    body(compiled->body),
+    foot(compiled->foot)
+  { }
 
   TemplateSection& Head() { return head; }
   TemplateSection& Body() { return body; }
   TemplateSection& Foot() { return foot; }
-
-  friend class TemplateParser;
 };
 
 // end
 }
 #endif
-
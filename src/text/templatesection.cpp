@@ -1,63 +1,35 @@
-#include "util/string.hpp"
-#include <boost/algorithm/string/replace.hpp>
 #include "text/templatesection.hpp"
-#include "text/error.hpp"
 
 namespace text
 {
 
-std::string TemplateSection::RegisterTag(std::string tagStr)
+template <typename T>
+void TemplateSection::SetValue(int slot, const T& value)
 {
-  util::Trim(tagStr);
-  util::ToLower(tagStr);
-
-  std::vector<std::string> args;
-  util::Split(args, tagStr, "|");
-  if (args.empty()) throw TemplateError("Invalid tag: " + tagStr);
-  
-  const std::string& name = args.front();
-  Tag tag(name);
-
-  for (auto it = args.begin() + 1; it != args.end(); ++it)
-  {
-    tag.SetFilter(*it);
-  }
-
-  tags.emplace_back(tag);
-
-  return name;
+  if (slot == -1) return;
+  // only sections that are filled in need their values
+  if (values.empty()) values.resize(compiled->Slots());
+  values[slot] = value;
 }
 
-void TemplateSection::DoRegisterValue(std::string tagName, 
-    const std::function<void(Tag&)>& doRegister)
-{
-  util::ToLower(tagName);
-  for (auto& tag : tags)
-  {
-    if (tag.Name() == tagName)
-      doRegister(tag);
-  }
-}
-  
-void TemplateSection::RegisterValue(const std::string& tagName, const std::string& value)
+void TemplateSection::RegisterValue(int slot, const std::string& value)
 {
-  DoRegisterValue(tagName, [&value](Tag& tag) { tag.RegisterValue(value); });
+  SetValue(slot, value);
 }
 
-void TemplateSection::RegisterValue(const std::string& tagName, int value)
+void TemplateSection::RegisterValue(int slot, int value)
 {
-  DoRegisterValue(tagName, [value](Tag& tag) { tag.RegisterValue(value); });
+  SetValue(slot, static_cast<long long>(value));
 }
 
-void TemplateSection::RegisterSize(const std::string& tagName, long long kBytes)
+void TemplateSection::RegisterSize(int slot, long long kBytes)
 {
-  DoRegisterValue(tagName, [kBytes](Tag& tag) { tag.RegisterSize(kBytes); });
+  SetValue(slot, static_cast<double>(kBytes));
 }
 
-
-void TemplateSection::RegisterSpeed(const std::string& tagName, double speed)
+void TemplateSection::RegisterSpeed(int slot, double speed)
 {
-  DoRegisterValue(tagName, [speed](Tag& tag) { tag.RegisterSpeed(speed); });
+  SetValue(slot, speed);
 }
 
 void TemplateSection::RegisterSpeed(const std::string& tagName, long long kBytes, 
@@ -67,15 +39,4 @@ void TemplateSection::RegisterSpeed(const std::string& tagName, long long kBytes
   else RegisterSpeed(tagName, kBytes / xfertime / 1.0);
 }
 
-std::string TemplateSection::Compile()
-{
-  std::string compiled = buffer;
-  for (auto& tag : tags)
-  {
-    boost::replace_first(compiled, "{{" + tag.Name() + "}}", tag.Compile());
-  }
-  return compiled;
 }
-
-}
-
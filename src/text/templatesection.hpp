@@ -2,43 +2,46 @@
 #define __TEXT_TEMPLATESECTION_HPP
 
 #include <string>
-#include <unordered_map>
-#include <functional>
-#include <algorithm>
+#include <vector>
+#include "text/compiled.hpp"
 #include "text/tag.hpp"
-#include "util/error.hpp"
 
 namespace text
 {
 
+// the values for one rendering of a compiled section. a tag's slot can
+// be looked up once and used instead of its name when filling in rows
 class TemplateSection
 {
-  std::string buffer;
-  std::vector<Tag> tags;
+  const CompiledSection* compiled;
+  std::vector<TagValue> values;
 
-  void DoRegisterValue(std::string tagName, const std::function<void(Tag&)>& doRegister);
+  template <typename T> void SetValue(int slot, const T& value);
   
 public:
-  void RegisterBuffer(const std::string& buffer) { this->buffer = buffer; }
-  std::string RegisterTag(std::string tagStr);
+  explicit TemplateSection(const CompiledSection& compiled) : compiled(&compiled) { }
 
-  void RegisterValue(const std::string& tagName, const std::string& value);
-  void RegisterValue(const std::string& tagName, int value);
+  int Slot(const std::string& tagName) const { return compiled->Slot(tagName); }
 
-  void RegisterSize(const std::string& tagName, long long kBytes);
+  void RegisterValue(const std::string& tagName, const std::string& value)
+  { RegisterValue(Slot(tagName), value); }
+  void RegisterValue(const std::string& tagName, int value)
+  { RegisterValue(Slot(tagName), value); }
+
+  void RegisterSize(const std::string& tagName, long long kBytes)
+  { RegisterSize(Slot(tagName), kBytes); }
   void RegisterSpeed(const std::string& tagName, long long bytes, long long xfertime);
-  void RegisterSpeed(const std::string& tagName, double speed);
+  void RegisterSpeed(const std::string& tagName, double speed)
+  { RegisterSpeed(Slot(tagName), speed); }
+
+  void RegisterValue(int slot, const std::string& value);
+  void RegisterValue(int slot, int value);
+  void RegisterSize(int slot, long long kBytes);
+  void RegisterSpeed(int slot, double speed);
 
-  std::string Compile();
+  std::string Compile() const { return compiled->Render(values); }
   
-  bool HasTag(const std::string& tagName) const
-  {
-    return std::find_if(tags.begin(), tags.end(), 
-              [&](const Tag& tag) 
-              { 
-                return tag.Name() == tagName; 
-              }) != tags.end();
-  }
+  bool HasTag(const std::string& tagName) const { return Slot(tagName) != -1; }
 };
 
 // end
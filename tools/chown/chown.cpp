@@ -9,6 +9,8 @@
 #include "cfg/config.hpp"
 #include "cfg/error.hpp"
 #include "fs/owner.hpp"
+#include "fs/ownertable.hpp"
+#include "util/path/path.hpp"
 #include "util/path/status.hpp"
 #include "util/path/diriterator.hpp"
 #include "version.hpp"
@@ -100,6 +102,7 @@ void SetOwner(Iterator begin, Iterator end, const fs::Owner& owner, bool recursi
   for (auto it = begin; it != end; ++it)
   {
     const std::string& path = *it;
+    if (util::path::Basename(path) == fs::OwnerTable::filename) continue;
     
     auto e = fs::SetOwner(path, owner);
     if (!e) std::cerr << path << ": " << e.Message() << std::endl;
@@ -191,6 +194,8 @@ int main(int argc, char** argv)
     return 1;
   }
 
+  fs::SetOwnershipStore(config->OwnershipStore());
+
   fs::Owner owner(-1, -1);
   auto e = LookupOwner(user, group, owner);
   if (!e)
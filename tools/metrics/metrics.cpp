@@ -0,0 +1,220 @@
+#include <iostream>
+#include <sstream>
+#include <boost/program_options/options_description.hpp>
+#include <boost/program_options/variables_map.hpp>
+#include <boost/program_options/parsers.hpp>
+#include "cfg/get.hpp"
+#include "cfg/error.hpp"
+#include "version.hpp"
+#include "ftp/online.hpp"
+#include "ftp/metrics.hpp"
+
+namespace po = boost::program_options;
+
+void DisplayHelp(char* argv0, po::options_description& desc)
+{
+  std::cout << "usage: " << argv0 << " [options]" << std::endl;
+  std::cout << desc;
+}
+
+void DisplayVersion()
+{
+  std::cout << "ebftpd metrics " + std::string(version) << std::endl;
+}
+
+bool ParseOptions(int argc, char** argv, std::string& configPath, std::string& format)
+{
+  po::options_description visible("supported options");
+  visible.add_options()
+    ("help,h", "display this help message")
+    ("version,v", "display version")
+    ("config-path,c", po::value<std::string>(&configPath), "specify location of config file")
+    ("format,f", po::value<std::string>(&format)->default_value("prometheus"),
+     "output format, prometheus or json")
+  ;
+
+  po::variables_map vm;
+  try
+  {
+    po::store(po::command_line_parser(argc, argv).options(visible).run(), vm);
+
+    if (vm.count("help"))
+    {
+      DisplayHelp(argv[0], visible);
+      return false;
+    }
+
+    if (vm.count("version"))
+    {
+      DisplayVersion();
+      return false;
+    }
+
+    po::notify(vm);
+  }
+  catch (const po::error& e)
+  {
+    std::cerr << e.what() << std::endl;
+    DisplayHelp(argv[0], visible);
+    return false;
+  }
+
+  if (format != "prometheus" && format != "json")
+  {
+    std::cerr << "Invalid format: " << format << std::endl;
+    DisplayHelp(argv[0], visible);
+    return false;
+  }
+
+  return true;
+}
+
+void PrometheusHistogram(std::ostream& os, const std::string& name, const std::string& label,
+                         const ftp::MetricsSnapshot::Histogram& histogram)
+{
+  unsigned long long cumulative = 0;
+  for (unsigned i = 0; i < ftp::MetricsHistogram::numBuckets - 1; ++i)
+  {
+    cumulative += histogram.buckets[i];
+    os << name << "_bucket{" << label << ",le=\""
+       << db::LatencyHistogram::bucketBounds[i] << "\"} " << cumulative << "\n";
+  }
+  os << name << "_bucket{" << label << ",le=\"+Inf\"} " << histogram.count << "\n";
+  os << name << "_sum{" << label << "} " << histogram.total << "\n";
+  os << name << "_count{" << label << "} " << histogram.count << "\n";
+}
+
+void Prometheus(std::ostream& os, const ftp::MetricsSnapshot& snapshot)
+{
+  for (unsigned i = 0; i < ftp::MetricsShard::numMetrics; ++i)
+  {
+    std::string name = "ebftpd_" + ftp::Metrics::MetricName(static_cast<ftp::Metric>(i)) + "_total";
+    os << "# TYPE " << name << " counter\n";
+    os << name << " " << snapshot.counters[i] << "\n";
+  }
+
+  for (unsigned i = 0; i < ftp::MetricsHeader::numOccupancies; ++i)
+  {
+    std::string name = "ebftpd_" + ftp::Metrics::OccupancyName(static_cast<ftp::Occupancy>(i));
+    os << "# TYPE " << name << " gauge\n";
+    os << name << " " << snapshot.occupancy[i] << "\n";
+  }
+
+  os << "# TYPE ebftpd_command_latency_microseconds histogram\n";
+  for (unsigned i = 0; i < ftp::MetricsShard::numVerbs; ++i)
+  {
+    if (snapshot.commands[i].count == 0) continue;
+    PrometheusHistogram(os, "ebftpd_command_latency_microseconds",
+                        "verb=\"" + std::string(ftp::Metrics::VerbName(i)) + "\"",
+                        snapshot.commands[i]);
+  }
+
+  os << "# TYPE ebftpd_db_latency_microseconds histogram\n";
+  for (unsigned i = 0; i < ftp::MetricsShard::numOperations; ++i)
+  {
+    PrometheusHistogram(os, "ebftpd_db_latency_microseconds",
+                        "operation=\"" + db::OperationName(static_cast<db::Operation>(i)) + "\"",
+                        snapshot.database[i]);
+  }
+}
+
+void JSONHistogram(std::ostream& os, const ftp::MetricsSnapshot::Histogram& histogram)
+{
+  os << "{\"count\":" << histogram.count << ",\"sum\":" << histogram.total << ",\"buckets\":[";
+  for (unsigned i = 0; i < ftp::MetricsHistogram::numBuckets; ++i)
+  {
+    if (i > 0) os << ",";
+    os << "{\"le\":";
+    if (i < ftp::MetricsHistogram::numBuckets - 1) os << db::LatencyHistogram::bucketBounds[i];
+    else os << "null";
+    os << ",\"count\":" << histogram.buckets[i] << "}";
+  }
+  os << "]}";
+}
+
+// names are all plain ascii so nothing needs escaping
+void JSON(std::ostream& os, const ftp::MetricsSnapshot& snapshot)
+{
+  os << "{\"counters\":{";
+  for (unsigned i = 0; i < ftp::MetricsShard::numMetrics; ++i)
+  {
+    if (i > 0) os << ",";
+    os << "\"" << ftp::Metrics::MetricName(static_cast<ftp::Metric>(i)) << "\":"
+       << snapshot.counters[i];
+  }
+
+  os << "},\"occupancy\":{";
+  for (unsigned i = 0; i < ftp::MetricsHeader::numOccupancies; ++i)
+  {
+    if (i > 0) os << ",";
+    os << "\"" << ftp::Metrics::OccupancyName(static_cast<ftp::Occupancy>(i)) << "\":"
+       << snapshot.occupancy[i];
+  }
+
+  os << "},\"command_latency_microseconds\":{";
+  bool first = true;
+  for (unsigned i = 0; i < ftp::MetricsShard::numVerbs; ++i)
+  {
+    if (snapshot.commands[i].count == 0) continue;
+    if (!first) os << ",";
+    first = false;
+    os << "\"" << ftp::Metrics::VerbName(i) << "\":";
+    JSONHistogram(os, snapshot.commands[i]);
+  }
+
+  os << "},\"db_latency_microseconds\":{";
+  for (unsigned i = 0; i < ftp::MetricsShard::numOperations; ++i)
+  {
+    if (i > 0) os << ",";
+    os << "\"" << db::OperationName(static_cast<db::Operation>(i)) << "\":";
+    JSONHistogram(os, snapshot.database[i]);
+  }
+  os << "}}\n";
+}
+
+int main(int argc, char** argv)
+{
+  std::string configPath;
+  std::string format;
+
+  if (!ParseOptions(argc, argv, configPath, format))
+  {
+    return 1;
+  }
+
+  try
+  {
+    cfg::UpdateShared(cfg::Config::Load(configPath, true));
+  }
+  catch (const cfg::ConfigError& e)
+  {
+    std::cerr << "Failed to load config: " << e.Message() << std::endl;
+    return 1;
+  }
+
+  if (cfg::Get().Pidfile().empty())
+  {
+    std::cerr << "There must be a pid file set in your config to use this tool." << std::endl;
+    return 1;
+  }
+
+  std::string id;
+  if (!ftp::SharedMemoryID(cfg::Get().Pidfile(), id))
+  {
+    std::cerr << "Unable to load pid from pid file: " << cfg::Get().Pidfile() << std::endl;
+    return 1;
+  }
+
+  ftp::MetricsReader reader(ftp::MetricsSharedMemoryID(id));
+  if (!reader.Valid())
+  {
+    std::cerr << "Unable to open metrics, the server may not be running." << std::endl;
+    return 1;
+  }
+
+  ftp::MetricsSnapshot snapshot(reader.Snapshot());
+  if (format == "json") JSON(std::cout, snapshot);
+  else Prometheus(std::cout, snapshot);
+
+  return 0;
+}
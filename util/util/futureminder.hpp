@@ -5,6 +5,7 @@
 #include <algorithm>
 #include <chrono>
 #include <boost/thread/once.hpp>
+#include <boost/thread/thread.hpp>
 #include <future>
 
 namespace util
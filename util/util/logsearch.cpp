@@ -0,0 +1,291 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <future>
+#include <iterator>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#if defined(__SSE2__)
+# include <emmintrin.h>
+#endif
+#include "util/logsearch.hpp"
+#include "util/error.hpp"
+#include "util/threadpool.hpp"
+
+namespace util
+{
+
+namespace
+{
+
+// chunks start small so a few recent lines are found quickly, and
+// grow each round for searches that go further back
+const size_t firstChunkSize = 64 * 1024;
+const size_t maxChunkSize = 4 * 1024 * 1024;
+
+inline char Lower(char ch)
+{
+  return ch >= 'A' && ch <= 'Z' ? ch + ('a' - 'A') : ch;
+}
+
+inline char Upper(char ch)
+{
+  return ch >= 'a' && ch <= 'z' ? ch - ('a' - 'A') : ch;
+}
+
+inline bool EqualLower(const char* s, const char* lower, size_t len)
+{
+  for (size_t i = 0; i < len; ++i)
+  {
+    if (Lower(s[i]) != lower[i]) return false;
+  }
+  return true;
+}
+
+// first occurrence of a lower case term in [p, end) ignoring case. blocks
+// of 16 are tested for the term's first and last characters at once and
+// only positions matching both are compared in full
+const char* Find(const char* p, const char* end, const std::string& term)
+{
+  size_t len = term.length();
+  if (len == 0) return p;
+  if (static_cast<size_t>(end - p) < len) return nullptr;
+
+  const char* last = end - len; // last possible start
+  char first = term[0];
+  char final = term[len - 1];
+
+#if defined(__SSE2__)
+  const __m128i firstLower = _mm_set1_epi8(first);
+  const __m128i firstUpper = _mm_set1_epi8(Upper(first));
+  const __m128i finalLower = _mm_set1_epi8(final);
+  const __m128i finalUpper = _mm_set1_epi8(Upper(final));
+
+  for (; p + 16 <= last + 1; p += 16)
+  {
+    __m128i head = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    __m128i tail = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + len - 1));
+    __m128i eq = _mm_and_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(head, firstLower), _mm_cmpeq_epi8(head, firstUpper)),
+        _mm_or_si128(_mm_cmpeq_epi8(tail, finalLower), _mm_cmpeq_epi8(tail, finalUpper)));
+
+    unsigned mask = _mm_movemask_epi8(eq);
+    while (mask)
+    {
+      int bit = __builtin_ctz(mask);
+      if (EqualLower(p + bit + 1, term.data() + 1, len - 2 + (len == 1))) return p + bit;
+      mask &= mask - 1;
+    }
+  }
+#endif
+
+  for (; p <= last; ++p)
+  {
+    if (Lower(*p) == first && Lower(p[len - 1]) == final &&
+        EqualLower(p + 1, term.data() + 1, len - 2 + (len == 1)))
+      return p;
+  }
+
+  return nullptr;
+}
+
+inline const char* LineBegin(const char* begin, const char* p)
+{
+  const char* nl = static_cast<const char*>(memrchr(begin, '\n', p - begin));
+  return nl ? nl + 1 : begin;
+}
+
+inline const char* LineEnd(const char* p, const char* end)
+{
+  const char* nl = static_cast<const char*>(memchr(p, '\n', end - p));
+  return nl ? nl : end;
+}
+
+inline size_t LineLength(const char* begin, const char* end)
+{
+  if (end > begin && end[-1] == '\r') --end;
+  return end - begin;
+}
+
+}
+
+LogSearch::LogSearch(const std::string& path, const std::vector<std::string>& terms) :
+  fd(-1), size(0), terms(terms)
+{
+  // longest term first, it's the one searched for, the rest are
+  // only checked on lines containing it
+  std::stable_sort(this->terms.begin(), this->terms.end(),
+                   [](const std::string& a, const std::string& b) { return a.length() > b.length(); });
+
+  fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) throw util::SystemError(errno);
+
+  struct stat st;
+  if (fstat(fd, &st) < 0)
+  {
+    int errno_ = errno;
+    close(fd);
+    throw util::SystemError(errno_);
+  }
+
+  size = st.st_size;
+}
+
+LogSearch::~LogSearch()
+{
+  if (fd >= 0) close(fd);
+}
+
+// reads the whole lines that end at end, at least length bytes of them
+// unless the file start is reached, and moves end back to where they
+// begin. false if the file was truncated under us or couldn't be read
+bool LogSearch::ReadChunk(off_t& end, size_t length, std::string& buffer) const
+{
+  while (true)
+  {
+    off_t begin = end > static_cast<off_t>(length) ? end - length : 0;
+    buffer.resize(end - begin);
+
+    size_t done = 0;
+    while (done < buffer.size())
+    {
+      ssize_t len = pread(fd, &buffer[done], buffer.size() - done, begin + done);
+      if (len < 0 && errno == EINTR) continue;
+      if (len <= 0) return false;
+      done += len;
+    }
+
+    if (begin == 0)
+    {
+      end = 0;
+      return true;
+    }
+
+    // drop the line that started before the chunk, unless
+    // that leaves nothing, then the chunk must grow
+    const char* nl = static_cast<const char*>(memchr(buffer.data(), '\n', buffer.size()));
+    if (nl && nl + 1 < buffer.data() + buffer.size())
+    {
+      size_t skip = nl + 1 - buffer.data();
+      buffer.erase(0, skip);
+      end = begin + skip;
+      return true;
+    }
+
+    length *= 2;
+  }
+}
+
+std::vector<std::string> LogSearch::Scan(const char* begin, const char* end, size_t max) const
+{
+  std::vector<Line> lines;
+  const char* p = begin;
+  while (p < end)
+  {
+    const char* match = Find(p, end, terms.front());
+    if (!match) break;
+
+    const char* lineBegin = LineBegin(std::max(begin, p), match);
+    const char* lineEnd = LineEnd(match, end);
+    bool okay = true;
+    for (auto it = terms.begin() + 1; it != terms.end() && okay; ++it)
+    {
+      okay = Find(lineBegin, lineEnd, *it) != nullptr;
+    }
+
+    size_t len = LineLength(lineBegin, lineEnd);
+    if (okay && len > 0) lines.emplace_back(lineBegin, len);
+    p = lineEnd + 1;
+  }
+
+  // only the newest are wanted
+  if (lines.size() > max) lines.erase(lines.begin(), lines.end() - max);
+  
+  std::vector<std::string> found;
+  found.reserve(lines.size());
+  for (const Line& line : lines)
+  {
+    found.emplace_back(line.first, line.second);
+  }
+  return found;
+}
+
+std::vector<std::string> LogSearch::Tail(size_t max) const
+{
+  std::vector<std::string> lines;
+  std::string buffer;
+  off_t chunkEnd = size;
+  while (chunkEnd > 0 && lines.size() < max && ReadChunk(chunkEnd, firstChunkSize, buffer))
+  {
+    const char* data = buffer.data();
+    const char* end = data + buffer.size();
+    while (end > data && lines.size() < max)
+    {
+      const char* begin = LineBegin(data, end);
+      size_t len = LineLength(begin, end);
+      if (len > 0) lines.emplace_back(begin, len);
+      end = begin > data ? begin - 1 : data;
+    }
+  }
+
+  std::reverse(lines.begin(), lines.end());
+  return lines;
+}
+
+std::vector<std::string> LogSearch::Last(size_t max, ThreadPool* pool) const
+{
+  std::vector<std::string> found;
+  if (size == 0 || max == 0) return found;
+  if (terms.empty()) return Tail(max);
+  
+  // each round reads one chunk per thread, newest first, and scans
+  // them at once. a truncate ends the search with what's been found
+  unsigned concurrency = pool ? std::max(1u, pool->Size()) : 1;
+  std::vector<std::vector<std::string>> newest;
+  size_t count = 0;
+  size_t chunkSize = firstChunkSize;
+  off_t end = size;
+  while (end > 0 && count < max)
+  {
+    std::vector<std::string> chunks;
+    while (end > 0 && chunks.size() < concurrency)
+    {
+      std::string buffer;
+      if (!ReadChunk(end, chunkSize, buffer))
+      {
+        end = 0;
+        break;
+      }
+      chunks.emplace_back(std::move(buffer));
+    }
+    chunkSize = std::min(chunkSize * 4, maxChunkSize);
+    if (chunks.empty()) break;
+
+    std::vector<std::future<std::vector<std::string>>> results;
+    for (size_t i = 1; i < chunks.size(); ++i)
+    {
+      const std::string* chunk = &chunks[i];
+      results.emplace_back(pool->Submit([this, chunk, max]()
+                           { return Scan(chunk->data(), chunk->data() + chunk->size(), max); }));
+    }
+
+    newest.emplace_back(Scan(chunks[0].data(), chunks[0].data() + chunks[0].size(), max));
+    count += newest.back().size();
+    for (auto& result : results)
+    {
+      newest.emplace_back(result.get());
+      count += newest.back().size();
+    }
+  }
+
+  for (auto it = newest.rbegin(); it != newest.rend(); ++it)
+  {
+    std::move(it->begin(), it->end(), std::back_inserter(found));
+  }
+
+  if (found.size() > max) found.erase(found.begin(), found.end() - max);
+  return found;
+}
+
+} /* util namespace */
@@ -0,0 +1,41 @@
+#ifndef __UTIL_LOGSEARCH_HPP
+#define __UTIL_LOGSEARCH_HPP
+
+#include <string>
+#include <utility>
+#include <vector>
+#include <sys/types.h>
+
+namespace util
+{
+
+class ThreadPool;
+
+// finds the most recent lines of a log file that contain every one of a
+// set of terms, ignoring ascii case. the file is read and scanned from
+// the end in large chunks, several at once given a pool, stopping as soon
+// as enough lines are found
+class LogSearch
+{
+  typedef std::pair<const char*, size_t> Line;
+
+  int fd;
+  off_t size;
+  std::vector<std::string> terms;
+
+  bool ReadChunk(off_t& end, size_t length, std::string& buffer) const;
+  std::vector<std::string> Scan(const char* begin, const char* end, size_t max) const;
+  std::vector<std::string> Tail(size_t max) const;
+
+public:
+  // terms must already be lower case, throws util::SystemError
+  LogSearch(const std::string& path, const std::vector<std::string>& terms);
+  ~LogSearch();
+
+  // up to max matching lines, oldest first
+  std::vector<std::string> Last(size_t max, ThreadPool* pool = nullptr) const;
+};
+
+} /* util namespace */
+
+#endif
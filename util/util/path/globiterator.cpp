@@ -1,5 +1,4 @@
 #include <algorithm>
-#include <fnmatch.h>
 #include <boost/bind.hpp>
 #include "util/path/globiterator.hpp"
 #include "util/path/diriterator.hpp"
@@ -9,6 +8,7 @@
 #include "util/path/status.hpp"
 #include "util/path/path.hpp"
 #include "util/verify.hpp"
+#include "util/wildcard.hpp"
 
 namespace util { namespace path
 {
@@ -16,20 +16,15 @@ namespace util { namespace path
 namespace
 {
 
-bool Filter(const std::string& path, const std::string& mask, bool lastToken,
+// the compiled mask is tried before anything else, only entries it matches
+// are stat'd and then only when a directory is required
+bool Filter(const std::string& path, const Wildcard& mask, bool lastToken,
             const std::function<bool(const std::string&)>& filter)
 {
-  if (filter && !filter(path)) return false;
-  if (!IsDirectory(path))
-  {
-    if (!lastToken) return false;
-    return !fnmatch(mask.c_str(), path.c_str(), 0);
-  }
-  else
-  if (mask.back() == '/')
-    return !fnmatch(mask.c_str(), (path + "/").c_str(), FNM_PATHNAME);
-  else
-    return !fnmatch(mask.c_str(), path.c_str(), 0);
+  bool trailingSlash = mask.Pattern().back() == '/';
+  if (trailingSlash ? !mask.Match(path + "/") : !mask.Match(path)) return false;
+  if ((!lastToken || trailingSlash) && !IsDirectory(path)) return false;
+  return !filter || filter(path);
 }
 
 bool IsWildcard(const std::string& pathToken)
@@ -171,8 +166,10 @@ DirIterator* GlobIterator::SubIterator::BeginIterator(bool recursive, Args&&...
 
 DirIterator* GlobIterator::SubIterator::BeginIterator(bool recursive)
 {
+  std::string fullMask(util::path::Join(path, *mask));
+  Wildcard wildcard(fullMask, fullMask.back() == '/' ? Wildcard::PathName : Wildcard::NoFlags);
   return BeginIterator(recursive, path, boost::bind(&Filter, _1, 
-                util::path::Join(path, *mask), lastToken, filter), false);
+                wildcard, lastToken, filter), false);
 }
 
 DirIterator* GlobIterator::SubIterator::EndIterator(bool recursive)
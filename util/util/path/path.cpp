@@ -1,3 +1,4 @@
+#include <cstring>
 #include <glob.h>
 #include <fnmatch.h>
 #include <stdexcept>
@@ -69,29 +70,55 @@ std::string JoinSegments(const std::vector<std::string>& segments)
   return result;
 }
 
-std::string Resolve(const std::string& path)
+void ResolveInPlace(std::string& path)
 {
-  if (path.empty()) return std::string();
+  if (path.empty()) return;
   bool absolute = path[0] == '/';
-  
-  std::vector<std::string> segments;
-  SplitSegments(path, segments);
-  for (auto it = segments.begin(); it != segments.end();)
+
+  // segments are compacted towards the front of the string as they're
+  // read, the write position never passes the read position
+  std::string::size_type out = 0;
+  std::string::size_type in = 0;
+  std::string::size_type len = path.length();
+  while (in < len)
   {
-    if (*it == ".") it = segments.erase(it);
-    else if (*it == "..")
+    if (path[in] == '/')
     {
-      if (it == segments.begin()) segments.erase(it);
-      else it = segments.erase(it - 1, it + 1);
+      ++in;
+      continue;
+    }
+
+    std::string::size_type end = path.find('/', in);
+    if (end == std::string::npos) end = len;
+
+    std::string::size_type segLen = end - in;
+    if (segLen == 1 && path[in] == '.') { }
+    else if (segLen == 2 && path[in] == '.' && path[in + 1] == '.')
+    {
+      if (out > 0)
+      {
+        std::string::size_type pos = path.rfind('/', out - 1);
+        out = pos == std::string::npos ? 0 : pos;
+      }
     }
     else
-      ++it;
+    {
+      if (absolute || out > 0) path[out++] = '/';
+      if (out != in) memmove(&path[out], &path[in], segLen);
+      out += segLen;
+    }
+
+    in = end;
   }
-  
-  std::string result(JoinSegments(segments));
-  if (result.empty()) return "/";
-  if (absolute && result[0] != '/') result.insert(0, 1, '/');
-  TrimTrailingSlash(result);
+
+  path.resize(out);
+  if (path.empty()) path = "/";
+}
+
+std::string Resolve(const std::string& path)
+{
+  std::string result(path);
+  ResolveInPlace(result);
   return result;
 }
 
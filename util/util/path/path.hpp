@@ -9,6 +9,7 @@ namespace util { namespace path
 
 void TrimTrailingSlash(std::string& path, bool keepRootSlash = true);
 std::string TrimTrailingSlashCopy(const std::string& path, bool keepRootSlash = true);
+void ResolveInPlace(std::string& path);
 std::string Resolve(const std::string& path);
 std::string Join(const std::string& path1, const std::string& path2);
 std::string Append(const std::string& path1, const std::string& path2);
@@ -1,4 +1,5 @@
 #include <unistd.h>
+#include <fcntl.h>
 #include <cerrno>
 #include <sys/statvfs.h>
 #include "util/path/status.hpp"
@@ -23,6 +24,27 @@ Status::Status(const std::string& path) :
   Reset();
 }
 
+Status::Status(int dirfd, const std::string& name) :
+  path(name),
+  linkDirectory(false),
+  linkRegularFile(false),
+  statOkay(false)
+{
+  if (fstatat(dirfd, name.c_str(), &native, AT_SYMLINK_NOFOLLOW) < 0)
+    throw util::SystemError(errno);
+  
+  if (IsSymLink())
+  {
+    struct stat st;
+    if (fstatat(dirfd, name.c_str(), &st, 0) == 0)
+    {
+      if (S_ISDIR(st.st_mode)) linkDirectory = true;
+      else if (S_ISREG(st.st_mode)) linkRegularFile = true;
+    }
+  }
+  statOkay = true;
+}
+
 Status& Status::Reset()
 {
   if (path.empty()) throw std::logic_error("no path set");
@@ -25,6 +25,8 @@ class Status
 public:
   Status();
   Status(const std::string& path);
+  // stat name relative to an open directory descriptor
+  Status(int dirfd, const std::string& name);
   
   Status& Reset(const std::string& path);
   
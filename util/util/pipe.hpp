@@ -2,6 +2,7 @@
 #define __UTIL_PIPE_HPP
 
 #include <unistd.h>
+#include <fcntl.h>
 #include <cerrno>
 #include <boost/noncopyable.hpp>
 #include "util/error.hpp"
@@ -9,14 +10,27 @@
 namespace util
 {
 
+// both ends are close on exec, anything passed to a child process must
+// be duplicated to the descriptor it's expected on
 class Pipe : boost::noncopyable
 {
   int fds[2];
 
+  void Create()
+  {
+#if defined(__linux__)
+    if (pipe2(fds, O_CLOEXEC) < 0) throw SystemError(errno);
+#else
+    if (pipe(fds) < 0) throw SystemError(errno);
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+#endif
+  }
+
 public:
   Pipe()
   {
-    if (pipe(fds) < 0) throw SystemError(errno);
+    Create();
   }
   
   int ReadFd() const { return fds[0]; }
@@ -54,7 +68,7 @@ public:
   void Reset()
   {
     Close();
-    if (pipe(fds) < 0) throw SystemError(errno);
+    Create();
   }
 };
 
@@ -3,6 +3,7 @@
 #include <unistd.h>
 #include <boost/thread/thread.hpp>
 #include "util/processreader.hpp"
+#include "util/spawn.hpp"
 
 namespace util
 {
@@ -38,42 +39,20 @@ void ProcessReader::Open()
   }
 
   pipe.reset(new util::Pipe());
-  util::Pipe errorPipe;
-  
-  if (fcntl(errorPipe.WriteFd(), F_SETFD, fcntl(errorPipe.WriteFd(), F_GETFD) | FD_CLOEXEC) < 0)
-   throw util::SystemError(errno);
-  
-  pid = fork();
-  if (pid < 0) throw util::SystemError(errno);
-  
-  if (pid)
+
+  try
   {
-    pipe->CloseWrite();
-    errorPipe.CloseWrite();
-    int error;
-    ssize_t len;
-    while ((len = read(errorPipe.ReadFd(), &error, sizeof(error))) < 0)
-      if (errno != EINTR && errno != EAGAIN) break;
-    if (len > 0)
-    {
-      Close(false);
-      throw util::SystemError(error);
-    }
+    // exec failures are thrown here, as they were reported through an
+    // error pipe when the whole daemon was forked
+    pid = util::Spawn(file, argv, env, -1, pipe->WriteFd());
   }
-  else
+  catch (const util::SystemError&)
   {
-    errorPipe.CloseRead();
-    pipe->CloseRead();
-    if (dup2(pipe->WriteFd(), fileno(stdout)) < 0) return;
-
-    execve(file.c_str(), PrepareArgv(argv), PrepareArgv(env));
-    pipe->CloseWrite();
-
-    int error = errno;
-    while (write(errorPipe.WriteFd(), &error, sizeof(error)) < 0)
-      if (errno != EINTR && errno != EAGAIN) break;
-    _exit(1);
+    Close();
+    throw;
   }
+
+  pipe->CloseWrite();
 }
 
 size_t ProcessReader::Read(char* buffer, size_t size, const util::TimePair* timeout)
@@ -161,20 +140,6 @@ bool ProcessReader::Getline(std::string& buffer, const util::TimePair* timeout)
   return true;
 }
 
-char** ProcessReader::PrepareArgv(const ArgvType& argv)
-{
-  char** a = new char*[argv.size() + 1];
-  for (size_t i = 0; i < argv.size(); ++i)
-  {
-    const std::string& s = argv[i];
-    a[i] = new char[s.size() + 1];
-    s.copy(a[i], s.size());
-    a[i][s.size()] = '\0';
-  }
-  a[argv.size()] = nullptr;
-  return a;
-}
-
 ProcessReader::ProcessReader() : 
   pid(-1), exitStatus(-1), eof(false),
   getcharBufferPos(nullptr), getcharBufferLen(0)
@@ -274,3 +239,93 @@ void ProcessReader::Interrupt()
 }
 
 } /* util namespace */
+
+#ifdef PROCESSREADER_TEST
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <sys/wait.h>
+
+// compares Open against the previous fork and execve with a daemon sized
+// resident set and thread count
+// usage: processreadertest [megabytes] [threads]
+
+namespace
+{
+
+void ForkExec(const std::string& file, char** argv, char** env)
+{
+  util::Pipe pipe;
+  pid_t pid = fork();
+  if (pid < 0) throw util::SystemError(errno);
+  if (!pid)
+  {
+    dup2(pipe.WriteFd(), STDOUT_FILENO);
+    execve(file.c_str(), argv, env);
+    _exit(1);
+  }
+
+  pipe.CloseWrite();
+  char buffer[64];
+  while (read(pipe.ReadFd(), buffer, sizeof(buffer)) > 0);
+  while (waitpid(pid, nullptr, 0) < 0 && errno == EINTR);
+}
+
+template <typename Function>
+double Time(Function fn, int iterations)
+{
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) fn();
+  std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count() / iterations;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+  size_t megabytes = argc > 1 ? atoi(argv[1]) : 1024;
+  int threads = argc > 2 ? atoi(argv[2]) : 200;
+  const int iterations = 200;
+
+  std::unique_ptr<char[]> resident(new char[megabytes * 1024 * 1024]);
+  memset(resident.get(), 1, megabytes * 1024 * 1024);
+
+  boost::mutex mutex;
+  mutex.lock();
+  boost::thread_group group;
+  for (int i = 0; i < threads; ++i)
+  {
+    group.create_thread([&mutex]() { boost::lock_guard<boost::mutex> lock(mutex); });
+  }
+
+  const std::string file("/bin/echo");
+  util::ProcessReader::ArgvType args { "echo", "ok" };
+  util::ProcessReader::ArgvType env { "PATH=/bin:/usr/bin" };
+  char* rawArgs[] = { const_cast<char*>("echo"), const_cast<char*>("ok"), nullptr };
+  char* rawEnv[] = { const_cast<char*>("PATH=/bin:/usr/bin"), nullptr };
+
+  double forkMs = Time([&]() { ForkExec(file, rawArgs, rawEnv); }, iterations);
+
+  std::string line;
+  size_t lines = 0;
+  double spawnMs = Time([&]()
+    {
+      util::ProcessReader child(file, args, env);
+      while (child.Getline(line)) ++lines;
+      child.Close(false);
+    }, iterations);
+
+  mutex.unlock();
+  group.join_all();
+
+  std::cout << megabytes << "MB resident, " << threads << " threads" << std::endl;
+  std::cout << "fork + execve:  " << forkMs << "ms" << std::endl;
+  std::cout << "posix_spawn:    " << spawnMs << "ms (" << lines << " lines)" << std::endl;
+  return 0;
+}
+
+#endif
@@ -44,7 +44,6 @@ private:
   size_t Read(char* buffer, size_t size, const util::TimePair* timeout);
   int GetcharBuffered(const util::TimePair* timeout);
   bool Getline(std::string& buffer, const util::TimePair* timeout);
-  static char** PrepareArgv(const ArgvType& argv);
 
 public:
 
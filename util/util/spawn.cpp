@@ -0,0 +1,77 @@
+#include <csignal>
+#include <spawn.h>
+#include <unistd.h>
+#include "util/spawn.hpp"
+#include "util/error.hpp"
+
+namespace util
+{
+
+namespace
+{
+
+// points into the strings, which outlive the spawn
+std::vector<char*> PrepareArgv(const std::vector<std::string>& argv)
+{
+  std::vector<char*> a;
+  a.reserve(argv.size() + 1);
+  for (const std::string& s : argv)
+  {
+    a.emplace_back(const_cast<char*>(s.c_str()));
+  }
+  a.emplace_back(nullptr);
+  return a;
+}
+
+}
+
+pid_t Spawn(const std::string& file, const std::vector<std::string>& argv,
+            const std::vector<std::string>& env, int stdinFd, int stdoutFd)
+{
+  std::vector<char*> argvp(PrepareArgv(argv));
+  std::vector<char*> envp(PrepareArgv(env));
+  
+  posix_spawn_file_actions_t actions;
+  int error = posix_spawn_file_actions_init(&actions);
+  if (error) throw util::SystemError(error);
+  
+  posix_spawnattr_t attr;
+  error = posix_spawnattr_init(&attr);
+  if (error)
+  {
+    posix_spawn_file_actions_destroy(&actions);
+    throw util::SystemError(error);
+  }
+  
+  // everything is blocked in the daemon, so the child must have it
+  // unblocked to be killable
+  sigset_t noSignals;
+  sigset_t allSignals;
+  sigemptyset(&noSignals);
+  sigfillset(&allSignals);
+  
+  if ((stdinFd < 0 || !(error = posix_spawn_file_actions_adddup2(&actions, stdinFd, STDIN_FILENO))) &&
+      (stdoutFd < 0 || !(error = posix_spawn_file_actions_adddup2(&actions, stdoutFd, STDOUT_FILENO))) &&
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 34)
+      !(error = posix_spawn_file_actions_addclosefrom_np(&actions, STDERR_FILENO + 1)) &&
+#endif
+      !(error = posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF)) &&
+      !(error = posix_spawnattr_setsigmask(&attr, &noSignals)) &&
+      !(error = posix_spawnattr_setsigdefault(&attr, &allSignals)))
+  {
+    pid_t pid;
+    error = posix_spawn(&pid, file.c_str(), &actions, &attr, argvp.data(), envp.data());
+    if (!error)
+    {
+      posix_spawnattr_destroy(&attr);
+      posix_spawn_file_actions_destroy(&actions);
+      return pid;
+    }
+  }
+  
+  posix_spawnattr_destroy(&attr);
+  posix_spawn_file_actions_destroy(&actions);
+  throw util::SystemError(error);
+}
+
+} /* util namespace */
@@ -0,0 +1,20 @@
+#ifndef __UTIL_SPAWN_HPP
+#define __UTIL_SPAWN_HPP
+
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+namespace util
+{
+
+// starts a child process without forking the caller. the descriptors
+// given are duplicated onto the child's stdin and stdout, -1 leaves them
+// inherited. the child has no signals blocked and default handlers for
+// all of them. throws util::SystemError, including when exec fails
+pid_t Spawn(const std::string& file, const std::vector<std::string>& argv,
+            const std::vector<std::string>& env, int stdinFd, int stdoutFd);
+
+} /* util namespace */
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef __UTIL_THREADPOOL_HPP
+#define __UTIL_THREADPOOL_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/thread.hpp>
+
+namespace util
+{
+
+class ThreadPool : boost::noncopyable
+{
+  std::mutex mutex;
+  std::condition_variable cond;
+  std::deque<std::function<void()>> queue;
+  boost::thread_group threads;
+  bool stopping;
+
+  void Main()
+  {
+    while (true)
+    {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (queue.empty() && !stopping) cond.wait(lock);
+        if (queue.empty()) return;
+        task = std::move(queue.front());
+        queue.pop_front();
+      }
+
+      task();
+    }
+  }
+
+public:
+  explicit ThreadPool(unsigned size) : stopping(false)
+  {
+    for (unsigned i = 0; i < size; ++i)
+      threads.create_thread(std::bind(&ThreadPool::Main, this));
+  }
+
+  ~ThreadPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+
+    cond.notify_all();
+    threads.join_all();
+  }
+
+  unsigned Size() const { return threads.size(); }
+
+  // queued tasks still run on destruction, exceptions are
+  // delivered through the returned future
+  template <typename Function>
+  std::future<typename std::result_of<Function()>::type> Submit(Function fn)
+  {
+    typedef typename std::result_of<Function()>::type Result;
+    auto task = std::make_shared<std::packaged_task<Result()>>(fn);
+    auto future = task->get_future();
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      queue.emplace_back([task]() { (*task)(); });
+    }
+
+    cond.notify_one();
+    return future;
+  }
+};
+
+} /* util namespace */
+
+#endif
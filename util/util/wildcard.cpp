@@ -0,0 +1,267 @@
+#include <cctype>
+#include <cstring>
+#include "util/wildcard.hpp"
+
+namespace util
+{
+
+namespace
+{
+
+inline unsigned char Fold(unsigned char ch)
+{
+  return ch >= 'A' && ch <= 'Z' ? ch + ('a' - 'A') : ch;
+}
+
+bool IsClass(const std::string& name, int ch)
+{
+  if (name == "alnum") return isalnum(ch);
+  if (name == "alpha") return isalpha(ch);
+  if (name == "blank") return ch == ' ' || ch == '\t';
+  if (name == "cntrl") return iscntrl(ch);
+  if (name == "digit") return isdigit(ch);
+  if (name == "graph") return isgraph(ch);
+  if (name == "lower") return islower(ch);
+  if (name == "print") return isprint(ch);
+  if (name == "punct") return ispunct(ch);
+  if (name == "space") return isspace(ch);
+  if (name == "upper") return isupper(ch);
+  if (name == "xdigit") return isxdigit(ch);
+  return false;
+}
+
+}
+
+Wildcard::Wildcard(const std::string& pattern, Flags flags) :
+  pattern(pattern), flags(flags), invalid(false)
+{
+  Compile();
+}
+
+// returns the position after the closing bracket, or 0 if the set is
+// unterminated in which case the bracket is taken literally. when case
+// folding, members and the tested character are both folded
+size_t Wildcard::CompileSet(size_t pos)
+{
+  std::bitset<256> set;
+  size_t len = pattern.length();
+  size_t i = pos + 1;
+
+  bool negate = i < len && (pattern[i] == '!' || pattern[i] == '^');
+  if (negate) ++i;
+
+  bool first = true;
+  while (true)
+  {
+    if (i >= len) return 0;
+
+    unsigned char ch = pattern[i];
+    if (ch == ']' && !first) break;
+    first = false;
+
+    if (ch == '[' && i + 1 < len && pattern[i + 1] == ':')
+    {
+      // anything that can't be a class name leaves the bracket as a member
+      size_t end = i + 2;
+      while (end < len && pattern[end] >= 'a' && pattern[end] <= 'z') ++end;
+      if (end + 1 < len && pattern[end] == ':' && pattern[end + 1] == ']')
+      {
+        std::string name(pattern, i + 2, end - i - 2);
+        for (int c = 0; c < 256; ++c)
+          if (IsClass(name, c)) set.set(c);
+        i = end + 2;
+        continue;
+      }
+    }
+
+    if (ch == '[' && i + 1 < len && (pattern[i + 1] == '.' || pattern[i + 1] == '='))
+    {
+      // single character collating symbols and equivalence classes only
+      char delim = pattern[i + 1];
+      if (i + 4 >= len || pattern[i + 3] != delim || pattern[i + 4] != ']')
+      {
+        invalid = true;
+        return len;
+      }
+      // glibc compares these unfolded
+      set.set(static_cast<unsigned char>(pattern[i + 2]));
+      i += 5;
+      continue;
+    }
+
+    if (ch == '\\' && i + 1 < len) ch = pattern[++i];
+    if (flags & CaseFold) ch = Fold(ch);
+
+    if (i + 2 < len && pattern[i + 1] == '-' && pattern[i + 2] != ']')
+    {
+      i += 2;
+      unsigned char hi = pattern[i];
+      if (hi == '\\' && i + 1 < len) hi = pattern[++i];
+      if (flags & CaseFold) hi = Fold(hi);
+      for (int c = ch; c <= hi; ++c) set.set(c);
+    }
+    else
+      set.set(ch);
+
+    ++i;
+  }
+
+  if (negate) set.flip();
+  if (flags & PathName) set.reset('/');
+
+  tokens.emplace_back(Token::Set, 0, sets.size());
+  sets.emplace_back(set);
+  return i + 1;
+}
+
+void Wildcard::Compile()
+{
+  size_t len = pattern.length();
+  for (size_t i = 0; i < len; )
+  {
+    unsigned char ch = pattern[i];
+    if (ch == '*')
+    {
+      if (tokens.empty() || tokens.back().type != Token::Star)
+        tokens.emplace_back(Token::Star);
+      ++i;
+      continue;
+    }
+    
+    if (ch == '?')
+    {
+      tokens.emplace_back(Token::Any);
+      ++i;
+      continue;
+    }
+    
+    if (ch == '[')
+    {
+      size_t next = CompileSet(i);
+      if (next != 0)
+      {
+        i = next;
+        continue;
+      }
+    }
+    
+    if (ch == '\\' && i + 1 < len) ch = pattern[++i];
+    tokens.emplace_back(Token::Literal, flags & CaseFold ? Fold(ch) : ch);
+    ++i;
+  }
+
+  hasStar = false;
+  minLength = 0;
+  for (const auto& token : tokens)
+  {
+    if (token.type == Token::Star) hasStar = true;
+    else ++minLength;
+  }
+
+  middleBegin = 0;
+  while (middleBegin < tokens.size() && tokens[middleBegin].type == Token::Literal)
+    prefix += tokens[middleBegin++].ch;
+
+  middleEnd = tokens.size();
+  if (hasStar)
+  {
+    while (tokens[middleEnd - 1].type == Token::Literal) --middleEnd;
+    for (size_t i = middleEnd; i < tokens.size(); ++i)
+      suffix += tokens[i].ch;
+  }
+
+  matchAll = !(flags & PathName) && middleEnd - middleBegin == 1 && 
+             tokens[middleBegin].type == Token::Star;
+}
+
+inline bool Wildcard::MatchOne(const Token& token, unsigned char ch) const
+{
+  switch (token.type)
+  {
+    case Token::Literal :
+      return (flags & CaseFold ? Fold(ch) : ch) == token.ch;
+    case Token::Any     :
+      return !(flags & PathName) || ch != '/';
+    case Token::Set     :
+      return sets[token.set].test(flags & CaseFold ? Fold(ch) : ch);
+    default             :
+      return false;
+  }
+}
+
+// tokens between the literal prefix and suffix against what's left of the
+// string, a mismatch resumes from the most recent star with it consuming
+// one more character. under PathName a star never consumes a slash, so
+// once the most recent star reaches one no match is possible
+bool Wildcard::MatchMiddle(const char* str, size_t len) const
+{
+  size_t ti = middleBegin;
+  size_t si = 0;
+  size_t starTi = std::string::npos;
+  size_t starSi = 0;
+  
+  while (si < len)
+  {
+    if (ti < middleEnd)
+    {
+      const Token& token = tokens[ti];
+      if (token.type == Token::Star)
+      {
+        starTi = ti++;
+        starSi = si;
+        continue;
+      }
+      
+      if (MatchOne(token, str[si]))
+      {
+        ++ti;
+        ++si;
+        continue;
+      }
+    }
+    
+    if (starTi == std::string::npos) return false;
+    if ((flags & PathName) && str[starSi] == '/') return false;
+    ti = starTi + 1;
+    si = ++starSi;
+  }
+  
+  while (ti < middleEnd && tokens[ti].type == Token::Star) ++ti;
+  return ti == middleEnd;
+}
+
+bool Wildcard::Match(const char* str, size_t len) const
+{
+  if (invalid) return false;
+  if (len < minLength || (!hasStar && len != minLength)) return false;
+  
+  if (flags & CaseFold)
+  {
+    for (size_t i = 0; i < prefix.length(); ++i)
+      if (Fold(str[i]) != static_cast<unsigned char>(prefix[i])) return false;
+    
+    const char* tail = str + len - suffix.length();
+    for (size_t i = 0; i < suffix.length(); ++i)
+      if (Fold(tail[i]) != static_cast<unsigned char>(suffix[i])) return false;
+  }
+  else
+  {
+    if (memcmp(str, prefix.data(), prefix.length()) ||
+        memcmp(str + len - suffix.length(), suffix.data(), suffix.length()))
+      return false;
+  }
+  
+  if (matchAll) return true;
+  return MatchMiddle(str + prefix.length(), len - prefix.length() - suffix.length());
+}
+
+int WildcardList::FirstMatch(const std::string& str) const
+{
+  for (size_t i = 0; i < wildcards.size(); ++i)
+  {
+    if (wildcards[i].Match(str)) return i;
+  }
+  return -1;
+}
+
+} /* util namespace */
@@ -0,0 +1,90 @@
+#ifndef __UTIL_WILDCARD_HPP
+#define __UTIL_WILDCARD_HPP
+
+#include <bitset>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace util
+{
+
+// compiled fnmatch(3) style pattern supporting *, ?, [..] sets with ranges,
+// classes and negation and backslash escapes. literal prefixes and suffixes
+// are compared before any wildcard matching is attempted
+class Wildcard
+{
+public:
+  enum Flags { NoFlags = 0, CaseFold = 1 << 0, PathName = 1 << 1 };
+
+private:
+  struct Token
+  {
+    enum Type : uint8_t { Literal, Any, Star, Set };
+
+    Type type;
+    unsigned char ch;
+    uint16_t set;
+
+    Token(Type type, unsigned char ch = 0, uint16_t set = 0) :
+      type(type), ch(ch), set(set) { }
+  };
+
+  std::string pattern;
+  Flags flags;
+  std::vector<Token> tokens;
+  std::vector<std::bitset<256>> sets;
+  std::string prefix;
+  std::string suffix;
+  size_t middleBegin;
+  size_t middleEnd;
+  size_t minLength;
+  bool hasStar;
+  bool matchAll;
+  bool invalid;
+
+  void Compile();
+  size_t CompileSet(size_t pos);
+  bool MatchOne(const Token& token, unsigned char ch) const;
+  bool MatchMiddle(const char* str, size_t len) const;
+
+public:
+  Wildcard() : flags(NoFlags), middleBegin(0), middleEnd(0), minLength(0),
+               hasStar(false), matchAll(false), invalid(false) { }
+  explicit Wildcard(const std::string& pattern, Flags flags = NoFlags);
+
+  bool Match(const char* str, size_t len) const;
+  bool Match(const std::string& str) const { return Match(str.data(), str.length()); }
+
+  const std::string& Pattern() const { return pattern; }
+};
+
+// many patterns matched against a single string
+class WildcardList
+{
+  std::vector<Wildcard> wildcards;
+
+public:
+  WildcardList() = default;
+
+  template <typename Container>
+  explicit WildcardList(const Container& patterns, Wildcard::Flags flags = Wildcard::NoFlags)
+  {
+    for (const auto& pattern : patterns) Add(pattern, flags);
+  }
+
+  void Add(const std::string& pattern, Wildcard::Flags flags = Wildcard::NoFlags)
+  { wildcards.emplace_back(pattern, flags); }
+
+  // index of the first matching pattern, or -1 if none match
+  int FirstMatch(const std::string& str) const;
+  bool MatchAny(const std::string& str) const { return FirstMatch(str) != -1; }
+
+  bool Empty() const { return wildcards.empty(); }
+  size_t Size() const { return wildcards.size(); }
+  const Wildcard& operator[](size_t index) const { return wildcards[index]; }
+};
+
+} /* util namespace */
+
+#endif